@@ -4,8 +4,8 @@ set SOURCE_DIR=%MY_DIR%external\llvm\llvm
 
 set PROJECTS=lld
 set TARGETS=X86;ARM;AArch64
-set BINARIES=llvm-mc.exe llvm-objcopy.exe llvm-strip.exe lld.exe llc.exe
-set PDBS=llvm-mc.pdb llvm-objcopy.pdb llvm-strip.pdb lld.pdb llc.pdb
+set BINARIES=llvm-mc.exe llvm-objcopy.exe llvm-strip.exe lld.exe llc.exe llvm-split.exe llvm-nm.exe
+set PDBS=llvm-mc.pdb llvm-objcopy.pdb llvm-strip.pdb lld.pdb llc.pdb llvm-split.pdb llvm-nm.pdb
 
 set HOST_BUILD_DIR=%BUILD_DIR%\%HOST%\llvm
 set HOST_BIN_DIR=%HOST_BUILD_DIR%\Release\bin
@@ -68,19 +68,25 @@ IF %ERRORLEVEL% GEQ 1 EXIT /B 4
 msbuild /p:Configuration=Release /m tools\llc\llc.vcxproj
 IF %ERRORLEVEL% GEQ 1 EXIT /B 5
 
-copy %HOST_BIN_DIR%\llvm-objcopy.exe %HOST_BIN_DIR%\llvm-strip.exe
+msbuild /p:Configuration=Release /m tools\llvm-split\llvm-split.vcxproj
 IF %ERRORLEVEL% GEQ 1 EXIT /B 6
 
-copy %HOST_BIN_DIR%\llvm-objcopy.pdb %HOST_BIN_DIR%\llvm-strip.pdb
+msbuild /p:Configuration=Release /m tools\llvm-nm\llvm-nm.vcxproj
 IF %ERRORLEVEL% GEQ 1 EXIT /B 7
 
+copy %HOST_BIN_DIR%\llvm-objcopy.exe %HOST_BIN_DIR%\llvm-strip.exe
+IF %ERRORLEVEL% GEQ 1 EXIT /B 8
+
+copy %HOST_BIN_DIR%\llvm-objcopy.pdb %HOST_BIN_DIR%\llvm-strip.pdb
+IF %ERRORLEVEL% GEQ 1 EXIT /B 9
+
 for %%b in (%BINARIES%) DO (
   copy %HOST_BIN_DIR%\%%b %HOST_ARTIFACTS_BIN_DIR%\%%b
-  IF %ERRORLEVEL% GEQ 1 EXIT /B 8
+  IF %ERRORLEVEL% GEQ 1 EXIT /B 10
 )
 for %%p in (%PDBS%) DO (
   copy %HOST_BIN_DIR%\%%p %HOST_ARTIFACTS_BIN_DIR%\%%p
-  IF %ERRORLEVEL% GEQ 1 EXIT /B 9
+  IF %ERRORLEVEL% GEQ 1 EXIT /B 11
 )
 
 cd %MY_DIR%
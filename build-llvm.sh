@@ -17,6 +17,39 @@ LLVM_VERSION_FILE="${HOST_ARTIFACTS_DIR}/llvm-version.txt"
 
 SOURCE_DIR="${MY_DIR}/external/llvm/llvm"
 
+#
+# mimalloc is an optional replacement of the system allocator which `as` can preload into `llvm-mc` and `ld`
+# (see its `--child-allocator` option).  Set BUILD_MIMALLOC=yes to build it along with LLVM.  The sources are
+# fetched by commit, not by the (mutable) tag, and the checked out commit is verified before building.  When the sources
+# are fetched, the upstream `v${MIMALLOC_VERSION}` tag must also resolve to MIMALLOC_COMMIT, so that the version and
+# the commit can't disagree.
+#
+MIMALLOC_VERSION="2.1.7"
+MIMALLOC_COMMIT="8c532c32c3c96e5ba1f2283e032f69ead8add00f"
+MIMALLOC_URL="https://github.com/microsoft/mimalloc.git"
+MIMALLOC_SOURCE_DIR="${BUILD_DIR}/mimalloc-source"
+MIMALLOC_BUILD_DIR="${BUILD_DIR}/mimalloc"
+
+#
+# Set LLVM_PGO=yes to build llvm-mc, lld and llc optimized with a profile collected while compiling, assembling and
+# linking Mono AOT-like code (tools/pgo-workload.py), plus ThinLTO.  This needs clang, ld.lld and llvm-profdata
+# (override with LLVM_PROFDATA) of the same version on the host and runs three stages:
+#
+#   1. build an instrumented LLVM
+#   2. run it over the training corpus (generated, or PGO_TRAINING_CORPUS laid out as described in the script) for all
+#      the Android targets and merge the collected profiles
+#   3. rebuild the tools with the merged profile and ThinLTO
+#
+# The optimized tools are then compared with a plain build made with the same compiler, and the report is written to
+# the artifacts directory.
+#
+PGO_BASELINE_BUILD_DIR="${BUILD_DIR}/llvm-baseline"
+PGO_INSTRUMENTED_BUILD_DIR="${BUILD_DIR}/llvm-instrumented"
+PGO_PROFILE_DIR="${BUILD_DIR}/llvm-profiles"
+PGO_WORK_DIR="${BUILD_DIR}/pgo-work"
+PGO_WORKLOAD="${MY_DIR}/tools/pgo-workload.py"
+PGO_REPORT_FILE="${HOST_ARTIFACTS_DIR}/pgo-benchmark.txt"
+
 function configure()
 {
 	local cflags="-D_LARGEFILE_SOURCE -D_FILE_OFFSET_BITS=64"
@@ -60,14 +93,15 @@ function configure()
 
 function configure_linux()
 {
-	configure
+	configure "$@"
 }
 
 function configure_darwin()
 {
 	configure -DCMAKE_OSX_SYSROOT="$(xcrun --show-sdk-path)" \
               -DCMAKE_OSX_DEPLOYMENT_TARGET="${MACOS_TARGET}" \
-              -DCMAKE_OSX_ARCHITECTURES='arm64;x86_64'
+              -DCMAKE_OSX_ARCHITECTURES='arm64;x86_64' \
+              "$@"
 }
 
 function copy_libs()
@@ -95,6 +129,8 @@ function build()
 	ninja -j${JOBS} llvm-mc
 	ninja -j${JOBS} lld
 	ninja -j${JOBS} llc
+	ninja -j${JOBS} llvm-split
+	ninja -j${JOBS} llvm-nm
 
 	cp -P -a "${HOST_BIN_DIR}/llvm-objcopy" "${HOST_BIN_DIR}/llvm-strip"
 	grep 'CMAKE_PROJECT_VERSION:' "${MY_BUILD_DIR}/CMakeCache.txt" | cut -d '=' -f 2 > "${LLVM_VERSION_FILE}"
@@ -111,6 +147,121 @@ function build()
 	fi
 }
 
+function build_mimalloc()
+{
+	local extension
+
+	local commit
+	if [ -d "${MIMALLOC_SOURCE_DIR}/.git" ]; then
+		commit="$(git -C "${MIMALLOC_SOURCE_DIR}" rev-parse HEAD)"
+	fi
+
+	if [ "${commit}" != "${MIMALLOC_COMMIT}" ]; then
+		# Annotated tags are listed twice, the `^{}` entry is the commit the tag points to
+		local tag_commit
+		tag_commit="$(git ls-remote "${MIMALLOC_URL}" "refs/tags/v${MIMALLOC_VERSION}" "refs/tags/v${MIMALLOC_VERSION}^{}" | sort -k2 | tail -n 1 | cut -f 1)"
+		if [ -z "${tag_commit}" ]; then
+			die "Unable to resolve mimalloc tag v${MIMALLOC_VERSION} in ${MIMALLOC_URL}"
+		fi
+		if [ "${tag_commit}" != "${MIMALLOC_COMMIT}" ]; then
+			die "mimalloc tag v${MIMALLOC_VERSION} points to commit ${tag_commit}, expected ${MIMALLOC_COMMIT}"
+		fi
+
+		create_empty_dir "${MIMALLOC_SOURCE_DIR}"
+		git -C "${MIMALLOC_SOURCE_DIR}" init -q
+		git -C "${MIMALLOC_SOURCE_DIR}" fetch -q --depth 1 "${MIMALLOC_URL}" "${MIMALLOC_COMMIT}"
+		git -C "${MIMALLOC_SOURCE_DIR}" checkout -q --detach FETCH_HEAD
+
+		commit="$(git -C "${MIMALLOC_SOURCE_DIR}" rev-parse HEAD)"
+		if [ "${commit}" != "${MIMALLOC_COMMIT}" ]; then
+			die "mimalloc ${MIMALLOC_VERSION} source is at commit ${commit}, expected ${MIMALLOC_COMMIT}"
+		fi
+	fi
+
+	# Local modifications would make the build differ from the pinned sources
+	if [ -n "$(git -C "${MIMALLOC_SOURCE_DIR}" status --porcelain)" ]; then
+		die "mimalloc source in ${MIMALLOC_SOURCE_DIR} has local modifications"
+	fi
+
+	create_empty_dir "${MIMALLOC_BUILD_DIR}"
+
+	local osx_args=
+	if [ "${HOST}" == "darwin" ]; then
+		osx_args="-DCMAKE_OSX_DEPLOYMENT_TARGET=${MACOS_TARGET} -DCMAKE_OSX_ARCHITECTURES=arm64;x86_64"
+		extension="dylib"
+	else
+		extension="so"
+	fi
+
+	set -x
+	(cd "${MIMALLOC_BUILD_DIR}"; \
+	 cmake -G Ninja \
+		   -DCMAKE_BUILD_TYPE=Release \
+		   -DMI_BUILD_SHARED=ON \
+		   -DMI_BUILD_STATIC=OFF \
+		   -DMI_BUILD_OBJECT=OFF \
+		   -DMI_BUILD_TESTS=OFF \
+		   -DMI_OVERRIDE=ON \
+		   ${osx_args} \
+		   "${MIMALLOC_SOURCE_DIR}" && \
+	 ninja -j${JOBS})
+	set +x
+
+	# `as` looks for the unversioned name
+	cp -L "${MIMALLOC_BUILD_DIR}/libmimalloc.${extension}" "${HOST_ARTIFACTS_LIB_DIR}/libmimalloc.${extension}"
+	if [ "${HOST}" == "linux" ]; then
+		strip "${HOST_ARTIFACTS_LIB_DIR}/libmimalloc.${extension}"
+	fi
+}
+
+function build_pgo_tools()
+{
+	local build_dir="${1}"
+	shift
+
+	create_empty_dir "${build_dir}"
+	(cd "${build_dir}"; configure_${HOST} "$@")
+	(cd "${build_dir}"; ninja -j${JOBS} llvm-mc lld llc)
+}
+
+function build_pgo()
+{
+	local corpus_dir="${PGO_TRAINING_CORPUS}"
+	local profdata="${LLVM_PROFDATA:-llvm-profdata}"
+	local merged_profile="${PGO_PROFILE_DIR}/merged.profdata"
+
+	if [ "${HOST}" != "linux" ]; then
+		die "PGO builds are supported only on Linux"
+	fi
+
+	export CC=clang
+	export CXX=clang++
+
+	echo "PGO stage 1: building instrumented tools"
+	build_pgo_tools "${PGO_INSTRUMENTED_BUILD_DIR}" -DLLVM_BUILD_INSTRUMENTED=IR -DLLVM_BUILD_RUNTIME=OFF
+
+	echo "PGO stage 2: collecting profile"
+	if [ -z "${corpus_dir}" ]; then
+		corpus_dir="${BUILD_DIR}/pgo-corpus"
+		create_empty_dir "${corpus_dir}"
+		python3 "${PGO_WORKLOAD}" generate "${corpus_dir}"
+	fi
+
+	create_empty_dir "${PGO_PROFILE_DIR}"
+	LLVM_PROFILE_FILE="${PGO_PROFILE_DIR}/%m-%p.profraw" \
+		python3 "${PGO_WORKLOAD}" run "${PGO_INSTRUMENTED_BUILD_DIR}/bin" "${corpus_dir}" "${PGO_WORK_DIR}"
+	"${profdata}" merge -output="${merged_profile}" "${PGO_PROFILE_DIR}"/*.profraw
+
+	echo "PGO stage 3: building optimized tools"
+	(cd "${MY_BUILD_DIR}"; configure_${HOST} -DLLVM_PROFDATA_FILE="${merged_profile}" -DLLVM_ENABLE_LTO=Thin -DLLVM_USE_LINKER=lld)
+	(cd "${MY_BUILD_DIR}"; build)
+
+	echo "Building baseline tools for comparison"
+	build_pgo_tools "${PGO_BASELINE_BUILD_DIR}"
+
+	python3 "${PGO_WORKLOAD}" benchmark "${PGO_BASELINE_BUILD_DIR}/bin" "${HOST_BIN_DIR}" "${corpus_dir}" "${PGO_WORK_DIR}" | tee "${PGO_REPORT_FILE}"
+}
+
 function print_compiler_info()
 {
 	local path="$(which ${1})"
@@ -147,5 +298,13 @@ case "${HOST}" in
 	*) JOBS=1 ;;
 esac
 
-(cd "${MY_BUILD_DIR}"; configure_${HOST})
-(cd "${MY_BUILD_DIR}"; build)
+if [ "${LLVM_PGO}" == "yes" ]; then
+	build_pgo
+else
+	(cd "${MY_BUILD_DIR}"; configure_${HOST})
+	(cd "${MY_BUILD_DIR}"; build)
+fi
+
+if [ "${BUILD_MIMALLOC}" == "yes" ]; then
+	build_mimalloc
+fi
@@ -27,4 +27,10 @@ IF %ERRORLEVEL% GEQ 1 EXIT /B 3
 copy %HOST_BIN_DIR%\as.pdb  %HOST_ARTIFACTS_BIN_DIR%\as.pdb
 IF %ERRORLEVEL% GEQ 1 EXIT /B 4
 
+copy %HOST_BIN_DIR%\llc-split.exe  %HOST_ARTIFACTS_BIN_DIR%\llc-split.exe
+IF %ERRORLEVEL% GEQ 1 EXIT /B 5
+
+copy %HOST_BIN_DIR%\llc-split.pdb  %HOST_ARTIFACTS_BIN_DIR%\llc-split.pdb
+IF %ERRORLEVEL% GEQ 1 EXIT /B 6
+
 cd %MY_DIR%
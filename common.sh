@@ -70,9 +70,9 @@ ARTIFACTS_DIR="${MY_DIR}/artifacts"
 HOST_ARTIFACTS_DIR="${ARTIFACTS_DIR}/${HOST}"
 HOST_ARTIFACTS_BIN_DIR="${HOST_ARTIFACTS_DIR}/bin"
 HOST_ARTIFACTS_LIB_DIR="${HOST_ARTIFACTS_DIR}/lib"
-LLVM_BINARIES="llvm-mc llvm-objcopy llvm-strip lld llc"
+LLVM_BINARIES="llvm-mc llvm-objcopy llvm-strip lld llc llvm-split llvm-nm"
 LLVM_PREFIXED_BINARIES="$(make_prefixed_binaries strip) $(make_prefixed_binaries ld)"
-XA_UTILS_BINARIES="as"
+XA_UTILS_BINARIES="as llc-split"
 XA_UTILS_PREFIXED_BINARIES="$(make_prefixed_binaries as)"
 BINARIES="${LLVM_BINARIES} ${LLVM_PREFIXED_BINARIES} ${XA_UTILS_BINARIES} ${XA_UTILS_PREFIXED_BINARIES}"
 OPERATING_SYSTEMS="linux darwin windows"
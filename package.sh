@@ -120,6 +120,11 @@ function prepare()
 		cp -P -a "${artifacts_source_lib}"/* "${artifacts_dest_lib}"
 		chmod 644 "${artifacts_dest_lib}"/*.*
 	fi
+
+	# Written by PGO builds of LLVM (see build-llvm.sh)
+	if [ -f "${artifacts_source}/pgo-benchmark.txt" ]; then
+		cp "${artifacts_source}/pgo-benchmark.txt" "${PACKAGE_ARTIFACTS_DIR}/${os}/"
+	fi
 }
 
 for os in ${OPERATING_SYSTEMS}; do
@@ -1,3 +1,6 @@
 #!/bin/bash -e
 MY_DIR="$(cd $(dirname $0);pwd)"
+if [ -n "${XA_LD_CACHE_DIR}" ]; then
+	exec "${MY_DIR}"/as @ld-cache "${MY_DIR}"/ld --no-relax "$@"
+fi
 exec "${MY_DIR}"/ld --no-relax "$@"
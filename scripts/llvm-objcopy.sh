@@ -1,3 +1,6 @@
 #!/bin/bash -e
 MY_DIR="$(cd $(dirname $0);pwd)"
+if [ "$1" == "--batch" ]; then
+	exec "${MY_DIR}"/as @batch-strip "${MY_DIR}"/llvm-objcopy "$@"
+fi
 exec "${MY_DIR}"/llvm-objcopy "$@"
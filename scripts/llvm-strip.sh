@@ -1,3 +1,6 @@
 #!/bin/bash -e
 MY_DIR="$(cd $(dirname $0);pwd)"
+if [ "$1" == "--batch" ]; then
+	exec "${MY_DIR}"/as @batch-strip "${MY_DIR}"/llvm-strip "$@"
+fi
 exec "${MY_DIR}"/llvm-strip "$@"
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: MIT
+#include <fstream>
+
+#include "archive_writer.hh"
+#include "elf_object.hh"
+#include "exceptions.hh"
+
+using namespace xamarin::android::gas;
+
+void ArchiveWriter::add_member (fs::path const& object_file)
+{
+	ElfObject object = ElfObject::read (object_file);
+
+	Member member { object_file, fs::file_size (object_file), {} };
+	for (ElfSymbol const& symbol : object.symbols ()) {
+		// Common symbols are indexed too, the same as `ar` does
+		if (symbol.binding () == ElfObject::STB_LOCAL || !symbol.is_defined () || symbol.name.empty ()) {
+			continue;
+		}
+
+		member.symbols.push_back (symbol.name);
+	}
+
+	members.push_back (std::move (member));
+}
+
+void ArchiveWriter::append_header (std::string &out, HeaderKind kind, std::string const& name, uint64_t size)
+{
+	auto append_field = [&out](std::string const& value, size_t width) {
+		out.append (value);
+		out.append (width - value.length (), ' ');
+	};
+
+	// The name table has no timestamp, owner or mode
+	bool name_table = kind == HeaderKind::NameTable;
+	append_field (name, 16);
+	append_field (name_table ? "" : "0", 12); // mtime
+	append_field (name_table ? "" : "0", 6);  // uid
+	append_field (name_table ? "" : "0", 6);  // gid
+	append_field (name_table ? "" : kind == HeaderKind::SymbolIndex ? "0" : "644", 8);
+	append_field (std::to_string (size), 10);
+	out.append ("`\n");
+}
+
+void ArchiveWriter::write (fs::path const& archive_file) const
+{
+	// Member names, either stored in the header (up to 15 characters) or in the long name table.  Thin archives store
+	// all the names in the table, as paths relative to the archive.
+	fs::path archive_dir = archive_file.parent_path ();
+	if (archive_dir.empty ()) {
+		archive_dir = fs::path { "." };
+	}
+
+	std::string long_names;
+	std::vector<std::string> header_names;
+	for (Member const& member : members) {
+		std::string name = thin ? fs::relative (member.path, archive_dir).generic_string () : member.path.filename ().string ();
+		if (!thin && name.length () <= max_short_name_length) {
+			header_names.push_back (name + "/");
+			continue;
+		}
+
+		std::string name_reference { "/" };
+		header_names.push_back (name_reference.append (std::to_string (long_names.length ())));
+		long_names.append (name).append ("/\n");
+	}
+
+	// The symbol index stores the offset of each member's header, the headers follow the index and the name table
+	size_t symbol_count = 0;
+	size_t symbol_names_size = 0;
+	for (Member const& member : members) {
+		symbol_count += member.symbols.size ();
+		for (std::string const& symbol : member.symbols) {
+			symbol_names_size += symbol.length () + 1;
+		}
+	}
+
+	auto member_offsets = [&](uint64_t first_member_offset) {
+		std::vector<uint64_t> offsets;
+		uint64_t offset = first_member_offset;
+		for (Member const& member : members) {
+			offsets.push_back (offset);
+			offset += header_size;
+			if (!thin) {
+				offset += member.size + (member.size % 2);
+			}
+		}
+		return offsets;
+	};
+
+	constexpr std::string_view magic { "!<arch>\n" };
+	constexpr std::string_view thin_magic { "!<thin>\n" };
+
+	// Like `ar`, the padding of the special members is included in their size
+	if (long_names.length () % 2 != 0) {
+		long_names.push_back ('\n');
+	}
+	uint64_t long_names_member_size = long_names.empty () ? 0 : header_size + long_names.length ();
+
+	// 32-bit offsets are used unless the archive is too large for them (`/SYM64/`)
+	bool index64 = false;
+	uint64_t index_size = 0;
+	std::vector<uint64_t> offsets;
+	for (;;) {
+		size_t word_size = index64 ? 8 : 4;
+		index_size = word_size * (symbol_count + 1) + symbol_names_size;
+		index_size += index_size % 2;
+		offsets = member_offsets (magic.length () + header_size + index_size + long_names_member_size);
+		if (index64 || offsets.empty () || offsets.back () <= UINT32_MAX) {
+			break;
+		}
+		index64 = true;
+	}
+
+	std::string head { thin ? thin_magic : magic };
+	if (symbol_count > 0) {
+		append_header (head, HeaderKind::SymbolIndex, index64 ? "/SYM64/" : "/", index_size);
+
+		// Big-endian count and offsets, followed by the NUL-terminated names
+		auto append_word = [&head, index64](uint64_t value) {
+			for (int shift = index64 ? 56 : 24; shift >= 0; shift -= 8) {
+				head.push_back (static_cast<char>((value >> shift) & 0xff));
+			}
+		};
+
+		append_word (symbol_count);
+		for (size_t i = 0; i < members.size (); i++) {
+			for (size_t j = 0; j < members[i].symbols.size (); j++) {
+				append_word (offsets[i]);
+			}
+		}
+
+		for (Member const& member : members) {
+			for (std::string const& symbol : member.symbols) {
+				head.append (symbol).push_back ('\0');
+			}
+		}
+
+		if (symbol_names_size % 2 != 0) {
+			head.push_back ('\0');
+		}
+	} else {
+		// No symbols, no index
+		offsets = member_offsets (magic.length () + long_names_member_size);
+	}
+
+	if (!long_names.empty ()) {
+		append_header (head, HeaderKind::NameTable, "//", long_names.length ());
+		head.append (long_names);
+	}
+
+	std::ofstream os { archive_file, std::ios::binary | std::ios::trunc };
+	if (!os) {
+		throw invalid_operation_error { "Unable to create archive " + archive_file.string () };
+	}
+	os.write (head.data (), static_cast<std::streamsize>(head.length ()));
+
+	std::vector<char> buffer (thin ? 0 : copy_buffer_size);
+	for (size_t i = 0; i < members.size (); i++) {
+		Member const& member = members[i];
+		std::string header;
+		append_header (header, HeaderKind::Member, header_names[i], member.size);
+		os.write (header.data (), static_cast<std::streamsize>(header.length ()));
+		if (thin) {
+			continue;
+		}
+
+		std::ifstream is { member.path, std::ios::binary };
+		uint64_t copied = 0;
+		while (is && copied < member.size) {
+			is.read (buffer.data (), static_cast<std::streamsize>(std::min<uint64_t> (buffer.size (), member.size - copied)));
+			os.write (buffer.data (), is.gcount ());
+			copied += static_cast<uint64_t>(is.gcount ());
+		}
+
+		if (copied != member.size) {
+			throw invalid_operation_error { "Unable to read archive member " + member.path.string () };
+		}
+
+		if (member.size % 2 != 0) {
+			os.put ('\n');
+		}
+	}
+
+	os.close ();
+	if (!os) {
+		throw invalid_operation_error { "Unable to write archive " + archive_file.string () };
+	}
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__ARCHIVE_WRITER_HH)
+#define __ARCHIVE_WRITER_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// Writes GNU `ar` archives of ELF objects, with the symbol index the linker uses to find the members it needs (the
+	// equivalent of `ar rcsD`).  Thin archives store only paths of the member objects (relative to the archive), not
+	// their contents.  Member headers are deterministic (zero timestamps, uid and gid), so that identical inputs give
+	// identical archives.  Errors throw `invalid_operation_error`.
+	class ArchiveWriter final
+	{
+		// Header fields are filled in the same way `ar` does it for each kind of member
+		enum class HeaderKind
+		{
+			Member,
+			SymbolIndex,
+			NameTable,
+		};
+
+		struct Member
+		{
+			fs::path                 path;
+			uint64_t                 size;
+			std::vector<std::string> symbols;
+		};
+
+		static constexpr size_t header_size = 60;
+		static constexpr size_t max_short_name_length = 15;
+		static constexpr size_t copy_buffer_size = 1024 * 1024;
+
+	public:
+		explicit ArchiveWriter (bool thin) noexcept
+			: thin (thin)
+		{}
+
+		// Reads the object's global symbols for the index, the contents are copied (for regular archives) by `write`
+		void add_member (fs::path const& object_file);
+		void write (fs::path const& archive_file) const;
+
+	private:
+		static void append_header (std::string &out, HeaderKind kind, std::string const& name, uint64_t size);
+
+	private:
+		bool                thin;
+		std::vector<Member> members;
+	};
+}
+#endif // __ARCHIVE_WRITER_HH
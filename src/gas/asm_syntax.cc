@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MIT
+#include "asm_syntax.hh"
+
+using namespace xamarin::android::gas;
+
+std::string_view AsmSyntax::trim (std::string_view s) noexcept
+{
+	while (!s.empty () && (s.front () == ' ' || s.front () == '\t' || s.front () == '\r')) {
+		s.remove_prefix (1);
+	}
+
+	while (!s.empty () && (s.back () == ' ' || s.back () == '\t' || s.back () == '\r')) {
+		s.remove_suffix (1);
+	}
+
+	return s;
+}
+
+bool AsmSyntax::is_identifier_start (char c) noexcept
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.' || c == '$';
+}
+
+bool AsmSyntax::is_identifier_char (char c) noexcept
+{
+	return is_identifier_start (c) || (c >= '0' && c <= '9');
+}
+
+std::string_view AsmSyntax::strip_comment (std::string_view line, TargetArchitecture arch, bool &has_block_comment) noexcept
+{
+	bool in_string = false;
+	for (size_t i = 0; i < line.length (); i++) {
+		char c = line[i];
+		if (in_string) {
+			if (c == '\\') {
+				i++;
+			} else if (c == '"') {
+				in_string = false;
+			}
+			continue;
+		}
+
+		if (c == '"') {
+			in_string = true;
+			continue;
+		}
+
+		char next = i + 1 < line.length () ? line[i + 1] : '\0';
+		if (c == '/' && next == '*') {
+			has_block_comment = true;
+			return line.substr (0, i);
+		}
+
+		bool is_comment;
+		switch (arch) {
+			case TargetArchitecture::ARM32:
+				is_comment = c == '@' || (c == '/' && next == '/');
+				break;
+
+			case TargetArchitecture::ARM64:
+				is_comment = c == '/' && next == '/';
+				break;
+
+			default:
+				is_comment = c == '#';
+				break;
+		}
+
+		if (is_comment) {
+			return line.substr (0, i);
+		}
+	}
+
+	return line;
+}
+
+void AsmSyntax::split_statements (std::string_view text, std::vector<std::string_view> &statements)
+{
+	statements.clear ();
+
+	bool in_string = false;
+	size_t start = 0;
+	for (size_t i = 0; i < text.length (); i++) {
+		char c = text[i];
+		if (in_string) {
+			if (c == '\\') {
+				i++;
+			} else if (c == '"') {
+				in_string = false;
+			}
+		} else if (c == '"') {
+			in_string = true;
+		} else if (c == ';') {
+			statements.push_back (text.substr (start, i - start));
+			start = i + 1;
+		}
+	}
+	statements.push_back (text.substr (start));
+}
+
+void AsmSyntax::parse_statement (std::string_view text, Statement &statement)
+{
+	statement.labels.clear ();
+	statement.mnemonic = {};
+	statement.operands = {};
+
+	text = trim (text);
+	while (!text.empty ()) {
+		size_t name_end = 0;
+		while (name_end < text.length () && is_identifier_char (text[name_end])) {
+			name_end++;
+		}
+
+		if (name_end == 0) {
+			break;
+		}
+
+		size_t colon = name_end;
+		while (colon < text.length () && (text[colon] == ' ' || text[colon] == '\t')) {
+			colon++;
+		}
+
+		if (colon >= text.length () || text[colon] != ':' || (colon + 1 < text.length () && text[colon + 1] == ':')) {
+			break;
+		}
+
+		statement.labels.push_back (text.substr (0, name_end));
+		text = trim (text.substr (colon + 1));
+	}
+
+	size_t mnemonic_end = 0;
+	while (mnemonic_end < text.length () && text[mnemonic_end] != ' ' && text[mnemonic_end] != '\t') {
+		mnemonic_end++;
+	}
+
+	statement.mnemonic = text.substr (0, mnemonic_end);
+	statement.operands = trim (text.substr (mnemonic_end));
+}
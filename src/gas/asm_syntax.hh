@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__ASM_SYNTAX_HH)
+#define __ASM_SYNTAX_HH
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <vector>
+
+#include "constants.hh"
+
+namespace xamarin::android::gas
+{
+	// Just enough of the GAS source syntax to find labels, directives and the identifiers they refer to, shared by
+	// the passes which analyze assembler source before it is handed to `llvm-mc`
+	class AsmSyntax final
+	{
+	public:
+		struct Statement
+		{
+			std::vector<std::string_view> labels;
+			std::string_view              mnemonic;
+			std::string_view              operands;
+		};
+
+	public:
+		// Returns the line without its comment.  `has_block_comment` is set if the line starts a `/* */` comment, those
+		// can span lines and aren't tracked (the line is cut at the comment's start).
+		static std::string_view strip_comment (std::string_view line, TargetArchitecture arch, bool &has_block_comment) noexcept;
+
+		// Splits the line (without comments) into statements, which are separated with `;`
+		static void split_statements (std::string_view text, std::vector<std::string_view> &statements);
+		static void parse_statement (std::string_view text, Statement &statement);
+
+		static std::string_view trim (std::string_view s) noexcept;
+		static bool is_identifier_start (char c) noexcept;
+		static bool is_identifier_char (char c) noexcept;
+
+		template<size_t N>
+		static bool is_one_of (std::string_view const& s, std::array<std::string_view, N> const& list) noexcept
+		{
+			return std::find (list.begin (), list.end (), s) != list.end ();
+		}
+	};
+}
+#endif // __ASM_SYNTAX_HH
@@ -0,0 +1,440 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+
+#include "batch_strip.hh"
+#include "constants.hh"
+#include "elf_object.hh"
+#include "file_utils.hh"
+#include "job_scheduler.hh"
+#include "process.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr uint32_t SHT_ARM_ATTRIBUTES = 0x70000003;
+
+	// Sanity limits for the section header checks, anything beyond them is simply processed
+	constexpr uint64_t max_section_count = 0x10000;
+	constexpr uint64_t max_section_names_size = 16 * 1024 * 1024;
+
+	// Options which take a separate value in `llvm-strip` or `llvm-objcopy`
+	constexpr std::array options_with_value {
+		platform::string_view { PSTR("-B") },
+		platform::string_view { PSTR("-F") },
+		platform::string_view { PSTR("-G") },
+		platform::string_view { PSTR("-I") },
+		platform::string_view { PSTR("-K") },
+		platform::string_view { PSTR("-L") },
+		platform::string_view { PSTR("-N") },
+		platform::string_view { PSTR("-O") },
+		platform::string_view { PSTR("-R") },
+		platform::string_view { PSTR("-W") },
+		platform::string_view { PSTR("-j") },
+		platform::string_view { PSTR("--add-gnu-debuglink") },
+		platform::string_view { PSTR("--add-section") },
+		platform::string_view { PSTR("--add-symbol") },
+		platform::string_view { PSTR("--binary-architecture") },
+		platform::string_view { PSTR("--dump-section") },
+		platform::string_view { PSTR("--globalize-symbol") },
+		platform::string_view { PSTR("--globalize-symbols") },
+		platform::string_view { PSTR("--input-target") },
+		platform::string_view { PSTR("--keep-global-symbol") },
+		platform::string_view { PSTR("--keep-global-symbols") },
+		platform::string_view { PSTR("--keep-section") },
+		platform::string_view { PSTR("--keep-symbol") },
+		platform::string_view { PSTR("--keep-symbols") },
+		platform::string_view { PSTR("--localize-symbol") },
+		platform::string_view { PSTR("--localize-symbols") },
+		platform::string_view { PSTR("--only-section") },
+		platform::string_view { PSTR("--output-target") },
+		platform::string_view { PSTR("--prefix-alloc-sections") },
+		platform::string_view { PSTR("--prefix-symbols") },
+		platform::string_view { PSTR("--redefine-sym") },
+		platform::string_view { PSTR("--redefine-syms") },
+		platform::string_view { PSTR("--remove-section") },
+		platform::string_view { PSTR("--rename-section") },
+		platform::string_view { PSTR("--set-section-alignment") },
+		platform::string_view { PSTR("--set-section-flags") },
+		platform::string_view { PSTR("--strip-symbol") },
+		platform::string_view { PSTR("--strip-symbols") },
+		platform::string_view { PSTR("--target") },
+		platform::string_view { PSTR("--update-section") },
+		platform::string_view { PSTR("--weaken-symbol") },
+		platform::string_view { PSTR("--weaken-symbols") },
+	};
+
+	fs::path from_utf8 (std::string_view s)
+	{
+		return fs::path { std::u8string { s.begin (), s.end () } };
+	}
+
+	uint64_t read_le (std::vector<uint8_t> const& data, size_t offset, size_t size) noexcept
+	{
+		uint64_t ret = 0;
+		if (offset > data.size () || size > data.size () - offset) {
+			return ret;
+		}
+
+		for (size_t i = 0; i < size; i++) {
+			ret |= static_cast<uint64_t>(data[offset + i]) << (i * 8);
+		}
+		return ret;
+	}
+
+	bool read_at (std::ifstream &is, uint64_t offset, uint64_t size, std::vector<uint8_t> &data)
+	{
+		data.resize (size);
+		is.clear ();
+		is.seekg (static_cast<std::streamoff>(offset));
+		is.read (reinterpret_cast<char*>(data.data ()), static_cast<std::streamsize>(size));
+		return static_cast<uint64_t>(is.gcount ()) == size;
+	}
+}
+
+BatchStrip::BatchStrip (fs::path const& tool)
+	: tool (tool),
+	  is_objcopy (tool.stem ().native ().find (PSTR("objcopy")) != platform::string::npos),
+	  strip_level (StripLevel::None)
+{}
+
+int BatchStrip::run (std::vector<platform::string> const& args)
+{
+	if (args.size () < 3) {
+		STDERR << "Usage: " << args[0] << " " << Constants::batch_strip_param << " <llvm-strip | llvm-objcopy> " << batch_param
+		       << " [options] <file | @file-list>..." << Constants::newline;
+		return Constants::wrapper_general_error_code;
+	}
+
+	BatchStrip batch { args[2] };
+	if (!batch.parse_arguments (args)) {
+		return Constants::wrapper_general_error_code;
+	}
+
+	return batch.process_files ();
+}
+
+bool BatchStrip::parse_arguments (std::vector<platform::string> const& args)
+{
+	bool level_given = false;
+	bool only_files = false;
+
+	for (size_t i = 3; i < args.size (); i++) {
+		platform::string const& arg = args[i];
+		if (only_files) {
+			if (!add_file (arg)) {
+				return false;
+			}
+			continue;
+		}
+
+		if (arg == batch_param) {
+			continue;
+		}
+
+		if (arg == PSTR("--")) {
+			only_files = true;
+			continue;
+		}
+
+		if (arg.starts_with (jobs_param)) {
+			platform::string const value = arg.substr (jobs_param.length ());
+			uint64_t jobs = 0;
+			try {
+				size_t pos = 0;
+				jobs = std::stoull (value, &pos);
+				if (pos != value.length ()) {
+					jobs = UINT64_MAX;
+				}
+			} catch (std::exception const&) {
+				jobs = UINT64_MAX;
+			}
+
+			if (jobs > Constants::max_jobs) {
+				STDERR << "Invalid " << jobs_param << " value: " << value << ". Expected a number, at most " << Constants::max_jobs << Constants::newline;
+				return false;
+			}
+			max_jobs = static_cast<uint32_t>(jobs);
+			continue;
+		}
+
+		// The files are modified in place, each of them would have to be written to the same output
+		if (arg.starts_with (PSTR("-o"))) {
+			STDERR << arg << " cannot be used with " << batch_param << Constants::newline;
+			return false;
+		}
+
+		if (arg.length () > 1 && arg[0] == PCHAR('@')) {
+			if (!add_file_list (arg.substr (1))) {
+				return false;
+			}
+			continue;
+		}
+
+		if (!arg.starts_with (PCHAR('-'))) {
+			if (!add_file (arg)) {
+				return false;
+			}
+			continue;
+		}
+
+		StripLevel previous_level = strip_level;
+		add_option (arg);
+		level_given |= strip_level != previous_level;
+
+		if (takes_value (arg) && i + 1 < args.size ()) {
+			options.push_back (args[++i]);
+		}
+	}
+
+	// Without any of the stripping options, `llvm-strip` strips everything while `llvm-objcopy` only copies
+	if (!is_objcopy && !level_given) {
+		strip_level = std::max (strip_level, StripLevel::All);
+	}
+
+	if (files.empty ()) {
+		STDERR << "No input files" << Constants::newline;
+		return false;
+	}
+
+	return true;
+}
+
+void BatchStrip::add_option (platform::string const& option)
+{
+	options.push_back (option);
+
+	auto raise_level = [this](StripLevel level) {
+		strip_level = std::max (strip_level, level);
+	};
+
+	if (option == PSTR("-s") || option == PSTR("--strip-all")) {
+		raise_level (StripLevel::All);
+	} else if (option == PSTR("--strip-unneeded")) {
+		raise_level (StripLevel::Unneeded);
+	} else if (option == PSTR("-g") || option == PSTR("-S") || option == PSTR("-d") || option == PSTR("--strip-debug")) {
+		raise_level (StripLevel::Debug);
+	} else if (option == PSTR("-x") || option == PSTR("--discard-all") || option == PSTR("-X") || option == PSTR("--discard-locals")) {
+		// These only touch the symbol table, a file without one has nothing they'd remove
+		raise_level (StripLevel::Unneeded);
+	} else if (option != PSTR("-D") && option != PSTR("--enable-deterministic-archives") &&
+	           option != PSTR("-U") && option != PSTR("--disable-deterministic-archives") &&
+	           option != PSTR("-p") && option != PSTR("--preserve-dates")) {
+		can_skip = false;
+	}
+}
+
+bool BatchStrip::takes_value (platform::string_view option) noexcept
+{
+	return std::find (options_with_value.begin (), options_with_value.end (), option) != options_with_value.end ();
+}
+
+bool BatchStrip::add_file (fs::path const& file)
+{
+	std::error_code ec;
+	if (!fs::is_regular_file (file, ec)) {
+		STDERR << "Input file " << file.native () << " does not exist" << Constants::newline;
+		return false;
+	}
+
+	// Two jobs writing the same file at the same time would lose one's result
+	fs::path normalized = fs::absolute (file).lexically_normal ();
+	for (fs::path const& existing : files) {
+		if (fs::absolute (existing).lexically_normal () == normalized) {
+			return true;
+		}
+	}
+
+	files.push_back (file);
+	return true;
+}
+
+bool BatchStrip::add_file_list (fs::path const& list)
+{
+	std::ifstream is { list, std::ios::binary };
+	if (!is) {
+		STDERR << "Unable to open file list " << list.native () << Constants::newline;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline (is, line)) {
+		while (!line.empty () && (line.back () == '\r' || line.back () == ' ' || line.back () == '\t')) {
+			line.pop_back ();
+		}
+
+		size_t start = line.find_first_not_of (" \t");
+		if (start == std::string::npos) {
+			continue;
+		}
+
+		if (!add_file (from_utf8 (std::string_view { line }.substr (start)))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int BatchStrip::process_files ()
+{
+	std::vector<Job> jobs;
+	for (fs::path const& file : files) {
+		if (is_already_stripped (file)) {
+			continue;
+		}
+
+		Job job;
+		job.input_file = file;
+		job.output_file = FileUtils::make_temporary_path (file);
+
+		std::error_code ec;
+		job.input_size = fs::file_size (file, ec);
+
+		job.process = std::make_unique<Process> (tool);
+		for (platform::string const& option : options) {
+			job.process->append_program_argument (option);
+		}
+
+		job.process->append_program_argument (file.native ());
+		if (!is_objcopy) {
+			job.process->append_program_argument (PSTR("-o"));
+		}
+		job.process->append_program_argument (job.output_file.native ());
+		jobs.push_back (std::move (job));
+	}
+
+	if (jobs.empty ()) {
+		return 0;
+	}
+
+	ScopeGuard remove_temporaries {
+		[&jobs]() {
+			for (Job const& job : jobs) {
+				std::error_code ec;
+				fs::remove (job.output_file, ec);
+			}
+		}
+	};
+
+	uint32_t jobs_count = max_jobs == 0 ? std::thread::hardware_concurrency () : max_jobs;
+	JobScheduler scheduler { jobs_count };
+	return scheduler.run (
+		jobs,
+		[](Job &job) -> int {
+			int ret = job.process->run (false);
+			if (ret != 0) {
+				STDERR << "Failed to process " << job.input_file.native () << Constants::newline;
+				return ret;
+			}
+
+			try {
+				FileUtils::replace_if_changed (job.output_file, job.input_file);
+			} catch (fs::filesystem_error const& ex) {
+				STDERR << "Failed to replace " << job.input_file.native () << ". " << ex.what () << Constants::newline;
+				return Constants::wrapper_general_error_code;
+			}
+
+			return 0;
+		}
+	);
+}
+
+bool BatchStrip::is_already_stripped (fs::path const& file) const
+{
+	if (!can_skip || strip_level == StripLevel::None) {
+		return false;
+	}
+
+	std::ifstream is { file, std::ios::binary };
+	std::vector<uint8_t> header;
+	if (!is || !read_at (is, 0, 64, header) || std::memcmp (header.data (), "\x7f" "ELF", 4) != 0 || header[5] != 1) {
+		return false; // not a little-endian ELF file, e.g. an archive
+	}
+
+	bool elf64 = header[4] == 2;
+	if (!elf64 && header[4] != 1) {
+		return false;
+	}
+
+	uint64_t shoff = read_le (header, elf64 ? 0x28 : 0x20, elf64 ? 8 : 4);
+	uint64_t shentsize = read_le (header, elf64 ? 0x3a : 0x2e, 2);
+	uint64_t shnum = read_le (header, elf64 ? 0x3c : 0x30, 2);
+	uint64_t shstrndx = read_le (header, elf64 ? 0x3e : 0x32, 2);
+
+	// No section headers at all, there's nothing left to strip
+	if (shoff == 0) {
+		return true;
+	}
+
+	if (shentsize != (elf64 ? 64 : 40)) {
+		return false;
+	}
+
+	// Counts which don't fit in the ELF header are stored in the first section header
+	std::vector<uint8_t> first_section;
+	if (!read_at (is, shoff, shentsize, first_section)) {
+		return false;
+	}
+
+	if (shnum == 0) {
+		shnum = read_le (first_section, elf64 ? 0x20 : 0x14, elf64 ? 8 : 4);
+	}
+
+	if (shstrndx == 0xffff) {
+		shstrndx = read_le (first_section, elf64 ? 0x28 : 0x18, 4);
+	}
+
+	std::vector<uint8_t> section_headers;
+	if (shnum > max_section_count || shstrndx >= shnum || !read_at (is, shoff, shnum * shentsize, section_headers)) {
+		return false;
+	}
+
+	auto field = [&](uint64_t index, size_t offset64, size_t offset32, size_t size64, size_t size32) -> uint64_t {
+		return read_le (section_headers, index * shentsize + (elf64 ? offset64 : offset32), elf64 ? size64 : size32);
+	};
+
+	uint64_t names_offset = field (shstrndx, 0x18, 0x10, 8, 4);
+	uint64_t names_size = field (shstrndx, 0x20, 0x14, 8, 4);
+	std::vector<uint8_t> names;
+	if (names_size > max_section_names_size || !read_at (is, names_offset, names_size, names)) {
+		return false;
+	}
+
+	for (uint64_t i = 1; i < shnum; i++) {
+		uint64_t name_offset = field (i, 0x00, 0x00, 4, 4);
+		uint32_t type = static_cast<uint32_t>(field (i, 0x04, 0x04, 4, 4));
+		uint64_t flags = field (i, 0x08, 0x08, 8, 4);
+		if (type == ElfObject::SHT_NULL) {
+			continue;
+		}
+
+		std::string_view name;
+		if (name_offset < names.size ()) {
+			char const* start = reinterpret_cast<char const*>(names.data ()) + name_offset;
+			name = std::string_view { start, strnlen (start, names.size () - name_offset) };
+		}
+
+		// The same sections `llvm-objcopy` considers debug information
+		if (name.starts_with (".debug") || name.starts_with (".zdebug") || name == ".gdb_index") {
+			return false;
+		}
+
+		if (strip_level >= StripLevel::Unneeded && type == ElfObject::SHT_SYMTAB) {
+			return false;
+		}
+
+		// `--strip-all` removes all the non-allocated sections, except for the few it always keeps
+		if (strip_level == StripLevel::All && (flags & ElfObject::SHF_ALLOC) == 0 && i != shstrndx &&
+		    !name.starts_with (".gnu.warning") && type != SHT_ARM_ATTRIBUTES) {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__BATCH_STRIP_HH)
+#define __BATCH_STRIP_HH
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// `<triple>-strip --batch` and `<triple>-objcopy --batch`: runs `llvm-strip` (or `llvm-objcopy`) with the same
+	// options over many files, in parallel, modifying them in place.  The wrapper scripts run it as
+	// `as @batch-strip <tool> --batch [options] <file | @list>...`, where `list` names a file with one input file per
+	// line.  Every file is written to a temporary file first, which then atomically replaces the original unless the
+	// contents didn't change, in which case the original is left untouched.  ELF files which no longer contain anything
+	// the options would remove are skipped without running the tool at all.
+	class BatchStrip final
+	{
+		// What the options remove, in increasing order.  Each level removes everything the previous one does.
+		enum class StripLevel
+		{
+			None,
+			Debug,    // `--strip-debug`
+			Unneeded, // `--strip-unneeded`
+			All,      // `--strip-all`, the `llvm-strip` default
+		};
+
+	public:
+		static constexpr platform::string_view batch_param { PSTR("--batch") };
+		static constexpr platform::string_view jobs_param { PSTR("--batch-jobs=") };
+
+	public:
+		explicit BatchStrip (fs::path const& tool);
+
+		// `args` is the complete `as @batch-strip ...` command line
+		static int run (std::vector<platform::string> const& args);
+
+	private:
+		bool parse_arguments (std::vector<platform::string> const& args);
+		bool add_file (fs::path const& file);
+		bool add_file_list (fs::path const& list);
+		void add_option (platform::string const& option);
+		int process_files ();
+		bool is_already_stripped (fs::path const& file) const;
+
+		static bool takes_value (platform::string_view option) noexcept;
+
+	private:
+		fs::path const                tool;
+		bool const                    is_objcopy;
+		std::vector<platform::string> options;
+		std::vector<fs::path>         files;
+		StripLevel                    strip_level;
+		bool                          can_skip = true;  // `false` if any option does more than strip
+		uint32_t                      max_jobs = 0;
+	};
+}
+#endif // __BATCH_STRIP_HH
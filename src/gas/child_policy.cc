@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <charconv>
+
+#include "child_policy.hh"
+#include "exceptions.hh"
+
+using namespace xamarin::android::gas;
+
+int64_t ChildPolicy::parse_number (std::string_view const& key, std::string_view const& value, int64_t min, int64_t max)
+{
+	int64_t ret = 0;
+	auto [end, ec] = std::from_chars (value.data (), value.data () + value.length (), ret);
+	if (ec != std::errc {} || end != value.data () + value.length () || ret < min || ret > max) {
+		throw invalid_argument_error {
+			"Invalid value '" + std::string { value } + "' of '" + std::string { key } + "', expected a number between " + std::to_string (min) + " and " + std::to_string (max)
+		};
+	}
+
+	return ret;
+}
+
+void ChildPolicy::parse_cpus (std::string_view const& list, std::vector<uint32_t> &cpus)
+{
+	// CPU numbers are limited by the size of the affinity mask
+	constexpr int64_t max_cpu = 1023;
+
+	std::string_view::size_type dash = list.find ('-');
+	if (dash == std::string_view::npos) {
+		cpus.push_back (static_cast<uint32_t>(parse_number ("cpus", list, 0, max_cpu)));
+		return;
+	}
+
+	int64_t first = parse_number ("cpus", list.substr (0, dash), 0, max_cpu);
+	int64_t last = parse_number ("cpus", list.substr (dash + 1), first, max_cpu);
+	for (int64_t cpu = first; cpu <= last; cpu++) {
+		cpus.push_back (static_cast<uint32_t>(cpu));
+	}
+}
+
+std::string ChildPolicy::parse_memory_size (std::string_view const& value)
+{
+	if (value == "max") {
+		return std::string { value };
+	}
+
+	int64_t multiplier = 1;
+	std::string_view number = value;
+	if (!number.empty ()) {
+		switch (number.back ()) {
+			case 'K': case 'k': multiplier = 1024; break;
+			case 'M': case 'm': multiplier = 1024 * 1024; break;
+			case 'G': case 'g': multiplier = 1024 * 1024 * 1024; break;
+			default: break;
+		}
+	}
+
+	if (multiplier != 1) {
+		number.remove_suffix (1);
+	}
+
+	int64_t size = parse_number ("memory.high", number, 1, INT64_MAX / multiplier);
+	return std::to_string (size * multiplier);
+}
+
+ChildPolicy ChildPolicy::parse (std::string_view const& spec)
+{
+	ChildPolicy policy;
+	std::string_view last_key;
+
+	std::string_view rest = spec;
+	while (!rest.empty ()) {
+		std::string_view::size_type comma = rest.find (',');
+		std::string_view item = rest.substr (0, comma);
+		rest = comma == std::string_view::npos ? std::string_view {} : rest.substr (comma + 1);
+		if (item.empty ()) {
+			continue;
+		}
+
+		std::string_view::size_type equals = item.find ('=');
+		std::string_view key = item.substr (0, equals);
+		std::string_view value = equals == std::string_view::npos ? std::string_view {} : item.substr (equals + 1);
+
+		// CPU lists contain commas themselves, items which are just numbers or ranges continue the list
+		if (equals == std::string_view::npos && last_key == "cpus" && !key.empty () && key[0] >= '0' && key[0] <= '9') {
+			parse_cpus (key, policy.cpus);
+			continue;
+		}
+
+		bool linux_only = true;
+		if (key == "nice") {
+			policy.nice = static_cast<int>(parse_number (key, value, -20, 19));
+			linux_only = false;
+		} else if (key == "ioprio") {
+			std::string_view::size_type colon = value.find (':');
+			std::string_view io_class = value.substr (0, colon);
+			if (io_class == "realtime" || io_class == "rt") {
+				policy.io_class = IoClass::RealTime;
+			} else if (io_class == "best-effort" || io_class == "be") {
+				policy.io_class = IoClass::BestEffort;
+			} else if (io_class == "idle") {
+				policy.io_class = IoClass::Idle;
+			} else {
+				throw invalid_argument_error { "Unknown I/O scheduling class '" + std::string { io_class } + "', expected one of: realtime, best-effort, idle" };
+			}
+
+			if (colon != std::string_view::npos) {
+				policy.io_level = static_cast<uint32_t>(parse_number (key, value.substr (colon + 1), 0, 7));
+			}
+		} else if (key == "batch" && equals == std::string_view::npos) {
+			policy.batch = true;
+		} else if (key == "cpus") {
+			parse_cpus (value, policy.cpus);
+		} else if (key == "cgroup") {
+			if (value.empty ()) {
+				throw invalid_argument_error { "'cgroup' requires a path" };
+			}
+			policy.cgroup = fs::path { value };
+		} else if (key == "cpu.weight") {
+			policy.cpu_weight = static_cast<uint32_t>(parse_number (key, value, 1, 10000));
+		} else if (key == "memory.high") {
+			policy.memory_high = parse_memory_size (value);
+		} else {
+			throw invalid_argument_error { "Unknown setting '" + std::string { item } + "'" };
+		}
+
+#if !defined (__linux__)
+		if (linux_only) {
+			throw invalid_argument_error { "'" + std::string { key } + "' is not supported on this platform" };
+		}
+#else
+		(void)linux_only;
+#endif
+		last_key = key;
+	}
+
+	if ((policy.cpu_weight.has_value () || !policy.memory_high.empty ()) && policy.cgroup.empty ()) {
+		throw invalid_argument_error { "'cpu.weight' and 'memory.high' require 'cgroup'" };
+	}
+
+	std::sort (policy.cpus.begin (), policy.cpus.end ());
+	policy.cpus.erase (std::unique (policy.cpus.begin (), policy.cpus.end ()), policy.cpus.end ());
+	return policy;
+}
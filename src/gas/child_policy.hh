@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__CHILD_POLICY_HH)
+#define __CHILD_POLICY_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// Scheduling and resource settings applied to every child process (`llvm-mc`, `ld`) we start, so that builds can
+	// be made to yield to interactive work on a workstation or, on the contrary, to take over a CI agent.
+	//
+	// The settings are described by a comma-separated list of:
+	//
+	//   nice=N               scheduling priority (-20 to 19, lowering it requires privileges)
+	//   ioprio=CLASS[:LEVEL] I/O scheduling class (`realtime`, `best-effort` or `idle`) and level (0 to 7, default 4)
+	//   batch                use the `SCHED_BATCH` scheduling policy
+	//   cpus=LIST            CPU affinity, in the `taskset --cpu-list` format (e.g. `cpus=0-3,8`)
+	//   cgroup=PATH          cgroup v2 group to run in, created if necessary (and then removed at exit), relative to
+	//                        the cgroup2 mount unless absolute.  The group must be writable by us (delegated, e.g. by
+	//                        `systemd-run --user`).
+	//   cpu.weight=N         `cpu.weight` of the group (1 to 10000)
+	//   memory.high=SIZE     `memory.high` of the group, in bytes with an optional K, M or G suffix, or `max`
+	//
+	// Only `nice` is available on all platforms, the rest is Linux-specific.  Invalid or unsupported settings throw
+	// `invalid_argument_error`.
+	struct ChildPolicy
+	{
+		enum class IoClass
+		{
+			RealTime = 1,
+			BestEffort = 2,
+			Idle = 3,
+		};
+
+		std::optional<int>      nice;
+		std::optional<IoClass>  io_class;
+		uint32_t                io_level = 4;
+		bool                    batch = false;
+		std::vector<uint32_t>   cpus;
+		fs::path                cgroup;
+		std::optional<uint32_t> cpu_weight;
+		std::string             memory_high;
+
+		static ChildPolicy parse (std::string_view const& spec);
+
+		bool empty () const noexcept
+		{
+			return !nice.has_value () && !io_class.has_value () && !batch && cpus.empty () && cgroup.empty ();
+		}
+
+	private:
+		static int64_t parse_number (std::string_view const& key, std::string_view const& value, int64_t min, int64_t max);
+		static void parse_cpus (std::string_view const& list, std::vector<uint32_t> &cpus);
+		static std::string parse_memory_size (std::string_view const& value);
+	};
+}
+#endif // __CHILD_POLICY_HH
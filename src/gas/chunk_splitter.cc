@@ -0,0 +1,1001 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <array>
+
+#include "chunk_splitter.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr std::array<std::string_view, 8> alignment_directives {
+		".align", ".p2align", ".p2alignw", ".p2alignl", ".balign", ".balignw", ".balignl", ".palign",
+	};
+
+	// Directives which make it impossible to reliably track the assembler state or see all the labels, or whose
+	// effect depends on what precedes them in the whole file
+	constexpr std::array<std::string_view, 31> unsupported_directives {
+		".previous", ".subsection", ".macro", ".endm", ".exitm", ".purgem", ".altmacro", ".noaltmacro",
+		".rept", ".irp", ".irpc", ".endr", ".include", ".if", ".ifdef", ".ifndef", ".ifc", ".ifeq", ".ifne",
+		".ifnc", ".ifb", ".ifnb", ".else", ".elseif", ".endif", ".org", ".end", ".struct", ".offset", ".req", ".unreq",
+	};
+
+	// Directives changing how the rest of the source is assembled, replayed in the prologue of every chunk
+	constexpr std::array<std::string_view, 9> state_directives_names {
+		".syntax", ".arch", ".cpu", ".fpu", ".object_arch", ".arch_extension", ".cfi_sections", ".addrsig", ".eabi_attribute",
+	};
+
+	constexpr std::array<std::string_view, 6> mode_directives {
+		".arm", ".thumb", ".code", ".code16", ".code32", ".code64",
+	};
+
+	constexpr std::array<std::string_view, 8> symbol_attribute_directives {
+		".globl", ".global", ".weak", ".hidden", ".internal", ".protected", ".local", ".addrsig_sym",
+	};
+
+	constexpr std::array<std::string_view, 4> assignment_directives {
+		".set", ".equ", ".equiv", ".eqv",
+	};
+
+	constexpr std::array<std::string_view, 17> arm_conditions {
+		"eq", "ne", "cs", "hs", "cc", "lo", "mi", "pl", "vs", "vc", "hi", "ls", "ge", "lt", "gt", "le", "al",
+	};
+
+	constexpr std::array<std::string_view, 5> function_types {
+		"%function", "@function", "STT_FUNC", "\"function\"", "function",
+	};
+
+	std::string_view first_operand (std::string_view operands) noexcept
+	{
+		return AsmSyntax::trim (operands.substr (0, operands.find (',')));
+	}
+}
+
+ChunkSplitter::ChunkSplitter (TargetArchitecture arch, size_t hash_size)
+	: target_arch (arch)
+{
+	current_section = intern_section (".text");
+	segments.push_back ({ Position {}, {} });
+
+	if (hash_size == 0) {
+		return;
+	}
+
+	identifier_ids.reserve (hash_size);
+	symbols.reserve (hash_size);
+}
+
+uint32_t ChunkSplitter::intern (std::string_view identifier)
+{
+	auto iter = identifier_ids.find (std::string { identifier });
+	if (iter != identifier_ids.end ()) {
+		return iter->second;
+	}
+
+	uint32_t id = static_cast<uint32_t>(symbols.size ());
+	identifier_ids.emplace (identifier, id);
+	symbols.emplace_back ();
+	return id;
+}
+
+uint32_t ChunkSplitter::intern_section (std::string_view name_token)
+{
+	std::string_view name = name_token;
+	if (name.length () >= 2 && name.front () == '"' && name.back () == '"') {
+		name = name.substr (1, name.length () - 2);
+	}
+
+	auto iter = section_ids.find (std::string { name });
+	if (iter != section_ids.end ()) {
+		return iter->second;
+	}
+
+	uint32_t id = static_cast<uint32_t>(sections.size ());
+	section_ids.emplace (name, id);
+	SectionInfo &section = sections.emplace_back ();
+	section.name_token = name_token;
+	return id;
+}
+
+std::string ChunkSplitter::statement_text (AsmSyntax::Statement const& statement)
+{
+	std::string text { statement.mnemonic };
+	if (!statement.operands.empty ()) {
+		text.append (" ").append (statement.operands);
+	}
+
+	return text;
+}
+
+bool ChunkSplitter::has_binary_minus (std::string_view operands) noexcept
+{
+	bool in_string = false;
+	for (size_t i = 0; i < operands.length (); i++) {
+		char c = operands[i];
+		if (in_string) {
+			if (c == '\\') {
+				i++;
+			} else if (c == '"') {
+				in_string = false;
+			}
+			continue;
+		}
+
+		if (c == '"') {
+			in_string = true;
+			continue;
+		}
+
+		if (c != '-') {
+			continue;
+		}
+
+		size_t prev = i;
+		while (prev > 0 && (operands[prev - 1] == ' ' || operands[prev - 1] == '\t')) {
+			prev--;
+		}
+
+		if (prev > 0) {
+			char p = operands[prev - 1];
+			if (AsmSyntax::is_identifier_char (p) || p == ')' || p == ']') {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool ChunkSplitter::has_complex_operator (std::string_view operands) noexcept
+{
+	bool in_string = false;
+	for (size_t i = 0; i < operands.length (); i++) {
+		char c = operands[i];
+		if (in_string) {
+			if (c == '\\') {
+				i++;
+			} else if (c == '"') {
+				in_string = false;
+			}
+			continue;
+		}
+
+		switch (c) {
+			case '"':
+				in_string = true;
+				break;
+
+			case '*':
+			case '/':
+			case '<':
+			case '>':
+			case '&':
+			case '|':
+			case '^':
+			case '~':
+			case '!':
+				return true;
+		}
+	}
+
+	return false;
+}
+
+uint64_t ChunkSplitter::hash_name (std::string_view name) noexcept
+{
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (char c : name) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+// ARM instructions other than branches and literal pool loads can only refer to labels the assembler resolves itself
+bool ChunkSplitter::is_arm_non_branch (std::string_view mnemonic, std::string_view operands) const noexcept
+{
+	std::string m;
+	for (char c : mnemonic) {
+		m.push_back (static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c));
+	}
+
+	if (m.ends_with (".w") || m.ends_with (".n")) {
+		m.resize (m.length () - 2);
+	}
+
+	std::string_view name { m };
+	for (std::string_view branch : { std::string_view { "blx" }, std::string_view { "bx" }, std::string_view { "bl" }, std::string_view { "b" } }) {
+		if (name == branch || (name.starts_with (branch) && AsmSyntax::is_one_of (name.substr (branch.length ()), arm_conditions))) {
+			return false;
+		}
+	}
+
+	if (name.starts_with ("movw") || name.starts_with ("movt")) {
+		return false;
+	}
+
+	if (name.starts_with ("ldr") && operands.find ('=') != std::string_view::npos) {
+		return false;
+	}
+
+	return true;
+}
+
+void ChunkSplitter::define_symbol (std::string_view name, bool variable)
+{
+	if (name.empty () || !AsmSyntax::is_identifier_start (name.front ())) {
+		return;
+	}
+
+	SymbolInfo &symbol = symbols[intern (name)];
+	if (symbol.defined_line != 0) {
+		// Redefinitions (e.g. of `.set` counters) are seen in the order of the source only in a single chunk
+		line_merges.emplace_back (symbol.defined_line, line_number);
+		symbol.variable = true;
+	} else {
+		symbol.defined_line = line_number;
+	}
+
+	if (variable) {
+		symbol.variable = true;
+	}
+}
+
+void ChunkSplitter::define_numeric_label (std::string_view label)
+{
+	std::string key { label };
+	auto iter = forward_numeric_references.find (key);
+	if (iter != forward_numeric_references.end ()) {
+		line_merges.emplace_back (iter->second, line_number);
+		forward_numeric_references.erase (iter);
+	}
+
+	numeric_labels[key] = line_number;
+}
+
+void ChunkSplitter::add_references (std::string_view operands, bool anchors)
+{
+	bool in_string = false;
+
+	for (size_t i = 0; i < operands.length (); i++) {
+		char c = operands[i];
+		if (in_string) {
+			if (c == '\\') {
+				i++;
+			} else if (c == '"') {
+				in_string = false;
+			}
+			continue;
+		}
+
+		if (c == '"') {
+			in_string = true;
+			continue;
+		}
+
+		if (!AsmSyntax::is_identifier_char (c)) {
+			continue;
+		}
+
+		size_t start = i;
+		while (i < operands.length () && AsmSyntax::is_identifier_char (operands[i])) {
+			i++;
+		}
+
+		std::string_view token = operands.substr (start, i - start);
+		bool is_register_or_specifier = start > 0 && (operands[start - 1] == '%' || operands[start - 1] == '@');
+		i--;
+
+		// AT&T syntax immediates, `$MAGIC` or `$table` refer to `MAGIC` and `table`
+		if (token.front () == '$' && target_arch != TargetArchitecture::ARM32 && target_arch != TargetArchitecture::ARM64) {
+			size_t name_start = token.find_first_not_of ('$');
+			if (name_start == std::string_view::npos) {
+				continue;
+			}
+			token.remove_prefix (name_start);
+		}
+
+		if (is_register_or_specifier || token == ".") {
+			continue;
+		}
+
+		if (!AsmSyntax::is_identifier_start (token.front ())) {
+			// Numeric local label references, `1b` or `2f`
+			std::string_view number = token.substr (0, token.length () - 1);
+			char direction = token.back ();
+			if ((direction != 'b' && direction != 'f') || number.empty () ||
+			    !std::all_of (number.begin (), number.end (), [](char d) { return d >= '0' && d <= '9'; })) {
+				continue;
+			}
+
+			if (direction == 'b') {
+				auto iter = numeric_labels.find (std::string { number });
+				if (iter != numeric_labels.end ()) {
+					line_merges.emplace_back (iter->second, line_number);
+				}
+			} else {
+				forward_numeric_references.emplace (number, line_number);
+			}
+			continue;
+		}
+
+		SymbolInfo &symbol = symbols[intern (token)];
+		if (anchors) {
+			symbol.first_anchor = std::min (symbol.first_anchor, line_number);
+			symbol.last_anchor = std::max (symbol.last_anchor, line_number);
+		} else {
+			symbol.first_reference = std::min (symbol.first_reference, line_number);
+			symbol.last_reference = std::max (symbol.last_reference, line_number);
+		}
+	}
+}
+
+void ChunkSplitter::add_attribute (std::string_view mnemonic, std::string_view operands, bool movable)
+{
+	AttributeDirective directive { line_number, std::string { mnemonic }, {}, {}, movable };
+
+	if (mnemonic == ".type") {
+		size_t comma = operands.find (',');
+		directive.symbols.emplace_back (AsmSyntax::trim (operands.substr (0, comma)));
+		if (comma != std::string_view::npos) {
+			directive.suffix = operands.substr (comma);
+		}
+	} else {
+		while (!operands.empty ()) {
+			size_t comma = operands.find (',');
+			std::string_view name = AsmSyntax::trim (operands.substr (0, comma));
+			if (!name.empty ()) {
+				directive.symbols.emplace_back (name);
+			}
+			operands = comma == std::string_view::npos ? std::string_view {} : operands.substr (comma + 1);
+		}
+	}
+
+	for (std::string const& name : directive.symbols) {
+		if (name.empty () || !AsmSyntax::is_identifier_start (name.front ())) {
+			// Quoted names and the like, don't bother
+			can_split = false;
+			return;
+		}
+
+		SymbolInfo &symbol = symbols[intern (name)];
+		if (mnemonic == ".globl" || mnemonic == ".global" || mnemonic == ".weak") {
+			symbol.global = true;
+		} else if (mnemonic == ".local") {
+			symbol.declared_local = true;
+		}
+	}
+
+	attribute_directives.push_back (std::move (directive));
+}
+
+void ChunkSplitter::add_state_directive (std::string slot, AsmSyntax::Statement const& statement)
+{
+	state_directives.push_back ({ line_number, std::move (slot), statement_text (statement) });
+}
+
+void ChunkSplitter::switch_section (std::string_view operands)
+{
+	// `.section name[, "flags"[, @type[, entsize | group, comdat]]][, unique, id]`
+	size_t comma = operands.find (',');
+	std::string_view name_token = AsmSyntax::trim (operands.substr (0, comma));
+	if (name_token.empty ()) {
+		can_split = false;
+		return;
+	}
+
+	uint32_t id = intern_section (name_token);
+	SectionInfo &section = sections[id];
+	if (comma != std::string_view::npos && section.declaration.empty ()) {
+		section.declaration = ".section ";
+		section.declaration.append (operands);
+
+		std::string_view flags = AsmSyntax::trim (operands.substr (comma + 1));
+		flags = flags.substr (0, flags.find (','));
+		if (flags.find ('G') != std::string_view::npos || operands.find ("comdat") != std::string_view::npos ||
+		    operands.find ("unique") != std::string_view::npos) {
+			section.in_group = true;
+		}
+	}
+
+	section.first_line = std::min (section.first_line, line_number);
+	section.last_line = std::max (section.last_line, line_number);
+	current_section = id;
+	section_switches.push_back ({ line_number, id });
+}
+
+void ChunkSplitter::start_segment (std::string_view function)
+{
+	Position const& start = in_preamble ? preamble_start : line_start;
+	function_open = true;
+
+	if (!start.can_be_boundary || start.line <= segments.back ().start.line) {
+		return;
+	}
+
+	segments.push_back ({ start, std::string { function } });
+}
+
+// Returns `true` if the directive neither emits anything nor refers to any symbol, so that it can precede a function
+// in the chunk the function starts
+bool ChunkSplitter::handle_directive (AsmSyntax::Statement const& statement, bool movable)
+{
+	std::string_view const& name = statement.mnemonic;
+	std::string_view const& operands = statement.operands;
+
+	if (AsmSyntax::is_one_of (name, unsupported_directives)) {
+		can_split = false;
+		return false;
+	}
+
+	if (name == ".text" || name == ".data" || name == ".bss") {
+		if (!operands.empty () && operands != "0") {
+			can_split = false; // subsections
+			return false;
+		}
+
+		current_section = intern_section (name);
+		sections[current_section].first_line = std::min (sections[current_section].first_line, line_number);
+		sections[current_section].last_line = std::max (sections[current_section].last_line, line_number);
+		section_switches.push_back ({ line_number, current_section });
+		return true;
+	}
+
+	if (name == ".section") {
+		switch_section (operands);
+		return true;
+	}
+
+	if (name == ".pushsection") {
+		section_stack.push_back (current_section);
+		switch_section (operands);
+		return false;
+	}
+
+	if (name == ".popsection") {
+		if (section_stack.empty ()) {
+			can_split = false;
+			return false;
+		}
+
+		current_section = section_stack.back ();
+		section_stack.pop_back ();
+		section_switches.push_back ({ line_number, current_section });
+		return false;
+	}
+
+	if (name == ".type") {
+		size_t comma = operands.find (',');
+		if (comma != std::string_view::npos && AsmSyntax::is_one_of (AsmSyntax::trim (operands.substr (comma + 1)), function_types)) {
+			function_symbols.insert (intern (AsmSyntax::trim (operands.substr (0, comma))));
+		}
+		add_attribute (name, operands, movable);
+		return true;
+	}
+
+	if (AsmSyntax::is_one_of (name, symbol_attribute_directives)) {
+		add_attribute (name, operands, movable);
+		return name != ".addrsig_sym";
+	}
+
+	if (AsmSyntax::is_one_of (name, alignment_directives) || name == ".thumb_func") {
+		return true;
+	}
+
+	if (AsmSyntax::is_one_of (name, mode_directives)) {
+		add_state_directive ("mode", statement);
+		return true;
+	}
+
+	if (name == ".intel_syntax" || name == ".att_syntax") {
+		add_state_directive ("x86-syntax", statement);
+		return true;
+	}
+
+	if (AsmSyntax::is_one_of (name, state_directives_names)) {
+		std::string slot { name };
+		if (name == ".eabi_attribute") {
+			slot.append (" ").append (first_operand (operands));
+		} else if (name == ".arch_extension") {
+			slot.append (" ").append (operands);
+		}
+		add_state_directive (std::move (slot), statement);
+		return name == ".syntax";
+	}
+
+	if (name == ".file") {
+		// The DWARF file table, `.file "name"` just names the object file's source
+		if (!operands.empty () && operands.front () >= '0' && operands.front () <= '9') {
+			std::string text = statement_text (statement);
+			if (std::find (file_directives.begin (), file_directives.end (), text) == file_directives.end ()) {
+				file_directives.push_back (std::move (text));
+			}
+
+			if (movable) {
+				blanked_lines.insert (line_number);
+			}
+		}
+		return false;
+	}
+
+	if (name == ".cfi_startproc") {
+		cfi_depth++;
+		return false;
+	}
+
+	if (name == ".cfi_endproc") {
+		cfi_depth--;
+		function_open = false;
+		return false;
+	}
+
+	if (name == ".size") {
+		function_open = false;
+		add_references (operands, true);
+		return false;
+	}
+
+	if (AsmSyntax::is_one_of (name, assignment_directives)) {
+		size_t comma = operands.find (',');
+		define_symbol (first_operand (operands), true);
+		if (comma != std::string_view::npos) {
+			add_references (operands.substr (comma + 1), true);
+		}
+		return false;
+	}
+
+	if (name == ".comm" || name == ".lcomm" || name == ".tls_common") {
+		std::string_view symbol_name = first_operand (operands);
+		define_symbol (symbol_name, false);
+		if (name != ".lcomm" && !symbol_name.empty () && AsmSyntax::is_identifier_start (symbol_name.front ())) {
+			symbols[intern (symbol_name)].common = true;
+		}
+		return false;
+	}
+
+	if (name == ".weakref" || name == ".thumb_set") {
+		define_symbol (first_operand (operands), true);
+		add_references (operands, true);
+		return false;
+	}
+
+	if (name == ".symver" || name == ".uleb128" || name == ".sleb128") {
+		add_references (operands, true);
+		return false;
+	}
+
+	if (name == ".incbin") {
+		incbin_lines.push_back (line_number);
+		return false;
+	}
+
+	add_references (operands, has_binary_minus (operands) || has_complex_operator (operands));
+	return false;
+}
+
+void ChunkSplitter::analyze_statement (std::string_view text, bool only_statement_on_line, bool first_statement_on_line, bool &preamble_only)
+{
+	AsmSyntax::Statement statement;
+	AsmSyntax::parse_statement (text, statement);
+
+	if (!statement.labels.empty ()) {
+		preamble_only = false;
+	}
+
+	for (size_t i = 0; i < statement.labels.size (); i++) {
+		std::string_view label = statement.labels[i];
+		if (!AsmSyntax::is_identifier_start (label.front ())) {
+			define_numeric_label (label);
+			continue;
+		}
+
+		if (first_statement_on_line && i == 0 && function_symbols.contains (intern (label))) {
+			start_segment (label);
+		}
+		define_symbol (label, false);
+	}
+
+	if (statement.mnemonic.empty ()) {
+		return;
+	}
+
+	// `symbol = expression`
+	size_t assignment = statement.mnemonic.find ('=');
+	if (assignment != std::string_view::npos || (statement.operands.starts_with ('=') && !statement.operands.starts_with ("=="))) {
+		preamble_only = false;
+
+		std::string assignment_text = statement_text (statement);
+		size_t equals = assignment_text.find ('=');
+		define_symbol (AsmSyntax::trim (std::string_view { assignment_text }.substr (0, equals)), true);
+		add_references (std::string_view { assignment_text }.substr (equals + 1), true);
+		return;
+	}
+
+	if (statement.mnemonic.front () == '.') {
+		if (!handle_directive (statement, only_statement_on_line && statement.labels.empty ())) {
+			preamble_only = false;
+		}
+		return;
+	}
+
+	preamble_only = false;
+	bool anchors = has_binary_minus (statement.operands) ||
+		(target_arch == TargetArchitecture::ARM32 && is_arm_non_branch (statement.mnemonic, statement.operands));
+	add_references (statement.operands, anchors);
+}
+
+void ChunkSplitter::analyze_line (std::string_view line)
+{
+	line_start = {
+		line_number,
+		offset,
+		current_section,
+		state_directives.size (),
+		section_stack.empty () && cfi_depth == 0 && !function_open && !sections[current_section].in_group,
+	};
+
+	bool has_block_comment = false;
+	std::string_view text = AsmSyntax::strip_comment (line, target_arch, has_block_comment);
+	if (has_block_comment) {
+		// Block comments can span lines, we don't track them
+		can_split = false;
+		return;
+	}
+
+	std::vector<std::string_view> statements;
+	AsmSyntax::split_statements (text, statements);
+
+	bool preamble_only = true;
+	for (size_t i = 0; i < statements.size (); i++) {
+		analyze_statement (statements[i], statements.size () == 1, i == 0, preamble_only);
+	}
+
+	if (!preamble_only) {
+		in_preamble = false;
+	} else if (!in_preamble) {
+		preamble_start = line_start;
+		in_preamble = true;
+	}
+}
+
+bool ChunkSplitter::analyze (std::istream &input)
+{
+	std::string line;
+	while (std::getline (input, line)) {
+		line_number++;
+		if (can_split) {
+			analyze_line (line);
+		}
+		offset += line.length () + 1;
+	}
+
+	if (input.bad ()) {
+		can_split = false;
+	}
+
+	finish_analysis ();
+	return can_split;
+}
+
+size_t ChunkSplitter::segment_of (uint64_t line) const noexcept
+{
+	auto iter = std::upper_bound (
+		segments.begin (), segments.end (), line,
+		[](uint64_t l, Segment const& segment) -> bool {
+			return l < segment.start.line;
+		}
+	);
+	return static_cast<size_t>(iter - segments.begin ()) - 1;
+}
+
+size_t ChunkSplitter::chunk_of (uint64_t line) const noexcept
+{
+	auto iter = std::upper_bound (
+		_chunks.begin (), _chunks.end (), line,
+		[](uint64_t l, Chunk const& chunk) -> bool {
+			return l < chunk.first_line;
+		}
+	);
+	return static_cast<size_t>(iter - _chunks.begin ()) - 1;
+}
+
+std::string ChunkSplitter::make_section_switch (uint32_t section) const
+{
+	SectionInfo const& info = sections[section];
+	if (!info.declaration.empty () && !info.in_group) {
+		return info.declaration;
+	}
+
+	if (info.name_token == ".text" || info.name_token == ".data" || info.name_token == ".bss") {
+		return info.name_token;
+	}
+
+	std::string ret { ".section " };
+	ret.append (info.name_token);
+	return ret;
+}
+
+void ChunkSplitter::make_single_chunk ()
+{
+	_chunks.clear ();
+	_chunks.push_back ({ 1, line_number, offset, {}, incbin_lines.empty () });
+	blanked_lines.clear ();
+}
+
+void ChunkSplitter::finish_analysis ()
+{
+	if (!can_split || segments.size () < 2) {
+		make_single_chunk ();
+		return;
+	}
+
+	size_t segment_count = segments.size ();
+	std::vector<int64_t> merge_delta (segment_count + 1, 0);
+	auto merge = [this, &merge_delta](uint64_t a, uint64_t b) {
+		if (a == 0 || b == 0 || a == no_line || b == no_line) {
+			return;
+		}
+
+		size_t first = segment_of (a);
+		size_t last = segment_of (b);
+		if (first == last) {
+			return;
+		}
+
+		if (first > last) {
+			std::swap (first, last);
+		}
+
+		// All the segments in (first, last] join the chunk of the segment preceding them
+		merge_delta[first + 1]++;
+		merge_delta[last + 1]--;
+	};
+
+	for (SymbolInfo const& symbol : symbols) {
+		if (symbol.defined_line == 0) {
+			continue;
+		}
+
+		bool local = symbol.variable || symbol.declared_local || !(symbol.global || symbol.common);
+		if (local) {
+			merge (symbol.defined_line, symbol.first_reference);
+			merge (symbol.defined_line, symbol.last_reference);
+		}
+
+		merge (symbol.defined_line, symbol.first_anchor);
+		merge (symbol.defined_line, symbol.last_anchor);
+	}
+
+	for (auto const& [a, b] : line_merges) {
+		merge (a, b);
+	}
+
+	for (SectionInfo const& section : sections) {
+		if (section.in_group) {
+			merge (section.first_line, section.last_line);
+		}
+	}
+
+	// Attributes of symbols defined in another chunk are moved to that chunk, unless they're on a line with other
+	// statements or also name symbols not defined in the input
+	std::vector<std::string> external_weak_symbols;
+	std::vector<bool> movable (attribute_directives.size (), false);
+	for (size_t i = 0; i < attribute_directives.size (); i++) {
+		AttributeDirective const& directive = attribute_directives[i];
+		bool has_external = false;
+		for (std::string const& name : directive.symbols) {
+			SymbolInfo const& symbol = symbols[identifier_ids.at (name)];
+			if (symbol.defined_line != 0) {
+				continue;
+			}
+
+			has_external = true;
+			if (directive.mnemonic == ".weak" &&
+			    std::find (external_weak_symbols.begin (), external_weak_symbols.end (), name) == external_weak_symbols.end ()) {
+				// A weak undefined reference becomes strong once linked with a strong one from another chunk
+				external_weak_symbols.push_back (name);
+			}
+		}
+
+		movable[i] = directive.movable && !has_external;
+		if (movable[i]) {
+			continue;
+		}
+
+		for (std::string const& name : directive.symbols) {
+			merge (directive.line, symbols[identifier_ids.at (name)].defined_line);
+		}
+	}
+
+	std::vector<size_t> chunk_start_segments;
+	int64_t joined = 0;
+	uint64_t chunk_size = 0;
+	for (size_t i = 0; i < segment_count; i++) {
+		joined += merge_delta[i];
+		bool can_cut = i > 0 && joined == 0;
+		if (i == 0 || (can_cut && (chunk_size >= max_chunk_size || (chunk_size >= min_chunk_size && hash_name (segments[i].function) % boundary_divisor == 0)))) {
+			chunk_start_segments.push_back (i);
+			_chunks.push_back ({ segments[i].start.line, 0, 0, {}, true });
+			chunk_size = 0;
+		}
+
+		uint64_t segment_end = i + 1 < segment_count ? segments[i + 1].start.offset : offset;
+		chunk_size += segment_end - segments[i].start.offset;
+	}
+
+	if (_chunks.size () < 2) {
+		make_single_chunk ();
+		return;
+	}
+
+	std::vector<std::string> replayed_attributes (_chunks.size ());
+	for (size_t i = 0; i < attribute_directives.size (); i++) {
+		if (!movable[i]) {
+			continue;
+		}
+
+		AttributeDirective const& directive = attribute_directives[i];
+		size_t chunk = chunk_of (directive.line);
+		bool moved = false;
+		for (std::string const& name : directive.symbols) {
+			if (chunk_of (symbols[identifier_ids.at (name)].defined_line) != chunk) {
+				moved = true;
+			}
+		}
+
+		if (!moved) {
+			continue;
+		}
+
+		blanked_lines.insert (directive.line);
+		for (std::string const& name : directive.symbols) {
+			std::string &replay = replayed_attributes[chunk_of (symbols[identifier_ids.at (name)].defined_line)];
+			replay.append (directive.mnemonic).append (" ").append (name).append (directive.suffix).append ("\n");
+		}
+	}
+
+	// Without the note, the linker would assume the chunks which lack it need an executable stack
+	auto stack_note = section_ids.find (".note.GNU-stack");
+
+	std::vector<std::pair<std::string, std::string>> state_slots;
+	size_t next_state_directive = 0;
+	size_t next_switch = 0;
+	size_t next_incbin = 0;
+	for (size_t c = 0; c < _chunks.size (); c++) {
+		Chunk &chunk = _chunks[c];
+		Position const& start = segments[chunk_start_segments[c]].start;
+		uint64_t end_line = c + 1 < _chunks.size () ? _chunks[c + 1].first_line : line_number + 1;
+		uint64_t end_offset = c + 1 < _chunks.size () ? segments[chunk_start_segments[c + 1]].start.offset : offset;
+
+		chunk.line_count = end_line - chunk.first_line;
+		chunk.size = end_offset - start.offset;
+
+		for (; next_state_directive < start.state_directives; next_state_directive++) {
+			StateDirective const& directive = state_directives[next_state_directive];
+			auto iter = std::find_if (
+				state_slots.begin (), state_slots.end (),
+				[&directive](auto const& slot) -> bool {
+					return slot.first == directive.slot;
+				}
+			);
+
+			if (iter == state_slots.end ()) {
+				state_slots.emplace_back (directive.slot, directive.text);
+			} else {
+				iter->second = directive.text;
+			}
+		}
+
+		std::string &prologue = chunk.prologue;
+		for (auto const& [slot, text] : state_slots) {
+			prologue.append (text).append ("\n");
+		}
+
+		for (std::string const& text : file_directives) {
+			prologue.append (text).append ("\n");
+		}
+
+		for (std::string const& name : external_weak_symbols) {
+			prologue.append (".weak ").append (name).append ("\n");
+		}
+
+		std::vector<uint32_t> used_sections { start.section };
+		for (; next_switch < section_switches.size () && section_switches[next_switch].line < end_line; next_switch++) {
+			uint32_t section = section_switches[next_switch].section;
+			if (std::find (used_sections.begin (), used_sections.end (), section) == used_sections.end ()) {
+				used_sections.push_back (section);
+			}
+		}
+
+		if (stack_note != section_ids.end () && std::find (used_sections.begin (), used_sections.end (), stack_note->second) == used_sections.end ()) {
+			used_sections.push_back (stack_note->second);
+		}
+
+		for (uint32_t section : used_sections) {
+			SectionInfo const& info = sections[section];
+			if (!info.in_group && !info.declaration.empty ()) {
+				prologue.append (info.declaration).append ("\n");
+			}
+		}
+
+		prologue.append (replayed_attributes[c]);
+		prologue.append (make_section_switch (start.section)).append ("\n");
+
+		for (; next_incbin < incbin_lines.size () && incbin_lines[next_incbin] < end_line; next_incbin++) {
+			chunk.cacheable = false;
+		}
+	}
+}
+
+bool ChunkSplitter::write_chunks (std::istream &input, std::string const& source_name, chunk_write_fn const& write) const
+{
+	std::string buffer;
+	buffer.reserve (write_buffer_size + 4096);
+
+	size_t chunk = 0;
+	bool chunk_open = false;
+	auto begin_chunk = [&]() -> bool {
+		chunk_open = true;
+
+		std::string marker { "# " };
+		marker
+			.append (std::to_string (_chunks[chunk].first_line))
+			.append (" \"")
+			.append (source_name)
+			.append ("\"\n");
+
+		return write (chunk, ChunkPart::Begin, {}) &&
+			write (chunk, ChunkPart::Prologue, _chunks[chunk].prologue) &&
+			write (chunk, ChunkPart::LineMarker, marker);
+	};
+
+	auto flush = [&]() -> bool {
+		if (buffer.empty ()) {
+			return true;
+		}
+
+		bool written = write (chunk, ChunkPart::Source, buffer);
+		buffer.clear ();
+		return written;
+	};
+
+	std::string line;
+	uint64_t current_line = 0;
+	while (std::getline (input, line)) {
+		current_line++;
+
+		if (chunk + 1 < _chunks.size () && current_line == _chunks[chunk + 1].first_line) {
+			if (!flush () || !write (chunk, ChunkPart::End, {})) {
+				return false;
+			}
+			chunk++;
+			chunk_open = false;
+		}
+
+		if (!chunk_open && !begin_chunk ()) {
+			return false;
+		}
+
+		if (blanked_lines.contains (current_line)) {
+			line.clear ();
+		}
+
+		buffer.append (line);
+		buffer.append ("\n");
+
+		if (buffer.size () >= write_buffer_size && !flush ()) {
+			return false;
+		}
+	}
+
+	if (input.bad ()) {
+		return false;
+	}
+
+	if (!chunk_open && !begin_chunk ()) {
+		return false;
+	}
+
+	return flush () && write (chunk, ChunkPart::End, {});
+}
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__CHUNK_SPLITTER_HH)
+#define __CHUNK_SPLITTER_HH
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "asm_syntax.hh"
+#include "constants.hh"
+
+namespace xamarin::android::gas
+{
+	// Splits assembler source into chunks which can be assembled separately and linked with `ld -r` into an object
+	// equivalent to the one assembled from the whole source, so that `--incremental` needs to reassemble only the
+	// chunks which changed.
+	//
+	// Chunks start at function boundaries (the function's label, preceded by its alignment, section and symbol
+	// attribute directives).  A chunk is at least `min_chunk_size` bytes long and ends before a function whose name
+	// hashes to a multiple of `boundary_divisor`, or once it reaches `max_chunk_size`.  The boundaries thus depend on
+	// the functions around them, not on their offsets, and an edit doesn't move the boundaries which follow it.
+	// Boundaries the assembler couldn't resolve references across are never used: functions referring to each other's
+	// local symbols, taking differences of labels in different functions or sharing a section group or a numeric
+	// local label stay in the same chunk.
+	//
+	// Every chunk starts with a prologue which restores the assembler state: the current section, flags of the
+	// sections it uses, instruction set and syntax directives, the DWARF file table and the attributes of the symbols
+	// it defines which are declared elsewhere.  A line marker follows, so that diagnostics and debug information refer
+	// to the original source lines.  Inputs using directives whose effect can't be tracked (macros, conditionals,
+	// includes, `.org` etc) form a single chunk.
+	class ChunkSplitter final
+	{
+	public:
+		enum class ChunkPart
+		{
+			Begin,
+			Prologue,
+			LineMarker,
+			Source,
+			End,
+		};
+
+		// Called for each part of every chunk, in order.  `text` is empty for `Begin` and `End`.
+		using chunk_write_fn = std::function<bool(size_t chunk, ChunkPart part, std::string_view const& text)>;
+
+		struct Chunk
+		{
+			uint64_t    first_line = 1;
+			uint64_t    line_count = 0;
+			uint64_t    size = 0;         // of the source lines, without the prologue
+			std::string prologue;
+			bool        cacheable = true; // `false` if the chunk reads other files (`.incbin`)
+		};
+
+		static constexpr uint64_t min_chunk_size   = 128 * 1024;
+		static constexpr uint64_t max_chunk_size   = 1024 * 1024;
+		static constexpr uint64_t boundary_divisor = 32;
+
+	private:
+		static constexpr uint64_t no_line = UINT64_MAX;
+		static constexpr size_t   write_buffer_size = 64 * 1024;
+
+		struct SymbolInfo
+		{
+			uint64_t defined_line = 0;        // `0` if not defined in the input
+			uint64_t first_reference = no_line;
+			uint64_t last_reference = 0;
+			uint64_t first_anchor = no_line;  // references the assembler must resolve itself, e.g. label differences
+			uint64_t last_anchor = 0;
+			bool     global = false;
+			bool     declared_local = false;
+			bool     common = false;
+			bool     variable = false;        // defined with `.set` and friends, or redefined
+		};
+
+		struct SectionInfo
+		{
+			std::string name_token;           // as written in the source, possibly quoted
+			std::string declaration;          // the first `.section` directive with flags, if any
+			bool        in_group = false;     // COMDAT group member or unique section, can't be declared in several chunks
+			uint64_t    first_line = no_line;
+			uint64_t    last_line = 0;
+		};
+
+		// Assembler state at the start of a line
+		struct Position
+		{
+			uint64_t line = 1;
+			uint64_t offset = 0;
+			uint32_t section = 0;
+			size_t   state_directives = 0;
+			bool     can_be_boundary = true;
+		};
+
+		struct Segment
+		{
+			Position    start;
+			std::string function;
+		};
+
+		struct StateDirective
+		{
+			uint64_t    line;
+			std::string slot;                 // directives in the same slot override each other
+			std::string text;
+		};
+
+		struct AttributeDirective
+		{
+			uint64_t                 line;
+			std::string              mnemonic;
+			std::vector<std::string> symbols;
+			std::string              suffix;  // e.g. `, @function` of `.type`
+			bool                     movable; // the only statement on its line
+		};
+
+		struct SectionSwitch
+		{
+			uint64_t line;
+			uint32_t section;
+		};
+
+	public:
+		// `hash_size` is the expected number of identifiers in the input (`0` if unknown)
+		explicit ChunkSplitter (TargetArchitecture arch, size_t hash_size = 0);
+
+		// Returns `false` if the input cannot be split, it then forms a single chunk
+		bool analyze (std::istream &input);
+
+		// Second pass over the same input.  `source_name` is the input file name used in the line markers.
+		bool write_chunks (std::istream &input, std::string const& source_name, chunk_write_fn const& write) const;
+
+		std::vector<Chunk> const& chunks () const noexcept
+		{
+			return _chunks;
+		}
+
+	private:
+		void analyze_line (std::string_view line);
+		void analyze_statement (std::string_view text, bool only_statement_on_line, bool first_statement_on_line, bool &preamble_only);
+		bool handle_directive (AsmSyntax::Statement const& statement, bool movable);
+		void define_symbol (std::string_view name, bool variable);
+		void define_numeric_label (std::string_view label);
+		void add_references (std::string_view operands, bool anchors);
+		void add_attribute (std::string_view mnemonic, std::string_view operands, bool movable);
+		void add_state_directive (std::string slot, AsmSyntax::Statement const& statement);
+		void switch_section (std::string_view operands);
+		void start_segment (std::string_view function);
+		uint32_t intern (std::string_view identifier);
+		uint32_t intern_section (std::string_view name_token);
+		bool is_arm_non_branch (std::string_view mnemonic, std::string_view operands) const noexcept;
+
+		void finish_analysis ();
+		void make_single_chunk ();
+		size_t segment_of (uint64_t line) const noexcept;
+		size_t chunk_of (uint64_t line) const noexcept;
+		std::string make_section_switch (uint32_t section) const;
+
+		static std::string statement_text (AsmSyntax::Statement const& statement);
+		static bool has_binary_minus (std::string_view operands) noexcept;
+		static bool has_complex_operator (std::string_view operands) noexcept;
+		static uint64_t hash_name (std::string_view name) noexcept;
+
+	private:
+		TargetArchitecture const target_arch;
+		bool                     can_split = true;
+		uint64_t                 line_number = 0;
+		uint64_t                 offset = 0;
+
+		uint32_t                 current_section = 0;
+		std::vector<uint32_t>    section_stack;
+		int                      cfi_depth = 0;
+		bool                     function_open = false; // `.size` or `.cfi_endproc` of the last function not seen yet
+		Position                 line_start;
+		Position                 preamble_start;
+		bool                     in_preamble = false;
+
+		// All the identifiers referenced anywhere are interned, to keep memory use in check on large inputs
+		std::unordered_map<std::string, uint32_t> identifier_ids;
+		std::vector<SymbolInfo>                   symbols;
+		std::unordered_set<uint32_t>              function_symbols;
+
+		std::unordered_map<std::string, uint32_t> section_ids;
+		std::vector<SectionInfo>                  sections;
+		std::vector<SectionSwitch>                section_switches;
+
+		std::vector<StateDirective>               state_directives;
+		std::vector<std::string>                  file_directives;
+		std::vector<AttributeDirective>           attribute_directives;
+		std::vector<uint64_t>                     incbin_lines;
+
+		std::unordered_map<std::string, uint64_t> numeric_labels;   // line of the last definition
+		std::unordered_map<std::string, uint64_t> forward_numeric_references;
+		std::vector<std::pair<uint64_t, uint64_t>> line_merges;     // lines which must end up in the same chunk
+
+		std::vector<Segment>                      segments;
+
+		// Results of the analysis, used by `write_chunks`
+		std::vector<Chunk>                        _chunks;
+		std::unordered_set<uint64_t>              blanked_lines;
+	};
+}
+#endif // __CHUNK_SPLITTER_HH
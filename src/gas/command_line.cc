@@ -42,7 +42,8 @@ bool CommandLine::parse (std::span<const CommandLineOption> options, std::vector
 			continue;
 		}
 
-		if (iter == option.cbegin ()) { // positional
+		// A lone `-` is positional too, it names stdin
+		if (iter == option.cbegin () || (iter == option.cend () && option.length () == 1)) { // positional
 			option_cb ({ positional_count++ }, { option });
 			continue;
 		}
@@ -82,6 +83,27 @@ bool CommandLine::parse (std::span<const CommandLineOption> options, std::vector
 		// C++ standard library on mac CI doesn't have std::ranges::find_if
 		auto match = std::find_if (options.begin (), options.end (), matching_option);
 #endif
+		if (match == options.end () && name_start - option.cbegin () == 1 && option_name.length () > 1) {
+			// Like getopt, single-letter options requiring a value accept it without a separator (e.g. `-Idir`)
+			auto matching_short_option = [this, &option_name] (CommandLineOption const& o) -> bool {
+				if (o.argument != ArgumentValue::Required || o.name.length () != 1 || o.name[0] != option_name[0]) {
+					return false;
+				}
+
+				return o.arch == TargetArchitecture::Any || o.arch == target_arch;
+			};
+
+#if !defined(__APPLE__)
+			match = ranges::find_if (options, matching_short_option);
+#else
+			match = std::find_if (options.begin (), options.end (), matching_short_option);
+#endif
+			if (match != options.end ()) {
+				option_cb (*match, option.substr (2));
+				continue;
+			}
+		}
+
 		if (match == options.end ()) {
 			STDERR << "Unrecognized option '" << option << Constants::newline;
 			continue;
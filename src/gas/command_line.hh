@@ -32,9 +32,36 @@ namespace xamarin::android::gas
 		Warn,
 		G,
 		MFPU,
+		MArch,
+		MCpu,
+		MThumb,
+		MTune,
+		MRelaxRelocations,
+		Mode32,
+		Mode64,
 		Version,
 		VersionExit,
 		Help,
+		Jobs,
+		MemoryBudget,
+		WriteIfChanged,
+		DebugPrefixMap,
+		ReproduciblePaths,
+		RemoteCache,
+		Quiet,
+		FunctionSections,
+		SplitDebug,
+		OutputKind,
+		ChildPolicy,
+		ChildAllocator,
+		ReduceMemoryOverheads,
+		HashSize,
+		IncludeDir,
+		MD,
+		ExportList,
+		SizeReport,
+		Incremental,
+		FoldSections,
 	};
 
 	struct CommandLineOption
@@ -2,6 +2,8 @@
 #if !defined (__CONSTANTS_HH)
 #define __CONSTANTS_HH
 
+#include <cstdint>
+
 #include "platform.hh"
 
 namespace xamarin::android::gas
@@ -17,13 +19,23 @@ namespace xamarin::android::gas
 		static constexpr platform::string_view llvm_mc_name { "llvm-mc" };
 #endif
 		static constexpr platform::string_view arch_hack_param { PSTR("@gas-arch=") };
+		static constexpr platform::string_view ld_cache_param { PSTR("@ld-cache") };
+		static constexpr platform::string_view batch_strip_param { PSTR("@batch-strip") };
 		static constexpr platform::string_view default_output_name { PSTR("a.out") };
+		static constexpr platform::string_view reproducible_paths_token { PSTR(".") };
+		// Upper bound of `--hash-size`, far more symbols than any single AOT assembly file has.  Each table reserves
+		// buckets for this many entries up front, so larger values would only exhaust memory
+		static constexpr uint64_t max_hash_size = 4 * 1024 * 1024;
+		// Upper bounds of `--jobs` and `--memory-budget` (in MB), the latter so that the budget in bytes fits in 64 bits
+		static constexpr uint64_t max_jobs = 4096;
+		static constexpr uint64_t max_memory_budget_mb = UINT64_MAX / (1024 * 1024);
 		static constexpr int wrapper_general_error_code         = 100;
 		static constexpr int wrapper_llvm_mc_killed_error_code  = wrapper_general_error_code + 1;
 		static constexpr int wrapper_llvm_mc_stopped_error_code = wrapper_general_error_code + 2;
 		static constexpr int wrapper_fork_failed_error_code     = wrapper_general_error_code + 3;
 		static constexpr int wrapper_exec_failed_error_code     = wrapper_general_error_code + 4;
 		static constexpr int wrapper_wait_failed_error_code     = wrapper_general_error_code + 5;
+		static constexpr int wrapper_input_failed_error_code    = wrapper_general_error_code + 6;
 	};
 
 	enum class TargetArchitecture
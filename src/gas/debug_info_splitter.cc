@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: MIT
+#include <array>
+#include <fstream>
+
+#include "debug_info_splitter.hh"
+#include "exceptions.hh"
+#include "file_utils.hh"
+
+using namespace xamarin::android::gas;
+
+bool DebugInfoSplitter::is_debug_section (ElfSection const& section) noexcept
+{
+	if (section.type == ElfObject::SHT_REL || section.type == ElfObject::SHT_RELA) {
+		return false; // removed along with the section they apply to
+	}
+
+	return section.name.starts_with (".debug_") || section.name.starts_with (".zdebug_") || section.name == ".gnu_debuglink";
+}
+
+uint32_t DebugInfoSplitter::crc32 (uint8_t const* data, size_t size) noexcept
+{
+	static std::array<uint32_t, 256> const table = []() {
+		std::array<uint32_t, 256> ret {};
+		for (uint32_t i = 0; i < ret.size (); i++) {
+			uint32_t c = i;
+			for (int bit = 0; bit < 8; bit++) {
+				c = (c & 1) != 0 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			}
+			ret[i] = c;
+		}
+		return ret;
+	}();
+
+	uint32_t crc = 0xffffffff;
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return crc ^ 0xffffffff;
+}
+
+ElfSection DebugInfoSplitter::make_debug_link (fs::path const& debug_link_name, uint32_t debug_file_crc)
+{
+	// File name, NUL-padded to a multiple of 4 bytes, followed by the CRC of the debug file
+	std::string name = debug_link_name.filename ().string ();
+
+	ElfSection section;
+	section.name = ".gnu_debuglink";
+	section.type = ElfObject::SHT_PROGBITS;
+	section.addralign = 4;
+	section.data.assign (name.begin (), name.end ());
+	section.data.push_back (0);
+	while (section.data.size () % 4 != 0) {
+		section.data.push_back (0);
+	}
+
+	for (size_t i = 0; i < 4; i++) {
+		section.data.push_back (static_cast<uint8_t>(debug_file_crc >> (i * 8)));
+	}
+
+	return section;
+}
+
+void DebugInfoSplitter::write_image (fs::path const& path, std::vector<uint8_t> const& image)
+{
+	std::ofstream os { path, std::ios::binary | std::ios::trunc };
+	os.write (reinterpret_cast<char const*>(image.data ()), static_cast<std::streamsize>(image.size ()));
+	os.close ();
+	if (!os) {
+		throw invalid_operation_error { "Unable to write " + path.string () };
+	}
+}
+
+void DebugInfoSplitter::split (fs::path const& object_file, fs::path const& debug_file, fs::path const& debug_link_name)
+{
+	ElfObject object = ElfObject::read (object_file);
+
+	// The debug file keeps all the sections (so that section indices in the debug info stay valid), but the contents
+	// of the loadable ones are dropped, like with `objcopy --only-keep-debug`.  Relocations of the code and data
+	// aren't needed by debuggers.
+	{
+		ElfObject debug = object;
+		debug.remove_sections (
+			[&debug](ElfSection const& section) {
+				if (section.type != ElfObject::SHT_REL && section.type != ElfObject::SHT_RELA) {
+					return section.type == ElfObject::SHT_LLVM_ADDRSIG;
+				}
+
+				return section.info < debug.sections ().size () && !is_debug_section (debug.sections ()[section.info]);
+			}
+		);
+
+		for (ElfSection &section : debug.sections ()) {
+			if ((section.flags & ElfObject::SHF_ALLOC) == 0 || section.type == ElfObject::SHT_NOBITS || section.type == ElfObject::SHT_NOTE) {
+				continue;
+			}
+
+			section.nobits_size = section.data.size ();
+			section.type = ElfObject::SHT_NOBITS;
+			section.data.clear ();
+			section.data.shrink_to_fit ();
+		}
+
+		std::vector<uint8_t> debug_image = debug.serialize ();
+		write_image (debug_file, debug_image);
+
+		object.remove_sections (is_debug_section);
+		object.add_section (make_debug_link (debug_link_name, crc32 (debug_image.data (), debug_image.size ())));
+	}
+
+	// Write the stripped object next to the original and replace it only once complete
+	fs::path stripped_file = FileUtils::make_temporary_path (object_file);
+	try {
+		object.write (stripped_file);
+		fs::rename (stripped_file, object_file);
+	} catch (...) {
+		std::error_code ec;
+		fs::remove (stripped_file, ec);
+		throw;
+	}
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__DEBUG_INFO_SPLITTER_HH)
+#define __DEBUG_INFO_SPLITTER_HH
+
+#include <cstddef>
+#include <cstdint>
+
+#include "elf_object.hh"
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// Does what `objcopy --only-keep-debug` followed by `objcopy --strip-debug --add-gnu-debuglink` does, without
+	// starting any processes and reading and writing the object just once.
+	class DebugInfoSplitter final
+	{
+	public:
+		// Moves the debug information from `object_file` (which is modified in place) to `debug_file`, and adds a
+		// `.gnu_debuglink` section referring to `debug_link_name` (the name the debug file will be installed under,
+		// used by debuggers to find it) to the object.  Throws `invalid_operation_error` on error.
+		static void split (fs::path const& object_file, fs::path const& debug_file, fs::path const& debug_link_name);
+
+		static bool is_debug_section (ElfSection const& section) noexcept;
+
+	private:
+		// The CRC-32 variant used by `.gnu_debuglink` (the same as zlib's)
+		static uint32_t crc32 (uint8_t const* data, size_t size) noexcept;
+		static ElfSection make_debug_link (fs::path const& debug_link_name, uint32_t debug_file_crc);
+		static void write_image (fs::path const& path, std::vector<uint8_t> const& image);
+	};
+}
+#endif // __DEBUG_INFO_SPLITTER_HH
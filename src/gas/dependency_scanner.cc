@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: MIT
+#include <cctype>
+#include <fstream>
+
+#include "dependency_scanner.hh"
+#include "exceptions.hh"
+#include "input_stream.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr std::string_view include_directive { ".include" };
+	constexpr std::string_view incbin_directive  { ".incbin" };
+
+	// Same as GAS, lines are wrapped before they get longer than this
+	constexpr size_t max_rule_columns = 72;
+
+	bool starts_with_directive (std::string_view const& line, std::string_view const& directive) noexcept
+	{
+		if (line.length () <= directive.length ()) {
+			return false;
+		}
+
+		// Directive names are case-insensitive
+		for (size_t i = 0; i < directive.length (); i++) {
+			if (std::tolower (static_cast<unsigned char>(line[i])) != directive[i]) {
+				return false;
+			}
+		}
+
+		char next = line[directive.length ()];
+		return next == ' ' || next == '\t' || next == '"';
+	}
+}
+
+void DependencyScanner::scan_input (fs::path const& input_file)
+{
+	if (seen.insert (input_file.string ()).second) {
+		_dependencies.push_back (input_file);
+	}
+
+	try {
+		std::unique_ptr<InputStream> input = InputStream::open (input_file);
+		std::string line;
+		while (std::getline (*input, line)) {
+			scan_line (line);
+		}
+	} catch (std::exception const&) {
+	}
+}
+
+void DependencyScanner::add_data (char const* data, size_t size)
+{
+	std::string_view chunk { data, size };
+	while (!chunk.empty ()) {
+		size_t newline = chunk.find ('\n');
+		if (newline == std::string_view::npos) {
+			pending_line.append (chunk);
+			return;
+		}
+
+		if (pending_line.empty ()) {
+			scan_line (chunk.substr (0, newline));
+		} else {
+			pending_line.append (chunk.substr (0, newline));
+			scan_line (pending_line);
+			pending_line.clear ();
+		}
+		chunk.remove_prefix (newline + 1);
+	}
+}
+
+void DependencyScanner::finish ()
+{
+	if (!pending_line.empty ()) {
+		scan_line (pending_line);
+		pending_line.clear ();
+	}
+}
+
+void DependencyScanner::scan_line (std::string_view line)
+{
+	while (!line.empty () && (line.front () == ' ' || line.front () == '\t')) {
+		line.remove_prefix (1);
+	}
+
+	bool is_include = starts_with_directive (line, include_directive);
+	if (!is_include && !starts_with_directive (line, incbin_directive)) {
+		return;
+	}
+
+	line.remove_prefix (is_include ? include_directive.length () : incbin_directive.length ());
+	std::optional<std::string> name = parse_file_name (line);
+	if (!name.has_value ()) {
+		return;
+	}
+
+	std::optional<fs::path> path = resolve (name.value ());
+	if (!path.has_value ()) {
+		return;
+	}
+
+	if (seen.insert (path.value ().string ()).second) {
+		_dependencies.push_back (path.value ());
+		if (is_include) {
+			scan_file (path.value ());
+		}
+	}
+}
+
+void DependencyScanner::scan_file (fs::path const& path)
+{
+	std::ifstream input { path, std::ios::binary };
+	if (!input) {
+		return;
+	}
+
+	std::string line;
+	while (std::getline (input, line)) {
+		scan_line (line);
+	}
+}
+
+std::optional<fs::path> DependencyScanner::resolve (std::string const& name) const
+{
+	auto is_file = [](fs::path const& path) -> bool {
+		std::error_code ec;
+		return fs::is_regular_file (path, ec);
+	};
+
+	fs::path path { name };
+	if (is_file (path)) {
+		return path;
+	}
+
+	if (path.is_absolute ()) {
+		return std::nullopt;
+	}
+
+	for (fs::path const& dir : include_dirs) {
+		fs::path candidate = dir / path;
+		if (is_file (candidate)) {
+			return candidate;
+		}
+	}
+
+	return std::nullopt;
+}
+
+std::optional<std::string> DependencyScanner::parse_file_name (std::string_view operands)
+{
+	while (!operands.empty () && (operands.front () == ' ' || operands.front () == '\t')) {
+		operands.remove_prefix (1);
+	}
+
+	// `llvm-mc` accepts only quoted names
+	if (operands.empty () || operands.front () != '"') {
+		return std::nullopt;
+	}
+
+	std::string name;
+	for (size_t i = 1; i < operands.length (); i++) {
+		char c = operands[i];
+		if (c == '"') {
+			return name;
+		}
+
+		if (c == '\\' && i + 1 < operands.length ()) {
+			i++;
+			c = operands[i];
+		}
+		name.push_back (c);
+	}
+
+	return std::nullopt;
+}
+
+std::string DependencyScanner::make_quote (fs::path const& path)
+{
+	std::string ret;
+	for (char c : path.string ()) {
+		switch (c) {
+			case ' ':
+			case '\t':
+			case '#':
+				ret.push_back ('\\');
+				break;
+
+			case '$':
+				ret.push_back ('$');
+				break;
+		}
+		ret.push_back (c);
+	}
+
+	return ret;
+}
+
+void DependencyScanner::write_make_rule (fs::path const& dependency_file, fs::path const& target, std::vector<fs::path> const& prerequisites)
+{
+	std::ofstream os { dependency_file, std::ios::binary };
+	if (!os) {
+		std::string message { "Unable to open " };
+		message.append (dependency_file.string ());
+		message.append (" for writing");
+		throw invalid_operation_error { message };
+	}
+
+	std::string rule = make_quote (target);
+	rule.push_back (':');
+	size_t column = rule.length ();
+
+	for (fs::path const& prerequisite : prerequisites) {
+		std::string quoted = make_quote (prerequisite);
+		if (column + quoted.length () + 3 > max_rule_columns) {
+			rule.append (" \\\n ");
+			column = 0;
+		} else {
+			rule.push_back (' ');
+			column++;
+		}
+
+		rule.append (quoted);
+		column += quoted.length ();
+	}
+	rule.push_back ('\n');
+
+	os.write (rule.data (), static_cast<std::streamsize>(rule.length ()));
+	os.close ();
+	if (!os) {
+		std::string message { "Unable to write " };
+		message.append (dependency_file.string ());
+		throw invalid_operation_error { message };
+	}
+}
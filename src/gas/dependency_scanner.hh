@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__DEPENDENCY_SCANNER_HH)
+#define __DEPENDENCY_SCANNER_HH
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// Collects the files the output depends on, for the `--MD` dependency file: the input files and the ones named by
+	// `.include` (which are scanned as well) and `.incbin` directives in them.  Names are resolved the same way `llvm-mc` does it, relative
+	// to the current directory first and then to each of the `-I` directories in order.  Files which cannot be found are
+	// skipped, `llvm-mc` reports them.  Only directives at the start of a statement are recognized, directives inside
+	// macros or conditionals are treated as if they were always expanded.
+	class DependencyScanner final
+	{
+	public:
+		explicit DependencyScanner (std::vector<fs::path> const& include_dirs)
+			: include_dirs (include_dirs)
+		{}
+
+		// Adds the input file and scans it (after decompression).  Inputs which cannot be read are skipped, `llvm-mc`
+		// fails to read them too.  Source read from stdin must be passed to `add_data` instead.
+		void scan_input (fs::path const& input_file);
+
+		// Scans source read from stdin as it is passed to `llvm-mc`, in chunks of any size.  `finish` must be called
+		// after the last one.
+		void add_data (char const* data, size_t size);
+		void finish ();
+
+		// In the order they were first referenced, without duplicates
+		std::vector<fs::path> const& dependencies () const noexcept
+		{
+			return _dependencies;
+		}
+
+		// Writes a make rule stating that `target` depends on all of `prerequisites`, the way GAS does it for `--MD`.
+		// Throws `invalid_operation_error` if the file cannot be written.
+		static void write_make_rule (fs::path const& dependency_file, fs::path const& target, std::vector<fs::path> const& prerequisites);
+
+	private:
+		void scan_line (std::string_view line);
+		void scan_file (fs::path const& path);
+		std::optional<fs::path> resolve (std::string const& name) const;
+
+		static std::optional<std::string> parse_file_name (std::string_view operands);
+		static std::string make_quote (fs::path const& path);
+
+	private:
+		std::vector<fs::path>           include_dirs;
+		std::vector<fs::path>           _dependencies;
+		std::unordered_set<std::string> seen;
+		std::string                     pending_line;
+	};
+}
+#endif // __DEPENDENCY_SCANNER_HH
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include "constants.hh"
+#include "diagnostics.hh"
+#include "platform.hh"
+
+using namespace xamarin::android::gas;
+
+bool DiagnosticsAggregator::Stream::parse_header (std::string_view const& line, DiagnosticSeverity &severity, std::string &message)
+{
+	// Source excerpts and carets are indented, diagnostics never are
+	if (line.empty () || line.front () == ' ' || line.front () == '\t') {
+		return false;
+	}
+
+	constexpr std::array<std::pair<std::string_view, DiagnosticSeverity>, 3> markers {{
+		{ ": error: ",   DiagnosticSeverity::Error },
+		{ ": warning: ", DiagnosticSeverity::Warning },
+		{ ": note: ",    DiagnosticSeverity::Note },
+	}};
+
+	for (auto const& [marker, marker_severity] : markers) {
+		size_t pos = line.find (marker);
+		if (pos == std::string_view::npos) {
+			continue;
+		}
+
+		severity = marker_severity;
+		message = line.substr (pos + marker.length ());
+		return true;
+	}
+
+	return false;
+}
+
+void DiagnosticsAggregator::Stream::add_line (std::string_view const& original_line)
+{
+	constexpr std::string_view stdin_prefix { "<stdin>:" };
+
+	std::string renamed_line;
+	std::string_view line = original_line;
+	if (!stdin_name.empty () && line.starts_with (stdin_prefix)) {
+		renamed_line.append (stdin_name).append (line.substr (stdin_prefix.length () - 1));
+		line = renamed_line;
+	}
+
+	DiagnosticSeverity line_severity;
+	std::string line_message;
+
+	if (parse_header (line, line_severity, line_message)) {
+		// Notes elaborate on the diagnostic preceding them
+		if (line_severity != DiagnosticSeverity::Note || !have_diagnostic) {
+			finish ();
+			have_diagnostic = true;
+			severity = line_severity;
+			message = std::move (line_message);
+		}
+	} else if (!have_diagnostic) {
+		// Not a diagnostic, nothing to aggregate
+		aggregator.pass_through (std::string { line } + "\n");
+		return;
+	}
+
+	text.append (line);
+	text.append ("\n");
+}
+
+void DiagnosticsAggregator::Stream::finish ()
+{
+	if (!have_diagnostic) {
+		return;
+	}
+
+	aggregator.add (severity, message, text);
+	have_diagnostic = false;
+	message.clear ();
+	text.clear ();
+}
+
+char const* DiagnosticsAggregator::severity_name (DiagnosticSeverity severity) noexcept
+{
+	switch (severity) {
+		case DiagnosticSeverity::Error:
+			return "error";
+
+		case DiagnosticSeverity::Warning:
+			return "warning";
+
+		case DiagnosticSeverity::Note:
+			return "note";
+	}
+
+	return "diagnostic";
+}
+
+void DiagnosticsAggregator::pass_through (std::string const& text)
+{
+	std::lock_guard<std::mutex> guard (lock);
+	STDERR << text.c_str ();
+}
+
+void DiagnosticsAggregator::add (DiagnosticSeverity severity, std::string const& message, std::string const& text)
+{
+	std::string key { severity_name (severity) };
+	key.append (": ").append (message);
+
+	std::lock_guard<std::mutex> guard (lock);
+	auto iter = index.find (key);
+	if (iter != index.end ()) {
+		entries[iter->second].count++;
+
+		// Every error location matters, only warnings and notes are deduplicated
+		if (severity == DiagnosticSeverity::Error) {
+			STDERR << text.c_str ();
+		}
+		return;
+	}
+
+	index.emplace (std::move (key), entries.size ());
+	entries.push_back ({ severity, message, 1 });
+
+	if (severity != DiagnosticSeverity::Warning || show_warnings) {
+		STDERR << text.c_str ();
+	}
+}
+
+void DiagnosticsAggregator::print_summary ()
+{
+	std::lock_guard<std::mutex> guard (lock);
+
+	uint64_t errors = 0, warnings = 0, repeated = 0;
+	std::vector<Entry const*> summary_entries;
+	for (Entry const& entry : entries) {
+		if (entry.severity == DiagnosticSeverity::Error) {
+			errors += entry.count;
+		} else if (entry.severity == DiagnosticSeverity::Warning) {
+			warnings += entry.count;
+		}
+
+		bool suppressed = entry.severity == DiagnosticSeverity::Warning && !show_warnings;
+		bool collapsed = entry.severity != DiagnosticSeverity::Error && entry.count > 1;
+		if (collapsed || suppressed) {
+			repeated += collapsed ? entry.count - 1 : 0;
+			summary_entries.push_back (&entry);
+		}
+	}
+
+	if (summary_entries.empty ()) {
+		return;
+	}
+
+	std::stable_sort (
+		summary_entries.begin (),
+		summary_entries.end (),
+		[](Entry const* a, Entry const* b) { return a->count > b->count; }
+	);
+
+	STDERR << "Diagnostics summary: " << errors << " error(s), " << warnings << " warning(s), "
+	       << entries.size () << " unique, " << repeated << " repeated diagnostic(s) not shown" << Constants::newline;
+
+	size_t shown = std::min (summary_entries.size (), max_summary_entries);
+	for (size_t i = 0; i < shown; i++) {
+		Entry const* entry = summary_entries[i];
+		STDERR << "  " << entry->count << " x " << severity_name (entry->severity) << ": " << entry->message.c_str () << Constants::newline;
+	}
+
+	if (shown < summary_entries.size ()) {
+		STDERR << "  ... and " << summary_entries.size () - shown << " more" << Constants::newline;
+	}
+
+	if (warnings > 0 && !show_warnings) {
+		STDERR << "Warnings were suppressed, use --warn to show them" << Constants::newline;
+	}
+}
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__DIAGNOSTICS_HH)
+#define __DIAGNOSTICS_HH
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace xamarin::android::gas
+{
+	enum class DiagnosticSeverity
+	{
+		Error,
+		Warning,
+		Note,
+	};
+
+	// Collects diagnostics printed by the child processes to their stderr.  Warnings and notes with the same message
+	// are considered identical regardless of their location: only the first one is shown, the rest are counted and
+	// reported in the summary printed at the end.  Errors are always shown, with all their locations.  Warnings are
+	// shown only if requested.
+	class DiagnosticsAggregator final
+	{
+		static constexpr size_t max_summary_entries = 20;
+
+		struct Entry
+		{
+			DiagnosticSeverity severity;
+			std::string        message;
+			uint64_t           count = 0;
+		};
+
+	public:
+		// Groups the lines of a single child's stderr into diagnostics: a line of the form `file:line:col: error: message`
+		// (or `program: error: message`) starts a new diagnostic, lines which follow it (source excerpt, caret etc) are
+		// part of it.  Must be used from a single thread.
+		class Stream final
+		{
+		public:
+			explicit Stream (DiagnosticsAggregator &aggregator) noexcept
+				: aggregator (aggregator)
+			{}
+
+			~Stream ()
+			{
+				finish ();
+			}
+
+			// Children reading their input from stdin refer to it as `<stdin>` in diagnostics, replace it with the
+			// name of the file the input came from
+			void set_stdin_name (std::string name)
+			{
+				stdin_name = std::move (name);
+			}
+
+			void add_line (std::string_view const& line);
+			void finish ();
+
+		private:
+			static bool parse_header (std::string_view const& line, DiagnosticSeverity &severity, std::string &message);
+
+		private:
+			DiagnosticsAggregator &aggregator;
+			bool                   have_diagnostic = false;
+			DiagnosticSeverity     severity = DiagnosticSeverity::Error;
+			std::string            message;
+			std::string            text;
+			std::string            stdin_name;
+		};
+
+	public:
+		explicit DiagnosticsAggregator (bool show_warnings) noexcept
+			: show_warnings (show_warnings)
+		{}
+
+		void print_summary ();
+
+	private:
+		void add (DiagnosticSeverity severity, std::string const& message, std::string const& text);
+		void pass_through (std::string const& text);
+		static char const* severity_name (DiagnosticSeverity severity) noexcept;
+
+	private:
+		bool const                               show_warnings;
+		std::mutex                               lock;
+		std::unordered_map<std::string, size_t>  index;
+		std::vector<Entry>                       entries;
+	};
+}
+#endif // __DIAGNOSTICS_HH
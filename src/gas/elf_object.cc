@@ -0,0 +1,732 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#include "elf_object.hh"
+#include "exceptions.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr uint32_t removed_index = UINT32_MAX;
+
+	// All the data is little-endian, we don't support big-endian targets
+	class ImageReader final
+	{
+	public:
+		explicit ImageReader (std::vector<uint8_t> const& image) noexcept
+			: image (image)
+		{}
+
+		void check (uint64_t offset, uint64_t size) const
+		{
+			if (offset > image.size () || size > image.size () - offset) {
+				throw invalid_operation_error { "Malformed ELF file: data extends past the end of file" };
+			}
+		}
+
+		uint8_t u8 (uint64_t offset) const
+		{
+			check (offset, 1);
+			return image[offset];
+		}
+
+		uint16_t u16 (uint64_t offset) const
+		{
+			check (offset, 2);
+			return static_cast<uint16_t>(image[offset] | (image[offset + 1] << 8));
+		}
+
+		uint32_t u32 (uint64_t offset) const
+		{
+			check (offset, 4);
+			return static_cast<uint32_t>(image[offset]) |
+				(static_cast<uint32_t>(image[offset + 1]) << 8) |
+				(static_cast<uint32_t>(image[offset + 2]) << 16) |
+				(static_cast<uint32_t>(image[offset + 3]) << 24);
+		}
+
+		uint64_t u64 (uint64_t offset) const
+		{
+			return static_cast<uint64_t>(u32 (offset)) | (static_cast<uint64_t>(u32 (offset + 4)) << 32);
+		}
+
+		// 32 or 64-bit "word", depending on the ELF class
+		uint64_t word (uint64_t offset, bool elf64) const
+		{
+			return elf64 ? u64 (offset) : u32 (offset);
+		}
+
+	private:
+		std::vector<uint8_t> const& image;
+	};
+
+	void put_u16 (uint8_t *p, uint16_t v) noexcept
+	{
+		p[0] = static_cast<uint8_t>(v);
+		p[1] = static_cast<uint8_t>(v >> 8);
+	}
+
+	void put_u32 (uint8_t *p, uint32_t v) noexcept
+	{
+		for (size_t i = 0; i < 4; i++) {
+			p[i] = static_cast<uint8_t>(v >> (i * 8));
+		}
+	}
+
+	void put_u64 (uint8_t *p, uint64_t v) noexcept
+	{
+		put_u32 (p, static_cast<uint32_t>(v));
+		put_u32 (p + 4, static_cast<uint32_t>(v >> 32));
+	}
+
+	void put_word (uint8_t *p, uint64_t v, bool elf64) noexcept
+	{
+		if (elf64) {
+			put_u64 (p, v);
+		} else {
+			put_u32 (p, static_cast<uint32_t>(v));
+		}
+	}
+
+	uint64_t align_to (uint64_t value, uint64_t alignment) noexcept
+	{
+		if (alignment <= 1) {
+			return value;
+		}
+
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	std::string read_string (std::vector<uint8_t> const& table, uint32_t offset)
+	{
+		if (offset >= table.size ()) {
+			throw invalid_operation_error { "Malformed ELF file: string offset outside of the string table" };
+		}
+
+		auto begin = table.begin () + offset;
+		auto end = std::find (begin, table.end (), 0);
+		if (end == table.end ()) {
+			throw invalid_operation_error { "Malformed ELF file: unterminated string in the string table" };
+		}
+
+		return std::string (begin, end);
+	}
+
+	class StringTableBuilder final
+	{
+	public:
+		StringTableBuilder ()
+		{
+			data.push_back ('\0');
+		}
+
+		uint32_t add (std::string const& s)
+		{
+			if (s.empty ()) {
+				return 0;
+			}
+
+			auto iter = offsets.find (s);
+			if (iter != offsets.end ()) {
+				return iter->second;
+			}
+
+			uint32_t offset = static_cast<uint32_t>(data.size ());
+			data.insert (data.end (), s.begin (), s.end ());
+			data.push_back ('\0');
+			offsets.emplace (s, offset);
+			return offset;
+		}
+
+	public:
+		std::vector<uint8_t>                      data;
+
+	private:
+		std::unordered_map<std::string, uint32_t> offsets;
+	};
+}
+
+uint64_t ElfSection::size () const noexcept
+{
+	return type == ElfObject::SHT_NOBITS ? nobits_size : data.size ();
+}
+
+bool ElfSymbol::is_defined () const noexcept
+{
+	return section != ElfObject::SHN_UNDEF;
+}
+
+ElfObject ElfObject::read (fs::path const& path)
+{
+	std::ifstream is { path, std::ios::binary };
+	if (!is) {
+		throw invalid_operation_error { "Unable to open " + path.string () };
+	}
+
+	std::vector<uint8_t> image { std::istreambuf_iterator<char> (is), std::istreambuf_iterator<char> () };
+	if (is.bad ()) {
+		throw invalid_operation_error { "Unable to read " + path.string () };
+	}
+
+	return parse (image);
+}
+
+ElfObject ElfObject::parse (std::vector<uint8_t> const& image)
+{
+	ImageReader reader { image };
+	reader.check (0, 16);
+	if (image[0] != 0x7f || image[1] != 'E' || image[2] != 'L' || image[3] != 'F') {
+		throw invalid_operation_error { "Not an ELF file" };
+	}
+
+	ElfObject elf;
+	std::memcpy (elf.e_ident, image.data (), sizeof (elf.e_ident));
+	if (image[4] != 1 && image[4] != 2) {
+		throw invalid_operation_error { "Malformed ELF file: unknown ELF class" };
+	}
+	elf.elf64 = image[4] == 2;
+
+	if (image[5] != 1) {
+		throw invalid_operation_error { "Big-endian ELF files are not supported" };
+	}
+
+	if (reader.u16 (16) != ET_REL) {
+		throw invalid_operation_error { "Only ELF relocatable objects are supported" };
+	}
+
+	elf.e_machine = reader.u16 (18);
+	elf.e_version = reader.u32 (20);
+
+	bool elf64 = elf.elf64;
+	uint64_t shoff     = elf64 ? reader.u64 (40) : reader.u32 (32);
+	elf.e_flags        = elf64 ? reader.u32 (48) : reader.u32 (36);
+	uint16_t shentsize = elf64 ? reader.u16 (58) : reader.u16 (46);
+	uint32_t shnum     = elf64 ? reader.u16 (60) : reader.u16 (48);
+	uint32_t shstrndx  = elf64 ? reader.u16 (62) : reader.u16 (50);
+
+	if (shoff == 0) {
+		throw invalid_operation_error { "Malformed ELF file: no section headers" };
+	}
+
+	if (shentsize != (elf64 ? 64 : 40)) {
+		throw invalid_operation_error { "Malformed ELF file: unexpected section header size" };
+	}
+
+	// With many sections, the real counts are stored in the null section header
+	if (shnum == 0) {
+		shnum = static_cast<uint32_t>(reader.word (shoff + (elf64 ? 32 : 20), elf64));
+	}
+
+	if (shstrndx == SHN_XINDEX) {
+		shstrndx = reader.u32 (shoff + (elf64 ? 40 : 24));
+	}
+
+	reader.check (shoff, static_cast<uint64_t>(shnum) * shentsize);
+	if (shstrndx >= shnum) {
+		throw invalid_operation_error { "Malformed ELF file: invalid section name table index" };
+	}
+
+	std::vector<uint32_t> name_offsets;
+	elf._sections.resize (shnum);
+	name_offsets.resize (shnum);
+	for (uint32_t i = 0; i < shnum; i++) {
+		uint64_t header = shoff + static_cast<uint64_t>(i) * shentsize;
+		ElfSection &section = elf._sections[i];
+
+		name_offsets[i]   = reader.u32 (header);
+		section.type      = reader.u32 (header + 4);
+		section.flags     = reader.word (header + 8, elf64);
+		section.addr      = elf64 ? reader.u64 (header + 16) : reader.u32 (header + 12);
+		uint64_t offset   = elf64 ? reader.u64 (header + 24) : reader.u32 (header + 16);
+		uint64_t size     = elf64 ? reader.u64 (header + 32) : reader.u32 (header + 20);
+		section.link      = elf64 ? reader.u32 (header + 40) : reader.u32 (header + 24);
+		section.info      = elf64 ? reader.u32 (header + 44) : reader.u32 (header + 28);
+		section.addralign = elf64 ? reader.u64 (header + 48) : reader.u32 (header + 32);
+		section.entsize   = elf64 ? reader.u64 (header + 56) : reader.u32 (header + 36);
+
+		if (i == 0) {
+			section = {};
+			continue;
+		}
+
+		if (section.type == SHT_NOBITS) {
+			section.nobits_size = size;
+		} else if (section.type != SHT_NULL) {
+			reader.check (offset, size);
+			section.data.assign (image.begin () + static_cast<ptrdiff_t>(offset), image.begin () + static_cast<ptrdiff_t>(offset + size));
+		}
+
+		if (section.type == SHT_SYMTAB) {
+			if (elf.symtab_index != 0) {
+				throw invalid_operation_error { "ELF files with more than one symbol table are not supported" };
+			}
+			elf.symtab_index = i;
+		}
+	}
+
+	for (uint32_t i = 1; i < shnum; i++) {
+		elf._sections[i].name = read_string (elf._sections[shstrndx].data, name_offsets[i]);
+	}
+	elf.shstrndx = shstrndx;
+
+	elf.parse_symbols ();
+	return elf;
+}
+
+void ElfObject::parse_symbols ()
+{
+	if (symtab_index == 0) {
+		return;
+	}
+
+	ElfSection const& symtab = _sections[symtab_index];
+	if (symtab.link == 0 || symtab.link >= _sections.size ()) {
+		throw invalid_operation_error { "Malformed ELF file: symbol table without a string table" };
+	}
+
+	std::vector<uint8_t> const& strtab = _sections[symtab.link].data;
+	std::vector<uint8_t> const* shndx_table = nullptr;
+	for (ElfSection const& section : _sections) {
+		if (section.type == SHT_SYMTAB_SHNDX && section.link == symtab_index) {
+			shndx_table = &section.data;
+			break;
+		}
+	}
+
+	ImageReader reader { symtab.data };
+	size_t entry_size = elf64 ? 24 : 16;
+	size_t count = symtab.data.size () / entry_size;
+	_symbols.resize (count);
+
+	for (size_t i = 0; i < count; i++) {
+		uint64_t entry = i * entry_size;
+		ElfSymbol &symbol = _symbols[i];
+		uint16_t shndx;
+
+		uint32_t name = reader.u32 (entry);
+		if (elf64) {
+			symbol.info  = reader.u8 (entry + 4);
+			symbol.other = reader.u8 (entry + 5);
+			shndx        = reader.u16 (entry + 6);
+			symbol.value = reader.u64 (entry + 8);
+			symbol.size  = reader.u64 (entry + 16);
+		} else {
+			symbol.value = reader.u32 (entry + 4);
+			symbol.size  = reader.u32 (entry + 8);
+			symbol.info  = reader.u8 (entry + 12);
+			symbol.other = reader.u8 (entry + 13);
+			shndx        = reader.u16 (entry + 14);
+		}
+
+		if (shndx == SHN_XINDEX) {
+			if (shndx_table == nullptr) {
+				throw invalid_operation_error { "Malformed ELF file: extended section index without SHT_SYMTAB_SHNDX" };
+			}
+			symbol.section = ImageReader { *shndx_table }.u32 (i * 4);
+		} else if (shndx >= SHN_LORESERVE) {
+			symbol.section = 0xffff0000 | shndx;
+		} else {
+			symbol.section = shndx;
+		}
+
+		symbol.name = name == 0 ? std::string {} : read_string (strtab, name);
+	}
+}
+
+uint32_t ElfObject::add_section (ElfSection section)
+{
+	_sections.push_back (std::move (section));
+	return static_cast<uint32_t>(_sections.size () - 1);
+}
+
+uint64_t ElfObject::relocation_size (ElfSection const& section) const noexcept
+{
+	if (section.type == SHT_RELA) {
+		return elf64 ? 24 : 12;
+	}
+
+	return elf64 ? 16 : 8;
+}
+
+void ElfObject::rewrite_relocation_symbols (ElfSection &section, std::vector<uint32_t> const& symbol_map) const
+{
+	uint64_t entry_size = relocation_size (section);
+	uint64_t info_offset = elf64 ? 8 : 4;
+	ImageReader reader { section.data };
+
+	for (uint64_t entry = 0; entry + entry_size <= section.data.size (); entry += entry_size) {
+		uint64_t info = reader.word (entry + info_offset, elf64);
+		uint64_t symbol = elf64 ? info >> 32 : info >> 8;
+		uint64_t type = elf64 ? info & 0xffffffff : info & 0xff;
+
+		if (symbol >= symbol_map.size () || symbol_map[symbol] == removed_index) {
+			throw invalid_operation_error { "Relocation in section " + section.name + " refers to a symbol in a removed section" };
+		}
+
+		uint64_t new_symbol = symbol_map[symbol];
+		info = elf64 ? (new_symbol << 32) | type : (new_symbol << 8) | type;
+		put_word (section.data.data () + entry + info_offset, info, elf64);
+	}
+}
+
+void ElfObject::remove_sections (std::function<bool(ElfSection const&)> const& predicate)
+{
+	size_t count = _sections.size ();
+	std::vector<bool> removed (count, false);
+
+	for (size_t i = 1; i < count; i++) {
+		if (i == shstrndx || i == symtab_index) {
+			continue;
+		}
+		removed[i] = predicate (_sections[i]);
+	}
+
+	// Relocations against removed sections go away with them
+	for (size_t i = 1; i < count; i++) {
+		ElfSection const& section = _sections[i];
+		if ((section.type == SHT_REL || section.type == SHT_RELA) && section.info < count && removed[section.info]) {
+			removed[i] = true;
+		}
+	}
+
+	std::vector<uint32_t> symbol_map (_symbols.size ());
+	std::vector<ElfSymbol> kept_symbols;
+	for (size_t i = 0; i < _symbols.size (); i++) {
+		uint32_t section = _symbols[i].section;
+		if (section != SHN_UNDEF && section < count && removed[section]) {
+			symbol_map[i] = removed_index;
+			continue;
+		}
+
+		symbol_map[i] = static_cast<uint32_t>(kept_symbols.size ());
+		kept_symbols.push_back (std::move (_symbols[i]));
+	}
+
+	bool symbols_removed = kept_symbols.size () != _symbols.size ();
+	if (symbols_removed) {
+		// Address significance tables refer to symbols by index, they're only an optimization hint
+		for (size_t i = 1; i < count; i++) {
+			if (_sections[i].type == SHT_LLVM_ADDRSIG) {
+				removed[i] = true;
+			}
+		}
+	}
+
+	std::vector<uint32_t> section_map (count);
+	uint32_t next_index = 0;
+	for (size_t i = 0; i < count; i++) {
+		section_map[i] = removed[i] ? removed_index : next_index++;
+	}
+
+	auto map_section = [&section_map, count](uint32_t index) -> uint32_t {
+		if (index >= count || section_map[index] == removed_index) {
+			return 0;
+		}
+		return section_map[index];
+	};
+
+	std::vector<ElfSection> kept_sections;
+	kept_sections.reserve (next_index);
+	for (size_t i = 0; i < count; i++) {
+		if (removed[i]) {
+			continue;
+		}
+
+		ElfSection &section = _sections[i];
+		if (symbols_removed && (section.type == SHT_REL || section.type == SHT_RELA) && section.link == symtab_index) {
+			rewrite_relocation_symbols (section, symbol_map);
+		}
+
+		if (section.type == SHT_GROUP) {
+			if (symbols_removed) {
+				if (section.info >= symbol_map.size () || symbol_map[section.info] == removed_index) {
+					throw invalid_operation_error { "Signature symbol of section group " + section.name + " was removed" };
+				}
+				section.info = symbol_map[section.info];
+			}
+
+			// The first word holds the group flags, the rest are member section indices
+			ImageReader reader { section.data };
+			std::vector<uint8_t> members (section.data.begin (), section.data.begin () + std::min<size_t> (4, section.data.size ()));
+			for (size_t offset = 4; offset + 4 <= section.data.size (); offset += 4) {
+				uint32_t member = map_section (reader.u32 (offset));
+				if (member == 0) {
+					continue;
+				}
+
+				uint8_t buf[4];
+				put_u32 (buf, member);
+				members.insert (members.end (), buf, buf + 4);
+			}
+			section.data = std::move (members);
+		}
+
+		if (section.link != 0) {
+			section.link = map_section (section.link);
+		}
+
+		if (section.type == SHT_REL || section.type == SHT_RELA || (section.flags & SHF_INFO_LINK) != 0) {
+			section.info = map_section (section.info);
+		}
+
+		kept_sections.push_back (std::move (section));
+	}
+
+	for (ElfSymbol &symbol : kept_symbols) {
+		if (symbol.section != SHN_UNDEF && symbol.section < count) {
+			symbol.section = section_map[symbol.section];
+		}
+	}
+
+	shstrndx = section_map[shstrndx];
+	symtab_index = symtab_index == 0 ? 0 : section_map[symtab_index];
+	_sections = std::move (kept_sections);
+	_symbols = std::move (kept_symbols);
+}
+
+void ElfObject::localize_symbols (std::function<bool(ElfSymbol const&)> const& predicate)
+{
+	std::vector<bool> local (_symbols.size (), true);
+	bool changed = false;
+	for (size_t i = 1; i < _symbols.size (); i++) {
+		ElfSymbol &symbol = _symbols[i];
+		if (symbol.binding () == STB_LOCAL) {
+			continue;
+		}
+
+		if (predicate (symbol)) {
+			symbol.info = static_cast<uint8_t>((STB_LOCAL << 4) | symbol.type ());
+			changed = true;
+		} else {
+			local[i] = false;
+		}
+	}
+
+	if (!changed) {
+		return;
+	}
+
+	// Address significance tables refer to symbols by index, they're only an optimization hint
+	remove_sections (
+		[](ElfSection const& section) -> bool {
+			return section.type == SHT_LLVM_ADDRSIG;
+		}
+	);
+
+	// Local symbols must precede the global ones, their relative order is preserved
+	std::vector<uint32_t> symbol_map (_symbols.size ());
+	std::vector<ElfSymbol> ordered_symbols;
+	ordered_symbols.reserve (_symbols.size ());
+	for (bool locals : { true, false }) {
+		for (size_t i = 0; i < _symbols.size (); i++) {
+			if (local[i] == locals) {
+				symbol_map[i] = static_cast<uint32_t>(ordered_symbols.size ());
+				ordered_symbols.push_back (std::move (_symbols[i]));
+			}
+		}
+	}
+
+	for (ElfSection &section : _sections) {
+		if (section.link != symtab_index) {
+			continue;
+		}
+
+		if (section.type == SHT_REL || section.type == SHT_RELA) {
+			rewrite_relocation_symbols (section, symbol_map);
+		} else if (section.type == SHT_GROUP && section.info < symbol_map.size ()) {
+			section.info = symbol_map[section.info];
+		}
+	}
+
+	_symbols = std::move (ordered_symbols);
+}
+
+std::vector<uint8_t> ElfObject::serialize () const
+{
+	size_t count = _sections.size ();
+	std::unordered_map<uint32_t, StringTableBuilder> string_tables;
+	std::unordered_map<uint32_t, std::vector<uint8_t>> generated;
+
+	StringTableBuilder &section_names = string_tables[shstrndx];
+	std::vector<uint32_t> name_offsets (count, 0);
+	for (size_t i = 1; i < count; i++) {
+		name_offsets[i] = section_names.add (_sections[i].name);
+	}
+
+	uint32_t symtab_info = 0;
+	if (symtab_index != 0) {
+		ElfSection const& symtab = _sections[symtab_index];
+		StringTableBuilder &symbol_names = string_tables[symtab.link];
+
+		uint32_t shndx_index = 0;
+		for (size_t i = 1; i < count; i++) {
+			if (_sections[i].type == SHT_SYMTAB_SHNDX && _sections[i].link == symtab_index) {
+				shndx_index = static_cast<uint32_t>(i);
+				break;
+			}
+		}
+
+		size_t entry_size = elf64 ? 24 : 16;
+		std::vector<uint8_t> &data = generated[symtab_index];
+		std::vector<uint8_t> shndx_data (_symbols.size () * 4, 0);
+		data.resize (_symbols.size () * entry_size);
+		symtab_info = static_cast<uint32_t>(_symbols.size ());
+
+		for (size_t i = 0; i < _symbols.size (); i++) {
+			ElfSymbol const& symbol = _symbols[i];
+			uint8_t *entry = data.data () + i * entry_size;
+
+			uint16_t shndx;
+			if (symbol.section >= 0xffff0000) {
+				shndx = static_cast<uint16_t>(symbol.section);
+			} else if (symbol.section >= SHN_LORESERVE) {
+				if (shndx_index == 0) {
+					throw invalid_operation_error { "Extended section indices require a SHT_SYMTAB_SHNDX section" };
+				}
+				shndx = SHN_XINDEX;
+				put_u32 (shndx_data.data () + i * 4, symbol.section);
+			} else {
+				shndx = static_cast<uint16_t>(symbol.section);
+			}
+
+			put_u32 (entry, symbol.name.empty () ? 0 : symbol_names.add (symbol.name));
+			if (elf64) {
+				entry[4] = symbol.info;
+				entry[5] = symbol.other;
+				put_u16 (entry + 6, shndx);
+				put_u64 (entry + 8, symbol.value);
+				put_u64 (entry + 16, symbol.size);
+			} else {
+				put_u32 (entry + 4, static_cast<uint32_t>(symbol.value));
+				put_u32 (entry + 8, static_cast<uint32_t>(symbol.size));
+				entry[12] = symbol.info;
+				entry[13] = symbol.other;
+				put_u16 (entry + 14, shndx);
+			}
+
+			if (symtab_info == _symbols.size () && i > 0 && symbol.binding () != STB_LOCAL) {
+				symtab_info = static_cast<uint32_t>(i);
+			}
+		}
+
+		if (shndx_index != 0) {
+			generated[shndx_index] = std::move (shndx_data);
+		}
+	}
+
+	for (auto& [index, builder] : string_tables) {
+		generated[index] = std::move (builder.data);
+	}
+
+	auto section_data = [this, &generated](size_t index) -> std::vector<uint8_t> const& {
+		auto iter = generated.find (static_cast<uint32_t>(index));
+		return iter != generated.end () ? iter->second : _sections[index].data;
+	};
+
+	uint64_t ehsize = elf64 ? 64 : 52;
+	uint64_t shentsize = elf64 ? 64 : 40;
+	std::vector<uint64_t> offsets (count, 0);
+	uint64_t offset = ehsize;
+	for (size_t i = 1; i < count; i++) {
+		ElfSection const& section = _sections[i];
+		if (section.type == SHT_NOBITS || section.type == SHT_NULL) {
+			offsets[i] = offset;
+			continue;
+		}
+
+		offset = align_to (offset, section.addralign);
+		offsets[i] = offset;
+		offset += section_data (i).size ();
+	}
+
+	uint64_t shoff = align_to (offset, elf64 ? 8 : 4);
+	std::array<uint8_t, 64> ehdr {};
+	uint8_t *p = ehdr.data ();
+
+	std::memcpy (p, e_ident, sizeof (e_ident));
+	put_u16 (p + 16, ET_REL);
+	put_u16 (p + 18, e_machine);
+	put_u32 (p + 20, e_version);
+	uint16_t shnum_field = count < SHN_LORESERVE ? static_cast<uint16_t>(count) : 0;
+	uint16_t shstrndx_field = shstrndx < SHN_LORESERVE ? static_cast<uint16_t>(shstrndx) : SHN_XINDEX;
+	if (elf64) {
+		put_u64 (p + 40, shoff);
+		put_u32 (p + 48, e_flags);
+		put_u16 (p + 52, static_cast<uint16_t>(ehsize));
+		put_u16 (p + 58, static_cast<uint16_t>(shentsize));
+		put_u16 (p + 60, shnum_field);
+		put_u16 (p + 62, shstrndx_field);
+	} else {
+		put_u32 (p + 32, static_cast<uint32_t>(shoff));
+		put_u32 (p + 36, e_flags);
+		put_u16 (p + 40, static_cast<uint16_t>(ehsize));
+		put_u16 (p + 46, static_cast<uint16_t>(shentsize));
+		put_u16 (p + 48, shnum_field);
+		put_u16 (p + 50, shstrndx_field);
+	}
+
+	std::vector<uint8_t> image (shoff + count * shentsize, 0);
+	std::copy_n (ehdr.begin (), ehsize, image.begin ());
+	p = image.data ();
+
+	for (size_t i = 0; i < count; i++) {
+		ElfSection const& section = _sections[i];
+		uint8_t *header = p + shoff + i * shentsize;
+
+		if (i == 0) {
+			// Section and section name table counts which don't fit in the ELF header
+			put_word (header + (elf64 ? 32 : 20), shnum_field == 0 ? count : 0, elf64);
+			put_u32 (header + (elf64 ? 40 : 24), shstrndx_field == SHN_XINDEX ? shstrndx : 0);
+			continue;
+		}
+
+		std::vector<uint8_t> const& data = section_data (i);
+		if (section.type != SHT_NOBITS && !data.empty ()) {
+			std::memcpy (p + offsets[i], data.data (), data.size ());
+		}
+
+		uint64_t size = section.type == SHT_NOBITS ? section.nobits_size : data.size ();
+		uint32_t info = i == symtab_index ? symtab_info : section.info;
+
+		put_u32 (header, name_offsets[i]);
+		put_u32 (header + 4, section.type);
+		if (elf64) {
+			put_u64 (header + 8, section.flags);
+			put_u64 (header + 16, section.addr);
+			put_u64 (header + 24, offsets[i]);
+			put_u64 (header + 32, size);
+			put_u32 (header + 40, section.link);
+			put_u32 (header + 44, info);
+			put_u64 (header + 48, section.addralign);
+			put_u64 (header + 56, section.entsize);
+		} else {
+			put_u32 (header + 8, static_cast<uint32_t>(section.flags));
+			put_u32 (header + 12, static_cast<uint32_t>(section.addr));
+			put_u32 (header + 16, static_cast<uint32_t>(offsets[i]));
+			put_u32 (header + 20, static_cast<uint32_t>(size));
+			put_u32 (header + 24, section.link);
+			put_u32 (header + 28, info);
+			put_u32 (header + 32, static_cast<uint32_t>(section.addralign));
+			put_u32 (header + 36, static_cast<uint32_t>(section.entsize));
+		}
+	}
+
+	return image;
+}
+
+void ElfObject::write (fs::path const& path) const
+{
+	std::vector<uint8_t> image = serialize ();
+
+	std::ofstream os { path, std::ios::binary | std::ios::trunc };
+	os.write (reinterpret_cast<char const*>(image.data ()), static_cast<std::streamsize>(image.size ()));
+	os.close ();
+	if (!os) {
+		throw invalid_operation_error { "Unable to write " + path.string () };
+	}
+}
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__ELF_OBJECT_HH)
+#define __ELF_OBJECT_HH
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	struct ElfSection
+	{
+		std::string          name;
+		uint32_t             type = 0;
+		uint64_t             flags = 0;
+		uint64_t             addr = 0;
+		uint32_t             link = 0;
+		uint32_t             info = 0;
+		uint64_t             addralign = 1;
+		uint64_t             entsize = 0;
+		std::vector<uint8_t> data;
+		uint64_t             nobits_size = 0; // `SHT_NOBITS` sections have no data, only the size
+
+		uint64_t size () const noexcept;
+	};
+
+	struct ElfSymbol
+	{
+		std::string name;
+		uint64_t    value = 0;
+		uint64_t    size = 0;
+		uint8_t     info = 0;
+		uint8_t     other = 0;
+
+		// Index of the section the symbol is defined in or, for the reserved values (`SHN_ABS`, `SHN_COMMON` etc),
+		// the reserved value sign-extended to 32 bits, so that it never collides with a real (extended) section index
+		uint32_t    section = 0;
+
+		uint8_t binding () const noexcept
+		{
+			return info >> 4;
+		}
+
+		uint8_t type () const noexcept
+		{
+			return info & 0x0f;
+		}
+
+		uint8_t visibility () const noexcept
+		{
+			return other & 0x03;
+		}
+
+		bool is_defined () const noexcept;
+	};
+
+	// In-memory representation of a little-endian ELF relocatable object (32 or 64-bit), as produced by `llvm-mc` and
+	// `ld -r`, which can be modified and written back.  Section and symbol indices are kept consistent when sections are
+	// removed, string tables and the symbol table are regenerated when the object is serialized.  Malformed or
+	// unsupported input throws `invalid_operation_error`.
+	class ElfObject final
+	{
+	public:
+		static constexpr uint32_t SHT_NULL          = 0;
+		static constexpr uint32_t SHT_PROGBITS      = 1;
+		static constexpr uint32_t SHT_SYMTAB        = 2;
+		static constexpr uint32_t SHT_STRTAB        = 3;
+		static constexpr uint32_t SHT_RELA          = 4;
+		static constexpr uint32_t SHT_NOTE          = 7;
+		static constexpr uint32_t SHT_NOBITS        = 8;
+		static constexpr uint32_t SHT_REL           = 9;
+		static constexpr uint32_t SHT_GROUP         = 17;
+		static constexpr uint32_t SHT_SYMTAB_SHNDX  = 18;
+		static constexpr uint32_t SHT_LLVM_ADDRSIG  = 0x6fff4c03;
+
+		static constexpr uint64_t SHF_WRITE         = 0x1;
+		static constexpr uint64_t SHF_ALLOC         = 0x2;
+		static constexpr uint64_t SHF_EXECINSTR     = 0x4;
+		static constexpr uint64_t SHF_MERGE         = 0x10;
+		static constexpr uint64_t SHF_STRINGS       = 0x20;
+		static constexpr uint64_t SHF_INFO_LINK     = 0x40;
+		static constexpr uint64_t SHF_GROUP         = 0x200;
+
+		static constexpr uint8_t STB_LOCAL          = 0;
+		static constexpr uint8_t STB_GLOBAL         = 1;
+		static constexpr uint8_t STB_WEAK           = 2;
+
+		static constexpr uint8_t STT_NOTYPE         = 0;
+		static constexpr uint8_t STT_OBJECT         = 1;
+		static constexpr uint8_t STT_FUNC           = 2;
+		static constexpr uint8_t STT_SECTION        = 3;
+		static constexpr uint8_t STT_FILE           = 4;
+
+		static constexpr uint8_t STV_DEFAULT        = 0;
+		static constexpr uint8_t STV_HIDDEN         = 2;
+
+		static constexpr uint32_t SHN_UNDEF         = 0;
+		static constexpr uint32_t SHN_ABS           = 0xfffffff1;
+		static constexpr uint32_t SHN_COMMON        = 0xfffffff2;
+
+	private:
+		static constexpr uint16_t ET_REL            = 1;
+		static constexpr uint16_t SHN_LORESERVE     = 0xff00;
+		static constexpr uint16_t SHN_XINDEX        = 0xffff;
+
+	public:
+		static ElfObject read (fs::path const& path);
+		static ElfObject parse (std::vector<uint8_t> const& image);
+
+		std::vector<uint8_t> serialize () const;
+		void write (fs::path const& path) const;
+
+		bool is_64bit () const noexcept
+		{
+			return elf64;
+		}
+
+		uint16_t machine () const noexcept
+		{
+			return e_machine;
+		}
+
+		std::vector<ElfSection>& sections () noexcept
+		{
+			return _sections;
+		}
+
+		std::vector<ElfSection> const& sections () const noexcept
+		{
+			return _sections;
+		}
+
+		// Symbol 0 is the null symbol, local symbols precede the global ones
+		std::vector<ElfSymbol>& symbols () noexcept
+		{
+			return _symbols;
+		}
+
+		std::vector<ElfSymbol> const& symbols () const noexcept
+		{
+			return _symbols;
+		}
+
+		bool has_symbol_table () const noexcept
+		{
+			return symtab_index != 0;
+		}
+
+		// Appends the section, returns its index
+		uint32_t add_section (ElfSection section);
+
+		// Removes all the sections matching `predicate`, together with their relocation sections and the symbols
+		// defined in them.  Throws if any remaining relocation refers to a removed symbol.
+		void remove_sections (std::function<bool(ElfSection const&)> const& predicate);
+
+		// Makes all the non-local symbols matching `predicate` local and moves them in front of the remaining global
+		// ones, updating the symbol indices in relocations and section groups
+		void localize_symbols (std::function<bool(ElfSymbol const&)> const& predicate);
+
+	private:
+		ElfObject () = default;
+
+		void parse_symbols ();
+		void rewrite_relocation_symbols (ElfSection &section, std::vector<uint32_t> const& symbol_map) const;
+		uint64_t relocation_size (ElfSection const& section) const noexcept;
+
+	private:
+		bool                    elf64 = false;
+		uint8_t                 e_ident[16] {};
+		uint16_t                e_machine = 0;
+		uint32_t                e_version = 0;
+		uint32_t                e_flags = 0;
+		uint32_t                shstrndx = 0;
+		uint32_t                symtab_index = 0;
+		std::vector<ElfSection> _sections;
+		std::vector<ElfSymbol>  _symbols;
+	};
+}
+#endif // __ELF_OBJECT_HH
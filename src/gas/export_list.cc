@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: MIT
+#include <fstream>
+
+#include "elf_object.hh"
+#include "exceptions.hh"
+#include "export_list.hh"
+
+using namespace xamarin::android::gas;
+
+ExportList ExportList::load (fs::path const& path)
+{
+	std::ifstream is { path, std::ios::binary };
+	if (!is) {
+		std::string message { "Unable to open export list " };
+		message.append (path.string ());
+		throw invalid_operation_error { message };
+	}
+
+	auto is_space = [](char c) -> bool {
+		return c == ' ' || c == '\t' || c == '\r';
+	};
+
+	ExportList ret;
+	std::string line;
+	while (std::getline (is, line)) {
+		std::string_view name { line };
+		while (!name.empty () && is_space (name.front ())) {
+			name.remove_prefix (1);
+		}
+
+		while (!name.empty () && (is_space (name.back ()) || name.back () == ';')) {
+			name.remove_suffix (1);
+		}
+
+		if (name.empty () || name.front () == '#') {
+			continue;
+		}
+
+		if (name.find_first_of ("*?") != std::string_view::npos) {
+			ret.patterns.emplace_back (name);
+		} else {
+			ret.names.emplace (name);
+		}
+	}
+
+	if (is.bad ()) {
+		std::string message { "Unable to read export list " };
+		message.append (path.string ());
+		throw invalid_operation_error { message };
+	}
+
+	return ret;
+}
+
+bool ExportList::wildcard_match (std::string_view pattern, std::string_view name) noexcept
+{
+	// Iterative matching with backtracking to the most recent `*`
+	size_t p = 0, n = 0;
+	size_t star = std::string_view::npos, star_n = 0;
+
+	while (n < name.length ()) {
+		if (p < pattern.length () && (pattern[p] == '?' || pattern[p] == name[n])) {
+			p++;
+			n++;
+		} else if (p < pattern.length () && pattern[p] == '*') {
+			star = p++;
+			star_n = n;
+		} else if (star != std::string_view::npos) {
+			p = star + 1;
+			n = ++star_n;
+		} else {
+			return false;
+		}
+	}
+
+	while (p < pattern.length () && pattern[p] == '*') {
+		p++;
+	}
+
+	return p == pattern.length ();
+}
+
+bool ExportList::contains (std::string_view const& symbol_name) const
+{
+	if (names.find (std::string { symbol_name }) != names.end ()) {
+		return true;
+	}
+
+	for (std::string const& pattern : patterns) {
+		if (wildcard_match (pattern, symbol_name)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+size_t ExportList::hide_unexported_symbols (fs::path const& object_file) const
+{
+	ElfObject object = ElfObject::read (object_file);
+
+	size_t hidden = 0;
+	for (ElfSymbol &symbol : object.symbols ()) {
+		uint8_t binding = symbol.binding ();
+		if (binding != ElfObject::STB_GLOBAL && binding != ElfObject::STB_WEAK) {
+			continue;
+		}
+
+		// Undefined symbols are resolved elsewhere, hiding them would change what they can bind to.  Symbols with
+		// non-default visibility are already out of `.dynsym` (or, if protected, were meant to be exported).
+		if (!symbol.is_defined () || symbol.visibility () != ElfObject::STV_DEFAULT || contains (symbol.name)) {
+			continue;
+		}
+
+		symbol.other = static_cast<uint8_t>((symbol.other & ~0x03) | ElfObject::STV_HIDDEN);
+		hidden++;
+	}
+
+	if (hidden > 0) {
+		object.write (object_file);
+	}
+
+	return hidden;
+}
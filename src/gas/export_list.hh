@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__EXPORT_LIST_HH)
+#define __EXPORT_LIST_HH
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// Names of the symbols which should stay visible outside of the shared library the objects are linked into, used
+	// by `--export-list` to hide all the others.  The list file has one symbol name per line, names containing `*` or
+	// `?` are shell-style wildcard patterns.  Empty lines and lines starting with `#` are ignored, as is a trailing `;`,
+	// so that simple lists written for version scripts can be reused.
+	class ExportList final
+	{
+	public:
+		// Throws `invalid_operation_error` if the file cannot be read
+		static ExportList load (fs::path const& path);
+
+		bool contains (std::string_view const& symbol_name) const;
+
+		// Marks all the global and weak symbols defined in the object which are not on the list as hidden, the way
+		// `.hidden` would, so that the linker leaves them out of `.dynsym`.  The object is rewritten only if any
+		// symbol was hidden.  Returns the number of symbols hidden, throws `invalid_operation_error` on error.
+		size_t hide_unexported_symbols (fs::path const& object_file) const;
+
+	private:
+		ExportList () = default;
+
+		static bool wildcard_match (std::string_view pattern, std::string_view name) noexcept;
+
+	private:
+		std::unordered_set<std::string> names;
+		std::vector<std::string>        patterns;
+	};
+}
+#endif // __EXPORT_LIST_HH
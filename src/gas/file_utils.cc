@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: MIT
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "file_utils.hh"
+
+using namespace xamarin::android::gas;
+
+bool FileUtils::files_identical (fs::path const& first, fs::path const& second)
+{
+	std::error_code ec;
+	uintmax_t first_size = fs::file_size (first, ec);
+	if (ec) {
+		return false;
+	}
+
+	uintmax_t second_size = fs::file_size (second, ec);
+	if (ec || first_size != second_size) {
+		return false;
+	}
+
+	std::ifstream first_is { first, std::ios::binary };
+	std::ifstream second_is { second, std::ios::binary };
+	if (!first_is || !second_is) {
+		return false;
+	}
+
+	// Compare the contents byte for byte: a hash would let two different files of the same size through, which would
+	// leave a stale output in place
+	std::vector<char> first_buffer (read_buffer_size);
+	std::vector<char> second_buffer (read_buffer_size);
+	while (first_is && second_is) {
+		first_is.read (first_buffer.data (), static_cast<std::streamsize>(first_buffer.size ()));
+		second_is.read (second_buffer.data (), static_cast<std::streamsize>(second_buffer.size ()));
+
+		std::streamsize nread = first_is.gcount ();
+		if (nread != second_is.gcount ()) {
+			return false;
+		}
+
+		if (std::memcmp (first_buffer.data (), second_buffer.data (), static_cast<size_t>(nread)) != 0) {
+			return false;
+		}
+	}
+
+	return !first_is.bad () && !second_is.bad () && first_is.eof () && second_is.eof ();
+}
+
+fs::path FileUtils::make_temporary_path (fs::path const& target)
+{
+	std::random_device rd;
+	std::mt19937_64 rng { (static_cast<uint64_t>(rd ()) << 32) | rd () };
+
+	fs::path ret;
+	do {
+		std::string suffix = std::to_string (rng () & 0xffffffffULL);
+		platform::string name { target.filename ().native () };
+		name.append (PSTR(".tmp"));
+		name.append (suffix.begin (), suffix.end ());
+		ret = target;
+		ret.replace_filename (name);
+	} while (fs::exists (ret));
+
+	return ret;
+}
+
+bool FileUtils::replace_if_changed (fs::path const& temporary, fs::path const& target)
+{
+	if (files_identical (temporary, target)) {
+		fs::remove (temporary);
+		return false;
+	}
+
+	// Atomic on POSIX, and `MoveFileEx` with `MOVEFILE_REPLACE_EXISTING` on Windows
+	fs::rename (temporary, target);
+	return true;
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__FILE_UTILS_HH)
+#define __FILE_UTILS_HH
+
+#include <cstdint>
+#include <filesystem>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	class FileUtils final
+	{
+		static constexpr size_t read_buffer_size = 1024 * 1024;
+
+	public:
+		// Returns `true` if both files exist and have identical contents.  Sizes are compared first, contents are
+		// compared byte for byte only if the sizes match.
+		static bool files_identical (fs::path const& first, fs::path const& second);
+
+		// Returns a unique path in the same directory as `target`, so that the file it names can later be atomically
+		// renamed to `target`
+		static fs::path make_temporary_path (fs::path const& target);
+
+		// Moves `temporary` over `target` unless `target` already has the same contents, in which case `temporary`
+		// is removed and `target` is left untouched, preserving its modification time.  Returns `true` if `target`
+		// was replaced.
+		static bool replace_if_changed (fs::path const& temporary, fs::path const& target);
+	};
+}
+#endif // __FILE_UTILS_HH
@@ -0,0 +1,412 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <array>
+
+#include "function_sections.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr std::array<std::string_view, 8> alignment_directives {
+		".align", ".p2align", ".p2alignw", ".p2alignl", ".balign", ".balignw", ".balignl", ".palign",
+	};
+
+	// Directives which don't emit anything into the current section, they don't separate alignment directives from
+	// the function label they precede
+	constexpr std::array<std::string_view, 16> attribute_directives {
+		".arm", ".code", ".file", ".global", ".globl", ".hidden", ".internal", ".local",
+		".loc", ".protected", ".size", ".syntax", ".thumb", ".thumb_func", ".type", ".weak",
+	};
+
+	// Directives which make it impossible to reliably track the current section or see all the labels
+	constexpr std::array<std::string_view, 15> unsupported_directives {
+		".previous", ".subsection", ".macro", ".rept", ".irp", ".irpc", ".include",
+		".if", ".ifdef", ".ifndef", ".ifc", ".ifeq", ".ifne", ".ifnc", ".purgem",
+	};
+
+	constexpr std::array<std::string_view, 5> function_types {
+		"%function", "@function", "STT_FUNC", "\"function\"", "function",
+	};
+}
+
+FunctionSectionsRewriter::FunctionSectionsRewriter (TargetArchitecture arch, size_t hash_size)
+	: target_arch (arch)
+{
+	if (hash_size == 0) {
+		return;
+	}
+
+	identifier_ids.reserve (hash_size);
+	label_owners.reserve (hash_size);
+	function_references.reserve (hash_size);
+}
+
+uint32_t FunctionSectionsRewriter::intern (std::string_view identifier)
+{
+	auto iter = identifier_ids.find (std::string { identifier });
+	if (iter != identifier_ids.end ()) {
+		return iter->second;
+	}
+
+	uint32_t id = static_cast<uint32_t>(identifier_ids.size ());
+	identifier_ids.emplace (identifier, id);
+	return id;
+}
+
+void FunctionSectionsRewriter::set_section (std::string_view operands)
+{
+	std::string_view name = operands.substr (0, operands.find_first_of (", \t"));
+	if (name.length () >= 2 && name.front () == '"' && name.back () == '"') {
+		name = name.substr (1, name.length () - 2);
+	}
+
+	current_section = { name == ".text" ? SectionKind::Text : SectionKind::Other, 0 };
+}
+
+// Returns `true` if the directive emits anything into the current section
+bool FunctionSectionsRewriter::handle_directive (AsmSyntax::Statement const& statement, bool only_statement_on_line)
+{
+	std::string_view const& name = statement.mnemonic;
+	std::string_view const& operands = statement.operands;
+
+	if (AsmSyntax::is_one_of (name, unsupported_directives)) {
+		can_split = false;
+		return true;
+	}
+
+	if (name == ".text") {
+		current_section = { operands.empty () || operands == "0" ? SectionKind::Text : SectionKind::Other, 0 };
+		pending_alignment.clear ();
+		return false;
+	}
+
+	if (name == ".data" || name == ".bss") {
+		current_section = { SectionKind::Other, 0 };
+		pending_alignment.clear ();
+		return false;
+	}
+
+	if (name == ".section") {
+		set_section (operands);
+		pending_alignment.clear ();
+		return false;
+	}
+
+	if (name == ".pushsection") {
+		section_stack.push_back (current_section);
+		set_section (operands);
+		pending_alignment.clear ();
+		return false;
+	}
+
+	if (name == ".popsection") {
+		if (section_stack.empty ()) {
+			can_split = false;
+			return false;
+		}
+
+		current_section = section_stack.back ();
+		section_stack.pop_back ();
+		pending_alignment.clear ();
+		return false;
+	}
+
+	if (name == ".type") {
+		size_t comma = operands.find (',');
+		if (comma != std::string_view::npos && AsmSyntax::is_one_of (AsmSyntax::trim (operands.substr (comma + 1)), function_types)) {
+			function_symbols.emplace (AsmSyntax::trim (operands.substr (0, comma)));
+		}
+		return false;
+	}
+
+	if (AsmSyntax::is_one_of (name, alignment_directives)) {
+		if (current_section.kind == SectionKind::Other) {
+			return true;
+		}
+
+		// Only alignment directives on lines of their own can be moved, so that no other statement is lost
+		if (!only_statement_on_line || !statement.labels.empty ()) {
+			return true;
+		}
+
+		std::string text { name };
+		text.append (" ").append (operands);
+		pending_alignment.push_back ({ line_number, std::move (text) });
+		return false;
+	}
+
+	if (AsmSyntax::is_one_of (name, attribute_directives)) {
+		return false;
+	}
+
+	return true;
+}
+
+void FunctionSectionsRewriter::add_references (std::string_view operands)
+{
+	std::vector<uint32_t> ids;
+	bool in_string = false;
+
+	for (size_t i = 0; i < operands.length (); i++) {
+		char c = operands[i];
+		if (in_string) {
+			if (c == '\\') {
+				i++;
+			} else if (c == '"') {
+				in_string = false;
+			}
+			continue;
+		}
+
+		if (c == '"') {
+			in_string = true;
+			continue;
+		}
+
+		if (!AsmSyntax::is_identifier_char (c)) {
+			continue;
+		}
+
+		size_t start = i;
+		while (i < operands.length () && AsmSyntax::is_identifier_char (operands[i])) {
+			i++;
+		}
+
+		std::string_view token = operands.substr (start, i - start);
+		bool is_register_or_specifier = start > 0 && operands[start - 1] == '%';
+		i--;
+
+		// Numbers (including numeric label references such as `1b`), `.` and x86 registers can't name labels
+		if (!AsmSyntax::is_identifier_start (token.front ()) || token == "." || is_register_or_specifier) {
+			continue;
+		}
+
+		uint32_t id = intern (token);
+		if (std::find (ids.begin (), ids.end (), id) == ids.end ()) {
+			ids.push_back (id);
+		}
+	}
+
+	if (current_section.kind == SectionKind::Split) {
+		uint32_t owner = current_section.owner;
+		for (uint32_t id : ids) {
+			auto iter = function_references.find (id);
+			if (iter == function_references.end ()) {
+				function_references.emplace (id, ReferenceRange { owner, owner });
+			} else {
+				iter->second.first = std::min (iter->second.first, owner);
+				iter->second.last = std::max (iter->second.last, owner);
+			}
+		}
+	} else if (ids.size () >= 2) {
+		outside_references.push_back (std::move (ids));
+	}
+}
+
+void FunctionSectionsRewriter::analyze_statement (std::string_view text, bool only_statement_on_line, bool first_statement_on_line)
+{
+	AsmSyntax::Statement statement;
+	AsmSyntax::parse_statement (text, statement);
+
+	for (size_t i = 0; i < statement.labels.size (); i++) {
+		std::string_view label = statement.labels[i];
+		bool in_text = current_section.kind != SectionKind::Other;
+
+		if (in_text && first_statement_on_line && i == 0 && function_symbols.contains (std::string { label })) {
+			uint32_t index = static_cast<uint32_t>(functions.size ());
+			functions.push_back ({ std::string { label }, line_number, current_section, std::move (pending_alignment) });
+			pending_alignment.clear ();
+			current_section = { SectionKind::Split, index };
+			continue;
+		}
+
+		pending_alignment.clear ();
+		if (!AsmSyntax::is_identifier_start (label.front ())) {
+			continue; // numeric local label
+		}
+
+		if (current_section.kind == SectionKind::Split) {
+			label_owners[intern (label)] = current_section.owner;
+		} else if (current_section.kind == SectionKind::Text) {
+			label_owners[intern (label)] = plain_text_owner;
+		}
+	}
+
+	if (statement.mnemonic.empty ()) {
+		return;
+	}
+
+	bool is_content = statement.mnemonic.front () == '.' ? handle_directive (statement, only_statement_on_line) : true;
+	if (!is_content) {
+		return;
+	}
+
+	pending_alignment.clear ();
+	add_references (statement.operands);
+}
+
+void FunctionSectionsRewriter::analyze_line (std::string_view line)
+{
+	bool has_block_comment = false;
+	std::string_view text = AsmSyntax::strip_comment (line, target_arch, has_block_comment);
+	if (has_block_comment) {
+		// Block comments can span lines, we don't track them
+		can_split = false;
+	}
+
+	std::vector<std::string_view> statements;
+	AsmSyntax::split_statements (text, statements);
+
+	for (size_t i = 0; i < statements.size (); i++) {
+		analyze_statement (statements[i], statements.size () == 1, i == 0);
+	}
+}
+
+bool FunctionSectionsRewriter::analyze (std::istream &input)
+{
+	std::string line;
+	while (can_split && std::getline (input, line)) {
+		line_number++;
+		analyze_line (line);
+	}
+
+	if (input.bad ()) {
+		can_split = false;
+	}
+
+	finish_analysis ();
+	return can_split;
+}
+
+void FunctionSectionsRewriter::finish_analysis ()
+{
+	if (!can_split || functions.empty ()) {
+		can_split = false;
+		return;
+	}
+
+	size_t function_count = functions.size ();
+	std::vector<int64_t> merge_delta (function_count + 1, 0);
+	auto merge = [&merge_delta](uint32_t a, uint32_t b) {
+		if (a == b) {
+			return;
+		}
+
+		if (a > b) {
+			std::swap (a, b);
+		}
+
+		// All the functions in (a, b] join the section of the function preceding them
+		merge_delta[a + 1]++;
+		merge_delta[b + 1]--;
+	};
+
+	for (auto const& [id, owner] : label_owners) {
+		auto iter = function_references.find (id);
+		if (iter == function_references.end ()) {
+			continue;
+		}
+
+		// A function referencing a label which stays in `.text` would have to stay there as well
+		if (owner == plain_text_owner) {
+			can_split = false;
+			return;
+		}
+
+		merge (owner, iter->second.first);
+		merge (owner, iter->second.last);
+	}
+
+	for (std::vector<uint32_t> const& ids : outside_references) {
+		uint32_t first = plain_text_owner, last = 0;
+		for (uint32_t id : ids) {
+			auto iter = label_owners.find (id);
+			if (iter == label_owners.end () || iter->second == plain_text_owner) {
+				continue;
+			}
+
+			first = std::min (first, iter->second);
+			last = std::max (last, iter->second);
+		}
+
+		if (first != plain_text_owner) {
+			merge (first, last);
+		}
+	}
+
+	std::vector<uint32_t> leader (function_count);
+	int64_t joined = 0;
+	for (uint32_t i = 0; i < function_count; i++) {
+		joined += merge_delta[i];
+		leader[i] = i > 0 && joined > 0 ? leader[i - 1] : i;
+		if (leader[i] == i) {
+			sections++;
+		}
+	}
+
+	for (uint32_t i = 0; i < function_count; i++) {
+		FunctionStart const& function = functions[i];
+		SectionState const& state = function.state_at_label;
+
+		if (state.kind == SectionKind::Split && leader[state.owner] == leader[i]) {
+			continue; // already in the right section
+		}
+
+		std::string prefix;
+		if (is_arm ()) {
+			// Literal pool entries of the preceding code must be placed in its section, within its reach
+			prefix.append (".ltorg; ");
+		}
+
+		prefix
+			.append (".section \".text.")
+			.append (functions[leader[i]].name)
+			.append ("\",\"ax\",%progbits; ");
+
+		for (AlignmentDirective const& alignment : function.alignment) {
+			prefix.append (alignment.text).append ("; ");
+			blanked_lines.insert (alignment.line);
+		}
+
+		switch_lines.emplace (function.line, std::move (prefix));
+	}
+}
+
+bool FunctionSectionsRewriter::rewrite (std::istream &input, Process::input_write_fn const& write) const
+{
+	std::string buffer;
+	buffer.reserve (write_buffer_size + 4096);
+
+	std::string line;
+	uint64_t current_line = 0;
+	while (std::getline (input, line)) {
+		current_line++;
+
+		if (can_split) {
+			if (blanked_lines.contains (current_line)) {
+				line.clear ();
+			} else {
+				auto iter = switch_lines.find (current_line);
+				if (iter != switch_lines.end ()) {
+					buffer.append (iter->second);
+				}
+			}
+		}
+
+		buffer.append (line);
+		buffer.append ("\n");
+
+		if (buffer.size () >= write_buffer_size) {
+			if (!write (buffer.data (), buffer.size ())) {
+				return false;
+			}
+			buffer.clear ();
+		}
+	}
+
+	if (input.bad ()) {
+		return false;
+	}
+
+	return buffer.empty () || write (buffer.data (), buffer.size ());
+}
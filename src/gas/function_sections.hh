@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__FUNCTION_SECTIONS_HH)
+#define __FUNCTION_SECTIONS_HH
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "asm_syntax.hh"
+#include "constants.hh"
+#include "process.hh"
+
+namespace xamarin::android::gas
+{
+	// Rewrites assembler source so that every function defined in `.text` is placed in its own `.text.<function>`
+	// section, like `-ffunction-sections` does for compilers.  This lets the final link garbage-collect unused
+	// functions and order them with a symbol ordering file.
+	//
+	// The input is processed twice.  The first pass (`analyze`) finds function start labels (labels of symbols
+	// declared with `.type SYM, %function` before they're defined) and all the references to non-function labels.
+	// Functions which reference each other's local labels (e.g. branches to or literal loads from `.L` labels, label
+	// differences in jump tables) are kept together in the section of the first of them, since such references must
+	// be resolved by the assembler and cannot cross sections.  The second pass (`rewrite`) inserts the section
+	// directives.  Directives are inserted on the function label's line, separated by `;`, so that line numbers in
+	// diagnostics and debug info don't change.  Alignment directives immediately preceding the function are moved
+	// along with it (their original lines are blanked) and, for ARM targets, `.ltorg` is emitted before every switch
+	// so that literal pools stay next to the function which uses them.
+	//
+	// Inputs using directives whose effect on the current section cannot be tracked reliably (`.previous`,
+	// `.subsection`, macros, conditionals, includes) are passed through unchanged.
+	class FunctionSectionsRewriter final
+	{
+		enum class SectionKind
+		{
+			Other,
+			Text,  // `.text` subsection 0
+			Split, // `.text.<function>`, created by us
+		};
+
+		struct SectionState
+		{
+			SectionKind kind = SectionKind::Other;
+			uint32_t    owner = 0; // function index, if `kind == Split`
+		};
+
+		struct AlignmentDirective
+		{
+			uint64_t    line;
+			std::string text;
+		};
+
+		struct FunctionStart
+		{
+			std::string                     name;
+			uint64_t                        line;
+			SectionState                    state_at_label;
+			std::vector<AlignmentDirective> alignment;
+		};
+
+		struct ReferenceRange
+		{
+			uint32_t first;
+			uint32_t last;
+		};
+
+		static constexpr size_t write_buffer_size = 64 * 1024;
+
+		// Owner of labels defined in `.text` outside of any function region
+		static constexpr uint32_t plain_text_owner = UINT32_MAX;
+
+	public:
+		// `hash_size` is the expected number of identifiers in the input (`0` if unknown), the tables are sized for it
+		// upfront instead of growing as the input is analyzed
+		explicit FunctionSectionsRewriter (TargetArchitecture arch, size_t hash_size = 0);
+
+		// Returns `false` if the input cannot be split, `rewrite` will then pass the input through unchanged
+		bool analyze (std::istream &input);
+		bool rewrite (std::istream &input, Process::input_write_fn const& write) const;
+
+		// Number of function sections the rewritten input defines
+		size_t section_count () const noexcept
+		{
+			return sections;
+		}
+
+	private:
+		void analyze_line (std::string_view line);
+		void analyze_statement (std::string_view text, bool only_statement_on_line, bool first_statement_on_line);
+		void finish_analysis ();
+		bool handle_directive (AsmSyntax::Statement const& statement, bool only_statement_on_line);
+		void set_section (std::string_view operands);
+		void add_references (std::string_view operands);
+		uint32_t intern (std::string_view identifier);
+		bool is_arm () const noexcept
+		{
+			return target_arch == TargetArchitecture::ARM32 || target_arch == TargetArchitecture::ARM64;
+		}
+
+	private:
+		TargetArchitecture const target_arch;
+		bool                     can_split = true;
+		uint64_t                 line_number = 0;
+
+		SectionState              current_section;
+		std::vector<SectionState> section_stack;
+		std::vector<AlignmentDirective> pending_alignment;
+
+		std::unordered_set<std::string>           function_symbols;
+		std::vector<FunctionStart>                functions;
+
+		// All the identifiers referenced anywhere are interned, to keep memory use in check on large inputs
+		std::unordered_map<std::string, uint32_t> identifier_ids;
+		// Function which owns the region a (non-function) label is defined in, indexed by identifier id
+		std::unordered_map<uint32_t, uint32_t>    label_owners;
+		// Range of functions referencing an identifier from within their regions, indexed by identifier id
+		std::unordered_map<uint32_t, ReferenceRange> function_references;
+		// Identifiers referenced together by a single statement outside of any function region (e.g. `.word .L2-.L1`)
+		std::vector<std::vector<uint32_t>>        outside_references;
+
+		// Results of the analysis, used by `rewrite`
+		std::unordered_map<uint64_t, std::string> switch_lines;
+		std::unordered_set<uint64_t>              blanked_lines;
+		size_t                                    sections = 0;
+	};
+}
+#endif // __FUNCTION_SECTIONS_HH
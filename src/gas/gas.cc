@@ -4,17 +4,151 @@
 #endif
 
 #include <array>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <optional>
 #include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
 
+#include "archive_writer.hh"
+#include "batch_strip.hh"
 #include "command_line.hh"
 #include "constants.hh"
+#include "debug_info_splitter.hh"
+#include "dependency_scanner.hh"
+#include "diagnostics.hh"
+#include "exceptions.hh"
+#include "export_list.hh"
+#include "file_utils.hh"
+#include "function_sections.hh"
 #include "gas.hh"
+#include "incremental_assembly.hh"
+#include "input_stream.hh"
+#include "job_scheduler.hh"
+#include "link_cache.hh"
 #include "llvm_mc_runner.hh"
+#include "remote_cache.hh"
+#include "section_folder.hh"
+#include "size_report.hh"
+#include "workload_capture.hh"
 
 using namespace xamarin::android::gas;
 
+namespace {
+	// How the source is passed to `llvm-mc` reading it from stdin
+	struct InputOptions
+	{
+		TargetArchitecture target_arch;
+		bool               function_sections;
+		bool               reduce_memory_overheads;
+		size_t             hash_size;
+		DependencyScanner *stdin_dependencies; // `nullptr` unless `--MD` is used
+	};
+}
+
+static bool feed_input (fs::path const& input_file, InputOptions const& options, Process::input_write_fn const& write)
+{
+	auto check_input = [&input_file](InputStream const& input) -> bool {
+		if (input.error ().empty ()) {
+			return true;
+		}
+
+		STDERR << "Failed to read input file " << input_file << ". " << input.error ().c_str () << Constants::newline;
+		return false;
+	};
+
+	// Dependencies of the source read from stdin are found as it is passed to `llvm-mc`
+	if (options.stdin_dependencies != nullptr && InputStream::is_stdin (input_file)) {
+		DependencyScanner &dependencies = *options.stdin_dependencies;
+		InputOptions stdin_options = options;
+		stdin_options.stdin_dependencies = nullptr;
+
+		bool fed = feed_input (
+			input_file,
+			stdin_options,
+			[&dependencies, &write](char const* data, size_t size) -> bool {
+				dependencies.add_data (data, size);
+				return write (data, size);
+			}
+		);
+		dependencies.finish ();
+		return fed;
+	}
+
+	try {
+		std::unique_ptr<InputStream> input = InputStream::open (input_file);
+		if (!options.function_sections) {
+			bool copied = input->copy_to (write);
+			return check_input (*input) && copied;
+		}
+
+		// Inputs which cannot be split are passed through unchanged.  The rewriter reads the input twice, stdin can be
+		// read only once so it is kept in memory or, if memory use is to be reduced, in a temporary file.
+		FunctionSectionsRewriter rewriter { options.target_arch, options.hash_size };
+		auto rewrite_file = [&](fs::path const& path) -> bool {
+			std::unique_ptr<InputStream> file_input = InputStream::open (path);
+			rewriter.analyze (*file_input);
+			if (!check_input (*file_input)) {
+				return false;
+			}
+
+			file_input = InputStream::open (path);
+			bool rewritten = rewriter.rewrite (*file_input, write);
+			return check_input (*file_input) && rewritten;
+		};
+
+		if (!InputStream::is_stdin (input_file)) {
+			return rewrite_file (input_file);
+		}
+
+		if (options.reduce_memory_overheads) {
+			fs::path spool_file = FileUtils::make_temporary_path (fs::temp_directory_path () / "xa-gas-stdin.s");
+			ScopeGuard remove_spool_file {
+				[&spool_file]() -> void {
+					std::error_code ec;
+					fs::remove (spool_file, ec);
+				}
+			};
+
+			std::ofstream spool { spool_file, std::ios::binary };
+			bool copied = input->copy_to (
+				[&spool](char const* data, size_t size) -> bool {
+					spool.write (data, static_cast<std::streamsize>(size));
+					return spool.good ();
+				}
+			);
+			spool.close ();
+			if (!check_input (*input)) {
+				return false;
+			}
+
+			if (!copied || !spool) {
+				STDERR << "Failed to write temporary file " << spool_file.native () << Constants::newline;
+				return false;
+			}
+
+			return rewrite_file (spool_file);
+		}
+
+		std::stringstream source;
+		source << input->rdbuf ();
+		if (!check_input (*input)) {
+			return false;
+		}
+
+		rewriter.analyze (source);
+		source.clear ();
+		source.seekg (0);
+		return rewriter.rewrite (source, write);
+	} catch (std::exception const& ex) {
+		STDERR << ex.what () << Constants::newline;
+		return false;
+	}
+}
+
 int Gas::usage (bool is_error, platform::string const message)
 {
 	if (!message.empty ()) {
@@ -28,18 +162,48 @@ int Gas::usage (bool is_error, platform::string const message)
 	          << "to fail with an error message." << Constants::newline
 	          << "Since `llvm-mc` does not support compiling multiple source files at the same time, this GAS behavior is emulated" << Constants::newline
 	          << "by running `llvm-mc` once per each input file and using the `ld` linker in the end to merge all the discrete output" << Constants::newline
-	          << "files into the single file indicated by the `-o` option." << Constants::newline << Constants::newline
+	          << "files into the single file indicated by the `-o` option." << Constants::newline
+	          << "Input files compressed with gzip (`.gz`) or zstd (`.zst`) are decompressed on the fly, `-` (or no input files)" << Constants::newline
+	          << "reads the source from stdin." << Constants::newline << Constants::newline
 	          << "Command line options are compatibile with GAS version " << BINUTILS_VERSION << Constants::newline << Constants::newline
 	          << "Currently supported options are:" << Constants::newline << Constants::newline
 	          << "All targets" << Constants::newline
 	          << "   -o FILE            path to the output object file" << Constants::newline
-	          << "  --warn              don't suppress warning messages" << Constants::newline
-	          << "   -g | --gen-debug   generate debug information in the output object file" << Constants::newline << Constants::newline
+	          << "  --warn              don't suppress warning messages (identical messages are shown only once, and" << Constants::newline
+	          << "                      counted in the summary)" << Constants::newline
+	          << "   -g | --gen-debug   generate debug information in the output object file" << Constants::newline
+	          << "  --debug-prefix-map OLD=NEW" << Constants::newline
+	          << "                      map source directory OLD to NEW in the debug information" << Constants::newline
+	          << "   -I DIR             add DIR to the search list for `.include` and `.incbin` directives" << Constants::newline
+	          << "  --MD FILE           write make-style dependencies of the output file (the input files and the files" << Constants::newline
+	          << "                      they `.include` or `.incbin`) to FILE" << Constants::newline
+	          << "  --reduce-memory-overheads" << Constants::newline
+	          << "                      prefer smaller memory use at the cost of longer build times: run one `llvm-mc`" << Constants::newline
+	          << "                      at a time (unless `--jobs` is given), keep source read from stdin in a temporary" << Constants::newline
+	          << "                      file instead of memory and run `ld` single-threaded" << Constants::newline
+	          << "  --hash-size=N       expected number of symbols in an input file, used to size the wrapper's own tables" << Constants::newline
+	          << "                      (at most " << Constants::max_hash_size << ")" << Constants::newline << Constants::newline
 	          << "x86/x86_64 targets" << Constants::newline
-	          << "  --32                output a 32-bit object [ignored, `llvm-mc` is always invoked for the right target]" << Constants::newline
-	          << "  --64                output a 64-bit object [ignored, as above]" << Constants::newline << Constants::newline
+	          << "  --32                output a 32-bit (i386) object" << Constants::newline
+	          << "  --64                output a 64-bit (x86_64) object" << Constants::newline
+	          << "  -march=CPU[+EXT...] generate code for CPU (e.g. x86-64-v3) with additional ISA extensions, any" << Constants::newline
+	          << "                      extension can be turned off with the `no` prefix (e.g. x86-64+sse4.2+noavx)" << Constants::newline
+	          << "  -mtune=CPU          optimize for CPU [validated, but ignored, `llvm-mc` has no separate tuning]" << Constants::newline
+	          << "  -mrelax-relocations=[yes|no]" << Constants::newline
+	          << "                      generate relaxable GOT relocations, letting the linker turn GOT loads into" << Constants::newline
+	          << "                      direct address computations" << Constants::newline << Constants::newline
+	          << "arm64 targets" << Constants::newline
+	          << "  -march=ARCH[+EXT...]" << Constants::newline
+	          << "                      select the target architecture and its extensions (e.g. armv8.2-a+lse+crc+dotprod)," << Constants::newline
+	          << "                      any extension can be turned off with the `no` prefix" << Constants::newline
+	          << "  -mcpu=CPU[+EXT...]  select the target processor and its extensions" << Constants::newline << Constants::newline
 	          << "armeabi/arm32 targets" << Constants::newline
-	          << "  -mfpu=FPU           select floating-point architecture for the target" << Constants::newline << Constants::newline
+	          << "  -mfpu=FPU           select floating-point architecture for the target" << Constants::newline
+	          << "  -march=ARCH[+EXT...]" << Constants::newline
+	          << "                      select the target architecture (default: armv7-a) and its extensions, any" << Constants::newline
+	          << "                      extension can be turned off with the `no` prefix (e.g. armv7-a+mp+nosimd)" << Constants::newline
+	          << "  -mcpu=CPU[+EXT...]  select the target processor and its extensions" << Constants::newline
+	          << "  -mthumb             assemble Thumb (Thumb-2 for ARMv7) code until `.arm` is seen" << Constants::newline << Constants::newline
 	          << "Ignored by GAS and this wrapper" << Constants::newline
 	          << "  --divide" << Constants::newline
 	          << "   -k" << Constants::newline
@@ -53,6 +217,57 @@ int Gas::usage (bool is_error, platform::string const message)
 	          << "   -h | --help        show this help screen" << Constants::newline
 	          << "   -V                 show version" << Constants::newline
 	          << "  --version           show version and exit " << Constants::newline
+	          << "  --reproducible-paths[=TOKEN]" << Constants::newline
+	          << "                      map the current working directory to TOKEN (default: `.`) in the debug information," << Constants::newline
+	          << "                      so that the output doesn't depend on the location of the source tree" << Constants::newline
+	          << "  --remote-cache=URL  use the Bazel-style HTTP object cache at URL (http://host[:port][/prefix]), the" << Constants::newline
+	          << "                      XA_GAS_REMOTE_CACHE environment variable is used if the option isn't given" << Constants::newline
+	          << "  --child-policy=SETTING[,SETTING...]" << Constants::newline
+	          << "                      scheduling and resource settings of the programs the wrapper runs, the" << Constants::newline
+	          << "                      XA_GAS_CHILD_POLICY environment variable is used if the option isn't given:" << Constants::newline
+	          << "                        nice=N               scheduling priority (-20 to 19)" << Constants::newline
+	          << "                        ioprio=CLASS[:LEVEL] I/O class (realtime, best-effort, idle) and level (0-7)" << Constants::newline
+	          << "                        batch                use the SCHED_BATCH scheduling policy" << Constants::newline
+	          << "                        cpus=LIST            CPU affinity (e.g. 0-3,8)" << Constants::newline
+	          << "                        cgroup=PATH          cgroup v2 group to run in (relative to /sys/fs/cgroup)" << Constants::newline
+	          << "                        cpu.weight=N         `cpu.weight` of the group" << Constants::newline
+	          << "                        memory.high=SIZE     `memory.high` of the group (e.g. 4G)" << Constants::newline
+	          << "                      all but `nice` are supported only on Linux" << Constants::newline
+	          << "  --child-allocator=ALLOCATOR" << Constants::newline
+	          << "                      memory allocator of the programs the wrapper runs: `system` (the default)," << Constants::newline
+	          << "                      `mimalloc` (if installed with the toolchain) or path to a shared library to" << Constants::newline
+	          << "                      preload, the XA_GAS_CHILD_ALLOCATOR environment variable is used if the option" << Constants::newline
+	          << "                      isn't given (not supported on Windows)" << Constants::newline
+	          << "  --jobs=N            run at most N (up to " << Constants::max_jobs << ") instances of `llvm-mc` concurrently (default:" << Constants::newline
+	          << "                      number of CPUs)" << Constants::newline
+	          << "  --quiet             don't print the command line of every program the wrapper runs, nor informational" << Constants::newline
+	          << "                      messages" << Constants::newline
+	          << "  --write-if-changed  leave the output file untouched (preserving its modification time) if its contents" << Constants::newline
+	          << "                      would not change" << Constants::newline
+	          << "  --function-sections place every function in its own `.text.<function>` section, so that the linker can" << Constants::newline
+	          << "                      discard unused functions (functions sharing local labels stay together)" << Constants::newline
+	          << "  --split-debug[=FILE]" << Constants::newline
+	          << "                      move the debug information to FILE (default: the output file name with `.debug`" << Constants::newline
+	          << "                      appended), leaving a `.gnu_debuglink` section referring to it in the output file" << Constants::newline
+	          << "  --export-list=FILE  mark all the global symbols defined in the output, except the ones listed in FILE (one" << Constants::newline
+	          << "                      name or `*`/`?` wildcard pattern per line), hidden so that they don't end up in the" << Constants::newline
+	          << "                      dynamic symbol table of the shared library the output is linked into" << Constants::newline
+	          << "  --size-report=FILE  write section sizes, the largest symbols and relocation counts of the output (of the" << Constants::newline
+	          << "                      objects, for archive outputs) to FILE as JSON, see tools/size-report-diff.py" << Constants::newline
+	          << "  --incremental       split the input into chunks at function boundaries and keep their objects in the" << Constants::newline
+	          << "                      `<output>.chunks` directory, so that only the chunks which changed since the" << Constants::newline
+	          << "                      previous run are assembled again (single input file, relocatable output only)" << Constants::newline
+	          << "  --fold-sections[=WHAT]" << Constants::newline
+	          << "                      fold identical sections of the output into one, `data` (the default) folds read-only" << Constants::newline
+	          << "                      data sections and COMDAT groups which define only local symbols, `all` also folds" << Constants::newline
+	          << "                      code sections and sections defining global symbols (COMDAT groups only if their" << Constants::newline
+	          << "                      symbols are all weak), so that distinct functions or tables may end up at the same" << Constants::newline
+	          << "                      address (relocatable output only)" << Constants::newline
+	          << "  --output-kind=KIND  what to combine the objects of multiple input files into: `relocatable` (the default," << Constants::newline
+	          << "                      a single object merged by `ld --relocatable`), `archive` or `thin-archive` (a GNU" << Constants::newline
+	          << "                      thin archive referring to the per-input objects, which must be kept)" << Constants::newline
+	          << "  --memory-budget=MB  memory available to all the concurrently running `llvm-mc` instances (default:" << Constants::newline
+	          << "                      derived from the system or cgroup available memory)" << Constants::newline
 	          << Constants::newline;
 
 	return is_error ? 1 : 0;
@@ -70,6 +285,28 @@ std::vector<platform::string> Gas::get_command_line (int argc, argv_char **argv)
 }
 
 int Gas::run (std::vector<platform::string> args)
+{
+	// The `ld` wrapper scripts run the linker through us when the link cache is enabled
+	if (args.size () > 1 && args[1] == Constants::ld_cache_param) {
+		return LinkCache::run (args);
+	}
+
+	// ...and the `strip` and `objcopy` ones run the tools through us in `--batch` mode
+	if (args.size () > 1 && args[1] == Constants::batch_strip_param) {
+		return BatchStrip::run (args);
+	}
+
+	std::unique_ptr<WorkloadCapture> capture = WorkloadCapture::from_environment ();
+	if (!capture) {
+		return assemble (std::move (args));
+	}
+
+	int ret = assemble (args);
+	capture->record (args, input_files, include_dirs, _gas_output_file, ret);
+	return ret;
+}
+
+int Gas::assemble (std::vector<platform::string> args)
 {
 	determine_program_dir (args);
 	auto lowercase_string = [](platform::string& s) {
@@ -133,16 +370,32 @@ int Gas::run (std::vector<platform::string> args)
 	}
 
 	fs::path llvm_mc = program_dir () / Constants::llvm_mc_name;
+	fs::path output_file = _gas_output_file.empty () ? fs::path { Constants::default_output_name } : _gas_output_file;
+
+	// With `--write-if-changed` everything is built into a temporary file first, which then replaces the real output
+	// file only if their contents differ.
+	fs::path actual_output_file = _write_if_changed ? FileUtils::make_temporary_path (output_file) : output_file;
+	ScopeGuard remove_temporary_output {
+		[&]() -> void {
+			if (_write_if_changed) {
+				std::error_code ec;
+				fs::remove (actual_output_file, ec);
+			}
+		}
+	};
+
 	bool multiple_input_files = false;
 	bool derive_output_file_name = false;
 	switch (input_files.size ()) {
 		case 0:
-			return usage (true, PSTR("missing input files on command line"));
+			// Like GAS, read the source from stdin
+			input_files.emplace_back (InputStream::stdin_name);
+			[[fallthrough]];
 
 		case 1:
 			// We should always have a value here since `a.out` is the default, but... :)
 			if (!_gas_output_file.empty ()) {
-				mc_runner->set_output_file_path (_gas_output_file);
+				mc_runner->set_output_file_path (actual_output_file);
 			} else {
 				derive_output_file_name = true;
 			}
@@ -154,12 +407,181 @@ int Gas::run (std::vector<platform::string> args)
 			break;
 	}
 
-	for (fs::path const& input : input_files) {
-		mc_runner->set_input_file_path (input, derive_output_file_name);
-		int ret = mc_runner->run (llvm_mc);
+	if (!fs::exists (llvm_mc)) {
+		STDERR << "Executable '" << llvm_mc.native () << "' does not exist." << Constants::newline;
+		return Constants::wrapper_exec_failed_error_code;
+	}
+
+	std::optional<ExportList> export_list;
+	if (!_export_list.empty ()) {
+		try {
+			export_list = ExportList::load (_export_list);
+		} catch (std::exception const& ex) {
+			STDERR << ex.what () << Constants::newline;
+			return Constants::wrapper_general_error_code;
+		}
+	}
+
+	std::vector<Job> jobs;
+	std::unique_ptr<IncrementalAssembly> incremental;
+	if (_incremental) {
+		// Chunks are fed to `llvm-mc` via a pipe, so that the debug info names the original input
+		fs::path const& input = input_files[0];
+		mc_runner->read_input_from_stdin (true);
+		mc_runner->set_input_file_path (input, false /* derive_output_file_name */);
+
+		incremental = std::make_unique<IncrementalAssembly> (input, output_file, target_arch (), _hash_size);
+		try {
+			incremental->prepare (*mc_runner->create_process (llvm_mc), _function_sections ? "function-sections" : "");
+		} catch (std::exception const& ex) {
+			STDERR << ex.what () << Constants::newline;
+			return Constants::wrapper_general_error_code;
+		}
+
+		for (IncrementalAssembly::PendingChunk const& chunk : incremental->pending_chunks ()) {
+			mc_runner->set_output_file_path (chunk.object_file);
+			jobs.push_back ({ chunk.source_file, chunk.object_file, chunk.size, mc_runner->create_process (llvm_mc), true });
+		}
+	} else {
+		for (fs::path const& input : input_files) {
+			InputCompression compression = InputStream::detect_compression (input);
+
+			// Compressed and rewritten inputs are passed to `llvm-mc` via a pipe, never stored on disk in their final form
+			bool input_from_stdin = _function_sections || compression != InputCompression::None || InputStream::is_stdin (input);
+			mc_runner->read_input_from_stdin (input_from_stdin);
+			mc_runner->set_input_file_path (input, derive_output_file_name);
+
+			fs::path job_output_file = derive_output_file_name ? mc_runner->make_output_file_path (input) : actual_output_file;
+			jobs.push_back ({ input, job_output_file, InputStream::decompressed_size (input), mc_runner->create_process (llvm_mc), input_from_stdin });
+		}
+	}
+
+	std::unique_ptr<RemoteCache> remote_cache;
+	if (!_remote_cache_url.empty ()) {
+		remote_cache = RemoteCache::create (_remote_cache_url);
+	}
+
+	DiagnosticsAggregator diagnostics { _show_warnings };
+	ScopeGuard print_diagnostics_summary {
+		[&diagnostics]() -> void {
+			diagnostics.print_summary ();
+		}
+	};
+
+	std::unique_ptr<DependencyScanner> dependencies;
+	if (!_dependency_file.empty ()) {
+		dependencies = std::make_unique<DependencyScanner> (include_dirs);
+		for (fs::path const& input : input_files) {
+			if (!InputStream::is_stdin (input)) {
+				dependencies->scan_input (input);
+			}
+		}
+	}
+
+	InputOptions const input_options { target_arch (), _function_sections, _reduce_memory_overheads, _hash_size, dependencies.get () };
+	auto run_job = [this, &remote_cache, &diagnostics, &input_options](Job &job) -> int {
+		std::optional<std::string> key;
+		if (remote_cache) {
+			key = remote_cache->make_key (*job.process, job.input_file, _function_sections ? "function-sections" : "");
+			if (key.has_value () && remote_cache->fetch (key.value (), job.output_file)) {
+				return 0;
+			}
+		}
+
+		DiagnosticsAggregator::Stream diagnostics_stream { diagnostics };
+		job.process->capture_stderr (
+			[&diagnostics_stream](std::string_view const& line) {
+				diagnostics_stream.add_line (line);
+			}
+		);
+
+		if (job.input_from_stdin) {
+			diagnostics_stream.set_stdin_name (job.input_file.string ());
+			job.process->feed_stdin (
+				[&input_options, &job](Process::input_write_fn const& write) -> bool {
+					return feed_input (job.input_file, input_options, write);
+				}
+			);
+		}
+
+		int ret = job.process->run (!_quiet);
+		diagnostics_stream.finish ();
 		if (ret != 0) {
-			STDERR << "  mc_runner failed with error code " << ret << Constants::newline;
-			return ret;
+			// `llvm-mc` removes its output when it fails, but if feeding the input failed (e.g. a truncated
+			// compressed file) it saw only the end of its input and wrote a valid-looking object of the partial
+			// source.  Left in place, it would be considered up to date by the build system on the next run.
+			std::error_code ec;
+			fs::remove (job.output_file, ec);
+		} else if (key.has_value ()) {
+			remote_cache->store (key.value (), job.output_file);
+		}
+
+		return ret;
+	};
+
+	uint32_t max_jobs = _max_jobs;
+	if (max_jobs == 0) {
+		max_jobs = _reduce_memory_overheads ? 1 : std::thread::hardware_concurrency ();
+	}
+	JobScheduler scheduler { max_jobs, _memory_budget };
+	int ret = scheduler.run (jobs, run_job);
+	if (ret != 0) {
+		STDERR << "  mc_runner failed with error code " << ret << Constants::newline;
+		return ret;
+	}
+
+	if (incremental) {
+		try {
+			incremental->commit ();
+		} catch (std::exception const& ex) {
+			STDERR << "Failed to update chunk cache " << incremental->cache_dir () << ". " << ex.what () << Constants::newline;
+			return Constants::wrapper_general_error_code;
+		}
+
+		if (!_quiet) {
+			STDOUT << "Reassembled " << jobs.size () << " of " << incremental->chunk_count () << " chunk(s) of " << input_files[0] << Constants::newline;
+		}
+
+		std::vector<fs::path> chunk_objects = incremental->object_files ();
+		if (chunk_objects.size () == 1) {
+			try {
+				fs::copy_file (chunk_objects[0], actual_output_file, fs::copy_options::overwrite_existing);
+			} catch (fs::filesystem_error const& ex) {
+				STDERR << "Failed to copy " << chunk_objects[0] << " to " << actual_output_file << ". " << ex.what () << Constants::newline;
+				return Constants::wrapper_general_error_code;
+			}
+		} else {
+			ret = merge_objects (chunk_objects, actual_output_file, ld_name, diagnostics);
+			if (ret != 0) {
+				return ret;
+			}
+		}
+	}
+
+	// Done on the individual objects, so that it works for archives too.  `ld -r` keeps the visibility.  Objects of
+	// the chunks are kept in the cache as they were assembled, the merged output is processed instead.
+	if (export_list.has_value ()) {
+		std::vector<fs::path> objects;
+		if (incremental) {
+			objects.push_back (actual_output_file);
+		} else {
+			for (Job const& job : jobs) {
+				objects.push_back (job.output_file);
+			}
+		}
+
+		size_t hidden = 0;
+		for (fs::path const& object : objects) {
+			try {
+				hidden += export_list->hide_unexported_symbols (object);
+			} catch (std::exception const& ex) {
+				STDERR << "Failed to hide symbols of " << object << ". " << ex.what () << Constants::newline;
+				return Constants::wrapper_general_error_code;
+			}
+		}
+
+		if (!_quiet) {
+			STDOUT << "Hid " << hidden << " symbol(s) not on the export list " << _export_list << Constants::newline;
 		}
 	}
 
@@ -169,24 +591,155 @@ int Gas::run (std::vector<platform::string> args)
 			output_files.push_back (mc_runner->make_output_file_path (input));
 		}
 
-		fs::path ld_path { program_dir () };
-		ld_path /= ld_name;
-		auto ld = std::make_unique<Process> (ld_path);
-		ld->append_program_argument (PSTR("-o"));
-		ld->append_program_argument (_gas_output_file.empty () ? platform::string (Constants::default_output_name) : _gas_output_file.native ());
-		ld->append_program_argument (PSTR("--relocatable"));
+		ret = merge_objects (output_files, actual_output_file, ld_name, diagnostics);
+		if (ret != 0) {
+			return ret;
+		}
+	}
 
-		for (fs::path const& output : output_files) {
-			ld->append_program_argument (output.native ());
+	if (_fold_sections) {
+		try {
+			SectionFolder::Result folded = SectionFolder::fold (actual_output_file, _fold_code ? SectionFolder::Mode::All : SectionFolder::Mode::ReadOnlyData);
+			if (!_quiet) {
+				STDOUT << "Folded " << folded.sections << " identical section(s) and " << folded.groups << " COMDAT group(s), saving " << folded.bytes << " bytes" << Constants::newline;
+			}
+		} catch (std::exception const& ex) {
+			STDERR << "Failed to fold identical sections of " << actual_output_file << ". " << ex.what () << Constants::newline;
+			return Constants::wrapper_general_error_code;
 		}
+	}
 
-		return ld->run ();
+	// Before the debug information is split off, so that its size is part of the report
+	if (!_size_report.empty ()) {
+		try {
+			SizeReport report;
+			if (multiple_input_files && _output_kind != OutputKind::Relocatable) {
+				for (Job const& job : jobs) {
+					report.add_object (job.output_file);
+				}
+			} else {
+				report.add_object (actual_output_file);
+			}
+			report.write (_size_report);
+		} catch (std::exception const& ex) {
+			STDERR << "Failed to write size report " << _size_report << ". " << ex.what () << Constants::newline;
+			return Constants::wrapper_general_error_code;
+		}
+	}
+
+	if (_split_debug) {
+		ret = split_debug_info (actual_output_file, output_file);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	if (dependencies) {
+		try {
+			DependencyScanner::write_make_rule (_dependency_file, output_file, dependencies->dependencies ());
+		} catch (std::exception const& ex) {
+			STDERR << "Failed to write dependency file " << _dependency_file << ". " << ex.what () << Constants::newline;
+			return Constants::wrapper_general_error_code;
+		}
+	}
+
+	if (_write_if_changed) {
+		try {
+			if (!FileUtils::replace_if_changed (actual_output_file, output_file) && !_quiet) {
+				STDOUT << "Output file " << output_file << " is up to date" << Constants::newline;
+			}
+		} catch (fs::filesystem_error const& ex) {
+			STDERR << "Failed to update output file " << output_file << ". " << ex.what () << Constants::newline;
+			return Constants::wrapper_general_error_code;
+		}
 	}
 
 	return 0;
 }
 
-constexpr std::array<CommandLineOption, 21> all_options {{
+int Gas::merge_objects (std::vector<fs::path> const& object_files, fs::path const& output_file, platform::string const& ld_name, DiagnosticsAggregator &diagnostics)
+{
+	if (_output_kind != OutputKind::Relocatable) {
+		// The linker accepts archives just as well as objects, building one costs almost no I/O (thin archives just
+		// refer to the objects) and needs no extra process
+		try {
+			ArchiveWriter archive { _output_kind == OutputKind::ThinArchive };
+			for (fs::path const& object : object_files) {
+				archive.add_member (object);
+			}
+			archive.write (output_file);
+		} catch (std::exception const& ex) {
+			STDERR << "Failed to create archive " << output_file << ". " << ex.what () << Constants::newline;
+			return Constants::wrapper_general_error_code;
+		}
+
+		return 0;
+	}
+
+	fs::path ld_path { program_dir () };
+	ld_path /= ld_name;
+	auto ld = std::make_unique<Process> (ld_path);
+	ld->append_program_argument (PSTR("-o"));
+	ld->append_program_argument (output_file.native ());
+	ld->append_program_argument (PSTR("--relocatable"));
+	if (_reduce_memory_overheads) {
+		// Each `lld` thread allocates its own buffers
+		ld->append_program_argument (PSTR("--threads=1"));
+	}
+	if (!_ld_emulation.empty ()) {
+		ld->append_program_argument (PSTR("-m"));
+		ld->append_program_argument (_ld_emulation);
+	}
+
+	for (fs::path const& object : object_files) {
+		ld->append_program_argument (object.native ());
+	}
+
+	DiagnosticsAggregator::Stream diagnostics_stream { diagnostics };
+	ld->capture_stderr (
+		[&diagnostics_stream](std::string_view const& line) {
+			diagnostics_stream.add_line (line);
+		}
+	);
+
+	int ret = ld->run (!_quiet);
+	diagnostics_stream.finish ();
+	return ret;
+}
+
+int Gas::split_debug_info (fs::path const& object_file, fs::path const& output_file)
+{
+	fs::path debug_file = _split_debug_file;
+	if (debug_file.empty ()) {
+		debug_file = output_file;
+		debug_file += PSTR(".debug");
+	}
+
+	// Same as with the object file, the debug file is left untouched if it didn't change
+	fs::path actual_debug_file = _write_if_changed ? FileUtils::make_temporary_path (debug_file) : debug_file;
+	ScopeGuard remove_temporary_debug_file {
+		[&]() -> void {
+			if (_write_if_changed) {
+				std::error_code ec;
+				fs::remove (actual_debug_file, ec);
+			}
+		}
+	};
+
+	try {
+		DebugInfoSplitter::split (object_file, actual_debug_file, debug_file);
+		if (_write_if_changed && !FileUtils::replace_if_changed (actual_debug_file, debug_file) && !_quiet) {
+			STDOUT << "Debug info file " << debug_file << " is up to date" << Constants::newline;
+		}
+	} catch (std::exception const& ex) {
+		STDERR << "Failed to split debug info of " << output_file << " into " << debug_file << ". " << ex.what () << Constants::newline;
+		return Constants::wrapper_general_error_code;
+	}
+
+	return 0;
+}
+
+constexpr std::array<CommandLineOption, 52> all_options {{
 	// Arguments ignored by GAS, we shall ignore them silently too
 	{ CLIPARAM("divide"),    OptionId::Ignore },
 	{ CLIPARAM("k"),         OptionId::Ignore },
@@ -202,23 +755,56 @@ constexpr std::array<CommandLineOption, 21> all_options {{
 	{ CLIPARAM("warn"),      OptionId::Warn },
 	{ CLIPARAM("g"),         OptionId::G },
 	{ CLIPARAM("gen-debug"), OptionId::G },
+	{ CLIPARAM("debug-prefix-map"), OptionId::DebugPrefixMap, ArgumentValue::Required },
+	{ CLIPARAM("I"),         OptionId::IncludeDir,     ArgumentValue::Required },
+	{ CLIPARAM("MD"),        OptionId::MD,             ArgumentValue::Required },
+	{ CLIPARAM("reduce-memory-overheads"), OptionId::ReduceMemoryOverheads },
+	{ CLIPARAM("hash-size"), OptionId::HashSize,       ArgumentValue::Required },
 
 	// Arguments handled by us, not passed to llvm-mc
 	{ CLIPARAM("h"),         OptionId::Help },
 	{ CLIPARAM("help"),      OptionId::Help },
 	{ CLIPARAM("V"),         OptionId::Version },
 	{ CLIPARAM("version"),   OptionId::VersionExit },
+	{ CLIPARAM("jobs"),      OptionId::Jobs,           ArgumentValue::Required },
+	{ CLIPARAM("memory-budget"), OptionId::MemoryBudget, ArgumentValue::Required },
+	{ CLIPARAM("write-if-changed"), OptionId::WriteIfChanged },
+	{ CLIPARAM("quiet"),     OptionId::Quiet },
+	{ CLIPARAM("reproducible-paths"), OptionId::ReproduciblePaths },
+	{ CLIPARAM("remote-cache"), OptionId::RemoteCache, ArgumentValue::Required },
+	{ CLIPARAM("child-policy"), OptionId::ChildPolicy, ArgumentValue::Required },
+	{ CLIPARAM("child-allocator"), OptionId::ChildAllocator, ArgumentValue::Required },
+	{ CLIPARAM("function-sections"), OptionId::FunctionSections },
+	{ CLIPARAM("split-debug"), OptionId::SplitDebug },
+	{ CLIPARAM("output-kind"), OptionId::OutputKind, ArgumentValue::Required },
+	{ CLIPARAM("export-list"), OptionId::ExportList, ArgumentValue::Required },
+	{ CLIPARAM("size-report"), OptionId::SizeReport, ArgumentValue::Required },
+	{ CLIPARAM("incremental"), OptionId::Incremental },
+	{ CLIPARAM("fold-sections"), OptionId::FoldSections },
 
 	// x86 arguments
 	{ CLIPARAM("32"),        OptionId::Ignore,         TargetArchitecture::X86 }, // llvm-mc doesn't need this
-	{ CLIPARAM("64"),        OptionId::Ignore,         TargetArchitecture::X86 }, // llvm-mc doesn't need this
+	{ CLIPARAM("64"),        OptionId::Mode64,         TargetArchitecture::X86 },
+	{ CLIPARAM("march"),     OptionId::MArch,          ArgumentValue::Required, TargetArchitecture::X86 },
+	{ CLIPARAM("mtune"),     OptionId::MTune,          ArgumentValue::Required, TargetArchitecture::X86 },
+	{ CLIPARAM("mrelax-relocations"), OptionId::MRelaxRelocations, ArgumentValue::Required, TargetArchitecture::X86 },
 
 	// x64 arguments
-	{ CLIPARAM("32"),        OptionId::Ignore,         TargetArchitecture::X64 }, // llvm-mc doesn't need this
+	{ CLIPARAM("32"),        OptionId::Mode32,         TargetArchitecture::X64 },
 	{ CLIPARAM("64"),        OptionId::Ignore,         TargetArchitecture::X64 }, // llvm-mc doesn't need this
+	{ CLIPARAM("march"),     OptionId::MArch,          ArgumentValue::Required, TargetArchitecture::X64 },
+	{ CLIPARAM("mtune"),     OptionId::MTune,          ArgumentValue::Required, TargetArchitecture::X64 },
+	{ CLIPARAM("mrelax-relocations"), OptionId::MRelaxRelocations, ArgumentValue::Required, TargetArchitecture::X64 },
+
+	// Arm64 arguments
+	{ CLIPARAM("march"),     OptionId::MArch,          ArgumentValue::Required, TargetArchitecture::ARM64 },
+	{ CLIPARAM("mcpu"),      OptionId::MCpu,           ArgumentValue::Required, TargetArchitecture::ARM64 },
 
 	// Arm32 arguments
 	{ CLIPARAM("mfpu"),      OptionId::MFPU,           ArgumentValue::Required, TargetArchitecture::ARM32 },
+	{ CLIPARAM("march"),     OptionId::MArch,          ArgumentValue::Required, TargetArchitecture::ARM32 },
+	{ CLIPARAM("mcpu"),      OptionId::MCpu,           ArgumentValue::Required, TargetArchitecture::ARM32 },
+	{ CLIPARAM("mthumb"),    OptionId::MThumb,         TargetArchitecture::ARM32 },
 }};
 
 Gas::ParseArgsResult Gas::parse_arguments (std::vector<platform::string> &args, std::unique_ptr<LlvmMcRunner>& mc_runner)
@@ -226,6 +812,44 @@ Gas::ParseArgsResult Gas::parse_arguments (std::vector<platform::string> &args,
 	bool terminate = false, is_error = false;
 	bool show_version = false, show_help = false;
 
+	auto parse_number = [&](CommandLineOption const& opt, platform::string const& value, uint64_t max) -> uint64_t {
+		uint64_t ret = 0;
+		try {
+			size_t pos = 0;
+			ret = std::stoull (value, &pos);
+			if (pos != value.length ()) {
+				throw std::invalid_argument ("trailing characters");
+			}
+		} catch (std::out_of_range const&) {
+			ret = UINT64_MAX;
+		} catch (std::exception const&) {
+			STDERR << "Option '" << opt.name << "' requires a numeric argument, got '" << value << "'" << Constants::newline;
+			terminate = true;
+			is_error = true;
+			return 0;
+		}
+
+		if (ret > max) {
+			STDERR << "Invalid value '" << value << "' of option '" << opt.name << "'. Expected at most " << max << Constants::newline;
+			terminate = true;
+			is_error = true;
+			return 0;
+		}
+
+		return ret;
+	};
+
+	// Target options are validated by the runner, which throws if they can't be mapped to llvm-mc options
+	auto map_target_option = [&](CommandLineOption const& opt, platform::string const& gas_name, platform::string const& value) {
+		try {
+			mc_runner->map_option (gas_name, value);
+		} catch (std::logic_error const& ex) {
+			STDERR << "Invalid value '" << value << "' of option '" << opt.name << "'. " << ex.what () << Constants::newline;
+			terminate = true;
+			is_error = true;
+		}
+	};
+
 	auto handle_arg = [&](CommandLine::TCallbackOption option, CommandLine::TOptionValue val) {
 		if (std::holds_alternative<uint32_t> (option)) {
 			platform::string arg = std::get<platform::string> (val);
@@ -264,13 +888,164 @@ Gas::ParseArgsResult Gas::parse_arguments (std::vector<platform::string> &args,
 				break;
 
 			case OptionId::MFPU:
-				mc_runner->map_option (PSTR("mfpu"), std::get<platform::string> (val));
+				map_target_option (opt, PSTR("mfpu"), std::get<platform::string> (val));
+				break;
+
+			case OptionId::MArch:
+				map_target_option (opt, PSTR("march"), std::get<platform::string> (val));
+				break;
+
+			case OptionId::MCpu:
+				map_target_option (opt, PSTR("mcpu"), std::get<platform::string> (val));
+				break;
+
+			case OptionId::MThumb:
+				map_target_option (opt, PSTR("mthumb"), std::get<platform::string> (val));
+				break;
+
+			case OptionId::MTune:
+				map_target_option (opt, PSTR("mtune"), std::get<platform::string> (val));
+				break;
+
+			case OptionId::MRelaxRelocations:
+				map_target_option (opt, PSTR("mrelax-relocations"), std::get<platform::string> (val));
+				break;
+
+			// Objects for the other word size are merged by the same linker, it just needs to be told their format
+			case OptionId::Mode32:
+				map_target_option (opt, PSTR("32"), std::get<platform::string> (val));
+				_ld_emulation = PSTR("elf_i386");
+				break;
+
+			case OptionId::Mode64:
+				map_target_option (opt, PSTR("64"), std::get<platform::string> (val));
+				_ld_emulation = PSTR("elf_x86_64");
 				break;
 
 			case OptionId::G:
 				mc_runner->generate_debug_info ();
 				break;
 
+			case OptionId::Warn:
+				_show_warnings = true;
+				break;
+
+			case OptionId::Quiet:
+				_quiet = true;
+				break;
+
+			case OptionId::FunctionSections:
+				_function_sections = true;
+				break;
+
+			case OptionId::SplitDebug:
+				_split_debug = true;
+				_split_debug_file = std::get<platform::string> (val);
+				break;
+
+			case OptionId::OutputKind: {
+				platform::string const& kind = std::get<platform::string> (val);
+				if (kind == PSTR("relocatable")) {
+					_output_kind = OutputKind::Relocatable;
+				} else if (kind == PSTR("archive")) {
+					_output_kind = OutputKind::Archive;
+				} else if (kind == PSTR("thin-archive")) {
+					_output_kind = OutputKind::ThinArchive;
+				} else {
+					STDERR << "Invalid value '" << kind << "' of option '" << opt.name << "'. Expected one of: relocatable, archive, thin-archive" << Constants::newline;
+					terminate = true;
+					is_error = true;
+				}
+				break;
+			}
+
+			case OptionId::Jobs:
+				_max_jobs = static_cast<uint32_t>(parse_number (opt, std::get<platform::string> (val), Constants::max_jobs));
+				break;
+
+			case OptionId::MemoryBudget:
+				_memory_budget = parse_number (opt, std::get<platform::string> (val), Constants::max_memory_budget_mb) * 1024 * 1024;
+				break;
+
+			case OptionId::IncludeDir:
+				include_dirs.emplace_back (std::get<platform::string> (val));
+				mc_runner->add_include_path (include_dirs.back ());
+				break;
+
+			case OptionId::MD:
+				_dependency_file = std::get<platform::string> (val);
+				break;
+
+			case OptionId::ExportList:
+				_export_list = std::get<platform::string> (val);
+				break;
+
+			case OptionId::SizeReport:
+				_size_report = std::get<platform::string> (val);
+				break;
+
+			case OptionId::Incremental:
+				_incremental = true;
+				break;
+
+			case OptionId::FoldSections: {
+				platform::string const& what = std::get<platform::string> (val);
+				_fold_sections = true;
+				if (what == PSTR("all")) {
+					_fold_code = true;
+				} else if (!what.empty () && what != PSTR("data")) {
+					STDERR << "Invalid value '" << what << "' of option '" << opt.name << "'. Expected one of: data, all" << Constants::newline;
+					terminate = true;
+					is_error = true;
+				}
+				break;
+			}
+
+			case OptionId::ReduceMemoryOverheads:
+				_reduce_memory_overheads = true;
+				break;
+
+			case OptionId::HashSize:
+				_hash_size = static_cast<size_t>(parse_number (opt, std::get<platform::string> (val), Constants::max_hash_size));
+				break;
+
+			case OptionId::WriteIfChanged:
+				_write_if_changed = true;
+				break;
+
+			case OptionId::DebugPrefixMap:
+				try {
+					mc_runner->add_debug_prefix_map (std::get<platform::string> (val));
+				} catch (invalid_argument_error const& ex) {
+					STDERR << "Invalid value '" << std::get<platform::string> (val) << "' of option '" << opt.name << "'. " << ex.what () << Constants::newline;
+					terminate = true;
+					is_error = true;
+				}
+				break;
+
+			case OptionId::ReproduciblePaths:
+				_reproducible_paths = true;
+				_reproducible_paths_token = std::get<platform::string> (val);
+				break;
+
+			case OptionId::RemoteCache: {
+				// URLs are ASCII
+				platform::string const& url = std::get<platform::string> (val);
+				_remote_cache_url.assign (url.begin (), url.end ());
+				break;
+			}
+
+			case OptionId::ChildAllocator:
+				_child_allocator = std::get<platform::string> (val);
+				break;
+
+			case OptionId::ChildPolicy: {
+				// The settings are ASCII
+				platform::string const& spec = std::get<platform::string> (val);
+				_child_policy.assign (spec.begin (), spec.end ());
+				break;
+			}
+
 			default:
 				break;
 		}
@@ -301,5 +1076,80 @@ Gas::ParseArgsResult Gas::parse_arguments (std::vector<platform::string> &args,
 		_gas_output_file = Constants::default_output_name;
 	}
 
+	if (_split_debug && _output_kind != OutputKind::Relocatable) {
+		STDERR << "Option '--split-debug' requires relocatable output (--output-kind=relocatable)" << Constants::newline;
+		return {true, true};
+	}
+
+	if (_fold_sections && _output_kind != OutputKind::Relocatable) {
+		STDERR << "Option '--fold-sections' requires relocatable output (--output-kind=relocatable)" << Constants::newline;
+		return {true, true};
+	}
+
+	if (_incremental && (input_files.size () != 1 || InputStream::is_stdin (input_files[0]) || _output_kind != OutputKind::Relocatable)) {
+		STDERR << "Option '--incremental' requires a single input file (not stdin) and relocatable output" << Constants::newline;
+		return {true, true};
+	}
+
+	if (_remote_cache_url.empty ()) {
+		char const* url = std::getenv ("XA_GAS_REMOTE_CACHE");
+		if (url != nullptr) {
+			_remote_cache_url = url;
+		}
+	}
+
+	if (_child_policy.empty ()) {
+		char const* spec = std::getenv ("XA_GAS_CHILD_POLICY");
+		if (spec != nullptr) {
+			_child_policy = spec;
+		}
+	}
+
+	if (!_child_policy.empty ()) {
+		try {
+			Process::set_child_policy (ChildPolicy::parse (_child_policy));
+		} catch (invalid_argument_error const& ex) {
+			STDERR << "Invalid child process policy '" << _child_policy.c_str () << "'. " << ex.what () << Constants::newline;
+			return {true, true};
+		} catch (invalid_operation_error const& ex) {
+			STDERR << "Failed to set up child process policy. " << ex.what () << Constants::newline;
+			return {true, true};
+		}
+	}
+
+	if (_child_allocator.empty ()) {
+		char const* allocator = std::getenv ("XA_GAS_CHILD_ALLOCATOR");
+		if (allocator != nullptr) {
+			_child_allocator = allocator;
+		}
+	}
+
+	if (!_child_allocator.empty () && _child_allocator != PSTR("system")) {
+		// `mimalloc` is optionally built along with LLVM, and installed with its libraries
+		fs::path library = _child_allocator;
+		if (library == PSTR("mimalloc")) {
+#if defined (__APPLE__)
+			library = program_dir () / PSTR("..") / PSTR("lib") / PSTR("libmimalloc.dylib");
+#else
+			library = program_dir () / PSTR("..") / PSTR("lib") / PSTR("libmimalloc.so");
+#endif
+		}
+
+		try {
+			Process::set_child_preload (library.lexically_normal ());
+		} catch (invalid_operation_error const& ex) {
+			STDERR << "Unable to use allocator '" << _child_allocator.native () << "'. " << ex.what () << Constants::newline;
+			return {true, true};
+		}
+	}
+
+	if (_reproducible_paths) {
+		platform::string mapping { fs::current_path ().make_preferred ().native () };
+		mapping
+			.append (PSTR("="))
+			.append (_reproducible_paths_token.empty () ? platform::string { Constants::reproducible_paths_token } : _reproducible_paths_token);
+		mc_runner->add_debug_prefix_map (mapping);
+	}
+
  	return {terminate, is_error};
 }
@@ -44,6 +44,7 @@ namespace xamarin::android::gas
 		TFunc fn;
 	};
 
+	class DiagnosticsAggregator;
 	class LlvmMcRunner;
 
 	template<class T>
@@ -79,6 +80,14 @@ namespace xamarin::android::gas
 
 	class Gas final
 	{
+		// What multiple input files are combined into
+		enum class OutputKind
+		{
+			Relocatable, // `ld --relocatable`
+			Archive,
+			ThinArchive,
+		};
+
 		struct ParseArgsResult
 		{
 			const bool terminate;
@@ -111,6 +120,7 @@ namespace xamarin::android::gas
 		void dump_command_line_args (int argc, argv_char **argv);
 		static void platform_setup ();
 		std::vector<platform::string> get_command_line (int argc, argv_char **argv);
+		void determine_program_dir (std::vector<platform::string> args);
 
 		int run (std::vector<platform::string> args);
 
@@ -133,8 +143,10 @@ namespace xamarin::android::gas
 		ParseArgsResult parse_arguments (std::vector<platform::string> &args, std::unique_ptr<LlvmMcRunner>& mc_runner);
 
 	private:
-		void determine_program_dir (std::vector<platform::string> args);
+		int assemble (std::vector<platform::string> args);
 		int usage (bool is_error, platform::string const message = PSTR(""));
+		int merge_objects (std::vector<fs::path> const& object_files, fs::path const& output_file, platform::string const& ld_name, DiagnosticsAggregator &diagnostics);
+		int split_debug_info (fs::path const& object_file, fs::path const& output_file);
 
 	private:
 		static constexpr size_t arm64_gas_name_size = calc_size (arm64_arch_prefix, generic_gas_name);
@@ -162,11 +174,35 @@ namespace xamarin::android::gas
 		static constexpr auto x64_ld_name           = concat_string_views<x64_ld_name_size> (x64_arch_prefix, generic_ld_name);
 
 		std::vector<fs::path> input_files;
+		std::vector<fs::path> include_dirs;
 
 		platform::string    _program_name;
 		fs::path            _gas_output_file;
 		fs::path            _program_dir;
 		TargetArchitecture  _target_arch;
+		uint32_t            _max_jobs = 0;
+		uint64_t            _memory_budget = 0;
+		bool                _reduce_memory_overheads = false;
+		size_t              _hash_size = 0;
+		bool                _write_if_changed = false;
+		bool                _show_warnings = false;
+		bool                _quiet = false;
+		bool                _function_sections = false;
+		platform::string    _ld_emulation;
+		OutputKind          _output_kind = OutputKind::Relocatable;
+		bool                _split_debug = false;
+		fs::path            _split_debug_file;
+		fs::path            _dependency_file;
+		fs::path            _export_list;
+		fs::path            _size_report;
+		bool                _incremental = false;
+		bool                _fold_sections = false;
+		bool                _fold_code = false;
+		bool                _reproducible_paths = false;
+		platform::string    _reproducible_paths_token;
+		std::string         _remote_cache_url;
+		std::string         _child_policy;
+		fs::path            _child_allocator;
 	};
 }
 #endif // __GAS_HH
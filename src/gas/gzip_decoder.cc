@@ -0,0 +1,524 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <cstring>
+
+#include "exceptions.hh"
+#include "gzip_decoder.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr uint8_t gzip_id1 = 0x1f;
+	constexpr uint8_t gzip_id2 = 0x8b;
+	constexpr uint8_t gzip_method_deflate = 8;
+
+	constexpr uint8_t gzip_flag_hcrc    = 0x02;
+	constexpr uint8_t gzip_flag_extra   = 0x04;
+	constexpr uint8_t gzip_flag_name    = 0x08;
+	constexpr uint8_t gzip_flag_comment = 0x10;
+	constexpr uint8_t gzip_flags_reserved = 0xe0;
+
+	constexpr uint32_t end_of_block = 256;
+
+	constexpr std::array<uint16_t, 29> length_base {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+	};
+
+	constexpr std::array<uint8_t, 29> length_extra {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+	};
+
+	constexpr std::array<uint16_t, 30> distance_base {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+		6145, 8193, 12289, 16385, 24577,
+	};
+
+	constexpr std::array<uint8_t, 30> distance_extra {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+	};
+
+	// Order in which the lengths of the code length code are stored in a dynamic block
+	constexpr std::array<uint8_t, 19> code_length_order {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+	};
+
+	constexpr std::array<uint32_t, 256> make_crc32_table () noexcept
+	{
+		std::array<uint32_t, 256> table {};
+		for (uint32_t i = 0; i < table.size (); i++) {
+			uint32_t c = i;
+			for (uint32_t bit = 0; bit < 8; bit++) {
+				c = (c & 1) != 0 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			}
+			table[i] = c;
+		}
+		return table;
+	}
+
+	constexpr std::array<uint32_t, 256> crc32_table = make_crc32_table ();
+
+	[[noreturn]] void invalid_data (char const* what)
+	{
+		throw invalid_operation_error { std::string { "Invalid gzip data: " } + what };
+	}
+
+	[[noreturn]] void truncated_data ()
+	{
+		throw invalid_operation_error { "Unexpected end of gzip data" };
+	}
+}
+
+GzipDecoder::GzipDecoder (read_fn read)
+	: read_input (std::move (read)),
+	  input (input_buffer_size),
+	  output (output_ring_size)
+{}
+
+size_t GzipDecoder::read (char *buffer, size_t size)
+{
+	size_t total = 0;
+	while (total < size) {
+		size_t pending = static_cast<size_t>(write_pos - read_pos);
+		if (pending > 0) {
+			size_t offset = static_cast<size_t>(read_pos % output_ring_size);
+			size_t count = std::min ({ pending, size - total, output_ring_size - offset });
+			std::memcpy (buffer + total, output.data () + offset, count);
+			crc = update_crc32 (crc, output.data () + offset, count);
+			read_pos += count;
+			total += count;
+			continue;
+		}
+
+		if (state == State::Done) {
+			break;
+		}
+
+		if (state == State::Trailer) {
+			// All the data of the member was returned, so the checksum is complete
+			verify_trailer ();
+			state = at_end () ? State::Done : State::Header;
+			continue;
+		}
+
+		decode ();
+	}
+
+	return total;
+}
+
+// Decodes until the output ring has no room for another match or the member ends
+void GzipDecoder::decode ()
+{
+	constexpr size_t limit = output_ring_size - window_size - max_match_length;
+
+	while (write_pos - read_pos < limit) {
+		switch (state) {
+			case State::Header:
+				read_header ();
+				break;
+
+			case State::BlockHeader:
+				if (last_block) {
+					align_to_byte ();
+					expected_crc = get_bits (16) | (get_bits (16) << 16);
+					expected_size = get_bits (16) | (get_bits (16) << 16);
+					state = State::Trailer;
+					return;
+				}
+				read_block_header ();
+				break;
+
+			case State::Stored:
+				copy_stored ();
+				break;
+
+			case State::Compressed:
+				decode_compressed ();
+				break;
+
+			case State::Trailer:
+			case State::Done:
+				return;
+		}
+	}
+}
+
+void GzipDecoder::read_header ()
+{
+	if (get_byte () != gzip_id1 || get_byte () != gzip_id2) {
+		invalid_data ("not in gzip format");
+	}
+
+	if (get_byte () != gzip_method_deflate) {
+		invalid_data ("unknown compression method");
+	}
+
+	uint8_t flags = get_byte ();
+	if ((flags & gzip_flags_reserved) != 0) {
+		invalid_data ("unknown header flags set");
+	}
+
+	// Modification time, extra flags and OS
+	for (uint32_t i = 0; i < 6; i++) {
+		get_byte ();
+	}
+
+	if ((flags & gzip_flag_extra) != 0) {
+		uint32_t length = get_byte ();
+		length |= static_cast<uint32_t>(get_byte ()) << 8;
+		for (uint32_t i = 0; i < length; i++) {
+			get_byte ();
+		}
+	}
+
+	if ((flags & gzip_flag_name) != 0) {
+		while (get_byte () != 0) {}
+	}
+
+	if ((flags & gzip_flag_comment) != 0) {
+		while (get_byte () != 0) {}
+	}
+
+	if ((flags & gzip_flag_hcrc) != 0) {
+		get_byte ();
+		get_byte ();
+	}
+
+	member_start = write_pos;
+	crc = 0;
+	last_block = false;
+	state = State::BlockHeader;
+}
+
+void GzipDecoder::read_block_header ()
+{
+	last_block = get_bits (1) != 0;
+	switch (get_bits (2)) {
+		case 0: {
+			align_to_byte ();
+			uint32_t length = get_bits (16);
+			uint32_t complement = get_bits (16);
+			if (length != (~complement & 0xffff)) {
+				invalid_data ("invalid stored block lengths");
+			}
+			stored_remaining = length;
+			state = State::Stored;
+			break;
+		}
+
+		case 1: {
+			std::array<uint8_t, 288 + 30> lengths;
+			std::fill (lengths.begin (), lengths.begin () + 144, 8);
+			std::fill (lengths.begin () + 144, lengths.begin () + 256, 9);
+			std::fill (lengths.begin () + 256, lengths.begin () + 280, 7);
+			std::fill (lengths.begin () + 280, lengths.begin () + 288, 8);
+			std::fill (lengths.begin () + 288, lengths.end (), 5);
+			build_code (literal_code, lengths.data (), 288);
+			build_code (distance_code, lengths.data () + 288, 30);
+			state = State::Compressed;
+			break;
+		}
+
+		case 2:
+			read_dynamic_codes ();
+			state = State::Compressed;
+			break;
+
+		default:
+			invalid_data ("invalid block type");
+	}
+}
+
+void GzipDecoder::read_dynamic_codes ()
+{
+	uint32_t literal_count = get_bits (5) + 257;
+	uint32_t distance_count = get_bits (5) + 1;
+	uint32_t code_length_count = get_bits (4) + 4;
+	if (literal_count > 286 || distance_count > 30) {
+		invalid_data ("too many length or distance symbols");
+	}
+
+	std::array<uint8_t, 19> code_lengths {};
+	for (uint32_t i = 0; i < code_length_count; i++) {
+		code_lengths[code_length_order[i]] = static_cast<uint8_t>(get_bits (3));
+	}
+
+	Huffman code_length_code;
+	build_code (code_length_code, code_lengths.data (), code_lengths.size ());
+
+	// The literal/length and distance code lengths form a single sequence, repeats may cross from one to the other
+	std::array<uint8_t, 286 + 30> lengths {};
+	uint32_t count = literal_count + distance_count;
+	uint32_t i = 0;
+	while (i < count) {
+		uint32_t symbol = decode_symbol (code_length_code);
+		if (symbol < 16) {
+			lengths[i++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+
+		uint8_t value = 0;
+		uint32_t repeat;
+		if (symbol == 16) {
+			if (i == 0) {
+				invalid_data ("repeated length with no first length");
+			}
+			value = lengths[i - 1];
+			repeat = 3 + get_bits (2);
+		} else if (symbol == 17) {
+			repeat = 3 + get_bits (3);
+		} else {
+			repeat = 11 + get_bits (7);
+		}
+
+		if (i + repeat > count) {
+			invalid_data ("too many code lengths");
+		}
+
+		std::fill_n (lengths.begin () + i, repeat, value);
+		i += repeat;
+	}
+
+	if (lengths[end_of_block] == 0) {
+		invalid_data ("missing end-of-block code");
+	}
+
+	build_code (literal_code, lengths.data (), literal_count);
+	build_code (distance_code, lengths.data () + literal_count, distance_count);
+}
+
+void GzipDecoder::copy_stored ()
+{
+	constexpr size_t limit = output_ring_size - window_size - max_match_length;
+
+	while (stored_remaining > 0 && write_pos - read_pos < limit) {
+		output[static_cast<size_t>(write_pos % output_ring_size)] = get_byte ();
+		write_pos++;
+		stored_remaining--;
+	}
+
+	if (stored_remaining == 0) {
+		state = State::BlockHeader;
+	}
+}
+
+void GzipDecoder::decode_compressed ()
+{
+	constexpr size_t limit = output_ring_size - window_size - max_match_length;
+	constexpr uint64_t ring_mask = output_ring_size - 1;
+	static_assert ((output_ring_size & ring_mask) == 0, "Output ring size must be a power of two");
+
+	uint8_t *ring = output.data ();
+	while (write_pos - read_pos < limit) {
+		uint32_t symbol = decode_symbol (literal_code);
+		if (symbol < end_of_block) {
+			ring[write_pos & ring_mask] = static_cast<uint8_t>(symbol);
+			write_pos++;
+			continue;
+		}
+
+		if (symbol == end_of_block) {
+			state = State::BlockHeader;
+			return;
+		}
+
+		symbol -= 257;
+		if (symbol >= length_base.size ()) {
+			invalid_data ("invalid literal/length code");
+		}
+		uint32_t length = length_base[symbol] + get_bits (length_extra[symbol]);
+
+		symbol = decode_symbol (distance_code);
+		if (symbol >= distance_base.size ()) {
+			invalid_data ("invalid distance code");
+		}
+		uint32_t distance = distance_base[symbol] + get_bits (distance_extra[symbol]);
+		if (distance > write_pos - member_start) {
+			invalid_data ("invalid distance too far back");
+		}
+
+		uint64_t from = write_pos - distance;
+		for (uint32_t n = 0; n < length; n++) {
+			ring[(write_pos + n) & ring_mask] = ring[(from + n) & ring_mask];
+		}
+		write_pos += length;
+	}
+}
+
+void GzipDecoder::verify_trailer ()
+{
+	if (crc != expected_crc) {
+		invalid_data ("incorrect data check");
+	}
+
+	if (static_cast<uint32_t>(write_pos - member_start) != expected_size) {
+		invalid_data ("incorrect length check");
+	}
+}
+
+bool GzipDecoder::refill_input ()
+{
+	input_pos = 0;
+	input_end = read_input (reinterpret_cast<char*>(input.data ()), input.size ());
+	return input_end > 0;
+}
+
+// Loads as many whole bytes as fit into the bit buffer, without reading past the end of the input
+void GzipDecoder::fill_bits ()
+{
+	while (bit_count <= 56) {
+		if (input_pos == input_end && !refill_input ()) {
+			return;
+		}
+
+		bits |= static_cast<uint64_t>(input[input_pos++]) << bit_count;
+		bit_count += 8;
+	}
+}
+
+uint32_t GzipDecoder::get_bits (uint32_t count)
+{
+	if (count == 0) {
+		return 0;
+	}
+
+	if (bit_count < count) {
+		fill_bits ();
+		if (bit_count < count) {
+			truncated_data ();
+		}
+	}
+
+	uint32_t ret = static_cast<uint32_t>(bits & ((1ull << count) - 1));
+	bits >>= count;
+	bit_count -= count;
+	return ret;
+}
+
+void GzipDecoder::align_to_byte () noexcept
+{
+	uint32_t extra = bit_count % 8;
+	bits >>= extra;
+	bit_count -= extra;
+}
+
+// Bytes are taken from the bit buffer first, it may hold data read ahead past the end of the compressed blocks
+uint8_t GzipDecoder::get_byte ()
+{
+	if (bit_count >= 8) {
+		return static_cast<uint8_t>(get_bits (8));
+	}
+
+	if (input_pos == input_end && !refill_input ()) {
+		truncated_data ();
+	}
+
+	return input[input_pos++];
+}
+
+bool GzipDecoder::at_end ()
+{
+	return bit_count == 0 && input_pos == input_end && !refill_input ();
+}
+
+uint32_t GzipDecoder::decode_symbol (Huffman const& code)
+{
+	if (bit_count < max_code_length) {
+		fill_bits ();
+	}
+
+	uint16_t entry = code.fast[bits & ((1u << fast_bits) - 1)];
+	uint32_t length = entry >> 9;
+	if (length != 0 && length <= bit_count) {
+		bits >>= length;
+		bit_count -= length;
+		return entry & 0x1ff;
+	}
+
+	// Codes are assigned in increasing order of length and value, `first` is the first code of `length` bits and
+	// `index` the position of its symbol in `symbols`
+	uint32_t value = 0;
+	uint32_t first = 0;
+	uint32_t index = 0;
+	for (length = 1; length <= max_code_length; length++) {
+		if (length > bit_count) {
+			truncated_data ();
+		}
+
+		value |= static_cast<uint32_t>(bits >> (length - 1)) & 1;
+		uint32_t count = code.counts[length];
+		if (value < first + count) {
+			bits >>= length;
+			bit_count -= length;
+			return code.symbols[index + (value - first)];
+		}
+
+		index += count;
+		first = (first + count) << 1;
+		value <<= 1;
+	}
+
+	invalid_data ("invalid code");
+}
+
+void GzipDecoder::build_code (Huffman &code, uint8_t const* lengths, size_t count)
+{
+	code.counts.fill (0);
+	for (size_t symbol = 0; symbol < count; symbol++) {
+		code.counts[lengths[symbol]]++;
+	}
+	code.counts[0] = 0;
+
+	// Incomplete codes are allowed (e.g. a single distance code), invalid bit sequences are then rejected when
+	// decoding
+	int32_t left = 1;
+	std::array<uint16_t, max_code_length + 2> offsets {};
+	std::array<uint32_t, max_code_length + 1> next_code {};
+	uint32_t next = 0;
+	for (uint32_t length = 1; length <= max_code_length; length++) {
+		left = (left << 1) - code.counts[length];
+		if (left < 0) {
+			invalid_data ("over-subscribed Huffman code");
+		}
+
+		offsets[length + 1] = static_cast<uint16_t>(offsets[length] + code.counts[length]);
+		next = (next + code.counts[length - 1]) << 1;
+		next_code[length] = next;
+	}
+
+	code.fast.fill (0);
+	for (size_t symbol = 0; symbol < count; symbol++) {
+		uint32_t length = lengths[symbol];
+		if (length == 0) {
+			continue;
+		}
+
+		code.symbols[offsets[length]++] = static_cast<uint16_t>(symbol);
+
+		uint32_t value = next_code[length]++;
+		if (length > fast_bits) {
+			continue;
+		}
+
+		// DEFLATE stores Huffman codes starting with their most significant bit, the bit buffer is consumed from its
+		// least significant bit
+		uint32_t reversed = 0;
+		for (uint32_t bit = 0; bit < length; bit++) {
+			reversed |= ((value >> bit) & 1) << (length - 1 - bit);
+		}
+
+		uint16_t entry = static_cast<uint16_t>((length << 9) | symbol);
+		for (uint32_t i = reversed; i < code.fast.size (); i += 1u << length) {
+			code.fast[i] = entry;
+		}
+	}
+}
+
+uint32_t GzipDecoder::update_crc32 (uint32_t crc, uint8_t const* data, size_t length) noexcept
+{
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++) {
+		crc = crc32_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__GZIP_DECODER_HH)
+#define __GZIP_DECODER_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace xamarin::android::gas
+{
+	// Streaming decoder of gzip data (RFC 1952, with the DEFLATE payload described by RFC 1951), used for compressed
+	// assembler input so that the program doesn't depend on zlib being available (or linked the same way) on every
+	// build host.  Concatenated gzip members are decoded as one stream, the CRC-32 and size recorded in every member's
+	// trailer are verified.
+	class GzipDecoder final
+	{
+		static constexpr size_t   input_buffer_size = 64 * 1024;
+		static constexpr size_t   window_size = 32 * 1024;       // maximum distance of a DEFLATE match
+		static constexpr size_t   max_match_length = 258;
+		static constexpr size_t   output_ring_size = 256 * 1024; // decoded data not yet returned, plus the window
+		static constexpr uint32_t max_code_length = 15;
+		static constexpr uint32_t fast_bits = 10;
+
+		// Canonical Huffman code.  Codes of up to `fast_bits` bits are decoded with a single lookup in `fast`, whose
+		// entries hold the symbol in the low 9 bits and the code length above them (0 for the longer codes).
+		struct Huffman
+		{
+			std::array<uint16_t, max_code_length + 1> counts {};
+			std::array<uint16_t, 288>                 symbols {};
+			std::array<uint16_t, 1u << fast_bits>     fast {};
+		};
+
+		enum class State
+		{
+			Header,
+			BlockHeader,
+			Stored,
+			Compressed,
+			Trailer,
+			Done,
+		};
+
+	public:
+		// Reads up to `size` bytes of compressed data into `buffer`, returns 0 at the end of the data
+		using read_fn = std::function<size_t(char *buffer, size_t size)>;
+
+	public:
+		explicit GzipDecoder (read_fn read);
+
+		// Stores up to `size` decompressed bytes in `buffer`, returns 0 at the end of the data.  Throws
+		// `invalid_operation_error` on invalid or truncated data.
+		size_t read (char *buffer, size_t size);
+
+	private:
+		void decode ();
+		void read_header ();
+		void read_block_header ();
+		void read_dynamic_codes ();
+		void copy_stored ();
+		void decode_compressed ();
+		void verify_trailer ();
+
+		bool refill_input ();
+		void fill_bits ();
+		uint32_t get_bits (uint32_t count);
+		void align_to_byte () noexcept;
+		uint8_t get_byte ();
+		bool at_end ();
+		uint32_t decode_symbol (Huffman const& code);
+
+		static void build_code (Huffman &code, uint8_t const* lengths, size_t count);
+		static uint32_t update_crc32 (uint32_t crc, uint8_t const* data, size_t length) noexcept;
+
+	private:
+		read_fn              read_input;
+		std::vector<uint8_t> input;
+		size_t               input_pos = 0;
+		size_t               input_end = 0;
+		uint64_t             bits = 0;
+		uint32_t             bit_count = 0;
+
+		std::vector<uint8_t> output;              // ring buffer of `output_ring_size` bytes
+		uint64_t             write_pos = 0;
+		uint64_t             read_pos = 0;
+		uint64_t             member_start = 0;    // `write_pos` at the start of the current member
+
+		State                state = State::Header;
+		bool                 last_block = false;
+		uint32_t             stored_remaining = 0;
+		Huffman              literal_code;
+		Huffman              distance_code;
+		uint32_t             crc = 0;
+		uint32_t             expected_crc = 0;
+		uint32_t             expected_size = 0;
+	};
+}
+#endif // __GZIP_DECODER_HH
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "http_client.hh"
+
+using namespace xamarin::android::gas;
+
+std::optional<HttpClient> HttpClient::from_url (std::string const& url, std::chrono::milliseconds timeout)
+{
+	constexpr std::string_view scheme { "http://" };
+	if (!url.starts_with (scheme)) {
+		return std::nullopt;
+	}
+
+	std::string rest = url.substr (scheme.length ());
+	std::string path_prefix;
+	size_t slash = rest.find ('/');
+	if (slash != std::string::npos) {
+		path_prefix = rest.substr (slash);
+		rest.erase (slash);
+		while (!path_prefix.empty () && path_prefix.back () == '/') {
+			path_prefix.pop_back ();
+		}
+	}
+
+	std::string port { "80" };
+	size_t colon = rest.rfind (':');
+	if (colon != std::string::npos && rest.find (']', colon) == std::string::npos) {
+		port = rest.substr (colon + 1);
+		rest.erase (colon);
+	}
+
+	// IPv6 literal addresses are enclosed in brackets
+	if (rest.length () > 2 && rest.front () == '[' && rest.back () == ']') {
+		rest = rest.substr (1, rest.length () - 2);
+	}
+
+	if (rest.empty () || port.empty () || !std::all_of (port.begin (), port.end (), [](char c) { return std::isdigit (static_cast<unsigned char>(c)); })) {
+		return std::nullopt;
+	}
+
+	return HttpClient { rest, port, path_prefix, timeout };
+}
+
+std::optional<HttpClient::Response> HttpClient::request (std::string const& method, std::string const& path, byte_buffer const* body) const
+{
+	std::string head { method };
+	head
+		.append (" ")
+		.append (path_prefix)
+		.append (path)
+		.append (" HTTP/1.1\r\n")
+		.append ("Host: ").append (host).append (":").append (port).append ("\r\n")
+		.append ("Connection: close\r\n");
+
+	if (body != nullptr) {
+		head
+			.append ("Content-Type: application/octet-stream\r\n")
+			.append ("Content-Length: ").append (std::to_string (body->size ())).append ("\r\n");
+	}
+	head.append ("\r\n");
+
+	byte_buffer request_data (head.begin (), head.end ());
+	if (body != nullptr) {
+		request_data.insert (request_data.end (), body->begin (), body->end ());
+	}
+
+	std::optional<byte_buffer> response_data = transfer (request_data);
+	if (!response_data.has_value ()) {
+		return std::nullopt;
+	}
+
+	return parse_response (response_data.value ());
+}
+
+std::optional<HttpClient::Response> HttpClient::parse_response (byte_buffer const& data)
+{
+	constexpr std::string_view header_end { "\r\n\r\n" };
+	auto headers_end = std::search (data.begin (), data.end (), header_end.begin (), header_end.end ());
+	if (headers_end == data.end ()) {
+		return std::nullopt;
+	}
+
+	std::string headers (data.begin (), headers_end);
+	auto body_start = headers_end + static_cast<ptrdiff_t>(header_end.length ());
+
+	// Status line: `HTTP/1.1 200 OK`
+	if (!headers.starts_with ("HTTP/1.")) {
+		return std::nullopt;
+	}
+
+	size_t status_start = headers.find (' ');
+	if (status_start == std::string::npos) {
+		return std::nullopt;
+	}
+
+	Response ret;
+	try {
+		ret.status = std::stoi (headers.substr (status_start + 1, 3));
+	} catch (std::exception const&) {
+		return std::nullopt;
+	}
+
+	std::string lowercase_headers { headers };
+	std::transform (
+		lowercase_headers.begin (),
+		lowercase_headers.end (),
+		lowercase_headers.begin (),
+		[](char c) { return static_cast<char>(std::tolower (static_cast<unsigned char>(c))); }
+	);
+
+	auto header_value = [&lowercase_headers](std::string_view const& name) -> std::optional<std::string> {
+		std::string needle { "\r\n" };
+		needle.append (name).append (":");
+
+		size_t pos = lowercase_headers.find (needle);
+		if (pos == std::string::npos) {
+			return std::nullopt;
+		}
+
+		pos += needle.length ();
+		size_t end = lowercase_headers.find ("\r\n", pos);
+		std::string value = lowercase_headers.substr (pos, end == std::string::npos ? std::string::npos : end - pos);
+		value.erase (0, value.find_first_not_of (" \t"));
+		value.erase (value.find_last_not_of (" \t") + 1);
+		return value;
+	};
+
+	std::optional<std::string> transfer_encoding = header_value ("transfer-encoding");
+	if (transfer_encoding.has_value () && transfer_encoding.value () == "chunked") {
+		auto iter = body_start;
+		while (true) {
+			constexpr std::string_view crlf { "\r\n" };
+			auto size_end = std::search (iter, data.end (), crlf.begin (), crlf.end ());
+			if (size_end == data.end ()) {
+				return std::nullopt;
+			}
+
+			size_t chunk_size;
+			try {
+				chunk_size = std::stoul (std::string (iter, size_end), nullptr, 16);
+			} catch (std::exception const&) {
+				return std::nullopt;
+			}
+
+			iter = size_end + static_cast<ptrdiff_t>(crlf.length ());
+			if (chunk_size == 0) {
+				break;
+			}
+
+			if (static_cast<size_t>(data.end () - iter) < chunk_size + crlf.length ()) {
+				return std::nullopt;
+			}
+
+			ret.body.insert (ret.body.end (), iter, iter + static_cast<ptrdiff_t>(chunk_size));
+			iter += static_cast<ptrdiff_t>(chunk_size + crlf.length ());
+		}
+
+		return ret;
+	}
+
+	ret.body.assign (body_start, data.end ());
+
+	std::optional<std::string> content_length = header_value ("content-length");
+	if (content_length.has_value ()) {
+		try {
+			if (std::stoull (content_length.value ()) != ret.body.size ()) {
+				return std::nullopt; // truncated
+			}
+		} catch (std::exception const&) {
+			return std::nullopt;
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__HTTP_CLIENT_HH)
+#define __HTTP_CLIENT_HH
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace xamarin::android::gas
+{
+	// Minimal HTTP/1.1 client, supporting only plain `http://` URLs and the `GET` and `PUT` methods.  Every request
+	// uses a new connection (`Connection: close`) and is bounded by the timeout passed to the constructor.  All the
+	// failures (name resolution, connection, timeouts, malformed responses) are reported by returning an empty
+	// response, callers are expected to fall back to doing the work locally.
+	class HttpClient final
+	{
+	public:
+		using byte_buffer = std::vector<uint8_t>;
+
+		struct Response
+		{
+			int         status = 0;
+			byte_buffer body;
+		};
+
+	public:
+		HttpClient (std::string host, std::string port, std::string path_prefix, std::chrono::milliseconds timeout)
+			: host (std::move (host)),
+			  port (std::move (port)),
+			  path_prefix (std::move (path_prefix)),
+			  timeout (timeout)
+		{}
+
+		// Accepts URLs of the form `http://host[:port][/path/prefix]`
+		static std::optional<HttpClient> from_url (std::string const& url, std::chrono::milliseconds timeout);
+
+		std::optional<Response> get (std::string const& path) const
+		{
+			return request ("GET", path, nullptr);
+		}
+
+		std::optional<Response> put (std::string const& path, byte_buffer const& body) const
+		{
+			return request ("PUT", path, &body);
+		}
+
+	private:
+		std::optional<Response> request (std::string const& method, std::string const& path, byte_buffer const* body) const;
+		static std::optional<Response> parse_response (byte_buffer const& data);
+
+		// Platform-specific: connects, sends `request` and reads everything the server sends back until it closes
+		// the connection
+		std::optional<byte_buffer> transfer (byte_buffer const& request) const;
+
+	private:
+		std::string               host;
+		std::string               port;
+		std::string               path_prefix;
+		std::chrono::milliseconds timeout;
+	};
+}
+#endif // __HTTP_CLIENT_HH
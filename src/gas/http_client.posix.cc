@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: MIT
+#include <cerrno>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "gas.hh"
+#include "http_client.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+#if defined (MSG_NOSIGNAL)
+	constexpr int send_flags = MSG_NOSIGNAL;
+#else
+	constexpr int send_flags = 0;
+#endif
+
+	bool wait_for (int fd, short events, std::chrono::milliseconds timeout)
+	{
+		pollfd pfd {};
+		pfd.fd = fd;
+		pfd.events = events;
+
+		int ret;
+		do {
+			ret = poll (&pfd, 1, static_cast<int>(timeout.count ()));
+		} while (ret == -1 && errno == EINTR);
+
+		return ret == 1 && (pfd.revents & (events | POLLHUP)) != 0;
+	}
+
+	int connect_with_timeout (addrinfo const* address, std::chrono::milliseconds timeout)
+	{
+		int fd = socket (address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (fd == -1) {
+			return -1;
+		}
+
+#if defined (SO_NOSIGPIPE)
+		int one = 1;
+		setsockopt (fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof (one));
+#endif
+
+		int flags = fcntl (fd, F_GETFL, 0);
+		if (flags == -1 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+			close (fd);
+			return -1;
+		}
+
+		if (connect (fd, address->ai_addr, address->ai_addrlen) == 0) {
+			return fd;
+		}
+
+		if (errno != EINPROGRESS || !wait_for (fd, POLLOUT, timeout)) {
+			close (fd);
+			return -1;
+		}
+
+		int error = 0;
+		socklen_t error_size = sizeof (error);
+		if (getsockopt (fd, SOL_SOCKET, SO_ERROR, &error, &error_size) == -1 || error != 0) {
+			close (fd);
+			return -1;
+		}
+
+		return fd;
+	}
+}
+
+std::optional<HttpClient::byte_buffer> HttpClient::transfer (byte_buffer const& request) const
+{
+	addrinfo hints {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo *addresses = nullptr;
+	if (getaddrinfo (host.c_str (), port.c_str (), &hints, &addresses) != 0) {
+		return std::nullopt;
+	}
+
+	int fd = -1;
+	for (addrinfo *address = addresses; address != nullptr && fd == -1; address = address->ai_next) {
+		fd = connect_with_timeout (address, timeout);
+	}
+	freeaddrinfo (addresses);
+
+	if (fd == -1) {
+		return std::nullopt;
+	}
+
+	ScopeGuard close_socket {
+		[fd]() -> void {
+			close (fd);
+		}
+	};
+
+	size_t sent = 0;
+	while (sent < request.size ()) {
+		if (!wait_for (fd, POLLOUT, timeout)) {
+			return std::nullopt;
+		}
+
+		ssize_t n = send (fd, request.data () + sent, request.size () - sent, send_flags);
+		if (n == -1) {
+			if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+				continue;
+			}
+			return std::nullopt;
+		}
+		sent += static_cast<size_t>(n);
+	}
+
+	byte_buffer response;
+	uint8_t buffer[64 * 1024];
+	while (true) {
+		if (!wait_for (fd, POLLIN, timeout)) {
+			return std::nullopt;
+		}
+
+		ssize_t n = recv (fd, buffer, sizeof (buffer), 0);
+		if (n == 0) {
+			break;
+		}
+
+		if (n == -1) {
+			if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+				continue;
+			}
+			return std::nullopt;
+		}
+
+		response.insert (response.end (), buffer, buffer + n);
+	}
+
+	return response;
+}
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: MIT
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <mutex>
+
+#include "gas.hh"
+#include "http_client.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	bool winsock_ready ()
+	{
+		static std::once_flag init_flag;
+		static bool initialized = false;
+
+		std::call_once (
+			init_flag,
+			[]() {
+				WSADATA wsa_data;
+				initialized = WSAStartup (MAKEWORD (2, 2), &wsa_data) == 0;
+			}
+		);
+
+		return initialized;
+	}
+
+	bool wait_for (SOCKET s, SHORT events, std::chrono::milliseconds timeout)
+	{
+		WSAPOLLFD pfd {};
+		pfd.fd = s;
+		pfd.events = events;
+
+		int ret = WSAPoll (&pfd, 1, static_cast<INT>(timeout.count ()));
+		return ret == 1 && (pfd.revents & (events | POLLHUP)) != 0;
+	}
+
+	SOCKET connect_with_timeout (addrinfo const* address, std::chrono::milliseconds timeout)
+	{
+		SOCKET s = socket (address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (s == INVALID_SOCKET) {
+			return INVALID_SOCKET;
+		}
+
+		u_long non_blocking = 1;
+		if (ioctlsocket (s, FIONBIO, &non_blocking) != 0) {
+			closesocket (s);
+			return INVALID_SOCKET;
+		}
+
+		if (connect (s, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0) {
+			return s;
+		}
+
+		if (WSAGetLastError () != WSAEWOULDBLOCK || !wait_for (s, POLLWRNORM, timeout)) {
+			closesocket (s);
+			return INVALID_SOCKET;
+		}
+
+		int error = 0;
+		int error_size = sizeof (error);
+		if (getsockopt (s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &error_size) != 0 || error != 0) {
+			closesocket (s);
+			return INVALID_SOCKET;
+		}
+
+		return s;
+	}
+}
+
+std::optional<HttpClient::byte_buffer> HttpClient::transfer (byte_buffer const& request) const
+{
+	if (!winsock_ready ()) {
+		return std::nullopt;
+	}
+
+	addrinfo hints {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo *addresses = nullptr;
+	if (getaddrinfo (host.c_str (), port.c_str (), &hints, &addresses) != 0) {
+		return std::nullopt;
+	}
+
+	SOCKET s = INVALID_SOCKET;
+	for (addrinfo *address = addresses; address != nullptr && s == INVALID_SOCKET; address = address->ai_next) {
+		s = connect_with_timeout (address, timeout);
+	}
+	freeaddrinfo (addresses);
+
+	if (s == INVALID_SOCKET) {
+		return std::nullopt;
+	}
+
+	ScopeGuard close_socket {
+		[s]() -> void {
+			closesocket (s);
+		}
+	};
+
+	size_t sent = 0;
+	while (sent < request.size ()) {
+		if (!wait_for (s, POLLWRNORM, timeout)) {
+			return std::nullopt;
+		}
+
+		int n = send (s, reinterpret_cast<char const*>(request.data () + sent), static_cast<int>(request.size () - sent), 0);
+		if (n == SOCKET_ERROR) {
+			if (WSAGetLastError () == WSAEWOULDBLOCK) {
+				continue;
+			}
+			return std::nullopt;
+		}
+		sent += static_cast<size_t>(n);
+	}
+
+	byte_buffer response;
+	char buffer[64 * 1024];
+	while (true) {
+		if (!wait_for (s, POLLRDNORM, timeout)) {
+			return std::nullopt;
+		}
+
+		int n = recv (s, buffer, sizeof (buffer), 0);
+		if (n == 0) {
+			break;
+		}
+
+		if (n == SOCKET_ERROR) {
+			if (WSAGetLastError () == WSAEWOULDBLOCK) {
+				continue;
+			}
+			return std::nullopt;
+		}
+
+		response.insert (response.end (), buffer, buffer + n);
+	}
+
+	return response;
+}
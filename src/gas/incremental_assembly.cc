@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: MIT
+#include <fstream>
+#include <unordered_set>
+
+#include "exceptions.hh"
+#include "file_utils.hh"
+#include "incremental_assembly.hh"
+#include "input_stream.hh"
+#include "json_writer.hh"
+#include "sha256.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	std::string to_utf8 (fs::path const& path)
+	{
+		std::u8string s = path.u8string ();
+		return { s.begin (), s.end () };
+	}
+
+	void check_input (InputStream const& input, fs::path const& input_file)
+	{
+		if (input.error ().empty () && !input.bad ()) {
+			return;
+		}
+
+		std::string message { "Failed to read input file " };
+		message.append (input_file.string ());
+		if (!input.error ().empty ()) {
+			message.append (". ");
+			message.append (input.error ());
+		}
+		throw invalid_operation_error { message };
+	}
+}
+
+IncrementalAssembly::IncrementalAssembly (fs::path const& input_file, fs::path const& output_file, TargetArchitecture arch, size_t hash_size)
+	: input_file (input_file),
+	  target_arch (arch),
+	  hash_size (hash_size)
+{
+	_cache_dir = output_file;
+	_cache_dir += PSTR(".chunks");
+}
+
+IncrementalAssembly::~IncrementalAssembly ()
+{
+	for (fs::path const& path : temporary_files) {
+		std::error_code ec;
+		fs::remove (path, ec);
+	}
+}
+
+fs::path IncrementalAssembly::object_path (std::string const& key) const
+{
+	return _cache_dir / (key + ".o");
+}
+
+void IncrementalAssembly::prepare (Process const& process, std::string_view const& input_transform)
+{
+	std::error_code ec;
+	fs::create_directories (_cache_dir, ec);
+	if (ec) {
+		std::string message { "Unable to create chunk cache directory " };
+		message.append (_cache_dir.string ()).append (". ").append (ec.message ());
+		throw invalid_operation_error { message };
+	}
+
+	ChunkSplitter splitter { target_arch, hash_size };
+	{
+		std::unique_ptr<InputStream> input = InputStream::open (input_file);
+		splitter.analyze (*input);
+		check_input (*input, input_file);
+	}
+	chunks = splitter.chunks ();
+
+	// Like the remote cache keys, the output and input names don't matter unless they're part of the debug info
+	bool has_debug_info = false;
+	Sha256 common_hash;
+	auto add_line = [](Sha256 &sha, std::string_view const& line) {
+		sha.update (line);
+		sha.update ("\n");
+	};
+
+	add_line (common_hash, key_format_version);
+	add_line (common_hash, XA_UTILS_VERSION);
+	add_line (common_hash, LLVM_VERSION);
+	for (platform::string const& arg : process.args ()) {
+		std::string utf8_arg = to_utf8 (fs::path { arg });
+		if (utf8_arg == "-" || utf8_arg.starts_with ("-o=") || utf8_arg.starts_with ("--main-file-name=")) {
+			continue;
+		}
+
+		if (utf8_arg == "-g") {
+			has_debug_info = true;
+		}
+		add_line (common_hash, utf8_arg);
+	}
+	add_line (common_hash, input_transform);
+
+	if (has_debug_info) {
+		add_line (common_hash, to_utf8 (fs::current_path ()));
+		add_line (common_hash, to_utf8 (input_file));
+	}
+
+	// Forward slashes work everywhere and need no escaping in the line markers
+	std::u8string const generic_name = input_file.generic_u8string ();
+	std::string const source_name { generic_name.begin (), generic_name.end () };
+
+	// First pass over the chunks computes their keys, the second one writes out only the ones not in the cache
+	keys.clear ();
+	Sha256 chunk_hash;
+	bool hashed = false;
+	{
+		std::unique_ptr<InputStream> input = InputStream::open (input_file);
+		hashed = splitter.write_chunks (
+			*input,
+			source_name,
+			[&](size_t, ChunkSplitter::ChunkPart part, std::string_view const& text) -> bool {
+				switch (part) {
+					case ChunkSplitter::ChunkPart::Begin:
+						chunk_hash = common_hash;
+						break;
+
+					case ChunkSplitter::ChunkPart::LineMarker:
+						// Line numbers matter only for the debug info, without it chunks can move around freely
+						if (has_debug_info) {
+							chunk_hash.update (text);
+						}
+						break;
+
+					case ChunkSplitter::ChunkPart::Prologue:
+					case ChunkSplitter::ChunkPart::Source:
+						chunk_hash.update (text);
+						break;
+
+					case ChunkSplitter::ChunkPart::End:
+						keys.push_back (chunk_hash.finish_hex ());
+						break;
+				}
+				return true;
+			}
+		);
+		check_input (*input, input_file);
+	}
+
+	if (!hashed || keys.size () != chunks.size ()) {
+		std::string message { "Failed to split input file " };
+		message.append (input_file.string ()).append (" into chunks");
+		throw invalid_operation_error { message };
+	}
+
+	pending.clear ();
+	for (size_t i = 0; i < chunks.size (); i++) {
+		// Chunks including other files are always assembled, the key doesn't cover their contents
+		if (chunks[i].cacheable && fs::exists (object_path (keys[i]))) {
+			continue;
+		}
+
+		fs::path source_file = _cache_dir / (keys[i] + ".s");
+		fs::path object_file = FileUtils::make_temporary_path (object_path (keys[i]));
+		temporary_files.push_back (source_file);
+		temporary_files.push_back (object_file);
+		pending.push_back ({ i, source_file, object_file, chunks[i].size });
+	}
+
+	if (pending.empty ()) {
+		return;
+	}
+
+	std::unique_ptr<InputStream> input = InputStream::open (input_file);
+	std::ofstream out;
+	auto next_pending = pending.begin ();
+	bool written = splitter.write_chunks (
+		*input,
+		source_name,
+		[&](size_t chunk, ChunkSplitter::ChunkPart part, std::string_view const& text) -> bool {
+			if (next_pending == pending.end () || next_pending->index != chunk) {
+				return true;
+			}
+
+			switch (part) {
+				case ChunkSplitter::ChunkPart::Begin:
+					out.open (next_pending->source_file, std::ios::binary | std::ios::trunc);
+					break;
+
+				case ChunkSplitter::ChunkPart::End:
+					out.close ();
+					next_pending++;
+					return !out.fail ();
+
+				default:
+					out.write (text.data (), static_cast<std::streamsize>(text.length ()));
+					break;
+			}
+			return out.good ();
+		}
+	);
+	check_input (*input, input_file);
+
+	if (!written) {
+		std::string message { "Failed to write chunk source to " };
+		message.append (_cache_dir.string ());
+		throw invalid_operation_error { message };
+	}
+}
+
+void IncrementalAssembly::commit ()
+{
+	for (PendingChunk const& chunk : pending) {
+		fs::rename (chunk.object_file, object_path (keys[chunk.index]));
+	}
+
+	write_manifest ();
+	remove_stale_files ();
+}
+
+std::vector<fs::path> IncrementalAssembly::object_files () const
+{
+	std::vector<fs::path> ret;
+	for (std::string const& key : keys) {
+		ret.push_back (object_path (key));
+	}
+
+	return ret;
+}
+
+void IncrementalAssembly::write_manifest () const
+{
+	JsonWriter json;
+	json.begin_object ();
+	json.key ("version");
+	json.value (uint64_t { 1 });
+	json.key ("input");
+	json.value (to_utf8 (input_file));
+	json.key ("chunks");
+	json.begin_array ();
+	for (size_t i = 0; i < chunks.size (); i++) {
+		json.begin_object ();
+		json.key ("first_line");
+		json.value (chunks[i].first_line);
+		json.key ("lines");
+		json.value (chunks[i].line_count);
+		json.key ("size");
+		json.value (chunks[i].size);
+		json.key ("key");
+		json.value (keys[i]);
+		json.end_object ();
+	}
+	json.end_array ();
+	json.end_object ();
+
+	fs::path manifest = _cache_dir / manifest_name;
+	fs::path temporary_manifest = FileUtils::make_temporary_path (manifest);
+	{
+		std::ofstream os { temporary_manifest, std::ios::binary };
+		if (!os) {
+			std::string message { "Unable to open " };
+			message.append (temporary_manifest.string ());
+			message.append (" for writing");
+			throw invalid_operation_error { message };
+		}
+
+		os.write (json.str ().data (), static_cast<std::streamsize>(json.str ().length ()));
+		os.write ("\n", 1);
+	}
+	fs::rename (temporary_manifest, manifest);
+}
+
+void IncrementalAssembly::remove_stale_files () const
+{
+	std::unordered_set<std::string> live_keys { keys.begin (), keys.end () };
+
+	std::error_code ec;
+	for (fs::directory_entry const& entry : fs::directory_iterator { _cache_dir, ec }) {
+		fs::path const& path = entry.path ();
+		if (path.extension () != PSTR(".o") && path.extension () != PSTR(".s")) {
+			continue;
+		}
+
+		if (live_keys.contains (path.stem ().string ()) && path.extension () == PSTR(".o")) {
+			continue;
+		}
+
+		std::error_code remove_ec;
+		fs::remove (path, remove_ec);
+	}
+}
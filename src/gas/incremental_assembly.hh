@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__INCREMENTAL_ASSEMBLY_HH)
+#define __INCREMENTAL_ASSEMBLY_HH
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chunk_splitter.hh"
+#include "constants.hh"
+#include "gas.hh"
+#include "process.hh"
+
+namespace xamarin::android::gas
+{
+	// `--incremental`: the input is split into chunks (see `ChunkSplitter`) whose objects are kept in a cache
+	// directory next to the output file, `<output>.chunks/<key>.o`.  The key of a chunk is the SHA-256 of its source
+	// (with the prologue), the normalized `llvm-mc` arguments and the toolchain versions, so only the chunks which
+	// changed since the previous run need to be assembled before all of them are merged with `ld -r`.  The cache
+	// directory also holds `manifest.json`, describing the chunk layout of the last run.  Objects no longer in the
+	// manifest are removed, the cache never holds more than one build's worth of them.
+	class IncrementalAssembly final
+	{
+		static constexpr std::string_view key_format_version { "xa-gas-chunk-cache-v1" };
+		static constexpr std::string_view manifest_name { "manifest.json" };
+
+	public:
+		struct PendingChunk
+		{
+			size_t   index;
+			fs::path source_file; // the chunk's source, with its prologue
+			fs::path object_file; // temporary, moved into the cache by `commit`
+			uint64_t size;
+		};
+
+	public:
+		IncrementalAssembly (fs::path const& input_file, fs::path const& output_file, TargetArchitecture arch, size_t hash_size);
+		~IncrementalAssembly ();
+
+		IncrementalAssembly (IncrementalAssembly const&) = delete;
+		IncrementalAssembly& operator= (IncrementalAssembly const&) = delete;
+
+		// Splits the input and writes the source of every chunk which isn't in the cache.  `process` is the
+		// `llvm-mc` invocation assembling the whole input from stdin, its arguments are part of the chunk keys.
+		// `input_transform` names the transformation applied to each chunk before it's assembled, if any.  Throws
+		// `invalid_operation_error` on failure.
+		void prepare (Process const& process, std::string_view const& input_transform);
+
+		std::vector<PendingChunk> const& pending_chunks () const noexcept
+		{
+			return pending;
+		}
+
+		// Once all the pending chunks are assembled, moves their objects into the cache, writes the manifest and
+		// removes the objects of chunks which no longer exist
+		void commit ();
+
+		// Objects of all the chunks, in the order of the input
+		std::vector<fs::path> object_files () const;
+
+		size_t chunk_count () const noexcept
+		{
+			return chunks.size ();
+		}
+
+		fs::path const& cache_dir () const noexcept
+		{
+			return _cache_dir;
+		}
+
+	private:
+		fs::path object_path (std::string const& key) const;
+		void write_manifest () const;
+		void remove_stale_files () const;
+
+	private:
+		fs::path const                    input_file;
+		TargetArchitecture const          target_arch;
+		size_t const                      hash_size;
+		fs::path                          _cache_dir;
+		std::vector<ChunkSplitter::Chunk> chunks;
+		std::vector<std::string>          keys;
+		std::vector<PendingChunk>         pending;
+		std::vector<fs::path>             temporary_files; // removed by the destructor, unless moved into the cache
+	};
+}
+#endif // __INCREMENTAL_ASSEMBLY_HH
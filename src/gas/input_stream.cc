@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: MIT
+#if defined (_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include <zstd.h>
+
+#include "exceptions.hh"
+#include "gzip_decoder.hh"
+#include "input_stream.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr std::string_view gzip_magic { "\x1f\x8b" };
+	constexpr std::string_view zstd_magic { "\x28\xb5\x2f\xfd" };
+	constexpr size_t magic_size = 4;
+	constexpr size_t decompressor_buffer_size = 256 * 1024;
+}
+
+// Reads raw data from `source` (after the already consumed `prefix`) and produces the decompressed data in chunks,
+// as the stream needs it
+class InputStream::Decompressor : public std::streambuf
+{
+public:
+	Decompressor (std::streambuf *source, std::string prefix)
+		: source (source),
+		  prefix (std::move (prefix)),
+		  output (decompressor_buffer_size)
+	{}
+
+	std::string const& error () const noexcept
+	{
+		return _error;
+	}
+
+protected:
+	int_type underflow () override
+	{
+		if (gptr () < egptr ()) {
+			return traits_type::to_int_type (*gptr ());
+		}
+
+		size_t size = _error.empty () ? decompress (output.data (), output.size ()) : 0;
+		if (size == 0) {
+			return traits_type::eof ();
+		}
+
+		setg (output.data (), output.data (), output.data () + size);
+		return traits_type::to_int_type (*gptr ());
+	}
+
+	// Returns the number of bytes stored in `buffer`, 0 at the end of data or on error
+	virtual size_t decompress (char *buffer, size_t size) = 0;
+
+	size_t read_source (char *buffer, size_t size)
+	{
+		size_t nread = 0;
+		if (prefix_pos < prefix.size ()) {
+			nread = std::min (size, prefix.size () - prefix_pos);
+			prefix.copy (buffer, nread, prefix_pos);
+			prefix_pos += nread;
+		}
+
+		if (nread < size) {
+			nread += static_cast<size_t>(source->sgetn (buffer + nread, static_cast<std::streamsize>(size - nread)));
+		}
+
+		return nread;
+	}
+
+	size_t fail (std::string message)
+	{
+		_error = std::move (message);
+		return 0;
+	}
+
+private:
+	std::streambuf   *source;
+	std::string       prefix;
+	size_t            prefix_pos = 0;
+	std::vector<char> output;
+	std::string       _error;
+};
+
+namespace {
+	// Used for uncompressed stdin, to replay the bytes consumed while detecting compression
+	class PassthroughDecompressor final : public InputStream::Decompressor
+	{
+	public:
+		using Decompressor::Decompressor;
+
+	protected:
+		size_t decompress (char *buffer, size_t size) override
+		{
+			return read_source (buffer, size);
+		}
+	};
+
+	class GzipDecompressor final : public InputStream::Decompressor
+	{
+	public:
+		GzipDecompressor (std::streambuf *source, std::string prefix)
+			: Decompressor (source, std::move (prefix)),
+			  decoder ([this](char *buffer, size_t size) { return read_source (buffer, size); })
+		{}
+
+	protected:
+		size_t decompress (char *buffer, size_t size) override
+		{
+			try {
+				return decoder.read (buffer, size);
+			} catch (invalid_operation_error const& ex) {
+				return fail (ex.what ());
+			}
+		}
+
+	private:
+		GzipDecoder decoder;
+	};
+
+	class ZstdDecompressor final : public InputStream::Decompressor
+	{
+	public:
+		ZstdDecompressor (std::streambuf *source, std::string prefix)
+			: Decompressor (source, std::move (prefix)),
+			  input (ZSTD_DStreamInSize ())
+		{
+			stream = ZSTD_createDStream ();
+			if (stream == nullptr) {
+				throw invalid_operation_error { "Failed to initialize zstd" };
+			}
+			ZSTD_initDStream (stream);
+		}
+
+		~ZstdDecompressor () override
+		{
+			ZSTD_freeDStream (stream);
+		}
+
+	protected:
+		size_t decompress (char *buffer, size_t size) override
+		{
+			ZSTD_outBuffer out { buffer, size, 0 };
+
+			while (out.pos == 0) {
+				if (in.pos == in.size && !source_exhausted) {
+					size_t nread = read_source (input.data (), input.size ());
+					source_exhausted = nread == 0;
+					in = { input.data (), nread, 0 };
+				}
+
+				// Called even when all the input is consumed, the decompressor may still have buffered output
+				size_t consumed = in.pos;
+				size_t ret = ZSTD_decompressStream (stream, &out, &in);
+				if (ZSTD_isError (ret)) {
+					return fail (std::string { "Invalid zstd data: " } + ZSTD_getErrorName (ret));
+				}
+
+				if (out.pos == 0 && source_exhausted && in.pos == consumed) {
+					return frame_complete ? 0 : fail ("Unexpected end of zstd data");
+				}
+
+				// 0 means the frame was completely decoded and flushed
+				frame_complete = ret == 0;
+			}
+
+			return out.pos;
+		}
+
+	private:
+		ZSTD_DStream     *stream;
+		std::vector<char> input;
+		ZSTD_inBuffer     in { nullptr, 0, 0 };
+		bool              source_exhausted = false;
+		bool              frame_complete = false;
+	};
+}
+
+InputStream::InputStream (InputCompression compression)
+	: std::istream (nullptr),
+	  _compression (compression)
+{}
+
+InputStream::~InputStream ()
+{}
+
+std::string const& InputStream::error () const noexcept
+{
+	static std::string const no_error;
+
+	return decompressor ? decompressor->error () : no_error;
+}
+
+InputCompression InputStream::detect_compression (std::string_view const& magic) noexcept
+{
+	if (magic.starts_with (gzip_magic)) {
+		return InputCompression::Gzip;
+	}
+
+	if (magic.starts_with (zstd_magic)) {
+		return InputCompression::Zstd;
+	}
+
+	return InputCompression::None;
+}
+
+InputCompression InputStream::detect_compression (fs::path const& path)
+{
+	if (is_stdin (path)) {
+		return InputCompression::None;
+	}
+
+	fs::path extension = path.extension ();
+	if (extension == PSTR(".gz")) {
+		return InputCompression::Gzip;
+	}
+
+	if (extension == PSTR(".zst")) {
+		return InputCompression::Zstd;
+	}
+
+	std::ifstream is { path, std::ios::binary };
+	char magic[magic_size] {};
+	is.read (magic, sizeof (magic));
+	return detect_compression (std::string_view { magic, static_cast<size_t>(is.gcount ()) });
+}
+
+std::unique_ptr<InputStream::Decompressor> InputStream::make_decompressor (InputCompression compression, std::streambuf *source, std::string prefix)
+{
+	switch (compression) {
+		case InputCompression::None:
+			return std::make_unique<PassthroughDecompressor> (source, std::move (prefix));
+
+		case InputCompression::Gzip:
+			return std::make_unique<GzipDecompressor> (source, std::move (prefix));
+
+		case InputCompression::Zstd:
+			return std::make_unique<ZstdDecompressor> (source, std::move (prefix));
+	}
+
+	return nullptr;
+}
+
+std::unique_ptr<InputStream> InputStream::open (fs::path const& path)
+{
+	if (is_stdin (path)) {
+#if defined (_WIN32)
+		_setmode (_fileno (stdin), _O_BINARY);
+#endif
+		// The magic number is read before we know whether the input is compressed, the decompressor will see it
+		// again
+		std::streambuf *source = std::cin.rdbuf ();
+		std::string prefix (magic_size, '\0');
+		prefix.resize (static_cast<size_t>(source->sgetn (prefix.data (), static_cast<std::streamsize>(prefix.size ()))));
+
+		InputCompression compression = detect_compression (std::string_view { prefix });
+		std::unique_ptr<InputStream> ret { new InputStream (compression) };
+		ret->decompressor = make_decompressor (compression, source, std::move (prefix));
+		ret->rdbuf (ret->decompressor.get ());
+		return ret;
+	}
+
+	InputCompression compression = detect_compression (path);
+	std::unique_ptr<InputStream> ret { new InputStream (compression) };
+	ret->file.open (path, std::ios::binary);
+	if (!ret->file) {
+		throw invalid_operation_error { "Unable to open input file " + path.string () };
+	}
+
+	if (compression == InputCompression::None) {
+		ret->rdbuf (ret->file.rdbuf ());
+	} else {
+		ret->decompressor = make_decompressor (compression, ret->file.rdbuf (), {});
+		ret->rdbuf (ret->decompressor.get ());
+	}
+
+	return ret;
+}
+
+bool InputStream::copy_to (Process::input_write_fn const& write)
+{
+	std::vector<char> buffer (copy_buffer_size);
+	while (*this) {
+		read (buffer.data (), static_cast<std::streamsize>(buffer.size ()));
+		size_t nread = static_cast<size_t>(gcount ());
+		if (nread > 0 && !write (buffer.data (), nread)) {
+			return false;
+		}
+	}
+
+	return !bad () && error ().empty ();
+}
+
+uintmax_t InputStream::decompressed_size (fs::path const& path)
+{
+	if (is_stdin (path)) {
+		return 0;
+	}
+
+	std::error_code ec;
+	uintmax_t file_size = fs::file_size (path, ec);
+	if (ec) {
+		return 0;
+	}
+
+	InputCompression compression = detect_compression (path);
+	if (compression == InputCompression::None) {
+		return file_size;
+	}
+
+	std::ifstream is { path, std::ios::binary };
+	if (compression == InputCompression::Gzip && file_size >= 18) {
+		// The trailer of the (last) gzip member stores the uncompressed size modulo 2^32
+		uint8_t isize[4] {};
+		is.seekg (-4, std::ios::end);
+		is.read (reinterpret_cast<char*>(isize), sizeof (isize));
+		uintmax_t size = static_cast<uintmax_t>(isize[0]) | (static_cast<uintmax_t>(isize[1]) << 8) |
+			(static_cast<uintmax_t>(isize[2]) << 16) | (static_cast<uintmax_t>(isize[3]) << 24);
+		if (is && size >= file_size) {
+			return size;
+		}
+	}
+
+	if (compression == InputCompression::Zstd) {
+		// The frame header (at most 18 bytes) may record the content size
+		char header[18] {};
+		is.read (header, sizeof (header));
+		unsigned long long size = ZSTD_getFrameContentSize (header, static_cast<size_t>(is.gcount ()));
+		if (size != ZSTD_CONTENTSIZE_UNKNOWN && size != ZSTD_CONTENTSIZE_ERROR) {
+			return static_cast<uintmax_t>(size);
+		}
+	}
+
+	return file_size * typical_compression_ratio;
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__INPUT_STREAM_HH)
+#define __INPUT_STREAM_HH
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "gas.hh"
+#include "process.hh"
+
+namespace xamarin::android::gas
+{
+	enum class InputCompression
+	{
+		None,
+		Gzip,
+		Zstd,
+	};
+
+	// Assembler source, read from a file or from stdin (`-`).  Inputs compressed with gzip or zstd (recognized by the
+	// `.gz` and `.zst` extensions or by their magic numbers) are decompressed on the fly as they are read, the
+	// decompressed text is never written anywhere.  Decompression errors end the input early, `error ()` then
+	// describes what went wrong.
+	class InputStream final : public std::istream
+	{
+		static constexpr size_t copy_buffer_size = 256 * 1024;
+
+		// Used to estimate the decompressed size when the compressed data doesn't record it
+		static constexpr uintmax_t typical_compression_ratio = 8;
+
+	public:
+		// Source of the decompressed data, defined in `input_stream.cc`
+		class Decompressor;
+
+		static constexpr platform::string_view stdin_name { PSTR("-") };
+
+		~InputStream () override;
+
+		// Throws `invalid_operation_error` if the input cannot be opened
+		static std::unique_ptr<InputStream> open (fs::path const& path);
+
+		static bool is_stdin (fs::path const& path) noexcept
+		{
+			return path.native () == stdin_name;
+		}
+
+		// Compression of stdin can only be detected by `open`, since it requires reading from it
+		static InputCompression detect_compression (fs::path const& path);
+
+		// Size of the decompressed input, exact if the compressed data records it, estimated otherwise.  Returns 0
+		// if the size is unknown (e.g. for stdin).
+		static uintmax_t decompressed_size (fs::path const& path);
+
+		InputCompression compression () const noexcept
+		{
+			return _compression;
+		}
+
+		std::string const& error () const noexcept;
+
+		// Writes the rest of the (decompressed) input with `write`, returns `false` on error
+		bool copy_to (Process::input_write_fn const& write);
+
+	private:
+		explicit InputStream (InputCompression compression);
+
+		static InputCompression detect_compression (std::string_view const& magic) noexcept;
+		static std::unique_ptr<Decompressor> make_decompressor (InputCompression compression, std::streambuf *source, std::string prefix);
+
+	private:
+		InputCompression              _compression;
+		std::ifstream                 file;
+		std::unique_ptr<Decompressor> decompressor;
+	};
+}
+#endif // __INPUT_STREAM_HH
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <thread>
+
+#include "job_scheduler.hh"
+
+using namespace xamarin::android::gas;
+
+int JobScheduler::run (std::vector<Job> &jobs, JobRunner const& runner)
+{
+	// Largest inputs take the longest to assemble, starting them first shortens the total wall clock time
+	std::stable_sort (
+		jobs.begin (),
+		jobs.end (),
+		[](Job const& a, Job const& b) -> bool { return a.input_size > b.input_size; }
+	);
+
+	if (memory_budget == 0) {
+		std::optional<uint64_t> available = get_available_memory ();
+		if (available.has_value ()) {
+			memory_budget = static_cast<uint64_t>(static_cast<double>(available.value ()) * memory_budget_ratio);
+		}
+	}
+
+	std::vector<std::thread> threads;
+	int result = 0;
+	size_t next_job = 0;
+
+	std::unique_lock<std::mutex> lock (state_lock);
+	while (next_job < jobs.size () && result == 0) {
+		Job &job = jobs[next_job];
+		if (!can_admit (job)) {
+			// Woken up either when a job finishes or periodically, to re-check memory pressure
+			job_finished.wait_for (lock, pressure_poll_interval);
+			continue;
+		}
+
+		uint64_t estimate = estimate_memory (job);
+		reserved_memory += estimate;
+		running_jobs++;
+		next_job++;
+
+		threads.emplace_back (
+			[this, &job, &runner, &result, estimate] () {
+				int ret = runner ? runner (job) : job.process->run ();
+
+				std::lock_guard<std::mutex> job_lock (state_lock);
+				reserved_memory -= estimate;
+				running_jobs--;
+				record_peak_rss (job);
+				if (ret != 0 && result == 0) {
+					result = ret;
+				}
+				job_finished.notify_all ();
+			}
+		);
+	}
+	lock.unlock ();
+
+	for (std::thread &t : threads) {
+		t.join ();
+	}
+
+	return result;
+}
+
+uint64_t JobScheduler::estimate_memory (Job const& job) const noexcept
+{
+	return base_job_memory + static_cast<uint64_t>(static_cast<double>(job.input_size) * bytes_per_input_byte);
+}
+
+void JobScheduler::record_peak_rss (Job const& job) noexcept
+{
+	uint64_t peak_rss = job.process->peak_rss ();
+	if (peak_rss == 0 || job.input_size == 0) {
+		return;
+	}
+
+	uint64_t input_dependent_rss = peak_rss > base_job_memory ? peak_rss - base_job_memory : 0;
+
+	// Leave some headroom, peak RSS isn't exactly linear in the input size
+	double observed = (static_cast<double>(input_dependent_rss) / static_cast<double>(job.input_size)) * 1.1;
+	if (!have_rss_history) {
+		// Real data beats our guess, regardless of which one is bigger
+		bytes_per_input_byte = observed;
+		have_rss_history = true;
+	} else {
+		bytes_per_input_byte = std::max (bytes_per_input_byte, observed);
+	}
+}
+
+bool JobScheduler::can_admit (Job const& job) const
+{
+	if (running_jobs >= max_jobs) {
+		return false;
+	}
+
+	// Always make progress, even if a single job is expected to exceed the budget
+	if (running_jobs == 0) {
+		return true;
+	}
+
+	if (memory_budget > 0 && reserved_memory + estimate_memory (job) > memory_budget) {
+		return false;
+	}
+
+	std::optional<double> pressure = get_memory_pressure ();
+	if (pressure.has_value () && pressure.value () > memory_pressure_threshold) {
+		return false;
+	}
+
+	return true;
+}
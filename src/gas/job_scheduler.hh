@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__JOB_SCHEDULER_HH)
+#define __JOB_SCHEDULER_HH
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "gas.hh"
+#include "process.hh"
+
+namespace xamarin::android::gas
+{
+	struct Job
+	{
+		fs::path                 input_file;
+		fs::path                 output_file;
+		uintmax_t                input_size = 0;
+		std::unique_ptr<Process> process;
+		bool                     input_from_stdin = false; // `process` expects the input to be fed to its stdin
+	};
+
+	// Runs assembler jobs concurrently, largest input first, admitting a new job only when the projected memory use of
+	// all the running jobs stays within the memory budget available to us.  `llvm-mc` peak RSS grows roughly linearly
+	// with the size of its input, so the memory needed by a job is estimated from the input size and the estimate is
+	// refined with the peak RSS of the jobs which have already finished.
+	class JobScheduler final
+	{
+		// Initial estimate of how many bytes of memory `llvm-mc` needs per byte of input
+		static constexpr double default_bytes_per_input_byte = 48.0;
+
+		// Memory used by `llvm-mc` regardless of the input size
+		static constexpr uint64_t base_job_memory = 32ULL * 1024 * 1024;
+
+		// Fraction of the available memory we allow our children to use
+		static constexpr double memory_budget_ratio = 0.8;
+
+		// If the `some avg10` memory pressure (percentage of time in the last 10s during which at least one task was
+		// stalled waiting for memory) exceeds this value, no new jobs are started until it drops below it again.
+		static constexpr double memory_pressure_threshold = 10.0;
+
+		// How often to re-check memory pressure while new jobs are held back
+		static constexpr std::chrono::milliseconds pressure_poll_interval { 250 };
+
+	public:
+		// Runs the job, returning its exit code.  The default runner simply runs the job's process.
+		using JobRunner = std::function<int(Job&)>;
+
+	public:
+		explicit JobScheduler (uint32_t max_jobs, uint64_t memory_budget = 0) noexcept
+			: max_jobs (max_jobs == 0 ? 1 : max_jobs),
+			  memory_budget (memory_budget)
+		{}
+
+		int run (std::vector<Job> &jobs, JobRunner const& runner = {});
+
+	private:
+		uint64_t estimate_memory (Job const& job) const noexcept;
+		void record_peak_rss (Job const& job) noexcept;
+		bool can_admit (Job const& job) const;
+
+		// Platform-specific, implemented in job_scheduler.{posix,windows}.cc
+
+		// Returns the amount of memory, in bytes, which can be used by new processes without causing the system (or
+		// the cgroup we run in) to start swapping or killing processes.  Empty if it cannot be determined.
+		static std::optional<uint64_t> get_available_memory ();
+
+		// Returns the current memory pressure, as a percentage, or empty if not supported by the OS.
+		static std::optional<double> get_memory_pressure ();
+
+	private:
+		uint32_t const          max_jobs;
+		uint64_t                memory_budget;
+		uint64_t                reserved_memory = 0;
+		uint32_t                running_jobs = 0;
+		double                  bytes_per_input_byte = default_bytes_per_input_byte;
+		bool                    have_rss_history = false;
+		std::mutex              state_lock;
+		std::condition_variable job_finished;
+	};
+}
+#endif // __JOB_SCHEDULER_HH
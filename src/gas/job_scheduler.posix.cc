@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <string>
+
+#include "job_scheduler.hh"
+
+using namespace xamarin::android::gas;
+
+#if defined (__linux__)
+namespace {
+	// Returns the value of a `memory.*` cgroup v2 file, empty if the file doesn't exist or the limit is `max`
+	std::optional<uint64_t> read_cgroup_value (fs::path const& file)
+	{
+		std::ifstream is { file };
+		std::string value;
+		if (!is || !(is >> value) || value == "max") {
+			return std::nullopt;
+		}
+
+		try {
+			return std::stoull (value);
+		} catch (std::exception const&) {
+			return std::nullopt;
+		}
+	}
+
+	// Finds the tightest `memory.max` limit among our cgroup and its ancestors, minus what's already in use there.
+	std::optional<uint64_t> get_cgroup_available_memory ()
+	{
+		std::ifstream is { "/proc/self/cgroup" };
+		std::string line;
+		fs::path cgroup_path;
+
+		while (std::getline (is, line)) {
+			// cgroup v2 entries have the form `0::/path/to/the/group`
+			if (line.starts_with ("0::")) {
+				cgroup_path = line.substr (3);
+				break;
+			}
+		}
+
+		if (cgroup_path.empty ()) {
+			return std::nullopt;
+		}
+
+		std::optional<uint64_t> ret;
+		fs::path const cgroup_root { "/sys/fs/cgroup" };
+		fs::path relative = cgroup_path.relative_path ();
+		while (true) {
+			fs::path dir = cgroup_root / relative;
+			std::optional<uint64_t> max = read_cgroup_value (dir / "memory.max");
+			if (max.has_value ()) {
+				uint64_t current = read_cgroup_value (dir / "memory.current").value_or (0);
+				uint64_t available = max.value () > current ? max.value () - current : 0;
+				if (!ret.has_value () || available < ret.value ()) {
+					ret = available;
+				}
+			}
+
+			if (relative.empty ()) {
+				break;
+			}
+			relative = relative.parent_path ();
+		}
+
+		return ret;
+	}
+
+	std::optional<uint64_t> get_system_available_memory ()
+	{
+		std::ifstream is { "/proc/meminfo" };
+		std::string name;
+		uint64_t value;
+		std::string unit;
+
+		while (is >> name >> value) {
+			std::getline (is, unit);
+			if (name == "MemAvailable:") {
+				return value * 1024; // reported in kB
+			}
+		}
+
+		return std::nullopt;
+	}
+}
+
+std::optional<uint64_t> JobScheduler::get_available_memory ()
+{
+	std::optional<uint64_t> system = get_system_available_memory ();
+	std::optional<uint64_t> cgroup = get_cgroup_available_memory ();
+
+	if (system.has_value () && cgroup.has_value ()) {
+		return std::min (system.value (), cgroup.value ());
+	}
+
+	return system.has_value () ? system : cgroup;
+}
+
+std::optional<double> JobScheduler::get_memory_pressure ()
+{
+	// Format: `some avg10=0.00 avg60=0.00 avg300=0.00 total=0`
+	std::ifstream is { "/proc/pressure/memory" };
+	std::string kind, avg10;
+	if (!is || !(is >> kind >> avg10) || kind != "some" || !avg10.starts_with ("avg10=")) {
+		return std::nullopt;
+	}
+
+	try {
+		return std::stod (avg10.substr (6));
+	} catch (std::exception const&) {
+		return std::nullopt;
+	}
+}
+#else // def __linux__
+std::optional<uint64_t> JobScheduler::get_available_memory ()
+{
+	return std::nullopt;
+}
+
+std::optional<double> JobScheduler::get_memory_pressure ()
+{
+	return std::nullopt;
+}
+#endif // ndef __linux__
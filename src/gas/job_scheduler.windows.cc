@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+#include <windows.h>
+
+#include "job_scheduler.hh"
+
+using namespace xamarin::android::gas;
+
+std::optional<uint64_t> JobScheduler::get_available_memory ()
+{
+	MEMORYSTATUSEX status {};
+	status.dwLength = sizeof (status);
+
+	if (!GlobalMemoryStatusEx (&status)) {
+		return std::nullopt;
+	}
+
+	return static_cast<uint64_t>(status.ullAvailPhys);
+}
+
+std::optional<double> JobScheduler::get_memory_pressure ()
+{
+	// Windows has no PSI equivalent
+	return std::nullopt;
+}
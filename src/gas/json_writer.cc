@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: MIT
+#include <array>
+#include <cstdio>
+
+#include "json_writer.hh"
+
+using namespace xamarin::android::gas;
+
+void JsonWriter::new_line ()
+{
+	out.push_back ('\n');
+	out.append (scope_empty.size () * 2, ' ');
+}
+
+void JsonWriter::begin_value ()
+{
+	if (after_key) {
+		after_key = false;
+		return;
+	}
+
+	if (scope_empty.empty ()) {
+		return;
+	}
+
+	if (!scope_empty.back ()) {
+		out.push_back (',');
+	}
+	scope_empty.back () = false;
+	new_line ();
+}
+
+void JsonWriter::end_scope (char closing)
+{
+	bool empty = scope_empty.back ();
+	scope_empty.pop_back ();
+	if (!empty) {
+		new_line ();
+	}
+	out.push_back (closing);
+
+	if (scope_empty.empty ()) {
+		out.push_back ('\n');
+	}
+}
+
+void JsonWriter::begin_object ()
+{
+	begin_value ();
+	out.push_back ('{');
+	scope_empty.push_back (true);
+}
+
+void JsonWriter::end_object ()
+{
+	end_scope ('}');
+}
+
+void JsonWriter::begin_array ()
+{
+	begin_value ();
+	out.push_back ('[');
+	scope_empty.push_back (true);
+}
+
+void JsonWriter::end_array ()
+{
+	end_scope (']');
+}
+
+void JsonWriter::key (std::string_view const& name)
+{
+	begin_value ();
+	append_quoted (name);
+	out.append (": ");
+	after_key = true;
+}
+
+void JsonWriter::value (std::string_view const& s)
+{
+	begin_value ();
+	append_quoted (s);
+}
+
+void JsonWriter::value (int64_t n)
+{
+	begin_value ();
+	out.append (std::to_string (n));
+}
+
+void JsonWriter::value (uint64_t n)
+{
+	begin_value ();
+	out.append (std::to_string (n));
+}
+
+void JsonWriter::value (double n)
+{
+	begin_value ();
+
+	std::array<char, 32> buffer;
+	int length = std::snprintf (buffer.data (), buffer.size (), "%.3f", n);
+	out.append (buffer.data (), static_cast<size_t>(length));
+}
+
+void JsonWriter::value (bool b)
+{
+	begin_value ();
+	out.append (b ? "true" : "false");
+}
+
+void JsonWriter::append_quoted (std::string_view const& s)
+{
+	constexpr char hex_digits[] = "0123456789abcdef";
+
+	out.push_back ('"');
+	for (char c : s) {
+		switch (c) {
+			case '"':  out.append ("\\\""); break;
+			case '\\': out.append ("\\\\"); break;
+			case '\n': out.append ("\\n"); break;
+			case '\r': out.append ("\\r"); break;
+			case '\t': out.append ("\\t"); break;
+
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					out.append ("\\u00");
+					out.push_back (hex_digits[(c >> 4) & 0x0f]);
+					out.push_back (hex_digits[c & 0x0f]);
+				} else {
+					out.push_back (c);
+				}
+				break;
+		}
+	}
+	out.push_back ('"');
+}
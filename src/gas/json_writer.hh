@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__JSON_WRITER_HH)
+#define __JSON_WRITER_HH
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace xamarin::android::gas
+{
+	// Builds an indented JSON document in memory.  Values inside objects must be preceded by `key`, the caller is
+	// responsible for the nesting being correct.  Strings must be UTF-8.
+	class JsonWriter final
+	{
+	public:
+		void begin_object ();
+		void end_object ();
+		void begin_array ();
+		void end_array ();
+		void key (std::string_view const& name);
+
+		void value (std::string_view const& s);
+		void value (char const* s)
+		{
+			value (std::string_view { s });
+		}
+
+		void value (int64_t n);
+		void value (uint64_t n);
+		void value (double n);
+		void value (bool b);
+
+		// The complete document, once the outermost object or array is closed
+		std::string const& str () const noexcept
+		{
+			return out;
+		}
+
+	private:
+		void begin_value ();
+		void end_scope (char closing);
+		void new_line ();
+		void append_quoted (std::string_view const& s);
+
+	private:
+		std::string       out;
+		std::vector<bool> scope_empty; // one entry per open object or array
+		bool              after_key = false;
+	};
+}
+#endif // __JSON_WRITER_HH
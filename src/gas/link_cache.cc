@@ -0,0 +1,1173 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "constants.hh"
+#include "file_utils.hh"
+#include "link_cache.hh"
+#include "process.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr std::string_view entries_dir_name { "entries" };
+	constexpr std::string_view output_entry_name { "output" };
+	constexpr std::string_view map_entry_name { "map" };
+	constexpr std::string_view messages_entry_name { "messages" };
+	constexpr std::string_view link_time_entry_name { "link-time" };
+	constexpr std::string_view stats_log_name { "stats.log" };
+
+	constexpr uint64_t max_script_size = 1024 * 1024;
+	constexpr size_t tar_block_size = 512;
+
+	// Options whose results aren't cached: they write files other than the output and the link map, print to stdout
+	// or make the linker read files we can't know about in advance
+	constexpr std::array uncacheable_options {
+		std::string_view { "-M" },
+		std::string_view { "-cref" },
+		std::string_view { "-dependency-file" },
+		std::string_view { "-error-handling-script" },
+		std::string_view { "-help" },
+		std::string_view { "-lto-obj-path" },
+		std::string_view { "-plugin" },
+		std::string_view { "-plugin-opt" },
+		std::string_view { "-print-archive-stats" },
+		std::string_view { "-print-gc-sections" },
+		std::string_view { "-print-icf-sections" },
+		std::string_view { "-print-map" },
+		std::string_view { "-print-memory-usage" },
+		std::string_view { "-print-symbol-order" },
+		std::string_view { "-reproduce" },
+		std::string_view { "-save-temps" },
+		std::string_view { "-t" },
+		std::string_view { "-thinlto-cache-dir" },
+		std::string_view { "-thinlto-emit-imports-files" },
+		std::string_view { "-thinlto-index-only" },
+		std::string_view { "-time-trace" },
+		std::string_view { "-trace" },
+		std::string_view { "-trace-symbol" },
+		std::string_view { "-v" },
+		std::string_view { "-verbose" },
+		std::string_view { "-version" },
+		std::string_view { "-why-extract" },
+		std::string_view { "-y" },
+	};
+
+	// Long options which start with the name of a short option taking an attached value
+	constexpr std::array attached_value_exceptions {
+		std::string_view { "-library" },
+		std::string_view { "-lto" },
+		std::string_view { "-oformat" },
+		std::string_view { "-omagic" },
+		std::string_view { "-opt-remarks" },
+		std::string_view { "-orphan-handling" },
+		std::string_view { "-output" },
+		std::string_view { "-Tbss" },
+		std::string_view { "-Tdata" },
+		std::string_view { "-Ttext" },
+	};
+
+	struct CacheEntry
+	{
+		fs::path           path;
+		fs::file_time_type last_used;
+		uint64_t           size;
+	};
+
+	std::string to_utf8 (fs::path const& path)
+	{
+		std::u8string s = path.u8string ();
+		return { s.begin (), s.end () };
+	}
+
+	fs::path from_utf8 (std::string_view s)
+	{
+		return fs::path { std::u8string { s.begin (), s.end () } };
+	}
+
+	bool is_existing_file (fs::path const& path)
+	{
+		std::error_code ec;
+		return fs::is_regular_file (path, ec);
+	}
+
+	// GNU ld accepts both `-option` and `--option`, the former is used for all the comparisons
+	std::string_view option_name (std::string_view arg)
+	{
+		if (arg.starts_with ("--") && arg.length () > 2) {
+			arg.remove_prefix (1);
+		}
+
+		size_t equals = arg.find ('=');
+		return equals == std::string_view::npos ? arg : arg.substr (0, equals);
+	}
+
+	bool is_uncacheable_option (std::string_view arg)
+	{
+		if (!arg.starts_with ('-')) {
+			return false;
+		}
+
+		std::string_view name = option_name (arg);
+		if (std::find (uncacheable_options.begin (), uncacheable_options.end (), name) != uncacheable_options.end ()) {
+			return true;
+		}
+
+		// `-ysymbol`
+		return arg.starts_with ("-y");
+	}
+
+	// Returns the value of option `name` at `args[index]`, given as `-name value`, `-name=value` or, if `attached` is
+	// `true`, `-namevalue`.  `index` is advanced past a separate value.
+	std::optional<std::string> option_value (std::vector<std::string> const& args, size_t &index, std::string_view name, bool attached)
+	{
+		std::string_view arg = args[index];
+		if (!arg.starts_with ('-')) {
+			return std::nullopt;
+		}
+
+		if (arg.starts_with ("--") && arg.length () > 2) {
+			arg.remove_prefix (1);
+		}
+
+		if (!arg.starts_with (name)) {
+			return std::nullopt;
+		}
+
+		if (arg.length () == name.length ()) {
+			if (index + 1 >= args.size ()) {
+				return std::nullopt;
+			}
+			index++;
+			return args[index];
+		}
+
+		if (arg[name.length ()] == '=') {
+			return std::string { arg.substr (name.length () + 1) };
+		}
+
+		if (!attached) {
+			return std::nullopt;
+		}
+
+		for (std::string_view const& exception : attached_value_exceptions) {
+			if (exception.starts_with (name) && arg.starts_with (exception)) {
+				return std::nullopt;
+			}
+		}
+
+		return std::string { arg.substr (name.length ()) };
+	}
+
+	// GNU-style response file quoting: arguments are separated by whitespace, single and double quotes group
+	// characters and backslash escapes the next character
+	std::vector<std::string> tokenize_response_file (std::string const& contents)
+	{
+		std::vector<std::string> ret;
+		std::string current;
+		bool in_token = false;
+		char quote = '\0';
+
+		for (size_t i = 0; i < contents.length (); i++) {
+			char c = contents[i];
+			if (c == '\\' && i + 1 < contents.length ()) {
+				current.push_back (contents[++i]);
+				in_token = true;
+			} else if (quote != '\0') {
+				if (c == quote) {
+					quote = '\0';
+				} else {
+					current.push_back (c);
+				}
+			} else if (c == '"' || c == '\'') {
+				quote = c;
+				in_token = true;
+			} else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+				if (in_token) {
+					ret.push_back (std::move (current));
+					current.clear ();
+					in_token = false;
+				}
+			} else {
+				current.push_back (c);
+				in_token = true;
+			}
+		}
+
+		if (in_token) {
+			ret.push_back (std::move (current));
+		}
+
+		return ret;
+	}
+
+	// Tokens of a linker script: names (quotes removed) and the punctuation which delimits the commands we look at
+	std::vector<std::string_view> tokenize_linker_script (std::string_view script)
+	{
+		std::vector<std::string_view> tokens;
+		auto is_delimiter = [](char c) -> bool {
+			return c == '(' || c == ')' || c == ',' || c == ';' || c == '{' || c == '}';
+		};
+		auto is_space = [](char c) -> bool {
+			return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+		};
+
+		size_t i = 0;
+		while (i < script.length ()) {
+			char c = script[i];
+			if (is_space (c)) {
+				i++;
+			} else if (script.substr (i).starts_with ("/*")) {
+				size_t end = script.find ("*/", i + 2);
+				if (end == std::string_view::npos) {
+					break;
+				}
+				i = end + 2;
+			} else if (c == '"') {
+				size_t end = script.find ('"', i + 1);
+				if (end == std::string_view::npos) {
+					end = script.length ();
+				}
+				tokens.push_back (script.substr (i + 1, end - i - 1));
+				i = end + 1;
+			} else if (is_delimiter (c)) {
+				tokens.push_back (script.substr (i, 1));
+				i++;
+			} else {
+				size_t start = i;
+				while (i < script.length () && !is_space (script[i]) && !is_delimiter (script[i]) && script[i] != '"' && !script.substr (i).starts_with ("/*")) {
+					i++;
+				}
+				tokens.push_back (script.substr (start, i - start));
+			}
+		}
+
+		return tokens;
+	}
+
+	bool read_file (fs::path const& path, std::string &contents)
+	{
+		std::ifstream is { path, std::ios::binary };
+		if (!is) {
+			return false;
+		}
+
+		std::ostringstream ss;
+		ss << is.rdbuf ();
+		contents = ss.str ();
+		return !is.bad ();
+	}
+
+	void copy_into_place (fs::path const& source, fs::path const& target)
+	{
+		fs::path temporary = FileUtils::make_temporary_path (target);
+		try {
+			fs::copy_file (source, temporary, fs::copy_options::overwrite_existing);
+			fs::rename (temporary, target);
+		} catch (...) {
+			std::error_code ec;
+			fs::remove (temporary, ec);
+			throw;
+		}
+	}
+
+	std::vector<CacheEntry> list_entries (fs::path const& entries_dir)
+	{
+		std::vector<CacheEntry> ret;
+		std::error_code ec;
+		for (fs::directory_entry const& entry : fs::directory_iterator { entries_dir, ec }) {
+			// Entries still being written are named after their key, with a temporary suffix
+			if (!entry.is_directory (ec) || entry.path ().filename ().string ().find ('.') != std::string::npos) {
+				continue;
+			}
+
+			uint64_t size = 0;
+			std::error_code file_ec;
+			for (fs::directory_entry const& file : fs::directory_iterator { entry.path (), file_ec }) {
+				std::error_code size_ec;
+				uintmax_t file_size = file.file_size (size_ec);
+				if (!size_ec) {
+					size += file_size;
+				}
+			}
+
+			std::error_code time_ec;
+			fs::file_time_type last_used = fs::last_write_time (entry.path (), time_ec);
+			ret.push_back ({ entry.path (), last_used, size });
+		}
+
+		return ret;
+	}
+
+	uint64_t parse_tar_number (char const* field, size_t length) noexcept
+	{
+		uint64_t ret = 0;
+		for (size_t i = 0; i < length; i++) {
+			char c = field[i];
+			if (c == ' ' && ret == 0) {
+				continue;
+			}
+
+			if (c < '0' || c > '7') {
+				break;
+			}
+			ret = (ret << 3) | static_cast<uint64_t>(c - '0');
+		}
+
+		return ret;
+	}
+
+	std::string tar_string (char const* field, size_t length)
+	{
+		return { field, strnlen (field, length) };
+	}
+}
+
+LinkCache::LinkCache (fs::path cache_dir, fs::path linker, std::vector<platform::string> linker_args)
+	: cache_dir (std::move (cache_dir)),
+	  linker (std::move (linker)),
+	  linker_args (std::move (linker_args))
+{}
+
+int LinkCache::run (std::vector<platform::string> const& args)
+{
+	fs::path cache_dir;
+	char const* dir = std::getenv (cache_dir_variable);
+	if (dir != nullptr && *dir != '\0') {
+		cache_dir = fs::absolute (fs::path { dir });
+	}
+
+	if (args.size () == 3 && args[2] == stats_param) {
+		if (cache_dir.empty ()) {
+			STDERR << cache_dir_variable << " is not set" << Constants::newline;
+			return Constants::wrapper_general_error_code;
+		}
+		return print_stats (cache_dir);
+	}
+
+	if (args.size () < 3) {
+		STDERR << "Usage: " << args[0] << " " << Constants::ld_cache_param << " <linker> [linker arguments] | " << stats_param << Constants::newline;
+		return Constants::wrapper_general_error_code;
+	}
+
+	LinkCache cache { std::move (cache_dir), args[2], { args.begin () + 3, args.end () } };
+	return cache.link ();
+}
+
+int LinkCache::link ()
+{
+	clock::time_point start_time = clock::now ();
+	std::string messages;
+
+	// The wrapper scripts don't come here without a cache directory, but it costs nothing to support it
+	if (cache_dir.empty ()) {
+		return run_linker ({}, messages);
+	}
+
+	std::optional<std::string> key;
+	try {
+		key = make_key ();
+	} catch (std::exception const& ex) {
+		make_uncacheable (ex.what ());
+	}
+
+	char const* check_mode = std::getenv (check_variable);
+	bool checking = check_mode != nullptr && *check_mode != '\0' && std::strcmp (check_mode, "0") != 0;
+	if (!key.has_value ()) {
+		if (checking) {
+			STDERR << "ld cache check: link not cacheable, " << uncacheable_reason.c_str () << Constants::newline;
+		}
+
+		int ret = run_linker ({}, messages);
+		record ("uncacheable", start_time);
+		return ret;
+	}
+
+	fs::path entry = cache_dir / entries_dir_name / key.value ();
+	if (checking) {
+		return check (entry, start_time);
+	}
+
+	std::optional<uint64_t> cached_link_time = restore (entry);
+	if (cached_link_time.has_value ()) {
+		uint64_t elapsed = elapsed_ms (start_time);
+		record ("hit", start_time, cached_link_time.value () > elapsed ? cached_link_time.value () - elapsed : 0);
+		return 0;
+	}
+
+	int ret = run_linker ({}, messages);
+	if (ret == 0) {
+		store (entry, messages, elapsed_ms (start_time));
+		evict (entry);
+	}
+	record ("miss", start_time);
+
+	return ret;
+}
+
+int LinkCache::check (fs::path const& entry, clock::time_point start_time)
+{
+	std::error_code ec;
+	fs::create_directories (cache_dir, ec);
+
+	fs::path reproduce_tar = FileUtils::make_temporary_path (cache_dir / "reproduce.tar");
+	ScopeGuard remove_tar {
+		[&reproduce_tar]() {
+			std::error_code remove_ec;
+			fs::remove (reproduce_tar, remove_ec);
+		}
+	};
+
+	platform::string reproduce_arg { PSTR("--reproduce=") };
+	reproduce_arg.append (reproduce_tar.native ());
+
+	std::string messages;
+	int ret = run_linker (reproduce_arg, messages);
+	if (ret != 0) {
+		return ret;
+	}
+
+	bool passed = true;
+	for (std::string const& member : uncovered_reproduce_members (reproduce_tar)) {
+		STDERR << "ld cache check: " << member.c_str () << " is read by the linker, but not covered by the cache key" << Constants::newline;
+		passed = false;
+	}
+
+	if (is_existing_file (entry / output_entry_name)) {
+		if (!FileUtils::files_identical (entry / output_entry_name, output_file)) {
+			STDERR << "ld cache check: " << output_file.c_str () << " differs from the cached output in " << entry.c_str () << Constants::newline;
+			passed = false;
+		}
+	} else if (passed) {
+		store (entry, messages, elapsed_ms (start_time));
+		evict (entry);
+	}
+
+	record ("check", start_time);
+	return passed ? 0 : Constants::wrapper_general_error_code;
+}
+
+int LinkCache::run_linker (platform::string const& extra_arg, std::string &messages) const
+{
+	Process ld { linker };
+	for (platform::string const& arg : linker_args) {
+		ld.append_program_argument (arg);
+	}
+
+	if (!extra_arg.empty ()) {
+		ld.append_program_argument (extra_arg);
+	}
+
+	// Diagnostics are stored along with the output, a cache hit must report the same warnings
+	ld.capture_stderr (
+		[&messages](std::string_view const& line) {
+			std::string text { line };
+			STDERR << text.c_str () << Constants::newline;
+			messages.append (text).append ("\n");
+		}
+	);
+
+	return ld.run (false);
+}
+
+std::optional<std::string> LinkCache::make_key ()
+{
+	std::vector<std::string> utf8_args;
+	for (platform::string const& arg : linker_args) {
+		utf8_args.push_back (to_utf8 (fs::path { arg }));
+	}
+	expand_arguments (utf8_args, 0);
+	collect_search_dirs ();
+
+	key_hash.update (key_format_version);
+	key_hash.update ("\n");
+	key_hash.update (XA_UTILS_VERSION);
+	key_hash.update ("\n");
+	key_hash.update (LLVM_VERSION);
+	key_hash.update ("\n");
+	add_arguments ();
+
+	if (!cacheable) {
+		return std::nullopt;
+	}
+
+	return key_hash.finish_hex ();
+}
+
+void LinkCache::make_uncacheable (std::string reason)
+{
+	if (cacheable) {
+		cacheable = false;
+		uncacheable_reason = std::move (reason);
+	}
+}
+
+void LinkCache::expand_arguments (std::vector<std::string> const& arguments, size_t depth)
+{
+	for (std::string const& arg : arguments) {
+		fs::path response_file;
+		if (arg.length () > 1 && arg[0] == '@') {
+			response_file = from_utf8 (std::string_view { arg }.substr (1));
+		}
+
+		// Like the linker, treat `@name` as a plain argument if there's no such file
+		if (response_file.empty () || !is_existing_file (response_file)) {
+			args.push_back (arg);
+			continue;
+		}
+
+		std::string contents;
+		if (depth >= max_include_depth || !read_file (response_file, contents)) {
+			std::string reason { "unable to read response file " };
+			reason.append (arg.substr (1));
+			make_uncacheable (std::move (reason));
+			return;
+		}
+		expand_arguments (tokenize_response_file (contents), depth + 1);
+	}
+}
+
+void LinkCache::collect_search_dirs ()
+{
+	// The linker uses the search directories for all the libraries and scripts, regardless of the order
+	for (size_t i = 0; i < args.size (); i++) {
+		std::optional<std::string> value = option_value (args, i, "-sysroot", false);
+		if (value.has_value ()) {
+			sysroot = from_utf8 (value.value ());
+		}
+	}
+
+	for (size_t i = 0; i < args.size (); i++) {
+		std::optional<std::string> value = option_value (args, i, "-library-path", false);
+		if (!value.has_value ()) {
+			value = option_value (args, i, "-L", true);
+		}
+
+		if (value.has_value ()) {
+			search_dirs.push_back (sysroot_path (value.value ()));
+		}
+	}
+}
+
+void LinkCache::add_arguments ()
+{
+	auto add_key_arg = [this](std::string_view const& arg) {
+		key_hash.update ("arg\t");
+		key_hash.update (arg);
+		key_hash.update ("\n");
+	};
+
+	// The link map lists the input files by name, the output depends only on their contents and order
+	bool input_names_matter = false;
+	for (size_t i = 0; i < args.size (); i++) {
+		if (option_value (args, i, "-Map", false).has_value ()) {
+			input_names_matter = true;
+		}
+	}
+
+	for (size_t i = 0; i < args.size () && cacheable; i++) {
+		std::string const& arg = args[i];
+		if (is_uncacheable_option (arg)) {
+			std::string reason { "option " };
+			reason.append (arg);
+			make_uncacheable (std::move (reason));
+			return;
+		}
+
+		// Names of the files the link writes don't affect their contents, but whether a map is written does
+		std::optional<std::string> value = option_value (args, i, "-output", false);
+		if (!value.has_value ()) {
+			value = option_value (args, i, "-o", true);
+		}
+
+		if (value.has_value ()) {
+			output_file = from_utf8 (value.value ());
+			add_key_arg ("-o");
+			continue;
+		}
+
+		value = option_value (args, i, "-Map", false);
+		if (value.has_value ()) {
+			map_file = from_utf8 (value.value ());
+			add_key_arg ("-Map");
+			continue;
+		}
+
+		std::string_view name = option_name (arg);
+		if (arg.starts_with ('-')) {
+			if (name == "-Bstatic" || name == "-static" || name == "-dn" || name == "-non_shared") {
+				static_libraries = true;
+			} else if (name == "-Bdynamic" || name == "-dy" || name == "-call_shared") {
+				static_libraries = false;
+			}
+		}
+
+		size_t first = i;
+		value = option_value (args, i, "-library-path", false);
+		if (!value.has_value ()) {
+			value = option_value (args, i, "-L", true);
+		}
+		if (!value.has_value ()) {
+			value = option_value (args, i, "-sysroot", false);
+		}
+
+		if (value.has_value ()) {
+			add_key_arg (args[first]);
+			add_key_arg (value.value ());
+			continue;
+		}
+
+		value = option_value (args, i, "-library", false);
+		if (!value.has_value ()) {
+			value = option_value (args, i, "-l", true);
+		}
+
+		if (value.has_value ()) {
+			add_key_arg (args[first]);
+			add_key_arg (value.value ());
+			add_library (value.value ());
+			continue;
+		}
+
+		value = option_value (args, i, "-script", false);
+		if (!value.has_value ()) {
+			value = option_value (args, i, "-T", true);
+		}
+
+		if (value.has_value ()) {
+			add_key_arg (args[first]);
+			add_key_arg (value.value ());
+
+			fs::path script = from_utf8 (value.value ());
+			std::optional<fs::path> found = is_existing_file (script) ? script : find_in_search_dirs (value.value ());
+			if (!found.has_value ()) {
+				std::string reason { "linker script " };
+				reason.append (value.value ()).append (" not found");
+				make_uncacheable (std::move (reason));
+				return;
+			}
+			add_input (found.value (), 0);
+			continue;
+		}
+
+		// Everything else is either an input file, an option or its value.  Whatever names an existing file is
+		// hashed, over-including a file costs nothing but a read.  Input files are keyed by their position, so that
+		// the same objects linked from another directory (e.g. another checkout) hit the same entry.
+		if (!arg.starts_with ('-')) {
+			fs::path path = from_utf8 (arg);
+			if (is_existing_file (path)) {
+				add_key_arg (input_names_matter ? std::string_view { arg } : std::string_view { "<input>" });
+				add_input (path, 0);
+			} else {
+				add_key_arg (arg);
+			}
+			continue;
+		}
+
+		add_key_arg (arg);
+
+		size_t equals = arg.find ('=');
+		if (equals != std::string::npos) {
+			fs::path path = from_utf8 (std::string_view { arg }.substr (equals + 1));
+			if (!path.empty () && is_existing_file (path)) {
+				add_input (path, 0);
+			}
+		}
+	}
+}
+
+void LinkCache::add_input (fs::path const& path, size_t depth)
+{
+	std::optional<std::string> digest = Sha256::hash_file_hex (path);
+	if (!digest.has_value ()) {
+		std::string reason { "unable to read " };
+		reason.append (to_utf8 (path));
+		make_uncacheable (std::move (reason));
+		return;
+	}
+
+	key_hash.update ("input\t");
+	key_hash.update (digest.value ());
+	key_hash.update ("\n");
+	input_digests.insert (digest.value ());
+
+	std::array<char, 8> magic {};
+	{
+		std::ifstream is { path, std::ios::binary };
+		is.read (magic.data (), magic.size ());
+	}
+
+	std::string_view const header { magic.data (), magic.size () };
+	if (header.starts_with ("\x7f" "ELF") || header == "!<arch>\n" || header.starts_with ("BC\xc0\xde")) {
+		return;
+	}
+
+	std::error_code ec;
+	uintmax_t size = fs::file_size (path, ec);
+	if (ec || size > max_script_size) {
+		return;
+	}
+
+	std::string contents;
+	if (!read_file (path, contents)) {
+		return;
+	}
+
+	// Thin archive members live in their own files.  Anything else which is text may be a linker script, which the
+	// linker accepts wherever it accepts an object or a library.
+	if (header == "!<thin>\n") {
+		add_thin_archive_members (path, contents, depth);
+	} else if (contents.find ('\0') == std::string::npos) {
+		add_linker_script (path, contents, depth);
+	}
+}
+
+void LinkCache::add_thin_archive_members (fs::path const& archive, std::string const& contents, size_t depth)
+{
+	constexpr size_t header_size = 60;
+	std::string_view long_names;
+	size_t offset = 8;
+
+	while (offset + header_size <= contents.length () && cacheable) {
+		std::string_view header { contents.data () + offset, header_size };
+		std::string_view name = header.substr (0, 16);
+		uint64_t size = std::strtoull (std::string { header.substr (48, 10) }.c_str (), nullptr, 10);
+		offset += header_size;
+
+		while (!name.empty () && name.back () == ' ') {
+			name.remove_suffix (1);
+		}
+
+		// Only the symbol table and the long name table are stored in a thin archive
+		if (name == "/" || name == "/SYM64/" || name == "//") {
+			if (name == "//" && offset + size <= contents.length ()) {
+				long_names = std::string_view { contents }.substr (offset, size);
+			}
+			offset += size + (size & 1);
+			continue;
+		}
+
+		std::string_view member_name;
+		if (name.starts_with ('/')) {
+			size_t name_offset = std::strtoull (std::string { name.substr (1) }.c_str (), nullptr, 10);
+			if (name_offset < long_names.length ()) {
+				member_name = long_names.substr (name_offset);
+				member_name = member_name.substr (0, member_name.find ('\n'));
+			}
+		} else {
+			member_name = name;
+		}
+
+		if (member_name.ends_with ('/')) {
+			member_name.remove_suffix (1);
+		}
+
+		fs::path member = from_utf8 (member_name);
+		if (member.is_relative ()) {
+			member = archive.parent_path () / member;
+		}
+
+		if (member_name.empty () || depth >= max_include_depth) {
+			std::string reason { "unable to read the members of thin archive " };
+			reason.append (to_utf8 (archive));
+			make_uncacheable (std::move (reason));
+			return;
+		}
+		add_input (member, depth + 1);
+	}
+}
+
+void LinkCache::add_linker_script (fs::path const& script, std::string const& contents, size_t depth)
+{
+	std::error_code ec;
+	fs::path canonical_script = fs::weakly_canonical (script, ec);
+	if (!scanned_scripts.insert (to_utf8 (ec ? script : canonical_script)).second) {
+		return;
+	}
+
+	auto add_script_input = [this, depth](std::string_view name) {
+		if (name.starts_with ("-l")) {
+			add_library (name.substr (2));
+			return;
+		}
+
+		std::optional<fs::path> found = find_script_input (name);
+		if (!found.has_value () || depth >= max_include_depth) {
+			std::string reason { "linker script input " };
+			reason.append (name).append (" not found");
+			make_uncacheable (std::move (reason));
+			return;
+		}
+		add_input (found.value (), depth + 1);
+	};
+
+	std::vector<std::string_view> tokens = tokenize_linker_script (contents);
+	for (size_t i = 0; i < tokens.size () && cacheable; i++) {
+		std::string_view token = tokens[i];
+		bool followed_by_list = i + 1 < tokens.size () && tokens[i + 1] == "(";
+
+		if ((token == "INPUT" || token == "GROUP" || token == "STARTUP") && followed_by_list) {
+			int nesting = 0;
+			for (i++; i < tokens.size () && cacheable; i++) {
+				std::string_view item = tokens[i];
+				if (item == "(") {
+					nesting++;
+				} else if (item == ")") {
+					if (--nesting == 0) {
+						break;
+					}
+				} else if (item != "," && item != "AS_NEEDED") {
+					add_script_input (item);
+				}
+			}
+		} else if (token == "INCLUDE" && i + 1 < tokens.size ()) {
+			add_script_input (tokens[++i]);
+		} else if (token == "SEARCH_DIR" && followed_by_list && i + 2 < tokens.size ()) {
+			search_dirs.push_back (sysroot_path (tokens[i + 2]));
+			i += 2;
+		} else if (token == "OUTPUT" && followed_by_list) {
+			std::string reason { "OUTPUT command in linker script " };
+			reason.append (to_utf8 (script));
+			make_uncacheable (std::move (reason));
+		}
+	}
+}
+
+void LinkCache::add_library (std::string_view name)
+{
+	std::optional<fs::path> found;
+	if (name.starts_with (':')) {
+		found = find_in_search_dirs (name.substr (1));
+	} else {
+		std::string base { "lib" };
+		base.append (name);
+		for (fs::path const& dir : search_dirs) {
+			if (!static_libraries && is_existing_file (dir / from_utf8 (base + ".so"))) {
+				found = dir / from_utf8 (base + ".so");
+				break;
+			}
+
+			if (is_existing_file (dir / from_utf8 (base + ".a"))) {
+				found = dir / from_utf8 (base + ".a");
+				break;
+			}
+		}
+	}
+
+	if (!found.has_value ()) {
+		std::string reason { "library " };
+		reason.append (name).append (" not found");
+		make_uncacheable (std::move (reason));
+		return;
+	}
+
+	add_input (found.value (), 0);
+}
+
+std::optional<fs::path> LinkCache::find_in_search_dirs (std::string_view name) const
+{
+	fs::path file_name = from_utf8 (name);
+	for (fs::path const& dir : search_dirs) {
+		if (is_existing_file (dir / file_name)) {
+			return dir / file_name;
+		}
+	}
+
+	return std::nullopt;
+}
+
+std::optional<fs::path> LinkCache::find_script_input (std::string_view name) const
+{
+	if (name.starts_with ('=')) {
+		fs::path path = sysroot_path (name);
+		return is_existing_file (path) ? std::optional<fs::path> { path } : std::nullopt;
+	}
+
+	fs::path path = from_utf8 (name);
+	if (path.is_absolute () && !sysroot.empty ()) {
+		fs::path in_sysroot = sysroot / path.relative_path ();
+		if (is_existing_file (in_sysroot)) {
+			return in_sysroot;
+		}
+	}
+
+	if (is_existing_file (path)) {
+		return path;
+	}
+
+	return find_in_search_dirs (name);
+}
+
+fs::path LinkCache::sysroot_path (std::string_view path) const
+{
+	if (!path.starts_with ('=')) {
+		return from_utf8 (path);
+	}
+
+	return sysroot / from_utf8 (path.substr (1)).relative_path ();
+}
+
+std::optional<uint64_t> LinkCache::restore (fs::path const& entry) const
+{
+	if (!is_existing_file (entry / output_entry_name) || (!map_file.empty () && !is_existing_file (entry / map_entry_name))) {
+		return std::nullopt;
+	}
+
+	// The entry may be evicted by a concurrent link at any time, this is then a miss
+	try {
+		copy_into_place (entry / output_entry_name, output_file);
+		if (!map_file.empty ()) {
+			copy_into_place (entry / map_entry_name, map_file);
+		}
+	} catch (fs::filesystem_error const&) {
+		return std::nullopt;
+	}
+
+	std::error_code ec;
+	fs::last_write_time (entry, fs::file_time_type::clock::now (), ec);
+
+	std::string messages;
+	if (read_file (entry / messages_entry_name, messages) && !messages.empty ()) {
+		STDERR << messages.c_str ();
+	}
+
+	std::string link_time;
+	read_file (entry / link_time_entry_name, link_time);
+	return std::strtoull (link_time.c_str (), nullptr, 10);
+}
+
+void LinkCache::store (fs::path const& entry, std::string const& messages, uint64_t link_time_ms) const
+{
+	std::error_code ec;
+	if (fs::exists (entry, ec)) {
+		return;
+	}
+
+	// The entry is written under a temporary name and then renamed, concurrent links never see it half-written.  If
+	// another link stored the same entry in the meantime, the rename fails and ours is dropped.
+	fs::path temporary = FileUtils::make_temporary_path (entry);
+	try {
+		fs::create_directories (temporary);
+		fs::copy_file (output_file, temporary / output_entry_name);
+		if (!map_file.empty ()) {
+			fs::copy_file (map_file, temporary / map_entry_name);
+		}
+
+		{
+			std::ofstream os { temporary / messages_entry_name, std::ios::binary };
+			os.write (messages.data (), static_cast<std::streamsize>(messages.length ()));
+		}
+
+		{
+			std::ofstream os { temporary / link_time_entry_name, std::ios::binary };
+			os << link_time_ms << '\n';
+		}
+
+		fs::rename (temporary, entry);
+	} catch (fs::filesystem_error const&) {
+		fs::remove_all (temporary, ec);
+	}
+}
+
+void LinkCache::evict (fs::path const& keep) const
+{
+	std::vector<CacheEntry> entries = list_entries (cache_dir / entries_dir_name);
+	std::sort (
+		entries.begin (),
+		entries.end (),
+		[](CacheEntry const& a, CacheEntry const& b) {
+			return a.last_used < b.last_used;
+		}
+	);
+
+	uint64_t total_size = 0;
+	for (CacheEntry const& entry : entries) {
+		total_size += entry.size;
+	}
+
+	uint64_t const max_size = max_cache_size ();
+	for (CacheEntry const& entry : entries) {
+		if (total_size <= max_size) {
+			break;
+		}
+
+		if (entry.path == keep) {
+			continue;
+		}
+
+		std::error_code ec;
+		fs::remove_all (entry.path, ec);
+		total_size -= entry.size;
+	}
+}
+
+void LinkCache::record (std::string_view outcome, clock::time_point start_time, uint64_t saved_ms) const
+{
+	std::error_code ec;
+	fs::create_directories (cache_dir, ec);
+
+	// A single short write to a file opened for appending, concurrent links don't garble each other's lines
+	std::string line { outcome };
+	line.append ("\t").append (std::to_string (elapsed_ms (start_time)));
+	line.append ("\t").append (std::to_string (saved_ms)).append ("\n");
+
+	std::ofstream log { cache_dir / stats_log_name, std::ios::binary | std::ios::app };
+	log.write (line.data (), static_cast<std::streamsize>(line.length ()));
+}
+
+std::vector<std::string> LinkCache::uncovered_reproduce_members (fs::path const& tar) const
+{
+	std::vector<std::string> ret;
+	std::ifstream is { tar, std::ios::binary };
+	if (!is) {
+		ret.push_back (to_utf8 (tar));
+		return ret;
+	}
+
+	std::array<char, tar_block_size> header;
+	std::vector<char> buffer (1024 * 1024);
+	std::string pax_path;
+
+	while (is.read (header.data (), header.size ())) {
+		if (std::all_of (header.begin (), header.end (), [](char c) { return c == '\0'; })) {
+			break;
+		}
+
+		std::string name = tar_string (header.data (), 100);
+		std::string prefix = tar_string (header.data () + 345, 155);
+		if (std::memcmp (header.data () + 257, "ustar", 5) == 0 && !prefix.empty ()) {
+			name = prefix + "/" + name;
+		}
+
+		uint64_t size = parse_tar_number (header.data () + 124, 12);
+		uint64_t padded_size = (size + tar_block_size - 1) / tar_block_size * tar_block_size;
+		char type = header[156];
+
+		// lld stores paths too long for the ustar header in PAX extended headers
+		if (type == 'x') {
+			std::string records (padded_size, '\0');
+			is.read (records.data (), static_cast<std::streamsize>(padded_size));
+			records.resize (size);
+
+			size_t pos = 0;
+			while (pos < records.length ()) {
+				size_t space = records.find (' ', pos);
+				uint64_t length = std::strtoull (records.c_str () + pos, nullptr, 10);
+				if (space == std::string::npos || length == 0 || pos + length > records.length ()) {
+					break;
+				}
+
+				std::string_view record { records.data () + space + 1, pos + length - space - 2 };
+				if (record.starts_with ("path=")) {
+					pax_path = record.substr (5);
+				}
+				pos += length;
+			}
+			continue;
+		}
+
+		if (!pax_path.empty ()) {
+			name = std::move (pax_path);
+			pax_path.clear ();
+		}
+
+		if (type != '0' && type != '\0') {
+			is.seekg (static_cast<std::streamoff>(padded_size), std::ios::cur);
+			continue;
+		}
+
+		Sha256 hash;
+		uint64_t remaining = size;
+		while (remaining > 0 && is) {
+			size_t chunk = static_cast<size_t>(std::min<uint64_t> (remaining, buffer.size ()));
+			is.read (buffer.data (), static_cast<std::streamsize>(chunk));
+			hash.update (buffer.data (), static_cast<size_t>(is.gcount ()));
+			remaining -= chunk;
+		}
+		is.seekg (static_cast<std::streamoff>(padded_size - size), std::ios::cur);
+
+		// Members are stored under a directory named after the archive, the linker adds its own two files
+		std::string_view member { name };
+		size_t slash = member.find ('/');
+		std::string_view relative = slash == std::string_view::npos ? member : member.substr (slash + 1);
+		if (relative == "response.txt" || relative == "version.txt") {
+			continue;
+		}
+
+		if (!input_digests.contains (hash.finish_hex ())) {
+			ret.push_back (std::string { relative });
+		}
+	}
+
+	return ret;
+}
+
+int LinkCache::print_stats (fs::path const& cache_dir)
+{
+	std::map<std::string, uint64_t> counts;
+	std::map<std::string, uint64_t> times;
+	uint64_t saved_ms = 0;
+
+	std::ifstream log { cache_dir / stats_log_name, std::ios::binary };
+	std::string line;
+	while (std::getline (log, line)) {
+		std::istringstream fields { line };
+		std::string outcome;
+		uint64_t time_ms = 0;
+		uint64_t line_saved_ms = 0;
+		if (!(fields >> outcome >> time_ms >> line_saved_ms)) {
+			continue;
+		}
+
+		counts[outcome]++;
+		times[outcome] += time_ms;
+		saved_ms += line_saved_ms;
+	}
+
+	uint64_t cacheable = counts["hit"] + counts["miss"];
+	double hit_rate = cacheable == 0 ? 0.0 : 100.0 * static_cast<double>(counts["hit"]) / static_cast<double>(cacheable);
+
+	uint64_t total_size = 0;
+	std::vector<CacheEntry> entries = list_entries (cache_dir / entries_dir_name);
+	for (CacheEntry const& entry : entries) {
+		total_size += entry.size;
+	}
+
+	auto seconds = [](uint64_t ms) -> double {
+		return static_cast<double>(ms) / 1000.0;
+	};
+
+	STDOUT << "Link cache " << cache_dir.c_str () << Constants::newline;
+	STDOUT << "  hits:        " << counts["hit"] << " (" << hit_rate << "%), " << seconds (times["hit"]) << "s" << Constants::newline;
+	STDOUT << "  misses:      " << counts["miss"] << ", " << seconds (times["miss"]) << "s" << Constants::newline;
+	STDOUT << "  uncacheable: " << counts["uncacheable"] << ", " << seconds (times["uncacheable"]) << "s" << Constants::newline;
+	STDOUT << "  checks:      " << counts["check"] << ", " << seconds (times["check"]) << "s" << Constants::newline;
+	STDOUT << "  time saved:  " << seconds (saved_ms) << "s" << Constants::newline;
+	STDOUT << "  entries:     " << entries.size () << ", " << total_size / (1024 * 1024) << " of " << max_cache_size () / (1024 * 1024) << " MB" << Constants::newline;
+
+	return 0;
+}
+
+uint64_t LinkCache::max_cache_size ()
+{
+	uint64_t size_mb = default_max_size_mb;
+	char const* size = std::getenv (cache_size_variable);
+	if (size != nullptr && *size != '\0') {
+		uint64_t value = std::strtoull (size, nullptr, 10);
+		if (value > 0) {
+			size_mb = value;
+		}
+	}
+
+	return size_mb * 1024 * 1024;
+}
+
+uint64_t LinkCache::elapsed_ms (clock::time_point start_time)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds> (clock::now () - start_time).count ());
+}
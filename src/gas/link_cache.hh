@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__LINK_CACHE_HH)
+#define __LINK_CACHE_HH
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "gas.hh"
+#include "sha256.hh"
+
+namespace xamarin::android::gas
+{
+	// Local cache of final link results.  When `XA_LD_CACHE_DIR` is set, the `ld` wrapper scripts run
+	// `as @ld-cache <ld> <arguments>` instead of the linker.  The key is the SHA-256 of the toolchain versions, the
+	// arguments (with response files expanded, the output and link map names left out and, unless a link map is
+	// written, the input file names replaced by their position) and the SHA-256 of every file the link reads:
+	// objects, archives (including the members of thin archives), libraries found in the search directories and
+	// linker scripts, along with the files they name.  Links whose inputs can't all be found, or which write anything
+	// besides the output file and the link map, go straight to the linker.  The cache directory holds:
+	//
+	//   entries/<key>/output      the linked file
+	//   entries/<key>/map         the link map, if one was requested
+	//   entries/<key>/messages    the linker's diagnostics, replayed on a hit
+	//   entries/<key>/link-time   wall time of the link, in milliseconds
+	//   stats.log                 one line per link: the outcome (`hit`, `miss`, `uncacheable` or `check`), its wall
+	//                             time and, for hits, the link time saved
+	//
+	// Once the entries grow beyond `XA_LD_CACHE_SIZE` megabytes, the least recently used ones are evicted.  With
+	// `XA_LD_CACHE_CHECK=1` every link runs with `--reproduce` and fails if the reproduce archive holds a file not
+	// covered by the key, or if the output differs from the cached one.  `as @ld-cache --stats` summarizes the log.
+	class LinkCache final
+	{
+		using clock = std::chrono::steady_clock;
+
+		static constexpr std::string_view key_format_version { "xa-ld-cache-v2" };
+		static constexpr uint64_t default_max_size_mb = 2048;
+		static constexpr size_t max_include_depth = 16;
+
+	public:
+		static constexpr char const cache_dir_variable[] = "XA_LD_CACHE_DIR";
+		static constexpr char const cache_size_variable[] = "XA_LD_CACHE_SIZE";
+		static constexpr char const check_variable[] = "XA_LD_CACHE_CHECK";
+		static constexpr platform::string_view stats_param { PSTR("--stats") };
+
+	public:
+		LinkCache (fs::path cache_dir, fs::path linker, std::vector<platform::string> linker_args);
+
+		// `args` is the complete `as @ld-cache ...` command line
+		static int run (std::vector<platform::string> const& args);
+
+		// Runs the link, or restores its result from the cache.  Returns the linker's exit code.
+		int link ();
+
+	private:
+		int check (fs::path const& entry, clock::time_point start_time);
+		int run_linker (platform::string const& extra_arg, std::string &messages) const;
+
+		// Returns an empty value if the link cannot be cached
+		std::optional<std::string> make_key ();
+		void expand_arguments (std::vector<std::string> const& args, size_t depth);
+		void collect_search_dirs ();
+		void add_arguments ();
+		void add_input (fs::path const& path, size_t depth);
+		void add_thin_archive_members (fs::path const& archive, std::string const& contents, size_t depth);
+		void add_linker_script (fs::path const& script, std::string const& contents, size_t depth);
+		void add_library (std::string_view name);
+		std::optional<fs::path> find_in_search_dirs (std::string_view name) const;
+		std::optional<fs::path> find_script_input (std::string_view name) const;
+		fs::path sysroot_path (std::string_view path) const;
+		void make_uncacheable (std::string reason);
+
+		// Returns the wall time of the original link, or an empty value on a miss
+		std::optional<uint64_t> restore (fs::path const& entry) const;
+		void store (fs::path const& entry, std::string const& messages, uint64_t link_time_ms) const;
+		void evict (fs::path const& keep) const;
+		void record (std::string_view outcome, clock::time_point start_time, uint64_t saved_ms = 0) const;
+		std::vector<std::string> uncovered_reproduce_members (fs::path const& tar) const;
+
+		static int print_stats (fs::path const& cache_dir);
+		static uint64_t max_cache_size ();
+		static uint64_t elapsed_ms (clock::time_point start_time);
+
+	private:
+		fs::path const                  cache_dir;
+		fs::path const                  linker;
+		std::vector<platform::string>   linker_args;  // passed to the linker unchanged
+
+		std::vector<std::string>        args;         // UTF-8, with response files expanded
+		std::vector<fs::path>           search_dirs;
+		fs::path                        sysroot;
+		fs::path                        output_file { "a.out" };
+		fs::path                        map_file;
+		bool                            static_libraries = false;
+		bool                            cacheable = true;
+		std::string                     uncacheable_reason;
+		Sha256                          key_hash;
+		std::unordered_set<std::string> input_digests;
+		std::unordered_set<std::string> scanned_scripts;
+	};
+}
+#endif // __LINK_CACHE_HH
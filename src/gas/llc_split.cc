@@ -0,0 +1,439 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+#include "constants.hh"
+#include "elf_object.hh"
+#include "file_utils.hh"
+#include "job_scheduler.hh"
+#include "llc_split.hh"
+#include "process.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	// `llc` options which may take their value as the next argument (`-mtriple x86_64-linux-android`), the others
+	// either take no value or need the `-option=value` form
+	constexpr std::array options_with_value {
+		platform::string_view { PSTR("o") },
+		platform::string_view { PSTR("code-model") },
+		platform::string_view { PSTR("debugger-tune") },
+		platform::string_view { PSTR("exception-model") },
+		platform::string_view { PSTR("filetype") },
+		platform::string_view { PSTR("float-abi") },
+		platform::string_view { PSTR("frame-pointer") },
+		platform::string_view { PSTR("load") },
+		platform::string_view { PSTR("march") },
+		platform::string_view { PSTR("mattr") },
+		platform::string_view { PSTR("mcpu") },
+		platform::string_view { PSTR("meabi") },
+		platform::string_view { PSTR("mtriple") },
+		platform::string_view { PSTR("relocation-model") },
+		platform::string_view { PSTR("thread-model") },
+		platform::string_view { PSTR("x") },
+	};
+
+	// Options writing files besides the output, which every partition would overwrite, or producing something other
+	// than code
+	constexpr std::array options_preventing_split {
+		platform::string_view { PSTR("info-output-file") },
+		platform::string_view { PSTR("pass-remarks-output") },
+		platform::string_view { PSTR("run-pass") },
+		platform::string_view { PSTR("split-dwarf-file") },
+		platform::string_view { PSTR("split-dwarf-output") },
+		platform::string_view { PSTR("start-after") },
+		platform::string_view { PSTR("start-before") },
+		platform::string_view { PSTR("stop-after") },
+		platform::string_view { PSTR("stop-before") },
+		platform::string_view { PSTR("time-trace") },
+		platform::string_view { PSTR("time-trace-file") },
+	};
+
+	platform::string to_platform_string (uint32_t value)
+	{
+		std::string s = std::to_string (value);
+		return { s.begin (), s.end () };
+	}
+}
+
+LlcSplit::LlcSplit (fs::path const& llc)
+	: llc (llc)
+{}
+
+int LlcSplit::run (fs::path const& program_dir, std::vector<platform::string> const& args)
+{
+	if (args.size () < 2) {
+		STDERR << "Usage: " << args[0] << " [" << partitions_param << "N] [" << jobs_param << "N] [llc options] <input>"
+		       << Constants::newline;
+		return Constants::wrapper_general_error_code;
+	}
+
+	LlcSplit split { program_dir / llc_name };
+	if (!split.parse_arguments (args)) {
+		return Constants::wrapper_general_error_code;
+	}
+
+	if (!split.can_split) {
+		return split.run_llc ();
+	}
+
+	uint32_t partitions = split.partition_count ();
+	if (partitions < 2) {
+		return split.run_llc ();
+	}
+
+	return split.split_and_compile (partitions);
+}
+
+bool LlcSplit::parse_arguments (std::vector<platform::string> const& args)
+{
+	for (size_t i = 1; i < args.size (); i++) {
+		platform::string const& arg = args[i];
+
+		if (arg.starts_with (partitions_param)) {
+			if (!parse_count (arg, partitions_param, max_partitions)) {
+				return false;
+			}
+			continue;
+		}
+
+		if (arg.starts_with (jobs_param)) {
+			if (!parse_count (arg, jobs_param, max_jobs)) {
+				return false;
+			}
+			continue;
+		}
+
+		all_args.push_back (arg);
+
+		// Input file or stdin
+		if (arg.length () < 2 || arg[0] != PCHAR('-')) {
+			if (!input_file.empty () || arg == PSTR("-")) {
+				can_split = false;
+			}
+			input_file = arg;
+			continue;
+		}
+
+		// Everything after it is positional, let `llc` sort it out
+		if (arg == PSTR("--")) {
+			can_split = false;
+			continue;
+		}
+
+		platform::string name = option_name (arg);
+		size_t equals = arg.find (PCHAR('='));
+		platform::string value;
+		bool separate_value = false;
+		if (equals != platform::string::npos) {
+			value = arg.substr (equals + 1);
+		} else if (takes_value (name) && i + 1 < args.size ()) {
+			value = args[++i];
+			all_args.push_back (value);
+			separate_value = true;
+		}
+
+		if (prevents_split (name)) {
+			can_split = false;
+		}
+
+		if (name == PSTR("o")) {
+			output_file = value;
+			continue;
+		}
+
+		if (name == PSTR("filetype")) {
+			object_output = value == PSTR("obj");
+		}
+
+		llc_args.push_back (arg);
+		if (separate_value) {
+			llc_args.push_back (value);
+		}
+	}
+
+	if (!object_output || input_file.empty () || output_file.empty () || output_file == PSTR("-")) {
+		can_split = false;
+	}
+
+	return true;
+}
+
+bool LlcSplit::parse_count (platform::string_view arg, platform::string_view param, uint32_t &count)
+{
+	platform::string value { arg.substr (param.length ()) };
+	try {
+		count = static_cast<uint32_t>(std::stoul (value));
+	} catch (std::exception const&) {
+		STDERR << "Invalid " << param << " value: " << value << Constants::newline;
+		return false;
+	}
+
+	return true;
+}
+
+platform::string LlcSplit::option_name (platform::string_view option)
+{
+	option.remove_prefix (option.starts_with (PSTR("--")) ? 2 : 1);
+	size_t equals = option.find (PCHAR('='));
+	if (equals != platform::string_view::npos) {
+		option = option.substr (0, equals);
+	}
+
+	return platform::string { option };
+}
+
+bool LlcSplit::takes_value (platform::string_view option) noexcept
+{
+	return std::find (options_with_value.begin (), options_with_value.end (), option) != options_with_value.end ();
+}
+
+bool LlcSplit::prevents_split (platform::string_view option) noexcept
+{
+	return std::find (options_preventing_split.begin (), options_preventing_split.end (), option) != options_preventing_split.end ();
+}
+
+uint32_t LlcSplit::partition_count () const
+{
+	uint32_t partitions = max_partitions;
+	if (partitions == 0) {
+		char const* value = std::getenv (partitions_variable);
+		if (value != nullptr && *value != '\0') {
+			partitions = static_cast<uint32_t>(std::strtoul (value, nullptr, 10));
+		} else {
+			partitions = std::thread::hardware_concurrency ();
+		}
+	}
+
+	std::error_code ec;
+	uintmax_t size = fs::file_size (input_file, ec);
+	if (ec) {
+		return 1;
+	}
+
+	return static_cast<uint32_t>(std::min<uintmax_t> (partitions, size / min_partition_size));
+}
+
+fs::path LlcSplit::tool_path (platform::string_view name) const
+{
+	fs::path ret = llc.parent_path ();
+	ret /= name;
+	ret += llc.extension ();
+	return ret;
+}
+
+int LlcSplit::run_llc () const
+{
+	Process process { llc };
+	for (platform::string const& arg : all_args) {
+		process.append_program_argument (arg);
+	}
+
+	return process.run (false);
+}
+
+bool LlcSplit::is_bitcode (fs::path const& path)
+{
+	std::ifstream is { path, std::ios::binary };
+	std::array<char, 4> magic {};
+	if (!is.read (magic.data (), magic.size ())) {
+		return false;
+	}
+
+	// Raw bitcode, or bitcode in a wrapper (as written for Darwin targets)
+	constexpr std::array<char, 4> raw_magic { 'B', 'C', '\xc0', '\xde' };
+	constexpr std::array<char, 4> wrapper_magic { '\xde', '\xc0', '\x17', '\x0b' };
+	return magic == raw_magic || magic == wrapper_magic;
+}
+
+int LlcSplit::run_llvm_split (fs::path const& module, uint32_t partitions, fs::path const& prefix, bool preserve_locals) const
+{
+	Process split { tool_path (PSTR("llvm-split")) };
+	if (preserve_locals) {
+		split.append_program_argument (PSTR("-preserve-locals"));
+	}
+	split.append_program_argument (PSTR("-j"));
+	split.append_program_argument (to_platform_string (partitions));
+	split.append_program_argument (PSTR("-o"));
+	split.append_program_argument (prefix.native ());
+	split.append_program_argument (module.native ());
+
+	int ret = split.run (false);
+	if (ret != 0) {
+		STDERR << "Failed to split module " << input_file.native () << Constants::newline;
+	}
+
+	return ret;
+}
+
+int LlcSplit::read_global_symbols (fs::path const& module, fs::path const& list_file, std::unordered_set<std::string> &globals) const
+{
+	Process nm { tool_path (PSTR("llvm-nm")) };
+	nm.append_program_argument (PSTR("--defined-only"));
+	nm.append_program_argument (PSTR("--extern-only"));
+	nm.append_program_argument (PSTR("--format=just-symbols"));
+	nm.append_program_argument (module.native ());
+	nm.redirect_stdout (list_file);
+
+	int ret = nm.run (false);
+	if (ret != 0) {
+		STDERR << "Failed to list the symbols of module " << input_file.native () << Constants::newline;
+		return ret;
+	}
+
+	std::ifstream is { list_file };
+	std::string name;
+	while (std::getline (is, name)) {
+		if (!name.empty () && name.back () == '\r') {
+			name.pop_back ();
+		}
+		globals.insert (std::move (name));
+	}
+
+	if (is.bad ()) {
+		STDERR << "Failed to read the symbols of module " << input_file.native () << Constants::newline;
+		return Constants::wrapper_general_error_code;
+	}
+
+	return 0;
+}
+
+bool LlcSplit::localize_split_symbols (fs::path const& object_file, std::unordered_set<std::string> const& globals) const
+{
+	try {
+		ElfObject object = ElfObject::read (object_file);
+		object.localize_symbols (
+			[&globals](ElfSymbol const& symbol) -> bool {
+				return symbol.is_defined () && symbol.binding () == ElfObject::STB_GLOBAL &&
+					symbol.visibility () == ElfObject::STV_HIDDEN && !globals.contains (symbol.name);
+			}
+		);
+
+		// `llvm-split` made them hidden as well, while local symbols of the module had the default visibility
+		for (ElfSymbol &symbol : object.symbols ()) {
+			if (symbol.binding () == ElfObject::STB_LOCAL && symbol.visibility () == ElfObject::STV_HIDDEN) {
+				symbol.other = static_cast<uint8_t>((symbol.other & ~0x03) | ElfObject::STV_DEFAULT);
+			}
+		}
+		object.write (object_file);
+	} catch (std::exception const& ex) {
+		STDERR << "Failed to restore the local symbols of " << input_file.native () << ". " << ex.what () << Constants::newline;
+		return false;
+	}
+
+	return true;
+}
+
+int LlcSplit::split_and_compile (uint32_t partitions)
+{
+	fs::path work_dir = FileUtils::make_temporary_path (output_file);
+	std::error_code ec;
+	if (!fs::create_directory (work_dir, ec)) {
+		STDERR << "Failed to create directory " << work_dir.native () << ". " << ec.message ().c_str () << Constants::newline;
+		return Constants::wrapper_general_error_code;
+	}
+
+	ScopeGuard remove_work_dir {
+		[&work_dir]() {
+			std::error_code ec;
+			fs::remove_all (work_dir, ec);
+		}
+	};
+
+	// `llvm-nm` reads only bitcode.  A single partition written by `llvm-split` is the whole module, in bitcode.
+	fs::path module = input_file;
+	int ret;
+	if (!is_bitcode (input_file)) {
+		fs::path prefix = work_dir / PSTR("module");
+		ret = run_llvm_split (input_file, 1, prefix, true /* preserve_locals */);
+		if (ret != 0) {
+			return ret;
+		}
+		module = prefix;
+		module += PSTR("0");
+	}
+
+	std::unordered_set<std::string> globals;
+	ret = read_global_symbols (module, work_dir / PSTR("globals.txt"), globals);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// `llvm-split` writes the partitions to `<prefix>0` ... `<prefix>N-1`
+	fs::path prefix = work_dir / PSTR("part");
+	ret = run_llvm_split (module, partitions, prefix, false /* preserve_locals */);
+	if (ret != 0) {
+		return ret;
+	}
+
+	std::vector<Job> jobs;
+	std::vector<fs::path> objects;
+	for (uint32_t i = 0; i < partitions; i++) {
+		Job job;
+		job.input_file = prefix;
+		job.input_file += to_platform_string (i);
+		job.output_file = job.input_file;
+		job.output_file += PSTR(".o");
+		job.input_size = fs::file_size (job.input_file, ec);
+
+		job.process = std::make_unique<Process> (llc);
+		for (platform::string const& arg : llc_args) {
+			job.process->append_program_argument (arg);
+		}
+		job.process->append_program_argument (PSTR("-o"));
+		job.process->append_program_argument (job.output_file.native ());
+		job.process->append_program_argument (job.input_file.native ());
+
+		objects.push_back (job.output_file);
+		jobs.push_back (std::move (job));
+	}
+
+	uint32_t jobs_count = max_jobs == 0 ? std::thread::hardware_concurrency () : max_jobs;
+	JobScheduler scheduler { jobs_count };
+	ret = scheduler.run (
+		jobs,
+		[](Job &job) -> int {
+			int ret = job.process->run (false);
+			if (ret != 0) {
+				STDERR << "Failed to compile partition " << job.input_file.filename ().native () << Constants::newline;
+			}
+			return ret;
+		}
+	);
+
+	if (ret != 0) {
+		return ret;
+	}
+
+	// In partition order, so that the output doesn't depend on the order the jobs finished in
+	fs::path merged = work_dir / PSTR("merged.o");
+	Process ld { tool_path (PSTR("ld")) };
+	ld.append_program_argument (PSTR("--relocatable"));
+	ld.append_program_argument (PSTR("-o"));
+	ld.append_program_argument (merged.native ());
+	for (fs::path const& object : objects) {
+		ld.append_program_argument (object.native ());
+	}
+
+	ret = ld.run (false);
+	if (ret != 0) {
+		STDERR << "Failed to merge the objects of " << input_file.native () << Constants::newline;
+		return ret;
+	}
+
+	if (!localize_split_symbols (merged, globals)) {
+		return Constants::wrapper_general_error_code;
+	}
+
+	fs::rename (merged, output_file, ec);
+	if (ec) {
+		STDERR << "Failed to create output file " << output_file.native () << ". " << ec.message ().c_str () << Constants::newline;
+		return Constants::wrapper_general_error_code;
+	}
+
+	return 0;
+}
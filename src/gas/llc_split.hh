@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__LLC_SPLIT_HH)
+#define __LLC_SPLIT_HH
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// `llc-split`: generates code for a large bitcode module on all the available cores.  It is a program of its own,
+	// taking the same arguments as `llc`.  The module is split into partitions by `llvm-split` (LLVM's SplitModule,
+	// which gives the local symbols hidden global linkage, so that references between the partitions still resolve),
+	// every partition is compiled by its own `llc` process with the original options and the objects are merged with
+	// `ld --relocatable` into the requested output, the way `as` merges the objects of multiple inputs.  The symbols
+	// which weren't global in the module (according to `llvm-nm`) are then made local again, as two outputs defining
+	// e.g. a `static` helper of the same name would otherwise clash in the final link.  All the tools are expected in
+	// the same directory as `llc-split`.
+	//
+	// `llc` runs unchanged if the output isn't an object file, the input or output is stdin/stdout, an option writes
+	// files of its own (e.g. `-split-dwarf-file`) or stops code generation early (e.g. `-stop-after`), or the input is
+	// too small to be worth splitting.  The number of partitions defaults to the number of CPUs and can be set with
+	// `--partitions=N` or the `XA_LLC_PARTITIONS` environment variable, `--split-jobs=N` limits the number of `llc`
+	// processes running at the same time.
+	class LlcSplit final
+	{
+		// Smallest part of the input worth a partition of its own, splitting and merging have their own costs
+		static constexpr uintmax_t min_partition_size = 256 * 1024;
+
+	public:
+		static constexpr platform::string_view partitions_param { PSTR("--partitions=") };
+		static constexpr platform::string_view jobs_param { PSTR("--split-jobs=") };
+		static constexpr char const partitions_variable[] = "XA_LLC_PARTITIONS";
+#if defined (_WIN32)
+		static constexpr platform::string_view llc_name { PSTR("llc.exe") };
+#else
+		static constexpr platform::string_view llc_name { "llc" };
+#endif
+
+	public:
+		explicit LlcSplit (fs::path const& llc);
+
+		// `program_dir` is the directory of `llc-split` and the other tools, `args` the complete command line
+		static int run (fs::path const& program_dir, std::vector<platform::string> const& args);
+
+	private:
+		bool parse_arguments (std::vector<platform::string> const& args);
+		int run_llc () const;
+		int split_and_compile (uint32_t partitions);
+		int run_llvm_split (fs::path const& module, uint32_t partitions, fs::path const& prefix, bool preserve_locals) const;
+		int read_global_symbols (fs::path const& module, fs::path const& list_file, std::unordered_set<std::string> &globals) const;
+		bool localize_split_symbols (fs::path const& object_file, std::unordered_set<std::string> const& globals) const;
+		uint32_t partition_count () const;
+		fs::path tool_path (platform::string_view name) const;
+
+		static bool is_bitcode (fs::path const& path);
+		static bool takes_value (platform::string_view option) noexcept;
+		static bool prevents_split (platform::string_view option) noexcept;
+		static platform::string option_name (platform::string_view option);
+		static bool parse_count (platform::string_view arg, platform::string_view param, uint32_t &count);
+
+	private:
+		fs::path const                llc;
+		std::vector<platform::string> all_args;   // passed to `llc` when it runs unchanged
+		std::vector<platform::string> llc_args;   // without the input and output files
+		fs::path                      input_file;
+		fs::path                      output_file;
+		bool                          object_output = false;
+		bool                          can_split = true;
+		uint32_t                      max_partitions = 0;
+		uint32_t                      max_jobs = 0;
+	};
+}
+#endif // __LLC_SPLIT_HH
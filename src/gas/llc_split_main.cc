@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+#include <vector>
+
+#include "gas.hh"
+#include "llc_split.hh"
+#include "platform.hh"
+
+#if defined(_WIN32)
+int wmain (int argc, wchar_t **argv)
+#else
+int main (int argc, char **argv)
+#endif
+{
+	xamarin::android::gas::Gas::platform_setup ();
+
+	// Only used to find the program's directory, which is done differently on each platform
+	xamarin::android::gas::Gas app;
+	std::vector<platform::string> args = app.get_command_line (argc, argv);
+	app.determine_program_dir (args);
+
+	return xamarin::android::gas::LlcSplit::run (app.program_dir (), args);
+}
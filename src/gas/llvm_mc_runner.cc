@@ -1,11 +1,13 @@
 // SPDX-License-Identifier: MIT
 #include <sys/types.h>
 
+#include <algorithm>
 #include <cstring>
 #include <cerrno>
 #include <memory>
 
 #include "constants.hh"
+#include "exceptions.hh"
 #include "llvm_mc_runner.hh"
 #include "platform.hh"
 #include "process.hh"
@@ -15,12 +17,14 @@ using namespace xamarin::android::gas;
 // Value is `true` if the option can be set multiple times
 std::unordered_map<LlvmMcArgument, bool> LlvmMcRunner::known_options {
 	{ LlvmMcArgument::Arch,          false },
+	{ LlvmMcArgument::DebugPrefixMap, true },
 	{ LlvmMcArgument::FileType,      false },
 	{ LlvmMcArgument::IncludeDir,    true },
 	{ LlvmMcArgument::Mcpu,          false },
 	{ LlvmMcArgument::Output,        false },
 	{ LlvmMcArgument::Mattr,         true },
 	{ LlvmMcArgument::GenerateDebug, false},
+	{ LlvmMcArgument::RelaxRelocations, false },
 };
 
 int LlvmMcRunner::run (fs::path const& executable_path)
@@ -30,6 +34,11 @@ int LlvmMcRunner::run (fs::path const& executable_path)
 		return Constants::wrapper_exec_failed_error_code;
 	}
 
+	return create_process (executable_path)->run ();
+}
+
+std::unique_ptr<Process> LlvmMcRunner::create_process (fs::path const& executable_path)
+{
 	auto process = std::make_unique<Process> (executable_path);
 	auto opt = arguments.find (LlvmMcArgument::Arch);
 	if (opt != arguments.end ()) {
@@ -44,23 +53,156 @@ int LlvmMcRunner::run (fs::path const& executable_path)
 		process->append_program_argument (PSTR("-g"));
 	}
 
+	opt = arguments.find (LlvmMcArgument::DebugPrefixMap);
+	if (opt != arguments.end ()) {
+		process->append_program_argument (PSTR("--fdebug-prefix-map"), opt->second);
+	}
+
 	opt = arguments.find (LlvmMcArgument::FileType);
 	if (opt != arguments.end ()) {
 		process->append_program_argument (PSTR("--filetype"), opt->second);
 	}
 
+	opt = arguments.find (LlvmMcArgument::IncludeDir);
+	if (opt != arguments.end ()) {
+		process->append_program_argument (PSTR("-I"), opt->second);
+	}
+
 	opt = arguments.find (LlvmMcArgument::Mattr);
 	if (opt != arguments.end ()) {
 		process->append_program_argument (PSTR("--mattr"), opt->second, true /* uses_comma_separated_list */);
 	}
 
+	opt = arguments.find (LlvmMcArgument::Mcpu);
+	if (opt != arguments.end ()) {
+		process->append_program_argument (PSTR("--mcpu"), opt->second);
+	}
+
+	opt = arguments.find (LlvmMcArgument::RelaxRelocations);
+	if (opt != arguments.end ()) {
+		process->append_program_argument (PSTR("--relax-relocations"), opt->second);
+	}
+
 	opt = arguments.find (LlvmMcArgument::Output);
 	if (opt != arguments.end ()) {
 		process->append_program_argument (PSTR("-o"), opt->second);
 	}
 
 	platform::string input_file { PSTR("\"") + input_file_path.make_preferred ().native () + PSTR("\"") };
-	process->append_program_argument (input_file_path.make_preferred ().native ());
+	if (input_from_stdin) {
+		process->append_program_argument (PSTR("--main-file-name"), input_file_path.make_preferred ().native ());
+		process->append_program_argument (PSTR("-"));
+	} else {
+		process->append_program_argument (input_file_path.make_preferred ().native ());
+	}
+
+	return process;
+}
+
+std::string LlvmMcRunner::to_utf8 (platform::string const& s)
+{
+#if !defined(_WIN32)
+	return s;
+#else
+	std::string ret (s.length (), 0);
+	std::transform (
+		s.begin (),
+		s.end (),
+		ret.begin (),
+		[](platform::string::value_type ch) {
+			return static_cast<std::string::value_type>(ch); }
+	);
+	return ret;
+#endif
+}
+
+platform::string LlvmMcRunner::split_extensions (platform::string const& value, attribute_map const& extension_map, std::vector<platform::string> &attributes)
+{
+	size_t plus = value.find (PCHAR('+'));
+	platform::string name = value.substr (0, plus);
+
+	while (plus != platform::string::npos) {
+		size_t next = value.find (PCHAR('+'), plus + 1);
+		platform::string extension = value.substr (plus + 1, next == platform::string::npos ? platform::string::npos : next - plus - 1);
+		plus = next;
+
+		bool disable = false;
+		auto mc_extension = extension_map.find (extension);
+		if (mc_extension == extension_map.end () && extension.starts_with (PSTR("no"))) {
+			disable = true;
+			mc_extension = extension_map.find (extension.substr (2));
+		}
+
+		if (mc_extension == extension_map.end ()) {
+			std::string message { "Unknown GAS architecture extension '" };
+			message.append (to_utf8 (extension));
+			message.append ("' in '");
+			message.append (to_utf8 (value));
+			message.append ("'");
+			throw invalid_argument_error { message };
+		}
+
+		if (mc_extension->second.empty ()) {
+			std::string message { "Unable to map known GAS architecture extension '" };
+			message.append (to_utf8 (extension));
+			message.append ("' to llvm-mc value");
+			throw invalid_operation_error { message };
+		}
+
+		for (platform::string attr : mc_extension->second) {
+			if (disable) {
+				attr[0] = PCHAR('-');
+			}
+			attributes.push_back (std::move (attr));
+		}
+	}
+
+	return name;
+}
+
+void LlvmMcRunner::map_gas_arch (platform::string const& value, attribute_map const& arch_map, attribute_map const& extension_map)
+{
+	std::vector<platform::string> extension_attributes;
+	platform::string arch = split_extensions (value, extension_map, extension_attributes);
+
+	auto mc_arch = arch_map.find (arch);
+	if (mc_arch == arch_map.end ()) {
+		std::string message { "Unknown GAS architecture: " };
+		message.append (to_utf8 (arch));
+		throw invalid_argument_error { message };
+	}
+
+	if (mc_arch->second.empty ()) {
+		std::string message { "Unable to map known GAS architecture '" };
+		message.append (to_utf8 (arch));
+		message.append ("' to llvm-mc value");
+		throw invalid_operation_error { message };
+	}
+
+	std::vector<platform::string> attrs = mc_arch->second;
+	attrs.insert (attrs.end (), extension_attributes.begin (), extension_attributes.end ());
+	set_arch_attributes (attrs);
+}
+
+void LlvmMcRunner::map_gas_cpu (platform::string const& value, cpu_map const& cpus, attribute_map const& extension_map)
+{
+	std::vector<platform::string> extension_attributes;
+	platform::string cpu = split_extensions (value, extension_map, extension_attributes);
+
+	auto mc_cpu = cpus.find (cpu);
+	if (mc_cpu == cpus.end ()) {
+		std::string message { "Unknown GAS CPU type: " };
+		message.append (to_utf8 (cpu));
+		throw invalid_argument_error { message };
+	}
+
+	if (mc_cpu->second.empty ()) {
+		std::string message { "Unable to map known GAS CPU type '" };
+		message.append (to_utf8 (cpu));
+		message.append ("' to llvm-mc value");
+		throw invalid_operation_error { message };
+	}
 
-	return process->run ();
+	set_mcpu (mc_cpu->second);
+	append_attributes (extension_attributes);
 }
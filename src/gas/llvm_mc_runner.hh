@@ -2,7 +2,9 @@
 #if !defined (__LLVM_MC_RUNNER_HH)
 #define __LLVM_MC_RUNNER_HH
 
+#include <algorithm>
 #include <filesystem>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -16,12 +18,14 @@ namespace xamarin::android::gas
 	enum class LlvmMcArgument
 	{
 		Arch,
+		DebugPrefixMap,
 		FileType,
 		GenerateDebug,
 		IncludeDir,
 		Mattr,
 		Mcpu,
 		Output,
+		RelaxRelocations,
 	};
 
 	enum class LlvmMcArchitecture
@@ -38,6 +42,13 @@ namespace xamarin::android::gas
 		// Value is `true` if the option can be set multiple times
 		static std::unordered_map<LlvmMcArgument, bool> known_options;
 
+		// GAS name to the list of llvm-mc `--mattr` attributes.  An empty list means GAS knows the name, but it has
+		// no llvm-mc equivalent.
+		using attribute_map = std::unordered_map<platform::string, std::vector<platform::string>>;
+
+		// GAS CPU name to the llvm-mc `--mcpu` value, empty if llvm-mc has no model for the CPU
+		using cpu_map = std::unordered_map<platform::string, platform::string>;
+
 	public:
 		virtual ~LlvmMcRunner ()
 		{}
@@ -80,14 +91,37 @@ namespace xamarin::android::gas
 			set_option (LlvmMcArgument::IncludeDir, include_path.native ());
 		}
 
+		// The process created by `create_process` reads the input from its stdin, the input file name is used only in
+		// the debug info
+		void read_input_from_stdin (bool enable = true)
+		{
+			input_from_stdin = enable;
+		}
+
 		void generate_debug_info ()
 		{
 			set_option (LlvmMcArgument::GenerateDebug);
 		}
 
+		// `mapping` has the form `OLD=NEW`, source paths in the debug info starting with `OLD` will have that prefix
+		// replaced with `NEW`
+		void add_debug_prefix_map (platform::string const& mapping)
+		{
+			size_t separator = mapping.find (PCHAR('='));
+			if (separator == platform::string::npos || separator == 0) {
+				throw invalid_argument_error { "Debug prefix map must have the form OLD=NEW" };
+			}
+
+			set_option (LlvmMcArgument::DebugPrefixMap, mapping);
+		}
+
 		virtual void map_option (platform::string const& gas_name, platform::string const& value = PSTR("")) = 0;
 		int run (fs::path const& executable_path);
 
+		// Creates, but doesn't run, the `llvm-mc` process for the current set of options and the current input file.
+		// Used when several input files are assembled concurrently.
+		std::unique_ptr<Process> create_process (fs::path const& executable_path);
+
 	protected:
 		LlvmMcRunner (LlvmMcArchitecture arch)
 		{
@@ -123,6 +157,14 @@ namespace xamarin::android::gas
 			set_option (LlvmMcArgument::Arch, arch);
 		}
 
+		// Switches to a variant of the architecture the runner was created for (e.g. ARM to Thumb), which needs a
+		// different `--arch` and target triple
+		void change_target (platform::string const& arch, platform::string const& triple_prefix)
+		{
+			arguments[LlvmMcArgument::Arch] = arch;
+			triple = triple_prefix + PSTR("-linux-gnu");
+		}
+
 		void set_mcpu (platform::string const& cpu)
 		{
 			set_option (LlvmMcArgument::Mcpu, cpu);
@@ -173,10 +215,50 @@ namespace xamarin::android::gas
 			}
 		}
 
+		// Replaces the attributes which select the architecture (set by the constructor or an earlier `-march`)
+		void set_arch_attributes (std::vector<platform::string> const& attrs)
+		{
+			remove_attributes (arch_attributes);
+			arch_attributes = attrs;
+			append_attributes (arch_attributes);
+		}
+
+		// Maps GAS `-march=ARCH[+EXT...]` to llvm-mc attributes, the last `-march` wins like with GAS.  Throws if
+		// either the architecture or any of the extensions is unknown or cannot be mapped.
+		void map_gas_arch (platform::string const& value, attribute_map const& arch_map, attribute_map const& extension_map);
+
+		// Maps GAS `-mcpu=CPU[+EXT...]` to llvm-mc `--mcpu` and attributes
+		void map_gas_cpu (platform::string const& value, cpu_map const& cpus, attribute_map const& extension_map);
+
+		// Splits `name+ext1+noext2...` into the name and the `--mattr` attributes for the extensions.  Every extension
+		// can be turned off by prefixing its name with `no`, which turns off all of its attributes.
+		static platform::string split_extensions (platform::string const& value, attribute_map const& extension_map, std::vector<platform::string> &attributes);
+
+		// GAS option values are ASCII
+		static std::string to_utf8 (platform::string const& s);
+
+		void remove_attributes (std::vector<platform::string> const& attrs)
+		{
+			auto iter = arguments.find (LlvmMcArgument::Mattr);
+			if (iter == arguments.end ()) {
+				return;
+			}
+
+			Process::string_list &current_attrs = std::get<Process::string_list> (iter->second);
+			for (platform::string const& attr : attrs) {
+				auto attr_iter = std::find (current_attrs.begin (), current_attrs.end (), attr);
+				if (attr_iter != current_attrs.end ()) {
+					current_attrs.erase (attr_iter);
+				}
+			}
+		}
+
 	private:
 		std::unordered_map<LlvmMcArgument, Process::process_argument> arguments;
 		fs::path input_file_path;
 		platform::string triple;
+		bool input_from_stdin = false;
+		std::vector<platform::string> arch_attributes;
 	};
 
 	class LlvmMcRunnerARM64 final : public LlvmMcRunner
@@ -190,6 +272,11 @@ namespace xamarin::android::gas
 		{}
 
 		virtual void map_option (platform::string const& gas_name, platform::string const& value = PSTR("")) override final;
+
+	private:
+		static attribute_map arch_type_map;
+		static attribute_map arch_extension_map;
+		static cpu_map       cpu_type_map;
 	};
 
 	class LlvmMcRunnerARM32 final : public LlvmMcRunner
@@ -198,8 +285,8 @@ namespace xamarin::android::gas
 		LlvmMcRunnerARM32 ()
 			: LlvmMcRunner (LlvmMcArchitecture::ARM32)
 		{
-			// We always target ARMv7-a
-			append_attribute (PSTR("+armv7-a"));
+			// We target ARMv7-a unless told otherwise with `-march`
+			set_arch_attributes ({ PSTR("+armv7-a") });
 		}
 
 		virtual ~LlvmMcRunnerARM32 ()
@@ -208,33 +295,54 @@ namespace xamarin::android::gas
 		virtual void map_option (platform::string const& gas_name, platform::string const& value = PSTR("")) override final;
 
 	private:
-		static std::unordered_map<platform::string, std::vector<platform::string>> fpu_type_map;
+		void map_fpu (platform::string const& value);
+
+	private:
+		static attribute_map fpu_type_map;
+		static attribute_map arch_type_map;
+		static attribute_map arch_extension_map;
+		static cpu_map       cpu_type_map;
 	};
 
-	class LlvmMcRunnerX64 final : public LlvmMcRunner
+	// x86 and x86_64 accept the same options, `--32` and `--64` switch between them like with GAS
+	class LlvmMcRunnerX86Family : public LlvmMcRunner
+	{
+	public:
+		virtual ~LlvmMcRunnerX86Family ()
+		{}
+
+		virtual void map_option (platform::string const& gas_name, platform::string const& value = PSTR("")) override final;
+
+	protected:
+		LlvmMcRunnerX86Family (LlvmMcArchitecture arch)
+			: LlvmMcRunner (arch)
+		{}
+
+	private:
+		static attribute_map arch_extension_map;
+		static cpu_map       cpu_type_map;
+	};
+
+	class LlvmMcRunnerX64 final : public LlvmMcRunnerX86Family
 	{
 	public:
 		LlvmMcRunnerX64 ()
-			: LlvmMcRunner (LlvmMcArchitecture::X64)
+			: LlvmMcRunnerX86Family (LlvmMcArchitecture::X64)
 		{}
 
 		virtual ~LlvmMcRunnerX64 ()
 		{}
-
-		virtual void map_option (platform::string const& gas_name, platform::string const& value = PSTR("")) override final;
 	};
 
-	class LlvmMcRunnerX86 final : public LlvmMcRunner
+	class LlvmMcRunnerX86 final : public LlvmMcRunnerX86Family
 	{
 	public:
 		LlvmMcRunnerX86 ()
-			: LlvmMcRunner (LlvmMcArchitecture::X86)
+			: LlvmMcRunnerX86Family (LlvmMcArchitecture::X86)
 		{}
 
 		virtual ~LlvmMcRunnerX86 ()
 		{}
-
-		virtual void map_option (platform::string const& gas_name, platform::string const& value = PSTR("")) override final;
 	};
 }
 #endif // __LLVM_MC_RUNNER_HH
@@ -6,6 +6,7 @@
 
 using namespace xamarin::android::gas;
 
+
 // Mapping isn't complete, because it's not clear to me what some of the entries need to map to, but since most of them
 // are unlikely to be used, I'm providing translation only for the most obvious ones. If there's need for the
 // non-obvious ones, they can be researched better at that time.
@@ -16,7 +17,7 @@ using namespace xamarin::android::gas;
 //
 //   llvm-mc --arch=arm --mattr=help < /dev/null
 //
-std::unordered_map<platform::string, std::vector<platform::string>> LlvmMcRunnerARM32::fpu_type_map {
+LlvmMcRunner::attribute_map LlvmMcRunnerARM32::fpu_type_map {
 	{ PSTR("arm1020e"),               {}},
 	{ PSTR("arm1020t"),               {}},
 	{ PSTR("arm1136jf-s"),            {}},
@@ -51,7 +52,7 @@ std::unordered_map<platform::string, std::vector<platform::string>> LlvmMcRunner
 	{ PSTR("vfpv3"),                  {PSTR("+vfp3")}},
 	{ PSTR("vfp3"),                   {PSTR("+vfp3")}}, // undocumented GAS option, alias for vfpv3 above
 	{ PSTR("vfpv3-d16"),              {PSTR("+vfp3d16")}},
-	{ PSTR("vfpv3-d16-fp16"),         {PSTR("vfp3d16,+fp16")}},
+	{ PSTR("vfpv3-d16-fp16"),         {PSTR("+vfp3d16,+fp16")}},
 	{ PSTR("vfpv3-fp16"),             {PSTR("+vfp3,+fp16")}},
 	{ PSTR("vfpv3xd"),                {}}, // no llvm-mc equivalent?
 	{ PSTR("vfpv3xd-d16"),            {}}, // no llvm-mc equivalent?
@@ -60,32 +61,130 @@ std::unordered_map<platform::string, std::vector<platform::string>> LlvmMcRunner
 	{ PSTR("vfpxd"),                  {}}, // no llvm-mc equivalent?
 };
 
-void LlvmMcRunnerARM32::map_option (platform::string const& gas_name, platform::string const& value)
-{
-	if (gas_name != PSTR("mfpu")) {
-		return;
-	}
+// GAS `-march` values, the attributes replace the default `+armv7-a`.  Architectures without an llvm-mc equivalent
+// (or with one that would produce different code than GAS) map to an empty list.  The list of architectures llvm-mc
+// supports is part of the `--mattr=help` output mentioned above.
+LlvmMcRunner::attribute_map LlvmMcRunnerARM32::arch_type_map {
+	{ PSTR("armv5t"),         {PSTR("+armv5t")}},
+	{ PSTR("armv5te"),        {PSTR("+armv5te")}},
+	{ PSTR("armv5tej"),       {PSTR("+armv5tej")}},
+	{ PSTR("armv6"),          {PSTR("+armv6")}},
+	{ PSTR("armv6j"),         {PSTR("+armv6j")}},
+	{ PSTR("armv6k"),         {PSTR("+armv6k")}},
+	{ PSTR("armv6kz"),        {PSTR("+armv6kz")}},
+	{ PSTR("armv6z"),         {PSTR("+armv6kz")}}, // GAS alias
+	{ PSTR("armv6zk"),        {PSTR("+armv6kz")}}, // GAS alias
+	{ PSTR("armv6t2"),        {PSTR("+armv6t2")}},
+	{ PSTR("armv6-m"),        {PSTR("+armv6-m")}},
+	{ PSTR("armv6s-m"),       {PSTR("+armv6s-m")}},
+	{ PSTR("armv7"),          {}}, // common subset of A, R and M profiles, no llvm-mc equivalent
+	{ PSTR("armv7-a"),        {PSTR("+armv7-a")}},
+	{ PSTR("armv7a"),         {PSTR("+armv7-a")}},
+	{ PSTR("armv7ve"),        {PSTR("+armv7ve")}},
+	{ PSTR("armv7-r"),        {PSTR("+armv7-r")}},
+	{ PSTR("armv7r"),         {PSTR("+armv7-r")}},
+	{ PSTR("armv7-m"),        {PSTR("+armv7-m")}},
+	{ PSTR("armv7m"),         {PSTR("+armv7-m")}},
+	{ PSTR("armv7e-m"),       {PSTR("+armv7e-m")}},
+	{ PSTR("armv8-a"),        {PSTR("+armv8-a")}},
+	{ PSTR("armv8.1-a"),      {PSTR("+armv8.1-a")}},
+	{ PSTR("armv8.2-a"),      {PSTR("+armv8.2-a")}},
+	{ PSTR("armv8.3-a"),      {PSTR("+armv8.3-a")}},
+	{ PSTR("armv8.4-a"),      {PSTR("+armv8.4-a")}},
+	{ PSTR("armv8.5-a"),      {PSTR("+armv8.5-a")}},
+	{ PSTR("armv8.6-a"),      {PSTR("+armv8.6-a")}},
+	{ PSTR("armv8-r"),        {PSTR("+armv8-r")}},
+	{ PSTR("armv8-m.base"),   {PSTR("+armv8-m.base")}},
+	{ PSTR("armv8-m.main"),   {PSTR("+armv8-m.main")}},
+	{ PSTR("armv8.1-m.main"), {PSTR("+armv8.1-m.main")}},
+	{ PSTR("armv9-a"),        {PSTR("+armv9-a")}},
+	{ PSTR("iwmmxt"),         {}},
+	{ PSTR("iwmmxt2"),        {}},
+	{ PSTR("xscale"),         {}},
+};
 
-	if (value.empty ()) {
-		throw invalid_argument_error { "The `-mfpu` option requires a value, argument `value` must not be empty" };
-	}
+// Extensions which can follow the `-march` or `-mcpu` value, e.g. `-march=armv7-a+mp+sec`.  Every extension can also
+// be turned off by prefixing its name with `no` (e.g. `+nosimd`), which turns its attributes off.
+LlvmMcRunner::attribute_map LlvmMcRunnerARM32::arch_extension_map {
+	{ PSTR("crc"),     {PSTR("+crc")}},
+	{ PSTR("crypto"),  {PSTR("+crypto")}},
+	{ PSTR("dotprod"), {PSTR("+dotprod")}},
+	{ PSTR("fp"),      {PSTR("+fp-armv8")}},
+	{ PSTR("fp16"),    {PSTR("+fullfp16")}},
+	{ PSTR("fp16fml"), {PSTR("+fp16fml")}},
+	{ PSTR("bf16"),    {PSTR("+bf16")}},
+	{ PSTR("i8mm"),    {PSTR("+i8mm")}},
+	{ PSTR("idiv"),    {PSTR("+hwdiv"), PSTR("+hwdiv-arm")}},
+	{ PSTR("mp"),      {PSTR("+mp")}},
+	{ PSTR("neon"),    {PSTR("+neon")}},
+	{ PSTR("ras"),     {PSTR("+ras")}},
+	{ PSTR("sb"),      {PSTR("+sb")}},
+	{ PSTR("sec"),     {PSTR("+trustzone")}},
+	{ PSTR("simd"),    {PSTR("+neon")}},
+	{ PSTR("virt"),    {PSTR("+virtualization"), PSTR("+hwdiv"), PSTR("+hwdiv-arm")}},
+	{ PSTR("xscale"),  {}},
+	{ PSTR("iwmmxt"),  {}},
+	{ PSTR("iwmmxt2"), {}},
+	{ PSTR("maverick"),{}},
+};
 
-	auto to_utf8 = [](platform::string const& s) -> std::string {
-#if !defined(_WIN32)
-		return s;
-#else
-		std::string ret (s.length (), 0);
-		std::transform (
-			s.begin (),
-			s.end (),
-			ret.begin (),
-			[](platform::string::value_type ch) {
-				return static_cast<std::string::value_type>(ch); }
-		);
-		return ret;
-#endif
-	};
+// GAS `-mcpu` values and the corresponding llvm-mc `--mcpu` values.  An empty value means the CPU is known to GAS, but
+// llvm-mc has no model for it.  The llvm-mc CPU list can be obtained by running
+//
+//   llvm-mc --arch=arm --mcpu=help < /dev/null
+//
+LlvmMcRunner::cpu_map LlvmMcRunnerARM32::cpu_type_map {
+	{ PSTR("arm926ej-s"),       PSTR("arm926ej-s") },
+	{ PSTR("arm1136j-s"),       PSTR("arm1136j-s") },
+	{ PSTR("arm1136jf-s"),      PSTR("arm1136jf-s") },
+	{ PSTR("arm1176jz-s"),      PSTR("arm1176jz-s") },
+	{ PSTR("arm1176jzf-s"),     PSTR("arm1176jzf-s") },
+	{ PSTR("mpcore"),           PSTR("mpcore") },
+	{ PSTR("mpcorenovfp"),      PSTR("mpcorenovfp") },
+	{ PSTR("cortex-a5"),        PSTR("cortex-a5") },
+	{ PSTR("cortex-a7"),        PSTR("cortex-a7") },
+	{ PSTR("cortex-a8"),        PSTR("cortex-a8") },
+	{ PSTR("cortex-a9"),        PSTR("cortex-a9") },
+	{ PSTR("cortex-a12"),       PSTR("cortex-a12") },
+	{ PSTR("cortex-a15"),       PSTR("cortex-a15") },
+	{ PSTR("cortex-a17"),       PSTR("cortex-a17") },
+	{ PSTR("cortex-a32"),       PSTR("cortex-a32") },
+	{ PSTR("cortex-a35"),       PSTR("cortex-a35") },
+	{ PSTR("cortex-a53"),       PSTR("cortex-a53") },
+	{ PSTR("cortex-a55"),       PSTR("cortex-a55") },
+	{ PSTR("cortex-a57"),       PSTR("cortex-a57") },
+	{ PSTR("cortex-a72"),       PSTR("cortex-a72") },
+	{ PSTR("cortex-a73"),       PSTR("cortex-a73") },
+	{ PSTR("cortex-a75"),       PSTR("cortex-a75") },
+	{ PSTR("cortex-a76"),       PSTR("cortex-a76") },
+	{ PSTR("cortex-a76ae"),     PSTR("cortex-a76ae") },
+	{ PSTR("cortex-a77"),       PSTR("cortex-a77") },
+	{ PSTR("cortex-a78"),       PSTR("cortex-a78") },
+	{ PSTR("cortex-x1"),        PSTR("cortex-x1") },
+	{ PSTR("cortex-r4"),        PSTR("cortex-r4") },
+	{ PSTR("cortex-r4f"),       PSTR("cortex-r4f") },
+	{ PSTR("cortex-r5"),        PSTR("cortex-r5") },
+	{ PSTR("cortex-r7"),        PSTR("cortex-r7") },
+	{ PSTR("cortex-r8"),        PSTR("cortex-r8") },
+	{ PSTR("cortex-r52"),       PSTR("cortex-r52") },
+	{ PSTR("cortex-m0"),        PSTR("cortex-m0") },
+	{ PSTR("cortex-m0plus"),    PSTR("cortex-m0plus") },
+	{ PSTR("cortex-m3"),        PSTR("cortex-m3") },
+	{ PSTR("cortex-m4"),        PSTR("cortex-m4") },
+	{ PSTR("cortex-m7"),        PSTR("cortex-m7") },
+	{ PSTR("cortex-m23"),       PSTR("cortex-m23") },
+	{ PSTR("cortex-m33"),       PSTR("cortex-m33") },
+	{ PSTR("exynos-m1"),        PSTR("exynos-m3") }, // the oldest Exynos model llvm-mc has
+	{ PSTR("krait"),            PSTR("krait") },
+	{ PSTR("kryo"),             PSTR("kryo") },
+	{ PSTR("generic-armv7-a"),  PSTR("generic") },
+	{ PSTR("marvell-pj4"),      PSTR("") },
+	{ PSTR("marvell-whitney"),  PSTR("") },
+	{ PSTR("xgene1"),           PSTR("") },
+};
 
+void LlvmMcRunnerARM32::map_fpu (platform::string const& value)
+{
 	auto mc_fpu = fpu_type_map.find (value);
 	if (mc_fpu == fpu_type_map.end ()) {
 		std::string message { "Unknown GAS FPU type: " };
@@ -102,3 +201,32 @@ void LlvmMcRunnerARM32::map_option (platform::string const& gas_name, platform::
 
 	append_attributes (mc_fpu->second);
 }
+
+void LlvmMcRunnerARM32::map_option (platform::string const& gas_name, platform::string const& value)
+{
+	if (gas_name == PSTR("mthumb")) {
+		// Code is assembled as Thumb (Thumb-2 with ARMv7) until the source switches to ARM with `.arm` or `.code 32`.
+		// llvm-mc always uses the unified syntax, regardless of `.syntax`.
+		change_target (PSTR("thumb"), PSTR("thumb"));
+		return;
+	}
+
+	if (gas_name != PSTR("mfpu") && gas_name != PSTR("march") && gas_name != PSTR("mcpu")) {
+		return;
+	}
+
+	if (value.empty ()) {
+		std::string message { "The `-" };
+		message.append (to_utf8 (gas_name));
+		message.append ("` option requires a value, argument `value` must not be empty");
+		throw invalid_argument_error { message };
+	}
+
+	if (gas_name == PSTR("mfpu")) {
+		map_fpu (value);
+	} else if (gas_name == PSTR("march")) {
+		map_gas_arch (value, arch_type_map, arch_extension_map);
+	} else {
+		map_gas_cpu (value, cpu_type_map, arch_extension_map);
+	}
+}
@@ -1,7 +1,138 @@
 // SPDX-License-Identifier: MIT
+#include "exceptions.hh"
 #include "llvm_mc_runner.hh"
 
 using namespace xamarin::android::gas;
 
-void LlvmMcRunnerARM64::map_option ([[maybe_unused]] platform::string const& gas_name, [[maybe_unused]] platform::string const& value)
-{}
+// GAS `-march` values.  llvm-mc assembles the base ARMv8-a instruction set by default, anything newer (or any of the
+// optional extensions below) must be enabled with `--mattr`, or each source file needs its own `.arch` directive.  The
+// full list of supported attributes can be obtained by running
+//
+//   llvm-mc --arch=aarch64 --mattr=help < /dev/null
+//
+LlvmMcRunner::attribute_map LlvmMcRunnerARM64::arch_type_map {
+	{ PSTR("armv8-a"),   {PSTR("+v8a")}},
+	{ PSTR("armv8.1-a"), {PSTR("+v8.1a")}},
+	{ PSTR("armv8.2-a"), {PSTR("+v8.2a")}},
+	{ PSTR("armv8.3-a"), {PSTR("+v8.3a")}},
+	{ PSTR("armv8.4-a"), {PSTR("+v8.4a")}},
+	{ PSTR("armv8.5-a"), {PSTR("+v8.5a")}},
+	{ PSTR("armv8.6-a"), {PSTR("+v8.6a")}},
+	{ PSTR("armv8.7-a"), {PSTR("+v8.7a")}},
+	{ PSTR("armv8.8-a"), {PSTR("+v8.8a")}},
+	{ PSTR("armv8-r"),   {PSTR("+v8r")}},
+	{ PSTR("armv9-a"),   {PSTR("+v9a")}},
+	{ PSTR("armv9.1-a"), {PSTR("+v9.1a")}},
+	{ PSTR("armv9.2-a"), {PSTR("+v9.2a")}},
+	{ PSTR("armv9.3-a"), {PSTR("+v9.3a")}},
+};
+
+// Extensions which can follow the `-march` or `-mcpu` value, e.g. `-march=armv8.2-a+lse+crc+dotprod`.  Every extension
+// can also be turned off by prefixing its name with `no` (e.g. `+nocrypto`).
+LlvmMcRunner::attribute_map LlvmMcRunnerARM64::arch_extension_map {
+	{ PSTR("aes"),          {PSTR("+aes")}},
+	{ PSTR("bf16"),         {PSTR("+bf16")}},
+	{ PSTR("crc"),          {PSTR("+crc")}},
+	{ PSTR("crypto"),       {PSTR("+crypto")}},
+	{ PSTR("dotprod"),      {PSTR("+dotprod")}},
+	{ PSTR("f32mm"),        {PSTR("+f32mm")}},
+	{ PSTR("f64mm"),        {PSTR("+f64mm")}},
+	{ PSTR("flagm"),        {PSTR("+flagm")}},
+	{ PSTR("fp"),           {PSTR("+fp-armv8")}},
+	{ PSTR("fp16"),         {PSTR("+fullfp16")}},
+	{ PSTR("fp16fml"),      {PSTR("+fp16fml")}},
+	{ PSTR("i8mm"),         {PSTR("+i8mm")}},
+	{ PSTR("ls64"),         {PSTR("+ls64")}},
+	{ PSTR("lse"),          {PSTR("+lse")}},
+	{ PSTR("memtag"),       {PSTR("+mte")}},
+	{ PSTR("mops"),         {PSTR("+mops")}},
+	{ PSTR("pauth"),        {PSTR("+pauth")}},
+	{ PSTR("predres"),      {PSTR("+predres")}},
+	{ PSTR("profile"),      {PSTR("+spe")}},
+	{ PSTR("ras"),          {PSTR("+ras")}},
+	{ PSTR("rcpc"),         {PSTR("+rcpc")}},
+	{ PSTR("rdma"),         {PSTR("+rdm")}},
+	{ PSTR("rng"),          {PSTR("+rand")}},
+	{ PSTR("sb"),           {PSTR("+sb")}},
+	{ PSTR("sha2"),         {PSTR("+sha2")}},
+	{ PSTR("sha3"),         {PSTR("+sha3")}},
+	{ PSTR("simd"),         {PSTR("+neon")}},
+	{ PSTR("sm4"),          {PSTR("+sm4")}},
+	{ PSTR("ssbs"),         {PSTR("+ssbs")}},
+	{ PSTR("sve"),          {PSTR("+sve")}},
+	{ PSTR("sve2"),         {PSTR("+sve2")}},
+	{ PSTR("sve2-aes"),     {PSTR("+sve2-aes")}},
+	{ PSTR("sve2-bitperm"), {PSTR("+sve2-bitperm")}},
+	{ PSTR("sve2-sha3"),    {PSTR("+sve2-sha3")}},
+	{ PSTR("sve2-sm4"),     {PSTR("+sve2-sm4")}},
+	{ PSTR("tme"),          {PSTR("+tme")}},
+	{ PSTR("pan"),          {}}, // part of ARMv8.1-a, can't be enabled separately in llvm-mc
+	{ PSTR("lor"),          {}}, // as above
+};
+
+// GAS `-mcpu` values and the corresponding llvm-mc `--mcpu` values.  The llvm-mc CPU list can be obtained by running
+//
+//   llvm-mc --arch=aarch64 --mcpu=help < /dev/null
+//
+LlvmMcRunner::cpu_map LlvmMcRunnerARM64::cpu_type_map {
+	{ PSTR("a64fx"),          PSTR("a64fx") },
+	{ PSTR("ampere1"),        PSTR("ampere1") },
+	{ PSTR("carmel"),         PSTR("carmel") },
+	{ PSTR("cortex-a34"),     PSTR("cortex-a34") },
+	{ PSTR("cortex-a35"),     PSTR("cortex-a35") },
+	{ PSTR("cortex-a53"),     PSTR("cortex-a53") },
+	{ PSTR("cortex-a55"),     PSTR("cortex-a55") },
+	{ PSTR("cortex-a57"),     PSTR("cortex-a57") },
+	{ PSTR("cortex-a65"),     PSTR("cortex-a65") },
+	{ PSTR("cortex-a65ae"),   PSTR("cortex-a65ae") },
+	{ PSTR("cortex-a72"),     PSTR("cortex-a72") },
+	{ PSTR("cortex-a73"),     PSTR("cortex-a73") },
+	{ PSTR("cortex-a75"),     PSTR("cortex-a75") },
+	{ PSTR("cortex-a76"),     PSTR("cortex-a76") },
+	{ PSTR("cortex-a76ae"),   PSTR("cortex-a76ae") },
+	{ PSTR("cortex-a77"),     PSTR("cortex-a77") },
+	{ PSTR("cortex-a78"),     PSTR("cortex-a78") },
+	{ PSTR("cortex-a78c"),    PSTR("cortex-a78c") },
+	{ PSTR("cortex-a510"),    PSTR("cortex-a510") },
+	{ PSTR("cortex-a710"),    PSTR("cortex-a710") },
+	{ PSTR("cortex-r82"),     PSTR("cortex-r82") },
+	{ PSTR("cortex-x1"),      PSTR("cortex-x1") },
+	{ PSTR("cortex-x2"),      PSTR("cortex-x2") },
+	{ PSTR("exynos-m1"),      PSTR("exynos-m3") }, // the oldest Exynos model llvm-mc has
+	{ PSTR("falkor"),         PSTR("falkor") },
+	{ PSTR("kryo"),           PSTR("kryo") },
+	{ PSTR("neoverse-e1"),    PSTR("neoverse-e1") },
+	{ PSTR("neoverse-n1"),    PSTR("neoverse-n1") },
+	{ PSTR("neoverse-n2"),    PSTR("neoverse-n2") },
+	{ PSTR("neoverse-v1"),    PSTR("neoverse-v1") },
+	{ PSTR("saphira"),        PSTR("saphira") },
+	{ PSTR("thunderx"),       PSTR("thunderx") },
+	{ PSTR("thunderxt81"),    PSTR("thunderxt81") },
+	{ PSTR("thunderxt83"),    PSTR("thunderxt83") },
+	{ PSTR("thunderxt88"),    PSTR("thunderxt88") },
+	{ PSTR("thunderx2t99"),   PSTR("thunderx2t99") },
+	{ PSTR("tsv110"),         PSTR("tsv110") },
+	{ PSTR("qdf24xx"),        PSTR("") },
+	{ PSTR("xgene1"),         PSTR("") },
+	{ PSTR("xgene2"),         PSTR("") },
+};
+
+void LlvmMcRunnerARM64::map_option (platform::string const& gas_name, platform::string const& value)
+{
+	if (gas_name != PSTR("march") && gas_name != PSTR("mcpu")) {
+		return;
+	}
+
+	if (value.empty ()) {
+		std::string message { "The `-" };
+		message.append (to_utf8 (gas_name));
+		message.append ("` option requires a value, argument `value` must not be empty");
+		throw invalid_argument_error { message };
+	}
+
+	if (gas_name == PSTR("march")) {
+		map_gas_arch (value, arch_type_map, arch_extension_map);
+	} else {
+		map_gas_cpu (value, cpu_type_map, arch_extension_map);
+	}
+}
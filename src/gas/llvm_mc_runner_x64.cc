@@ -1,7 +0,0 @@
-// SPDX-License-Identifier: MIT
-#include "llvm_mc_runner.hh"
-
-using namespace xamarin::android::gas;
-
-void LlvmMcRunnerX64::map_option ([[maybe_unused]] platform::string const& gas_name, [[maybe_unused]] platform::string const& value)
-{}
@@ -1,7 +1,185 @@
 // SPDX-License-Identifier: MIT
+#include "exceptions.hh"
 #include "llvm_mc_runner.hh"
 
 using namespace xamarin::android::gas;
 
-void LlvmMcRunnerX86::map_option ([[maybe_unused]] platform::string const& gas_name, [[maybe_unused]] platform::string const& value)
-{}
+// GAS `-march` (and `-mtune`) CPU names and the corresponding llvm-mc `--mcpu` values.  The llvm-mc CPU list can be
+// obtained by running
+//
+//   llvm-mc --arch=x86-64 --mcpu=help < /dev/null
+//
+LlvmMcRunner::cpu_map LlvmMcRunnerX86Family::cpu_type_map {
+	{ PSTR("i386"),       PSTR("i386") },
+	{ PSTR("i486"),       PSTR("i486") },
+	{ PSTR("i586"),       PSTR("i586") },
+	{ PSTR("i686"),       PSTR("i686") },
+	{ PSTR("pentium"),    PSTR("pentium") },
+	{ PSTR("pentiumpro"), PSTR("pentiumpro") },
+	{ PSTR("pentiumii"),  PSTR("pentium2") },
+	{ PSTR("pentiumiii"), PSTR("pentium3") },
+	{ PSTR("pentium4"),   PSTR("pentium4") },
+	{ PSTR("prescott"),   PSTR("prescott") },
+	{ PSTR("nocona"),     PSTR("nocona") },
+	{ PSTR("core"),       PSTR("yonah") },
+	{ PSTR("core2"),      PSTR("core2") },
+	{ PSTR("corei7"),     PSTR("corei7") },
+	{ PSTR("k6"),         PSTR("k6") },
+	{ PSTR("k6_2"),       PSTR("k6-2") },
+	{ PSTR("athlon"),     PSTR("athlon") },
+	{ PSTR("opteron"),    PSTR("opteron") },
+	{ PSTR("k8"),         PSTR("k8") },
+	{ PSTR("amdfam10"),   PSTR("amdfam10") },
+	{ PSTR("bdver1"),     PSTR("bdver1") },
+	{ PSTR("bdver2"),     PSTR("bdver2") },
+	{ PSTR("bdver3"),     PSTR("bdver3") },
+	{ PSTR("bdver4"),     PSTR("bdver4") },
+	{ PSTR("btver1"),     PSTR("btver1") },
+	{ PSTR("btver2"),     PSTR("btver2") },
+	{ PSTR("znver1"),     PSTR("znver1") },
+	{ PSTR("znver2"),     PSTR("znver2") },
+	{ PSTR("znver3"),     PSTR("znver3") },
+	{ PSTR("generic32"),  PSTR("i686") },
+	{ PSTR("generic64"),  PSTR("x86-64") },
+	{ PSTR("x86-64"),     PSTR("x86-64") },
+	{ PSTR("x86-64-v2"),  PSTR("x86-64-v2") }, // SSE4.2, POPCNT
+	{ PSTR("x86-64-v3"),  PSTR("x86-64-v3") }, // AVX2, BMI2, FMA, MOVBE
+	{ PSTR("x86-64-v4"),  PSTR("x86-64-v4") }, // AVX-512
+	{ PSTR("iamcu"),      PSTR("lakemont") },
+	{ PSTR("i8086"),      PSTR("") },
+	{ PSTR("i186"),       PSTR("") },
+	{ PSTR("i286"),       PSTR("") },
+	{ PSTR("l1om"),       PSTR("") },
+	{ PSTR("k1om"),       PSTR("") },
+};
+
+// ISA extensions which can follow the `-march` value, e.g. `-march=x86-64+sse4.2+popcnt`.  Every extension can also
+// be turned off by prefixing its name with `no` (e.g. `+noavx`).  The full list of supported attributes can be
+// obtained by running
+//
+//   llvm-mc --arch=x86-64 --mattr=help < /dev/null
+//
+LlvmMcRunner::attribute_map LlvmMcRunnerX86Family::arch_extension_map {
+	{ PSTR("3dnow"),       {PSTR("+3dnow")}},
+	{ PSTR("3dnowa"),      {PSTR("+3dnowa")}},
+	{ PSTR("abm"),         {PSTR("+lzcnt"), PSTR("+popcnt")}},
+	{ PSTR("adx"),         {PSTR("+adx")}},
+	{ PSTR("aes"),         {PSTR("+aes")}},
+	{ PSTR("avx"),         {PSTR("+avx")}},
+	{ PSTR("avx2"),        {PSTR("+avx2")}},
+	{ PSTR("avx512f"),     {PSTR("+avx512f")}},
+	{ PSTR("avx512bw"),    {PSTR("+avx512bw")}},
+	{ PSTR("avx512cd"),    {PSTR("+avx512cd")}},
+	{ PSTR("avx512dq"),    {PSTR("+avx512dq")}},
+	{ PSTR("avx512er"),    {PSTR("+avx512er")}},
+	{ PSTR("avx512ifma"),  {PSTR("+avx512ifma")}},
+	{ PSTR("avx512pf"),    {PSTR("+avx512pf")}},
+	{ PSTR("avx512vbmi"),  {PSTR("+avx512vbmi")}},
+	{ PSTR("avx512vl"),    {PSTR("+avx512vl")}},
+	{ PSTR("avx_vnni"),    {PSTR("+avxvnni")}},
+	{ PSTR("bmi"),         {PSTR("+bmi")}},
+	{ PSTR("bmi2"),        {PSTR("+bmi2")}},
+	{ PSTR("cldemote"),    {PSTR("+cldemote")}},
+	{ PSTR("clflushopt"),  {PSTR("+clflushopt")}},
+	{ PSTR("clwb"),        {PSTR("+clwb")}},
+	{ PSTR("clzero"),      {PSTR("+clzero")}},
+	{ PSTR("cx16"),        {PSTR("+cx16")}},
+	{ PSTR("f16c"),        {PSTR("+f16c")}},
+	{ PSTR("fma"),         {PSTR("+fma")}},
+	{ PSTR("fma4"),        {PSTR("+fma4")}},
+	{ PSTR("fsgsbase"),    {PSTR("+fsgsbase")}},
+	{ PSTR("gfni"),        {PSTR("+gfni")}},
+	{ PSTR("lwp"),         {PSTR("+lwp")}},
+	{ PSTR("lzcnt"),       {PSTR("+lzcnt")}},
+	{ PSTR("mmx"),         {PSTR("+mmx")}},
+	{ PSTR("movbe"),       {PSTR("+movbe")}},
+	{ PSTR("movdir64b"),   {PSTR("+movdir64b")}},
+	{ PSTR("movdiri"),     {PSTR("+movdiri")}},
+	{ PSTR("mwaitx"),      {PSTR("+mwaitx")}},
+	{ PSTR("pclmul"),      {PSTR("+pclmul")}},
+	{ PSTR("popcnt"),      {PSTR("+popcnt")}},
+	{ PSTR("prfchw"),      {PSTR("+prfchw")}},
+	{ PSTR("ptwrite"),     {PSTR("+ptwrite")}},
+	{ PSTR("rdpid"),       {PSTR("+rdpid")}},
+	{ PSTR("rdrnd"),       {PSTR("+rdrnd")}},
+	{ PSTR("rdseed"),      {PSTR("+rdseed")}},
+	{ PSTR("rtm"),         {PSTR("+rtm")}},
+	{ PSTR("serialize"),   {PSTR("+serialize")}},
+	{ PSTR("sha"),         {PSTR("+sha")}},
+	{ PSTR("sse"),         {PSTR("+sse")}},
+	{ PSTR("sse2"),        {PSTR("+sse2")}},
+	{ PSTR("sse3"),        {PSTR("+sse3")}},
+	{ PSTR("sse4"),        {PSTR("+sse4.2")}},
+	{ PSTR("sse4.1"),      {PSTR("+sse4.1")}},
+	{ PSTR("sse4.2"),      {PSTR("+sse4.2")}},
+	{ PSTR("sse4a"),       {PSTR("+sse4a")}},
+	{ PSTR("ssse3"),       {PSTR("+ssse3")}},
+	{ PSTR("tbm"),         {PSTR("+tbm")}},
+	{ PSTR("vaes"),        {PSTR("+vaes")}},
+	{ PSTR("vpclmulqdq"),  {PSTR("+vpclmulqdq")}},
+	{ PSTR("waitpkg"),     {PSTR("+waitpkg")}},
+	{ PSTR("xop"),         {PSTR("+xop")}},
+	{ PSTR("xsave"),       {PSTR("+xsave")}},
+	{ PSTR("xsavec"),      {PSTR("+xsavec")}},
+	{ PSTR("xsaveopt"),    {PSTR("+xsaveopt")}},
+	{ PSTR("xsaves"),      {PSTR("+xsaves")}},
+	{ PSTR("8087"),        {}},
+	{ PSTR("287"),         {}},
+	{ PSTR("387"),         {}},
+	{ PSTR("vmx"),         {}}, // always available in llvm-mc
+	{ PSTR("smx"),         {}}, // as above
+};
+
+void LlvmMcRunnerX86Family::map_option (platform::string const& gas_name, platform::string const& value)
+{
+	if (gas_name == PSTR("32")) {
+		change_target (PSTR("x86"), PSTR("i386"));
+		return;
+	}
+
+	if (gas_name == PSTR("64")) {
+		change_target (PSTR("x86-64"), PSTR("x86_64"));
+		return;
+	}
+
+	if (gas_name != PSTR("march") && gas_name != PSTR("mtune") && gas_name != PSTR("mrelax-relocations")) {
+		return;
+	}
+
+	if (value.empty ()) {
+		std::string message { "The `-" };
+		message.append (to_utf8 (gas_name));
+		message.append ("` option requires a value, argument `value` must not be empty");
+		throw invalid_argument_error { message };
+	}
+
+	if (gas_name == PSTR("march")) {
+		map_gas_cpu (value, cpu_type_map, arch_extension_map);
+		return;
+	}
+
+	if (gas_name == PSTR("mtune")) {
+		// llvm-mc has no separate tuning option, the CPU selected with `-march` decides which NOP sequences are used
+		// for padding.  The value is only validated.
+		auto mc_cpu = cpu_type_map.find (value);
+		if (mc_cpu == cpu_type_map.end ()) {
+			std::string message { "Unknown GAS CPU type: " };
+			message.append (to_utf8 (value));
+			throw invalid_argument_error { message };
+		}
+		return;
+	}
+
+	// `yes` lets the linker relax GOT loads (e.g. `mov foo@GOTPCREL(%rip)` to `lea foo(%rip)`) by using the
+	// `R_X86_64_[REX_]GOTPCRELX` and `R_386_GOT32X` relocations
+	if (value == PSTR("yes")) {
+		set_option (LlvmMcArgument::RelaxRelocations, PSTR("true"));
+	} else if (value == PSTR("no")) {
+		set_option (LlvmMcArgument::RelaxRelocations, PSTR("false"));
+	} else {
+		std::string message { "Invalid `-mrelax-relocations` value '" };
+		message.append (to_utf8 (value));
+		message.append ("', expected `yes` or `no`");
+		throw invalid_argument_error { message };
+	}
+}
@@ -7,8 +7,12 @@
 
 using namespace xamarin::android::gas;
 
+std::mutex Process::output_lock;
+
 void Process::print_process_command_line ()
 {
+	std::lock_guard<std::mutex> lock (output_lock);
+
 	STDOUT << "Running: " << executable_path;
 	for (platform::string const& arg : _args) {
 		STDOUT << " " << arg;
@@ -58,3 +62,28 @@ void Process::append_program_argument (platform::string const& option_name, stri
 
 	_args.push_back (value_arg);
 }
+
+void Process::dispatch_stderr_lines (std::string &pending, bool end_of_output)
+{
+	size_t line_start = 0;
+	while (true) {
+		size_t line_end = pending.find ('\n', line_start);
+		if (line_end == std::string::npos) {
+			break;
+		}
+
+		size_t line_length = line_end - line_start;
+		if (line_length > 0 && pending[line_end - 1] == '\r') {
+			line_length--;
+		}
+
+		stderr_handler (std::string_view { pending.data () + line_start, line_length });
+		line_start = line_end + 1;
+	}
+
+	pending.erase (0, line_start);
+	if (end_of_output && !pending.empty ()) {
+		stderr_handler (pending);
+		pending.clear ();
+	}
+}
@@ -2,11 +2,16 @@
 #if !defined (__PROCESS_HH)
 #define __PROCESS_HH
 
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
+#include "child_policy.hh"
 #include "command_line.hh"
 #include "gas.hh"
 #include "platform.hh"
@@ -18,12 +23,31 @@ namespace xamarin::android::gas
 	public:
 		using string_list = std::vector<platform::string>;
 		using process_argument = std::variant<platform::string, string_list>;
+		using output_line_handler = std::function<void(std::string_view const& line)>;
+
+		// Writes `size` bytes to the child's stdin, returns `false` if the child stopped reading
+		using input_write_fn = std::function<bool(char const* data, size_t size)>;
+
+		// Produces the child's whole stdin using the passed writer, returns `false` on failure
+		using input_producer = std::function<bool(input_write_fn const& write)>;
 
 	public:
 		explicit Process (fs::path const& executable_path)
 			: executable_path (executable_path.lexically_normal ())
 		{}
 
+		// Applies to all the processes started afterwards.  Settings which need to be prepared in advance (e.g. the
+		// cgroup) are prepared here, throws `invalid_operation_error` if that fails.  The rest is applied by the child
+		// just before it runs the program, on a best-effort basis: failures there are ignored, they must not fail the
+		// build.
+		static void set_child_policy (ChildPolicy const& policy);
+
+		// Makes the dynamic linker load `library` into all the processes started afterwards, before any other
+		// library, so that it can replace functions like `malloc`.  The library is added in front of the `LD_PRELOAD`
+		// (`DYLD_INSERT_LIBRARIES` on macOS) inherited by the children.  Throws `invalid_operation_error` if the
+		// library doesn't exist or preloading isn't supported on this platform.
+		static void set_child_preload (fs::path const& library);
+
 		int run (bool print_command_line = true);
 		void append_program_argument (platform::string const& option_name, platform::string const& option_value = PSTR(""));
 		void append_program_argument (platform::string const& option_name, string_list const& option_value, bool uses_comma_separated_list = false);
@@ -40,18 +64,56 @@ namespace xamarin::android::gas
 			}
 		}
 
+		// Instead of being inherited, the child's stderr is read through a pipe and passed, line by line (without the
+		// line terminator), to `handler`.  Called on the thread which runs the process.
+		void capture_stderr (output_line_handler handler)
+		{
+			stderr_handler = std::move (handler);
+		}
+
+		// Instead of being inherited, the child's stdin is a pipe fed by `producer`, on a separate thread, while the
+		// process runs.  If the producer fails the run fails as well, regardless of the child's exit code.
+		void feed_stdin (input_producer producer)
+		{
+			stdin_producer = std::move (producer);
+		}
+
+		// The child's stdout is written to `path`, which is created or truncated, instead of being inherited
+		void redirect_stdout (fs::path const& path)
+		{
+			stdout_file = path;
+		}
+
 		std::vector<platform::string> const& args () const noexcept
 		{
 			return _args;
 		}
 
+		// Peak resident set size of the child, in bytes, as reported by the OS once the process terminated.  Zero if
+		// the process hasn't been run yet or the value couldn't be obtained.
+		uint64_t peak_rss () const noexcept
+		{
+			return _peak_rss;
+		}
+
 	private:
 		void print_process_command_line ();
+
+		// Passes all the complete lines in `pending` to `stderr_handler` and removes them from `pending`.  At the end
+		// of the output, an unterminated last line is passed as well.
+		void dispatch_stderr_lines (std::string &pending, bool end_of_output);
 		std::vector<platform::string::const_pointer> make_exec_args ();
 
 	private:
+		// Processes may be ran from several threads at the same time, this makes sure their output isn't garbled
+		static std::mutex output_lock;
+
 		std::vector<platform::string> _args;
 		fs::path const executable_path;
+		uint64_t _peak_rss = 0;
+		output_line_handler stderr_handler;
+		input_producer stdin_producer;
+		fs::path stdout_file;
 	};
 }
 #endif
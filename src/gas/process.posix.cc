@@ -2,17 +2,233 @@
 #include <cstring>
 #include <cerrno>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
 
+#if defined (__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
 #include "constants.hh"
+#include "exceptions.hh"
 #include "process.hh"
 
+extern char **environ;
+
 using namespace xamarin::android::gas;
 
+namespace {
+	// Processes are started from several threads at once.  Pipe descriptors must not leak into children spawned by
+	// other threads, or we'd never see the end of output until those children terminate, so creating the pipe, making
+	// it close-on-exec and forking must happen atomically with regards to other spawns.
+	std::mutex spawn_lock;
+
+	// A child which exits before reading all of its input must not kill us with SIGPIPE, we want to see the `EPIPE`
+	// write error instead
+	std::once_flag sigpipe_ignored;
+
+	// `ChildPolicy` translated to what the child needs to pass to system calls.  Between `fork` and `exec` only
+	// async-signal-safe functions may be called, so nothing can be allocated or formatted there.
+	struct PreparedChildPolicy
+	{
+		bool      set_nice = false;
+		int       nice = 0;
+#if defined (__linux__)
+		int       ioprio = -1;
+		bool      batch = false;
+		bool      set_affinity = false;
+		cpu_set_t affinity;
+		int       cgroup_procs_fd = -1;
+#endif
+	} child_policy;
+
+#if defined (__linux__)
+	// cgroups created by `set_child_policy`, deepest first.  They're removed when we exit, after all our children
+	// have terminated, groups still used by other processes (e.g. a concurrent build sharing the group) cannot be
+	// removed and are left for the last user.
+	struct CreatedCgroups
+	{
+		std::vector<fs::path> groups;
+
+		~CreatedCgroups ()
+		{
+			if (child_policy.cgroup_procs_fd >= 0) {
+				close (child_policy.cgroup_procs_fd);
+				child_policy.cgroup_procs_fd = -1;
+			}
+
+			for (fs::path const& group : groups) {
+				std::error_code ec;
+				fs::remove (group, ec);
+			}
+		}
+	} created_cgroups;
+#endif
+
+	// Environment of the children, if it has to be different from ours.  Prepared in advance, for the same reason as
+	// the policy above.
+	std::vector<std::string> child_environment_storage;
+	std::vector<char*>       child_environment;
+
+	// Called in the child, right before `exec`
+	void apply_child_policy () noexcept
+	{
+		if (child_policy.set_nice) {
+			setpriority (PRIO_PROCESS, 0, child_policy.nice);
+		}
+
+#if defined (__linux__)
+		if (child_policy.ioprio >= 0) {
+			syscall (SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, child_policy.ioprio);
+		}
+
+		if (child_policy.batch) {
+			sched_param param {};
+			sched_setscheduler (0, SCHED_BATCH, &param);
+		}
+
+		if (child_policy.set_affinity) {
+			sched_setaffinity (0, sizeof (child_policy.affinity), &child_policy.affinity);
+		}
+
+		if (child_policy.cgroup_procs_fd >= 0) {
+			// Writing 0 moves the writing process
+			[[maybe_unused]] ssize_t n = write (child_policy.cgroup_procs_fd, "0", 1);
+		}
+#endif
+	}
+
+#if defined (__linux__)
+	void write_cgroup_file (fs::path const& path, std::string const& value)
+	{
+		int fd = open (path.c_str (), O_WRONLY | O_CLOEXEC);
+		if (fd == -1 || write (fd, value.data (), value.length ()) != static_cast<ssize_t>(value.length ())) {
+			std::string error = std::strerror (errno);
+			if (fd != -1) {
+				close (fd);
+			}
+			throw invalid_operation_error { "Failed to write '" + value + "' to " + path.string () + ". " + error };
+		}
+		close (fd);
+	}
+#endif
+
+	bool write_all (int fd, char const* data, size_t size)
+	{
+		while (size > 0) {
+			ssize_t n = write (fd, data, size);
+			if (n == -1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+
+			data += n;
+			size -= static_cast<size_t>(n);
+		}
+
+		return true;
+	}
+}
+
+void Process::set_child_policy (ChildPolicy const& policy)
+{
+	child_policy.set_nice = policy.nice.has_value ();
+	child_policy.nice = policy.nice.value_or (0);
+
+#if defined (__linux__)
+	if (policy.io_class.has_value ()) {
+		// The idle class has no levels
+		uint32_t level = policy.io_class.value () == ChildPolicy::IoClass::Idle ? 0 : policy.io_level;
+		child_policy.ioprio = static_cast<int>((static_cast<uint32_t>(policy.io_class.value ()) << 13) | level);
+	}
+
+	child_policy.batch = policy.batch;
+
+	CPU_ZERO (&child_policy.affinity);
+	child_policy.set_affinity = !policy.cpus.empty ();
+	for (uint32_t cpu : policy.cpus) {
+		CPU_SET (cpu, &child_policy.affinity);
+	}
+
+	if (policy.cgroup.empty ()) {
+		return;
+	}
+
+	constexpr char const cgroup2_mount[] = "/sys/fs/cgroup";
+	fs::path group = policy.cgroup.is_absolute () ? policy.cgroup : fs::path { cgroup2_mount } / policy.cgroup;
+
+	std::error_code ec;
+	std::vector<fs::path> missing;
+	for (fs::path dir = group; dir.has_relative_path () && !fs::exists (dir, ec); dir = dir.parent_path ()) {
+		missing.push_back (dir);
+	}
+
+	fs::create_directories (group, ec);
+	if (ec) {
+		throw invalid_operation_error { "Failed to create cgroup " + group.string () + ". " + ec.message () };
+	}
+	created_cgroups.groups.insert (created_cgroups.groups.end (), missing.begin (), missing.end ());
+
+	if (policy.cpu_weight.has_value ()) {
+		write_cgroup_file (group / "cpu.weight", std::to_string (policy.cpu_weight.value ()));
+	}
+
+	if (!policy.memory_high.empty ()) {
+		write_cgroup_file (group / "memory.high", policy.memory_high);
+	}
+
+	fs::path procs = group / "cgroup.procs";
+	child_policy.cgroup_procs_fd = open (procs.c_str (), O_WRONLY | O_CLOEXEC);
+	if (child_policy.cgroup_procs_fd == -1) {
+		throw invalid_operation_error { "Failed to open " + procs.string () + ". " + std::strerror (errno) };
+	}
+#endif
+}
+
+void Process::set_child_preload (fs::path const& library)
+{
+#if defined (__APPLE__)
+	constexpr std::string_view preload_variable { "DYLD_INSERT_LIBRARIES" };
+#else
+	constexpr std::string_view preload_variable { "LD_PRELOAD" };
+#endif
+
+	std::error_code ec;
+	fs::path library_path = fs::absolute (library, ec);
+	if (ec || !fs::is_regular_file (library_path, ec)) {
+		throw invalid_operation_error { "Library " + library.string () + " does not exist" };
+	}
+
+	std::string preload { library_path.string () };
+	child_environment_storage.clear ();
+	for (char **env = environ; *env != nullptr; env++) {
+		std::string_view entry { *env };
+		if (entry.length () > preload_variable.length () && entry.starts_with (preload_variable) && entry[preload_variable.length ()] == '=') {
+			preload.append (":").append (entry.substr (preload_variable.length () + 1));
+			continue;
+		}
+
+		child_environment_storage.emplace_back (entry);
+	}
+	child_environment_storage.emplace_back (std::string { preload_variable } + "=" + preload);
+
+	child_environment.clear ();
+	for (std::string &entry : child_environment_storage) {
+		child_environment.push_back (entry.data ());
+	}
+	child_environment.push_back (nullptr);
+}
+
 std::vector<platform::string::const_pointer> Process::make_exec_args ()
 {
 	std::vector<platform::string::const_pointer> exec_args;
@@ -49,40 +265,177 @@ int Process::run (bool print_command_line)
 	// `execv(2)` needs the array to be null-terminated
 	exec_args.push_back (nullptr);
 
+	int stdout_fd = -1;
+	if (!stdout_file.empty ()) {
+		stdout_fd = open (stdout_file.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		if (stdout_fd == -1) {
+			STDERR << "Failed to create " << stdout_file.native () << ". " << std::strerror (errno) << Constants::newline;
+			return Constants::wrapper_fork_failed_error_code;
+		}
+	}
+
+	ScopeGuard stdout_guard {
+		[&stdout_fd]() {
+			if (stdout_fd != -1) {
+				close (stdout_fd);
+			}
+		}
+	};
+
+	int stdin_pipe[2] = { -1, -1 };
+	int stderr_pipe[2] = { -1, -1 };
+	std::unique_lock<std::mutex> spawn_guard (spawn_lock);
+	if (stdin_producer) {
+		std::call_once (sigpipe_ignored, []() { signal (SIGPIPE, SIG_IGN); });
+
+		if (pipe (stdin_pipe) == -1) {
+			STDERR << "Failed to create pipe. " << std::strerror (errno) << Constants::newline;
+			return Constants::wrapper_fork_failed_error_code;
+		}
+
+		fcntl (stdin_pipe[0], F_SETFD, FD_CLOEXEC);
+		fcntl (stdin_pipe[1], F_SETFD, FD_CLOEXEC);
+	}
+
+	if (stderr_handler) {
+		if (pipe (stderr_pipe) == -1) {
+			STDERR << "Failed to create pipe. " << std::strerror (errno) << Constants::newline;
+			if (stdin_producer) {
+				close (stdin_pipe[0]);
+				close (stdin_pipe[1]);
+			}
+			return Constants::wrapper_fork_failed_error_code;
+		}
+
+		fcntl (stderr_pipe[0], F_SETFD, FD_CLOEXEC);
+		fcntl (stderr_pipe[1], F_SETFD, FD_CLOEXEC);
+	}
+
 	pid_t llvm_mc_pid = fork ();
 	if (llvm_mc_pid == -1) {
 		STDERR << "Fork failed. " << std::strerror (errno) << Constants::newline;
+		if (stdin_producer) {
+			close (stdin_pipe[0]);
+			close (stdin_pipe[1]);
+		}
+		if (stderr_handler) {
+			close (stderr_pipe[0]);
+			close (stderr_pipe[1]);
+		}
 		return Constants::wrapper_fork_failed_error_code;
 	}
 
 	if (llvm_mc_pid == 0) {
-		if (execv (executable_path.c_str (), const_cast<char* const*>(exec_args.data ())) == -1) {
-			STDERR << "Failed to run " << Constants::llvm_mc_name << ". " << std::strerror (errno) << Constants::newline;
+		if (stdin_producer) {
+			// Ignored signals stay ignored across `exec`, the child should get the default behavior
+			signal (SIGPIPE, SIG_DFL);
+			dup2 (stdin_pipe[0], STDIN_FILENO);
+		}
+
+		if (stderr_handler) {
+			// `dup2` clears the close-on-exec flag of the new descriptor
+			dup2 (stderr_pipe[1], STDERR_FILENO);
+		}
+
+		if (stdout_fd != -1) {
+			dup2 (stdout_fd, STDOUT_FILENO);
+		}
+
+		apply_child_policy ();
+
+		char* const* argv = const_cast<char* const*>(exec_args.data ());
+		int ret = child_environment.empty () ? execv (executable_path.c_str (), argv) : execve (executable_path.c_str (), argv, child_environment.data ());
+		if (ret == -1) {
+			STDERR << "Failed to run " << executable_path.filename ().native () << ". " << std::strerror (errno) << Constants::newline;
 		}
 		_exit (Constants::wrapper_exec_failed_error_code);
 	}
+	spawn_guard.unlock ();
+
+	bool input_ok = true;
+	std::thread stdin_writer;
+	if (stdin_producer) {
+		close (stdin_pipe[0]);
+		stdin_writer = std::thread {
+			[this, &input_ok, fd = stdin_pipe[1]]() {
+				input_ok = stdin_producer (
+					[fd](char const* data, size_t size) -> bool {
+						return write_all (fd, data, size);
+					}
+				);
+				close (fd);
+			}
+		};
+	}
+
+	ScopeGuard writer_guard {
+		[&stdin_writer]() {
+			if (stdin_writer.joinable ()) {
+				stdin_writer.join ();
+			}
+		}
+	};
+
+	if (stderr_handler) {
+		close (stderr_pipe[1]);
+
+		std::string pending;
+		char buffer[4096];
+		while (true) {
+			ssize_t n = read (stderr_pipe[0], buffer, sizeof (buffer));
+			if (n == -1 && errno == EINTR) {
+				continue;
+			}
+
+			if (n <= 0) {
+				break;
+			}
+
+			pending.append (buffer, static_cast<size_t>(n));
+			dispatch_stderr_lines (pending, false /* end_of_output */);
+		}
+		dispatch_stderr_lines (pending, true /* end_of_output */);
+		close (stderr_pipe[0]);
+	}
+
+	if (stdin_writer.joinable ()) {
+		stdin_writer.join ();
+	}
 
 	int wstatus = 0;
+	struct rusage usage {};
 	do {
-		pid_t result = waitpid (llvm_mc_pid,  &wstatus, WUNTRACED);
+		pid_t result = wait4 (llvm_mc_pid,  &wstatus, WUNTRACED, &usage);
 
 		if (result == -1) {
-			STDERR << "Failed to wait for " << Constants::llvm_mc_name << " to terminate. " << std::strerror (errno) << Constants::newline;
+			STDERR << "Failed to wait for " << executable_path.filename ().native () << " to terminate. " << std::strerror (errno) << Constants::newline;
 			return Constants::wrapper_wait_failed_error_code;
 		}
 
 		if (WIFSIGNALED (wstatus)) {
-			STDERR << Constants::llvm_mc_name << " was killed by signal " << WTERMSIG (wstatus) << Constants::newline;
+			STDERR << executable_path.filename ().native () << " was killed by signal " << WTERMSIG (wstatus) << Constants::newline;
 			return Constants::wrapper_llvm_mc_killed_error_code;
 		} else if (WIFSTOPPED (wstatus)) {
-			STDERR << Constants::llvm_mc_name << " was stopped by signal " << WSTOPSIG (wstatus) << Constants::newline;
+			STDERR << executable_path.filename ().native () << " was stopped by signal " << WSTOPSIG (wstatus) << Constants::newline;
 			kill (llvm_mc_pid, SIGKILL); // Let's not risk hanging indifinitely...
 			return Constants::wrapper_llvm_mc_stopped_error_code;
 		}
 	} while (!WIFEXITED(wstatus) && !WIFSIGNALED(wstatus));
 
+#if defined (__APPLE__)
+	_peak_rss = static_cast<uint64_t>(usage.ru_maxrss); // bytes on macOS
+#else
+	_peak_rss = static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes on Linux
+#endif
+
 	if (WEXITSTATUS (wstatus) != 0) {
-		STDERR << Constants::llvm_mc_name << " exited with status " << WEXITSTATUS (wstatus) << Constants::newline;
+		STDERR << executable_path.filename ().native () << " exited with status " << WEXITSTATUS (wstatus) << Constants::newline;
+		return WEXITSTATUS (wstatus);
+	}
+
+	if (!input_ok) {
+		STDERR << "Failed to pass input to " << executable_path.filename ().native () << Constants::newline;
+		return Constants::wrapper_input_failed_error_code;
 	}
-	return WEXITSTATUS (wstatus);
+	return 0;
 }
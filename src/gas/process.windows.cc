@@ -1,16 +1,52 @@
 // SPDX-License-Identifier: MIT
 #include <windows.h>
+#include <psapi.h>
 #include <synchapi.h>
 #include <tchar.h>
 //#include <unistd.h>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 #include "constants.hh"
+#include "exceptions.hh"
 #include "platform.hh"
 #include "process.hh"
 
 using namespace xamarin::android::gas;
 
+namespace {
+	// Processes are started from several threads at once and all inheritable handles are inherited by every child we
+	// start.  Pipe handles must not leak into children spawned by other threads, or we'd never see the end of output
+	// until those children terminate, hence pipe creation, spawning and closing our copy of the write end must happen
+	// atomically with regards to other spawns.
+	std::mutex spawn_lock;
+
+	// Priority class matching the `nice` setting of the child policy, the only setting supported on Windows
+	DWORD child_priority_class = 0;
+}
+
+void Process::set_child_policy (ChildPolicy const& policy)
+{
+	if (!policy.nice.has_value ()) {
+		child_priority_class = 0;
+		return;
+	}
+
+	int nice = policy.nice.value ();
+	if (nice <= -10) {
+		child_priority_class = HIGH_PRIORITY_CLASS;
+	} else if (nice < 0) {
+		child_priority_class = ABOVE_NORMAL_PRIORITY_CLASS;
+	} else if (nice == 0) {
+		child_priority_class = NORMAL_PRIORITY_CLASS;
+	} else if (nice < 10) {
+		child_priority_class = BELOW_NORMAL_PRIORITY_CLASS;
+	} else {
+		child_priority_class = IDLE_PRIORITY_CLASS;
+	}
+}
+
 static platform::string escape_argument (platform::string arg)
 {
 	bool needs_quote = false;
@@ -43,6 +79,11 @@ static platform::string escape_argument (platform::string arg)
 	return result;
 }
 
+void Process::set_child_preload ([[maybe_unused]] fs::path const& library)
+{
+	throw invalid_operation_error { "Preloading libraries into child processes is not supported on Windows" };
+}
+
 int Process::run (bool print_command_line)
 {
 	if (print_command_line) {
@@ -63,7 +104,57 @@ int Process::run (bool print_command_line)
 	STARTUPINFOW si {};
 	si.cb = sizeof(si);
 
-	DWORD creation_flags = CREATE_UNICODE_ENVIRONMENT;
+	std::unique_lock<std::mutex> spawn_guard (spawn_lock);
+	SECURITY_ATTRIBUTES sa {};
+	sa.nLength = sizeof (sa);
+	sa.bInheritHandle = TRUE;
+
+	HANDLE stdin_read = nullptr;
+	HANDLE stdin_write = nullptr;
+	if (stdin_producer) {
+		if (!CreatePipe (&stdin_read, &stdin_write, &sa, 0)) {
+			return Constants::wrapper_exec_failed_error_code;
+		}
+		SetHandleInformation (stdin_write, HANDLE_FLAG_INHERIT, 0);
+	}
+
+	HANDLE stderr_read = nullptr;
+	HANDLE stderr_write = nullptr;
+	if (stderr_handler) {
+		if (!CreatePipe (&stderr_read, &stderr_write, &sa, 0)) {
+			if (stdin_producer) {
+				CloseHandle (stdin_read);
+				CloseHandle (stdin_write);
+			}
+			return Constants::wrapper_exec_failed_error_code;
+		}
+		SetHandleInformation (stderr_read, HANDLE_FLAG_INHERIT, 0);
+	}
+
+	HANDLE stdout_handle = INVALID_HANDLE_VALUE;
+	if (!stdout_file.empty ()) {
+		stdout_handle = CreateFileW (stdout_file.c_str (), GENERIC_WRITE, FILE_SHARE_READ, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (stdout_handle == INVALID_HANDLE_VALUE) {
+			if (stdin_producer) {
+				CloseHandle (stdin_read);
+				CloseHandle (stdin_write);
+			}
+			if (stderr_handler) {
+				CloseHandle (stderr_read);
+				CloseHandle (stderr_write);
+			}
+			return Constants::wrapper_exec_failed_error_code;
+		}
+	}
+
+	if (stdin_producer || stderr_handler || stdout_handle != INVALID_HANDLE_VALUE) {
+		si.dwFlags |= STARTF_USESTDHANDLES;
+		si.hStdInput = stdin_producer ? stdin_read : GetStdHandle (STD_INPUT_HANDLE);
+		si.hStdOutput = stdout_handle != INVALID_HANDLE_VALUE ? stdout_handle : GetStdHandle (STD_OUTPUT_HANDLE);
+		si.hStdError = stderr_handler ? stderr_write : GetStdHandle (STD_ERROR_HANDLE);
+	}
+
+	DWORD creation_flags = CREATE_UNICODE_ENVIRONMENT | child_priority_class;
 	wchar_t* wargs = _wcsdup(args.c_str());
 	BOOL success = CreateProcessW (
 		binary.c_str (),
@@ -79,10 +170,67 @@ int Process::run (bool print_command_line)
 	);
 	free (wargs);
 
+	if (stdin_producer) {
+		CloseHandle (stdin_read);
+	}
+	if (stderr_handler) {
+		CloseHandle (stderr_write);
+	}
+	if (stdout_handle != INVALID_HANDLE_VALUE) {
+		CloseHandle (stdout_handle);
+	}
+	spawn_guard.unlock ();
+
 	if (!success) {
+		if (stdin_producer) {
+			CloseHandle (stdin_write);
+		}
+		if (stderr_handler) {
+			CloseHandle (stderr_read);
+		}
 		return Constants::wrapper_exec_failed_error_code;
 	}
 
+	bool input_ok = true;
+	std::thread stdin_writer;
+	if (stdin_producer) {
+		stdin_writer = std::thread {
+			[this, &input_ok, stdin_write]() {
+				input_ok = stdin_producer (
+					[stdin_write](char const* data, size_t size) -> bool {
+						while (size > 0) {
+							DWORD nwritten = 0;
+							DWORD chunk = static_cast<DWORD>(size > 0x10000000 ? 0x10000000 : size);
+							if (!WriteFile (stdin_write, data, chunk, &nwritten, nullptr)) {
+								return false; // ERROR_NO_DATA if the child closed its end
+							}
+							data += nwritten;
+							size -= nwritten;
+						}
+						return true;
+					}
+				);
+				CloseHandle (stdin_write);
+			}
+		};
+	}
+
+	if (stderr_handler) {
+		std::string pending;
+		char buffer[4096];
+		DWORD nread = 0;
+		while (ReadFile (stderr_read, buffer, sizeof (buffer), &nread, nullptr) && nread > 0) {
+			pending.append (buffer, nread);
+			dispatch_stderr_lines (pending, false /* end_of_output */);
+		}
+		dispatch_stderr_lines (pending, true /* end_of_output */);
+		CloseHandle (stderr_read);
+	}
+
+	if (stdin_writer.joinable ()) {
+		stdin_writer.join ();
+	}
+
 	// TODO: error handling below
 	int ret = 0;
 	DWORD result = WaitForSingleObject (pi.hProcess, INFINITE);
@@ -97,8 +245,17 @@ int Process::run (bool print_command_line)
 		ret = 1;
 	}
 
+	PROCESS_MEMORY_COUNTERS pmc {};
+	if (GetProcessMemoryInfo (pi.hProcess, &pmc, sizeof (pmc))) {
+		_peak_rss = static_cast<uint64_t>(pmc.PeakWorkingSetSize);
+	}
+
 	CloseHandle (pi.hProcess);
 	CloseHandle (pi.hThread);
 
+	if (ret == 0 && !input_ok) {
+		STDERR << "Failed to pass input to " << executable_path.filename ().native () << Constants::newline;
+		return Constants::wrapper_input_failed_error_code;
+	}
 	return ret;
 }
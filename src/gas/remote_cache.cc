@@ -0,0 +1,437 @@
+// SPDX-License-Identifier: MIT
+#if defined (_WIN32)
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "constants.hh"
+#include "file_utils.hh"
+#include "input_stream.hh"
+#include "remote_cache.hh"
+#include "sha256.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	std::string to_utf8 (platform::string const& s)
+	{
+#if defined (_WIN32)
+		if (s.empty ()) {
+			return {};
+		}
+
+		int size = WideCharToMultiByte (CP_UTF8, 0, s.data (), static_cast<int>(s.size ()), nullptr, 0, nullptr, nullptr);
+		std::string ret (static_cast<size_t>(size), '\0');
+		WideCharToMultiByte (CP_UTF8, 0, s.data (), static_cast<int>(s.size ()), ret.data (), size, nullptr, nullptr);
+		return ret;
+#else
+		return s;
+#endif
+	}
+
+	// Mimics `llvm-mc`: the first matching `--fdebug-prefix-map` entry is applied to the path
+	std::string remap_debug_path (std::string const& path, std::vector<std::string> const& prefix_map)
+	{
+		for (std::string const& entry : prefix_map) {
+			size_t separator = entry.find ('=');
+			std::string old_prefix = entry.substr (0, separator);
+			if (path.starts_with (old_prefix)) {
+				return entry.substr (separator + 1) + path.substr (old_prefix.length ());
+			}
+		}
+
+		return path;
+	}
+
+	// Just enough of the protobuf wire format to write and read the `ActionResult` messages of the action cache
+	constexpr uint32_t wire_varint = 0;
+	constexpr uint32_t wire_fixed64 = 1;
+	constexpr uint32_t wire_length_delimited = 2;
+	constexpr uint32_t wire_fixed32 = 5;
+
+	void write_varint (std::vector<uint8_t> &out, uint64_t value)
+	{
+		while (value >= 0x80) {
+			out.push_back (static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back (static_cast<uint8_t>(value));
+	}
+
+	void write_bytes_field (std::vector<uint8_t> &out, uint32_t field, void const* data, size_t length)
+	{
+		write_varint (out, (field << 3) | wire_length_delimited);
+		write_varint (out, length);
+		auto bytes = static_cast<uint8_t const*>(data);
+		out.insert (out.end (), bytes, bytes + length);
+	}
+
+	class ProtobufReader final
+	{
+	public:
+		ProtobufReader (uint8_t const* data, size_t length) noexcept
+			: pos (data),
+			  end (data + length)
+		{}
+
+		// Returns the value of the first length-delimited `field`, skipping all the other fields
+		std::optional<std::string_view> find_bytes_field (uint32_t field)
+		{
+			while (pos < end) {
+				std::optional<uint64_t> key = read_varint ();
+				if (!key.has_value ()) {
+					return std::nullopt;
+				}
+
+				uint32_t wire_type = static_cast<uint32_t>(key.value () & 0x7);
+				size_t length;
+				switch (wire_type) {
+					case wire_varint:
+						if (!read_varint ().has_value ()) {
+							return std::nullopt;
+						}
+						continue;
+
+					case wire_fixed64:
+						length = 8;
+						break;
+
+					case wire_fixed32:
+						length = 4;
+						break;
+
+					case wire_length_delimited: {
+						std::optional<uint64_t> value_length = read_varint ();
+						if (!value_length.has_value ()) {
+							return std::nullopt;
+						}
+						length = static_cast<size_t>(value_length.value ());
+						break;
+					}
+
+					default:
+						return std::nullopt;
+				}
+
+				if (length > static_cast<size_t>(end - pos)) {
+					return std::nullopt;
+				}
+
+				std::string_view value { reinterpret_cast<char const*>(pos), length };
+				pos += length;
+				if (wire_type == wire_length_delimited && (key.value () >> 3) == field) {
+					return value;
+				}
+			}
+
+			return std::nullopt;
+		}
+
+	private:
+		std::optional<uint64_t> read_varint () noexcept
+		{
+			uint64_t value = 0;
+			for (uint32_t shift = 0; shift < 64 && pos < end; shift += 7) {
+				uint8_t byte = *pos++;
+				value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0) {
+					return value;
+				}
+			}
+
+			return std::nullopt;
+		}
+
+	private:
+		uint8_t const* pos;
+		uint8_t const* end;
+	};
+}
+
+std::unique_ptr<RemoteCache> RemoteCache::create (std::string const& url)
+{
+	std::optional<HttpClient> client = HttpClient::from_url (url, request_timeout);
+	if (!client.has_value ()) {
+		return nullptr;
+	}
+
+	return std::make_unique<RemoteCache> (url, std::move (client.value ()));
+}
+
+std::optional<RemoteCache::InputHash> RemoteCache::hash_input (fs::path const& input_file, std::vector<std::string> const& prefixes)
+{
+	// stdin can be read only once, the assembler needs it
+	if (InputStream::is_stdin (input_file)) {
+		return std::nullopt;
+	}
+
+	// Compressed inputs are hashed after decompression, so that `.include` is found in them too and the key doesn't
+	// depend on the compression
+	std::unique_ptr<InputStream> input;
+	try {
+		input = InputStream::open (input_file);
+	} catch (std::exception const&) {
+		return std::nullopt;
+	}
+
+	std::istream &is = *input;
+
+	constexpr std::string_view include_directive { ".include" };
+	constexpr std::string_view incbin_directive  { ".incbin" };
+	size_t overlap = include_directive.length ();
+	for (std::string const& prefix : prefixes) {
+		overlap = std::max (overlap, prefix.length ());
+	}
+
+	InputHash ret;
+	Sha256 sha;
+	std::vector<char> buffer (overlap + 1024 * 1024);
+	size_t carried = 0;
+	while (is) {
+		is.read (buffer.data () + carried, static_cast<std::streamsize>(buffer.size () - carried));
+		size_t nread = static_cast<size_t>(is.gcount ());
+		sha.update (buffer.data () + carried, nread);
+
+		// The tail of the previous block is kept in front of the buffer, so that strings split between two reads
+		// are found too
+		std::string_view data { buffer.data (), carried + nread };
+		if (data.find (include_directive) != std::string_view::npos || data.find (incbin_directive) != std::string_view::npos) {
+			return std::nullopt;
+		}
+
+		if (!ret.mentions_mapped_prefix) {
+			ret.mentions_mapped_prefix = std::any_of (
+				prefixes.begin (),
+				prefixes.end (),
+				[&data](std::string const& prefix) {
+					return data.find (prefix) != std::string_view::npos;
+				}
+			);
+		}
+
+		carried = std::min (overlap, data.length ());
+		std::memmove (buffer.data (), data.data () + data.length () - carried, carried);
+	}
+
+	if (is.bad () || !input->error ().empty ()) {
+		return std::nullopt;
+	}
+
+	ret.hash = sha.finish_hex ();
+	return ret;
+}
+
+std::optional<std::string> RemoteCache::make_key (Process const& process, fs::path const& input_file, std::string_view const& input_transform) const
+{
+	if (disabled) {
+		return std::nullopt;
+	}
+
+	constexpr std::string_view prefix_map_option { "--fdebug-prefix-map=" };
+	platform::string const input_arg = fs::path { input_file }.make_preferred ().native ();
+	bool has_debug_info = false;
+	std::vector<std::string> prefix_map;
+	std::vector<std::string> key_args;
+
+	for (platform::string const& arg : process.args ()) {
+		std::string utf8_arg = to_utf8 (arg);
+
+		// Output and input file names don't affect the object's contents, unless they're recorded in the debug info
+		// (see below)
+		if (arg == input_arg || utf8_arg.starts_with ("-o=") || utf8_arg.starts_with ("--main-file-name=")) {
+			continue;
+		}
+
+		if (utf8_arg == "-g") {
+			has_debug_info = true;
+		} else if (utf8_arg.starts_with (prefix_map_option)) {
+			// The old prefix is usually the absolute path of the workspace, only the paths it's applied to matter
+			// (see below)
+			prefix_map.push_back (utf8_arg.substr (prefix_map_option.length ()));
+			continue;
+		}
+
+		key_args.push_back (std::move (utf8_arg));
+	}
+
+	std::vector<std::string> mapped_prefixes;
+	for (std::string const& entry : prefix_map) {
+		std::string old_prefix = entry.substr (0, entry.find ('='));
+		if (!old_prefix.empty ()) {
+			mapped_prefixes.push_back (std::move (old_prefix));
+		}
+	}
+
+	std::optional<InputHash> input_hash = hash_input (input_file, mapped_prefixes);
+	if (!input_hash.has_value ()) {
+		return std::nullopt;
+	}
+
+	Sha256 sha;
+	auto add_line = [&sha](std::string_view const& line) {
+		sha.update (line);
+		sha.update ("\n");
+	};
+
+	add_line (key_format_version);
+	add_line (XA_UTILS_VERSION);
+	add_line (LLVM_VERSION);
+	for (std::string const& arg : key_args) {
+		add_line (arg);
+	}
+
+	if (!input_transform.empty ()) {
+		add_line (input_transform);
+	}
+
+	// Paths in the input itself (e.g. in `.file` directives) are remapped too, the mappings are part of the key if
+	// they apply to any of them.  Such inputs depend on the workspace location anyway.
+	if (input_hash->mentions_mapped_prefix) {
+		for (std::string const& entry : prefix_map) {
+			add_line (entry);
+		}
+	}
+
+	if (has_debug_info) {
+		// Compilation directory and the source file name are part of the DWARF data
+		add_line (remap_debug_path (to_utf8 (fs::current_path ().make_preferred ().native ()), prefix_map));
+		add_line (remap_debug_path (to_utf8 (input_arg), prefix_map));
+	}
+
+	add_line (input_hash->hash);
+	return sha.finish_hex ();
+}
+
+bool RemoteCache::is_success (std::optional<HttpClient::Response> const& response)
+{
+	if (!response.has_value ()) {
+		// Server unreachable or not responding in time, don't slow down the rest of the build trying again
+		if (!disabled.exchange (true)) {
+			STDERR << "warning: remote cache " << url.c_str () << " is not reachable, it won't be used for the rest of this run" << Constants::newline;
+		}
+		return false;
+	}
+
+	return response->status >= 200 && response->status < 300;
+}
+
+bool RemoteCache::fetch (std::string const& key, fs::path const& output_file)
+{
+	if (disabled) {
+		return false;
+	}
+
+	std::optional<HttpClient::Response> action = client.get ("/ac/" + key);
+	if (!is_success (action)) {
+		return false;
+	}
+
+	std::optional<std::string> action_digest = read_action_result (action->body);
+	if (!action_digest.has_value ()) {
+		return false;
+	}
+
+	std::string const& digest = action_digest.value ();
+	std::optional<HttpClient::Response> object = client.get ("/cas/" + digest);
+	if (!is_success (object)) {
+		return false;
+	}
+
+	// Never trust the server blindly
+	if (Sha256::hash_hex (object->body.data (), object->body.size ()) != digest) {
+		return false;
+	}
+
+	fs::path temporary_output = FileUtils::make_temporary_path (output_file);
+	{
+		std::ofstream os { temporary_output, std::ios::binary | std::ios::trunc };
+		os.write (reinterpret_cast<char const*>(object->body.data ()), static_cast<std::streamsize>(object->body.size ()));
+		if (!os) {
+			std::error_code ec;
+			fs::remove (temporary_output, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename (temporary_output, output_file, ec);
+	if (ec) {
+		fs::remove (temporary_output, ec);
+		return false;
+	}
+
+	return true;
+}
+
+void RemoteCache::store (std::string const& key, fs::path const& output_file)
+{
+	if (disabled) {
+		return;
+	}
+
+	std::ifstream is { output_file, std::ios::binary };
+	if (!is) {
+		return;
+	}
+
+	HttpClient::byte_buffer object { std::istreambuf_iterator<char> (is), std::istreambuf_iterator<char> () };
+	std::string digest = Sha256::hash_hex (object.data (), object.size ());
+
+	// Content first, so that the action cache never points to a missing object
+	if (!is_success (client.put ("/cas/" + digest, object))) {
+		return;
+	}
+
+	is_success (client.put ("/ac/" + key, make_action_result (digest, object.size ())));
+}
+
+HttpClient::byte_buffer RemoteCache::make_action_result (std::string const& digest, uint64_t size)
+{
+	// message Digest { string hash = 1; int64 size_bytes = 2; }
+	HttpClient::byte_buffer digest_message;
+	write_bytes_field (digest_message, 1, digest.data (), digest.size ());
+	write_varint (digest_message, (2 << 3) | wire_varint);
+	write_varint (digest_message, size);
+
+	// message OutputFile { string path = 1; Digest digest = 2; ... }
+	HttpClient::byte_buffer output_file;
+	write_bytes_field (output_file, 1, output_file_name.data (), output_file_name.size ());
+	write_bytes_field (output_file, 2, digest_message.data (), digest_message.size ());
+
+	// message ActionResult { repeated OutputFile output_files = 2; ... int32 exit_code = 4; ... }, exit code 0 is
+	// the default and isn't written
+	HttpClient::byte_buffer ret;
+	write_bytes_field (ret, 2, output_file.data (), output_file.size ());
+	return ret;
+}
+
+std::optional<std::string> RemoteCache::read_action_result (HttpClient::byte_buffer const& action_result)
+{
+	ProtobufReader result_reader { action_result.data (), action_result.size () };
+	std::optional<std::string_view> output_file = result_reader.find_bytes_field (2);
+	if (!output_file.has_value ()) {
+		return std::nullopt;
+	}
+
+	ProtobufReader output_file_reader { reinterpret_cast<uint8_t const*>(output_file->data ()), output_file->size () };
+	std::optional<std::string_view> digest_message = output_file_reader.find_bytes_field (2);
+	if (!digest_message.has_value ()) {
+		return std::nullopt;
+	}
+
+	ProtobufReader digest_reader { reinterpret_cast<uint8_t const*>(digest_message->data ()), digest_message->size () };
+	std::optional<std::string_view> hash = digest_reader.find_bytes_field (1);
+	if (!hash.has_value () || hash->size () != Sha256::digest_size * 2) {
+		return std::nullopt;
+	}
+
+	return std::string { hash.value () };
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__REMOTE_CACHE_HH)
+#define __REMOTE_CACHE_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gas.hh"
+#include "http_client.hh"
+#include "process.hh"
+
+namespace xamarin::android::gas
+{
+	// Client of a remote object cache using the Bazel HTTP cache protocol: `/ac/<key>` (action cache) holds an
+	// `ActionResult` message (REAPI) for the key of an `llvm-mc` invocation, with the digest of the object it produced
+	// as its only output file, `/cas/<digest>` (content addressable storage) holds the object itself.  The action key
+	// is the SHA-256 of the normalized `llvm-mc` argument vector, the toolchain versions and the SHA-256 of the input
+	// file.  Paths which depend on the location of the workspace are left out of the key (or remapped with the debug
+	// prefix map first), so that all the checkouts of a project can share the cache.
+	//
+	// The cache is strictly an optimization: if the server cannot be reached the cache is disabled, with a warning,
+	// for the rest of the run and the objects are assembled locally.
+	class RemoteCache final
+	{
+		static constexpr std::chrono::milliseconds request_timeout { 5000 };
+		static constexpr std::string_view key_format_version { "xa-gas-remote-cache-v2" };
+		static constexpr std::string_view output_file_name { "object.o" };
+
+		struct InputHash
+		{
+			std::string hash;
+			bool        mentions_mapped_prefix = false;
+		};
+
+	public:
+		RemoteCache (std::string url, HttpClient client) noexcept
+			: url (std::move (url)),
+			  client (std::move (client))
+		{}
+
+		// Returns `nullptr` if `url` isn't a supported (`http://host[:port][/prefix]`) URL
+		static std::unique_ptr<RemoteCache> create (std::string const& url);
+
+		// Returns the action key for `process` assembling `input_file`, or an empty value if the invocation cannot be
+		// cached (e.g. because the input includes other files, whose contents aren't part of the key).  `input_transform`
+		// names the transformation applied to the input before it's passed to the process, if any.
+		std::optional<std::string> make_key (Process const& process, fs::path const& input_file, std::string_view const& input_transform = {}) const;
+
+		// Downloads the object for `key` into `output_file`.  Returns `false` on a cache miss or any error.
+		bool fetch (std::string const& key, fs::path const& output_file);
+
+		// Uploads `output_file` as the result for `key`
+		void store (std::string const& key, fs::path const& output_file);
+
+	private:
+		bool is_success (std::optional<HttpClient::Response> const& response);
+
+		// Returns the hash of the input, or an empty value if it cannot be cached.  Also checks whether the input
+		// contains any of `prefixes`, i.e. whether its debug info depends on the `--debug-prefix-map` mappings.
+		static std::optional<InputHash> hash_input (fs::path const& input_file, std::vector<std::string> const& prefixes);
+
+		static HttpClient::byte_buffer make_action_result (std::string const& digest, uint64_t size);
+		static std::optional<std::string> read_action_result (HttpClient::byte_buffer const& action_result);
+
+	private:
+		std::string       url;
+		HttpClient        client;
+		std::atomic<bool> disabled { false };
+	};
+}
+#endif // __REMOTE_CACHE_HH
@@ -0,0 +1,568 @@
+// SPDX-License-Identifier: MIT
+#include <map>
+#include <optional>
+#include <unordered_map>
+
+#include "exceptions.hh"
+#include "section_folder.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	// Tags of the relocation target keys, symbol indices are used as they are
+	constexpr uint64_t section_target = 1ULL << 62;
+	constexpr uint64_t class_target   = 2ULL << 62;
+
+	uint64_t read_le (std::vector<uint8_t> const& data, size_t offset, size_t size) noexcept
+	{
+		uint64_t ret = 0;
+		for (size_t i = 0; i < size; i++) {
+			ret |= static_cast<uint64_t>(data[offset + i]) << (i * 8);
+		}
+		return ret;
+	}
+
+	void write_le (std::vector<uint8_t> &data, size_t offset, uint64_t value, size_t size) noexcept
+	{
+		for (size_t i = 0; i < size; i++) {
+			data[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+		}
+	}
+
+	// FNV-1a
+	class Hasher final
+	{
+	public:
+		void add (uint8_t const* data, size_t size) noexcept
+		{
+			for (size_t i = 0; i < size; i++) {
+				hash = (hash ^ data[i]) * 0x100000001b3ULL;
+			}
+		}
+
+		void add (uint64_t value) noexcept
+		{
+			for (size_t i = 0; i < 8; i++) {
+				hash = (hash ^ static_cast<uint8_t>(value >> (i * 8))) * 0x100000001b3ULL;
+			}
+		}
+
+		uint64_t value () const noexcept
+		{
+			return hash;
+		}
+
+	private:
+		uint64_t hash = 0xcbf29ce484222325ULL;
+	};
+}
+
+SectionFolder::SectionFolder (ElfObject &object, Mode mode)
+	: object (object),
+	  mode (mode)
+{}
+
+SectionFolder::Result SectionFolder::fold (fs::path const& object_file, Mode mode)
+{
+	ElfObject object = ElfObject::read (object_file);
+	if (!object.has_symbol_table ()) {
+		return {};
+	}
+
+	SectionFolder folder { object, mode };
+	Result result = folder.fold ();
+	if (result.sections > 0) {
+		object.write (object_file);
+	}
+
+	return result;
+}
+
+SectionFolder::Result SectionFolder::fold ()
+{
+	find_candidates ();
+	if (candidates.empty ()) {
+		return {};
+	}
+	partition ();
+
+	size_t count = object.sections ().size ();
+	std::vector<uint32_t> replacement (count, 0);
+	for (std::vector<uint32_t> const& members : classes) {
+		// Group members fold only together with the rest of their group
+		if (members.size () < 2 || in_group[members[0]]) {
+			continue;
+		}
+
+		for (size_t i = 1; i < members.size (); i++) {
+			replacement[members[i]] = members[0];
+		}
+	}
+
+	std::map<std::vector<uint32_t>, size_t> group_shapes;
+	std::vector<uint32_t> dissolved_groups;
+	std::vector<uint32_t> removed_groups;
+	std::vector<bool> dissolved (count, false);
+	for (size_t i = 0; i < groups.size (); i++) {
+		Group const& group = groups[i];
+		std::vector<uint32_t> shape;
+		for (uint32_t member : group.members) {
+			shape.push_back (class_of[member]);
+		}
+
+		auto [it, inserted] = group_shapes.try_emplace (std::move (shape), i);
+		if (inserted) {
+			continue;
+		}
+
+		Group const& survivor = groups[it->second];
+		for (size_t j = 0; j < group.members.size (); j++) {
+			replacement[group.members[j]] = survivor.members[j];
+		}
+		removed_groups.push_back (group.index);
+
+		if (!dissolved[survivor.index]) {
+			dissolved[survivor.index] = true;
+			dissolved_groups.push_back (survivor.index);
+		}
+	}
+
+	return apply (replacement, dissolved_groups, removed_groups);
+}
+
+void SectionFolder::find_candidates ()
+{
+	std::vector<ElfSection> const& sections = object.sections ();
+	size_t count = sections.size ();
+	in_group.assign (count, false);
+	relocations.assign (count, {});
+	class_of.assign (count, no_class);
+
+	std::vector<Group> comdat_groups;
+	for (uint32_t i = 1; i < count; i++) {
+		ElfSection const& section = sections[i];
+		if (section.type == ElfObject::SHT_REL || section.type == ElfObject::SHT_RELA) {
+			if (section.info < count && section.link < count && sections[section.link].type == ElfObject::SHT_SYMTAB) {
+				read_relocations (section);
+			}
+			continue;
+		}
+
+		if (section.type != ElfObject::SHT_GROUP || section.data.size () < 4) {
+			continue;
+		}
+
+		// The first word holds the group flags, the rest are member section indices
+		Group group { i, {} };
+		bool eligible = (read_le (section.data, 0, 4) & GRP_COMDAT) != 0;
+		for (size_t offset = 4; offset + 4 <= section.data.size (); offset += 4) {
+			uint32_t member = static_cast<uint32_t>(read_le (section.data, offset, 4));
+			if (member == 0 || member >= count) {
+				eligible = false;
+				continue;
+			}
+
+			in_group[member] = true;
+			if (sections[member].type == ElfObject::SHT_REL || sections[member].type == ElfObject::SHT_RELA) {
+				continue;
+			}
+
+			eligible = eligible && is_candidate (sections[member], true);
+			group.members.push_back (member);
+		}
+
+		if (eligible && !group.members.empty ()) {
+			comdat_groups.push_back (std::move (group));
+		}
+	}
+
+	// Once a group is dissolved, a strong definition in it would clash with another object's copy of the group.
+	// Code outside the object may compare the addresses of any two global symbols, so unless all the sections are
+	// folded sections defining them are left alone.
+	std::vector<bool> has_strong_symbols (count, false);
+	std::vector<bool> has_global_symbols (count, false);
+	for (ElfSymbol const& symbol : object.symbols ()) {
+		uint8_t binding = symbol.binding ();
+		if (!symbol.is_defined () || symbol.section >= count || binding == ElfObject::STB_LOCAL) {
+			continue;
+		}
+
+		has_global_symbols[symbol.section] = true;
+		if (binding != ElfObject::STB_WEAK) {
+			has_strong_symbols[symbol.section] = true;
+		}
+	}
+
+	auto is_address_significant = [this, &has_global_symbols](uint32_t section) -> bool {
+		return mode != Mode::All && has_global_symbols[section];
+	};
+
+	for (uint32_t i = 1; i < count; i++) {
+		if (!in_group[i] && is_candidate (sections[i], false) && !is_address_significant (i)) {
+			candidates.push_back (i);
+		}
+	}
+
+	for (Group &group : comdat_groups) {
+		bool eligible = true;
+		for (uint32_t member : group.members) {
+			eligible = eligible && !has_strong_symbols[member] && !is_address_significant (member);
+		}
+
+		if (eligible) {
+			candidates.insert (candidates.end (), group.members.begin (), group.members.end ());
+			groups.push_back (std::move (group));
+		}
+	}
+}
+
+bool SectionFolder::is_candidate (ElfSection const& section, bool grouped) const noexcept
+{
+	constexpr uint64_t excluded_flags = ElfObject::SHF_WRITE | SHF_TLS | SHF_LINK_ORDER;
+
+	if (section.type != ElfObject::SHT_PROGBITS || (section.flags & ElfObject::SHF_ALLOC) == 0 || (section.flags & excluded_flags) != 0) {
+		return false;
+	}
+
+	if (section.data.empty () || section.name == ".eh_frame" || section.name == ".init" || section.name == ".fini") {
+		return false;
+	}
+
+	if (grouped) {
+		return true;
+	}
+
+	return (section.flags & ElfObject::SHF_GROUP) == 0 && (mode == Mode::All || (section.flags & ElfObject::SHF_EXECINSTR) == 0);
+}
+
+void SectionFolder::read_relocations (ElfSection const& section)
+{
+	bool rela = section.type == ElfObject::SHT_RELA;
+	bool elf64 = object.is_64bit ();
+	size_t word_size = elf64 ? 8 : 4;
+	size_t entry_size = word_size * (rela ? 3 : 2);
+
+	std::vector<Relocation> &ret = relocations[section.info];
+	for (size_t offset = 0; offset + entry_size <= section.data.size (); offset += entry_size) {
+		uint64_t info = read_le (section.data, offset + word_size, word_size);
+		Relocation relocation {
+			.offset = read_le (section.data, offset, word_size),
+			.type = elf64 ? static_cast<uint32_t>(info & 0xffffffff) : static_cast<uint32_t>(info & 0xff),
+			.symbol = elf64 ? static_cast<uint32_t>(info >> 32) : static_cast<uint32_t>(info >> 8),
+			.addend = 0,
+		};
+
+		if (rela) {
+			uint64_t addend = read_le (section.data, offset + 2 * word_size, word_size);
+			relocation.addend = elf64 ? static_cast<int64_t>(addend) : static_cast<int32_t>(addend);
+		}
+		ret.push_back (relocation);
+	}
+}
+
+uint64_t SectionFolder::shape_hash (ElfSection const& section, std::vector<Relocation> const& relocations) noexcept
+{
+	Hasher hasher;
+	hasher.add (section.flags);
+	hasher.add (section.addralign);
+	hasher.add (section.entsize);
+	hasher.add (section.data.data (), section.data.size ());
+	for (Relocation const& relocation : relocations) {
+		hasher.add (relocation.offset);
+		hasher.add (relocation.type);
+		hasher.add (static_cast<uint64_t>(relocation.addend));
+	}
+
+	return hasher.value ();
+}
+
+bool SectionFolder::same_shape (uint32_t a, uint32_t b) const
+{
+	ElfSection const& first = object.sections ()[a];
+	ElfSection const& second = object.sections ()[b];
+	if (in_group[a] != in_group[b] || first.flags != second.flags || first.addralign != second.addralign ||
+	    first.entsize != second.entsize || first.data != second.data) {
+		return false;
+	}
+
+	std::vector<Relocation> const& first_relocations = relocations[a];
+	std::vector<Relocation> const& second_relocations = relocations[b];
+	if (first_relocations.size () != second_relocations.size ()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < first_relocations.size (); i++) {
+		Relocation const& x = first_relocations[i];
+		Relocation const& y = second_relocations[i];
+		if (x.offset != y.offset || x.type != y.type || x.addend != y.addend) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::vector<SectionFolder::target_key> SectionFolder::relocation_targets (uint32_t section) const
+{
+	std::vector<ElfSymbol> const& symbols = object.symbols ();
+	size_t count = object.sections ().size ();
+
+	std::vector<target_key> ret;
+	ret.reserve (relocations[section].size ());
+	for (Relocation const& relocation : relocations[section]) {
+		if (relocation.symbol >= symbols.size ()) {
+			ret.emplace_back (relocation.symbol, 0);
+			continue;
+		}
+
+		// Symbols which may be preempted at run time must stay the same, others are equivalent if they are at the
+		// same place of equivalent sections
+		ElfSymbol const& symbol = symbols[relocation.symbol];
+		bool preemptible = symbol.binding () != ElfObject::STB_LOCAL && symbol.visibility () == ElfObject::STV_DEFAULT;
+		if (preemptible || !symbol.is_defined () || symbol.section >= count) {
+			ret.emplace_back (relocation.symbol, 0);
+		} else if (class_of[symbol.section] != no_class) {
+			ret.emplace_back (class_target | class_of[symbol.section], symbol.value);
+		} else {
+			ret.emplace_back (section_target | symbol.section, symbol.value);
+		}
+	}
+
+	return ret;
+}
+
+void SectionFolder::partition ()
+{
+	std::vector<ElfSection> const& sections = object.sections ();
+
+	// Start with classes of sections identical except for what their relocations refer to...
+	std::unordered_map<uint64_t, std::vector<uint32_t>> classes_by_hash;
+	for (uint32_t section : candidates) {
+		std::vector<uint32_t> &same_hash = classes_by_hash[shape_hash (sections[section], relocations[section])];
+
+		bool found = false;
+		for (uint32_t c : same_hash) {
+			if (same_shape (classes[c][0], section)) {
+				classes[c].push_back (section);
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			same_hash.push_back (static_cast<uint32_t>(classes.size ()));
+			classes.push_back ({ section });
+		}
+	}
+
+	auto assign_classes = [this] {
+		for (uint32_t c = 0; c < classes.size (); c++) {
+			for (uint32_t section : classes[c]) {
+				class_of[section] = c;
+			}
+		}
+	};
+	assign_classes ();
+
+	// ...and split them until the relocations of all the members of every class refer to equivalent targets
+	bool changed;
+	do {
+		changed = false;
+
+		std::vector<std::vector<uint32_t>> refined;
+		for (std::vector<uint32_t> &members : classes) {
+			if (members.size () < 2) {
+				refined.push_back (std::move (members));
+				continue;
+			}
+
+			std::map<std::vector<target_key>, size_t> split;
+			for (uint32_t section : members) {
+				auto [it, inserted] = split.try_emplace (relocation_targets (section), refined.size ());
+				if (inserted) {
+					refined.emplace_back ();
+				}
+				refined[it->second].push_back (section);
+			}
+			changed = changed || split.size () > 1;
+		}
+
+		classes = std::move (refined);
+		assign_classes ();
+	} while (changed);
+}
+
+SectionFolder::Result SectionFolder::apply (std::vector<uint32_t> const& replacement, std::vector<uint32_t> const& dissolved_groups,
+                                            std::vector<uint32_t> const& removed_groups)
+{
+	std::vector<ElfSection> &sections = object.sections ();
+	size_t count = sections.size ();
+
+	Result result;
+	std::vector<bool> removed (count, false);
+	for (size_t i = 1; i < count; i++) {
+		if (replacement[i] != 0) {
+			removed[i] = true;
+			result.sections++;
+			result.bytes += sections[i].size ();
+		}
+	}
+
+	// Sections ordered after the folded ones (e.g. `.ARM.exidx`) describe them only, the replacement has its own
+	for (size_t i = 1; i < count; i++) {
+		ElfSection const& section = sections[i];
+		if ((section.flags & SHF_LINK_ORDER) != 0 && section.link < count && removed[section.link]) {
+			removed[i] = true;
+			if ((section.flags & ElfObject::SHF_ALLOC) != 0) {
+				result.bytes += section.size ();
+			}
+		}
+	}
+
+	for (uint32_t i = 1; i < count; i++) {
+		if (sections[i].name == ".eh_frame") {
+			result.bytes += remove_frame_descriptions (i, removed);
+		}
+	}
+
+	for (ElfSymbol &symbol : object.symbols ()) {
+		if (symbol.is_defined () && symbol.section < count && replacement[symbol.section] != 0) {
+			symbol.section = replacement[symbol.section];
+		}
+	}
+
+	for (uint32_t group : removed_groups) {
+		removed[group] = true;
+		result.groups++;
+	}
+
+	for (uint32_t group : dissolved_groups) {
+		ElfSection const& section = sections[group];
+		for (size_t offset = 4; offset + 4 <= section.data.size (); offset += 4) {
+			sections[read_le (section.data, offset, 4)].flags &= ~ElfObject::SHF_GROUP;
+		}
+		removed[group] = true;
+	}
+
+	ElfSection const* first = sections.data ();
+	object.remove_sections (
+		[&removed, first](ElfSection const& section) -> bool {
+			return removed[static_cast<size_t>(&section - first)];
+		}
+	);
+
+	return result;
+}
+
+uint64_t SectionFolder::remove_frame_descriptions (uint32_t eh_frame, std::vector<bool> const& removed)
+{
+	std::vector<ElfSection> &sections = object.sections ();
+	std::vector<ElfSymbol> const& symbols = object.symbols ();
+	size_t count = sections.size ();
+
+	ElfSection *relocation_section = nullptr;
+	for (ElfSection &section : sections) {
+		if ((section.type == ElfObject::SHT_REL || section.type == ElfObject::SHT_RELA) && section.info == eh_frame) {
+			relocation_section = &section;
+			break;
+		}
+	}
+
+	if (relocation_section == nullptr) {
+		return 0;
+	}
+
+	// Section the relocation at each offset refers to
+	std::unordered_map<uint64_t, uint32_t> targets;
+	for (Relocation const& relocation : relocations[eh_frame]) {
+		if (relocation.symbol < symbols.size () && symbols[relocation.symbol].section < count) {
+			targets.emplace (relocation.offset, symbols[relocation.symbol].section);
+		}
+	}
+
+	// Records kept, as old offset, new offset and size.  Only FDEs of the removed sections go, CIEs stay.
+	std::vector<uint8_t> const& data = sections[eh_frame].data;
+	std::vector<uint8_t> kept_data;
+	std::map<uint64_t, std::pair<uint64_t, uint64_t>> kept_records;
+	std::vector<std::pair<uint64_t, uint64_t>> cie_pointers;  // new offsets of the CIE pointer fields and the CIEs they point to
+	for (uint64_t offset = 0; offset + 4 <= data.size ();) {
+		uint64_t length = read_le (data, offset, 4);
+		uint64_t header_size = 4;
+		if (length == 0xffffffff) {
+			if (offset + 12 > data.size ()) {
+				break;
+			}
+			length = read_le (data, offset + 4, 8);
+			header_size = 12;
+		}
+
+		uint64_t record_size = header_size + length;
+		if (length > data.size () - offset - header_size) {
+			throw invalid_operation_error { "Malformed .eh_frame section: record extends past the end of section" };
+		}
+
+		uint64_t id_offset = offset + header_size;
+		uint64_t cie_id = length >= 4 ? read_le (data, id_offset, 4) : 0;
+		if (cie_id != 0) {
+			auto target = targets.find (id_offset + 4);
+			if (target != targets.end () && removed[target->second]) {
+				offset += record_size;
+				continue;
+			}
+			cie_pointers.emplace_back (kept_data.size () + header_size, id_offset - cie_id);
+		}
+
+		kept_records.emplace (offset, std::make_pair (static_cast<uint64_t>(kept_data.size ()), record_size));
+		kept_data.insert (kept_data.end (), data.begin () + static_cast<ptrdiff_t>(offset), data.begin () + static_cast<ptrdiff_t>(offset + record_size));
+		offset += record_size;
+	}
+
+	uint64_t removed_bytes = data.size () - kept_data.size ();
+	if (removed_bytes == 0) {
+		return 0;
+	}
+
+	// Maps an offset in the old section to the new one, if the record containing it was kept
+	auto map_offset = [&kept_records](uint64_t offset) -> std::optional<uint64_t> {
+		auto it = kept_records.upper_bound (offset);
+		if (it == kept_records.begin ()) {
+			return std::nullopt;
+		}
+
+		--it;
+		auto const& [new_offset, size] = it->second;
+		if (offset - it->first >= size) {
+			return std::nullopt;
+		}
+		return new_offset + (offset - it->first);
+	};
+
+	// FDEs refer to their CIE by the distance back from the pointer itself
+	for (auto const& [field, cie] : cie_pointers) {
+		std::optional<uint64_t> new_cie = map_offset (cie);
+		if (!new_cie.has_value ()) {
+			throw invalid_operation_error { "Malformed .eh_frame section: FDE refers to a missing CIE" };
+		}
+		write_le (kept_data, field, field - new_cie.value (), 4);
+	}
+	sections[eh_frame].data = std::move (kept_data);
+
+	bool elf64 = object.is_64bit ();
+	size_t word_size = elf64 ? 8 : 4;
+	size_t entry_size = word_size * (relocation_section->type == ElfObject::SHT_RELA ? 3 : 2);
+	std::vector<uint8_t> kept_relocations;
+	std::vector<uint8_t> const& relocation_data = relocation_section->data;
+	for (size_t offset = 0; offset + entry_size <= relocation_data.size (); offset += entry_size) {
+		std::optional<uint64_t> new_offset = map_offset (read_le (relocation_data, offset, word_size));
+		if (!new_offset.has_value ()) {
+			continue;
+		}
+
+		size_t entry = kept_relocations.size ();
+		kept_relocations.insert (kept_relocations.end (), relocation_data.begin () + static_cast<ptrdiff_t>(offset), relocation_data.begin () + static_cast<ptrdiff_t>(offset + entry_size));
+		write_le (kept_relocations, entry, new_offset.value (), word_size);
+	}
+	relocation_section->data = std::move (kept_relocations);
+
+	return removed_bytes;
+}
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__SECTION_FOLDER_HH)
+#define __SECTION_FOLDER_HH
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "elf_object.hh"
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// Folds identical sections of a relocatable object, used by `--fold-sections` on the object merged from multiple
+	// inputs.  Sections are identical if they have the same type, flags, alignment and contents, and relocations of the
+	// same types and addends at the same offsets, referring either to the same symbols or to non-preemptible symbols at
+	// the same offsets of identical sections (so that identical functions calling identical functions fold too).
+	//
+	// Read-only data sections are always considered, code sections and sections defining global or weak symbols only
+	// in the `All` mode, since distinct functions or exported tables would end up at the same address.  COMDAT groups
+	// are folded as a whole, when all their members are identical and all the non-local symbols they define are weak.  The symbols of a folded section (or group) are moved to the section which
+	// replaces it, so relocations referring to them are unaffected.  A group which replaces another is dissolved: its
+	// sections could otherwise be discarded by the final link in favour of another object's copy, taking the folded
+	// group's symbols along.  Call frame information of the folded sections is removed from `.eh_frame`, since the
+	// linker would otherwise find overlapping FDEs.
+	class SectionFolder final
+	{
+		static constexpr uint32_t GRP_COMDAT      = 0x1;
+		static constexpr uint64_t SHF_LINK_ORDER  = 0x80;
+		static constexpr uint64_t SHF_TLS         = 0x400;
+		static constexpr uint32_t no_class        = UINT32_MAX;
+
+	public:
+		enum class Mode
+		{
+			ReadOnlyData,
+			All,
+		};
+
+		struct Result
+		{
+			size_t   sections = 0;        // folded sections, including members of folded groups
+			size_t   groups = 0;
+			uint64_t bytes = 0;           // of allocated sections removed
+		};
+
+	private:
+		struct Relocation
+		{
+			uint64_t offset;
+			uint32_t type;
+			uint32_t symbol;
+			int64_t  addend;
+		};
+
+		struct Group
+		{
+			uint32_t              index;
+			std::vector<uint32_t> members;  // without the relocation sections
+		};
+
+		using target_key = std::pair<uint64_t, uint64_t>;
+
+	public:
+		// Rewrites the object if anything was folded, throws `invalid_operation_error` on error
+		static Result fold (fs::path const& object_file, Mode mode);
+
+	private:
+		SectionFolder (ElfObject &object, Mode mode);
+
+		Result fold ();
+		void find_candidates ();
+		void read_relocations (ElfSection const& section);
+		void partition ();
+		bool same_shape (uint32_t a, uint32_t b) const;
+		std::vector<target_key> relocation_targets (uint32_t section) const;
+		Result apply (std::vector<uint32_t> const& replacement, std::vector<uint32_t> const& dissolved_groups,
+		              std::vector<uint32_t> const& removed_groups);
+
+		// Removes the FDEs of the removed sections from `.eh_frame`, the replacements have their own.  Returns the
+		// number of bytes removed.
+		uint64_t remove_frame_descriptions (uint32_t eh_frame, std::vector<bool> const& removed);
+
+		bool is_candidate (ElfSection const& section, bool in_group) const noexcept;
+		static uint64_t shape_hash (ElfSection const& section, std::vector<Relocation> const& relocations) noexcept;
+
+	private:
+		ElfObject                           &object;
+		Mode const                           mode;
+		std::vector<bool>                    in_group;
+		std::vector<Group>                   groups;
+		std::vector<std::vector<Relocation>> relocations;   // per section
+		std::vector<uint32_t>                candidates;
+		std::vector<uint32_t>                class_of;      // per section, `no_class` if not a candidate
+		std::vector<std::vector<uint32_t>>   classes;
+	};
+}
+#endif // __SECTION_FOLDER_HH
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "sha256.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr std::array<uint32_t, 64> round_constants {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+	};
+
+	constexpr uint32_t rotr (uint32_t x, uint32_t n) noexcept
+	{
+		return (x >> n) | (x << (32 - n));
+	}
+}
+
+Sha256::Sha256 () noexcept
+	: state {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	  }
+{}
+
+void Sha256::transform (uint8_t const* block) noexcept
+{
+	std::array<uint32_t, 64> w;
+	for (size_t i = 0; i < 16; i++) {
+		w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) |
+		       (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+		       (static_cast<uint32_t>(block[i * 4 + 2]) << 8) |
+		       static_cast<uint32_t>(block[i * 4 + 3]);
+	}
+
+	for (size_t i = 16; i < 64; i++) {
+		uint32_t s0 = rotr (w[i - 15], 7) ^ rotr (w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = rotr (w[i - 2], 17) ^ rotr (w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+	for (size_t i = 0; i < 64; i++) {
+		uint32_t s1 = rotr (e, 6) ^ rotr (e, 11) ^ rotr (e, 25);
+		uint32_t ch = (e & f) ^ (~e & g);
+		uint32_t t1 = h + s1 + ch + round_constants[i] + w[i];
+		uint32_t s0 = rotr (a, 2) ^ rotr (a, 13) ^ rotr (a, 22);
+		uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+		uint32_t t2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void Sha256::update (void const* data, size_t length) noexcept
+{
+	auto bytes = static_cast<uint8_t const*>(data);
+	total_length += length;
+
+	if (buffer_used > 0) {
+		size_t to_copy = std::min (buffer.size () - buffer_used, length);
+		std::memcpy (buffer.data () + buffer_used, bytes, to_copy);
+		buffer_used += to_copy;
+		bytes += to_copy;
+		length -= to_copy;
+
+		if (buffer_used < buffer.size ()) {
+			return;
+		}
+
+		transform (buffer.data ());
+		buffer_used = 0;
+	}
+
+	while (length >= buffer.size ()) {
+		transform (bytes);
+		bytes += buffer.size ();
+		length -= buffer.size ();
+	}
+
+	if (length > 0) {
+		std::memcpy (buffer.data (), bytes, length);
+		buffer_used = length;
+	}
+}
+
+Sha256::digest_type Sha256::finish () noexcept
+{
+	uint64_t bit_length = total_length * 8;
+
+	uint8_t const padding_start = 0x80;
+	update (&padding_start, 1);
+
+	uint8_t const zero = 0;
+	while (buffer_used != 56) {
+		update (&zero, 1);
+	}
+
+	std::array<uint8_t, 8> length_bytes;
+	for (size_t i = 0; i < length_bytes.size (); i++) {
+		length_bytes[i] = static_cast<uint8_t>(bit_length >> (56 - i * 8));
+	}
+	update (length_bytes.data (), length_bytes.size ());
+
+	digest_type digest;
+	for (size_t i = 0; i < state.size (); i++) {
+		digest[i * 4]     = static_cast<uint8_t>(state[i] >> 24);
+		digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+		digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+		digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+	}
+
+	return digest;
+}
+
+std::string Sha256::finish_hex ()
+{
+	return to_hex (finish ());
+}
+
+std::string Sha256::to_hex (digest_type const& digest)
+{
+	constexpr char hex_digits[] = "0123456789abcdef";
+
+	std::string ret;
+	ret.reserve (digest.size () * 2);
+	for (uint8_t b : digest) {
+		ret.push_back (hex_digits[b >> 4]);
+		ret.push_back (hex_digits[b & 0x0f]);
+	}
+
+	return ret;
+}
+
+std::string Sha256::hash_hex (void const* data, size_t length)
+{
+	Sha256 sha;
+	sha.update (data, length);
+	return sha.finish_hex ();
+}
+
+std::optional<std::string> Sha256::hash_file_hex (std::filesystem::path const& path)
+{
+	std::ifstream is { path, std::ios::binary };
+	if (!is) {
+		return std::nullopt;
+	}
+
+	Sha256 sha;
+	std::vector<char> buffer (1024 * 1024);
+	while (is) {
+		is.read (buffer.data (), static_cast<std::streamsize>(buffer.size ()));
+		sha.update (buffer.data (), static_cast<size_t>(is.gcount ()));
+	}
+
+	if (is.bad ()) {
+		return std::nullopt;
+	}
+
+	return sha.finish_hex ();
+}
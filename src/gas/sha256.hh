@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__SHA256_HH)
+#define __SHA256_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace xamarin::android::gas
+{
+	// Incremental SHA-256 (FIPS 180-4), used wherever content needs to be addressed in a way shared with tools outside
+	// of this program (e.g. remote caches)
+	class Sha256 final
+	{
+	public:
+		static constexpr size_t digest_size = 32;
+		using digest_type = std::array<uint8_t, digest_size>;
+
+	public:
+		Sha256 () noexcept;
+
+		void update (void const* data, size_t length) noexcept;
+
+		void update (std::string_view const& data) noexcept
+		{
+			update (data.data (), data.size ());
+		}
+
+		digest_type finish () noexcept;
+		std::string finish_hex ();
+
+		static std::string to_hex (digest_type const& digest);
+		static std::string hash_hex (void const* data, size_t length);
+		static std::optional<std::string> hash_file_hex (std::filesystem::path const& path);
+
+	private:
+		void transform (uint8_t const* block) noexcept;
+
+	private:
+		std::array<uint32_t, 8> state;
+		std::array<uint8_t, 64> buffer;
+		size_t                  buffer_used = 0;
+		uint64_t                total_length = 0;
+	};
+}
+#endif // __SHA256_HH
@@ -0,0 +1,505 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+
+#include "debug_info_splitter.hh"
+#include "exceptions.hh"
+#include "json_writer.hh"
+#include "size_report.hh"
+
+using namespace xamarin::android::gas;
+
+namespace {
+	constexpr uint16_t EM_386     = 3;
+	constexpr uint16_t EM_ARM     = 40;
+	constexpr uint16_t EM_X86_64  = 62;
+	constexpr uint16_t EM_AARCH64 = 183;
+
+	constexpr uint32_t SHT_SYMTAB_SHNDX = 18;
+	constexpr uint8_t  STT_TLS          = 6;
+
+	struct RelocationName
+	{
+		uint32_t    type;
+		char const* name;
+	};
+
+	// Only the relocations the assembler (or `ld -r`) can produce and the common dynamic ones, others are reported by
+	// number
+	constexpr std::array x86_64_relocations {
+		RelocationName { 0, "NONE" }, RelocationName { 1, "64" }, RelocationName { 2, "PC32" }, RelocationName { 3, "GOT32" },
+		RelocationName { 4, "PLT32" }, RelocationName { 5, "COPY" }, RelocationName { 6, "GLOB_DAT" }, RelocationName { 7, "JUMP_SLOT" },
+		RelocationName { 8, "RELATIVE" }, RelocationName { 9, "GOTPCREL" }, RelocationName { 10, "32" }, RelocationName { 11, "32S" },
+		RelocationName { 12, "16" }, RelocationName { 13, "PC16" }, RelocationName { 14, "8" }, RelocationName { 15, "PC8" },
+		RelocationName { 16, "DTPMOD64" }, RelocationName { 17, "DTPOFF64" }, RelocationName { 18, "TPOFF64" }, RelocationName { 19, "TLSGD" },
+		RelocationName { 20, "TLSLD" }, RelocationName { 21, "DTPOFF32" }, RelocationName { 22, "GOTTPOFF" }, RelocationName { 23, "TPOFF32" },
+		RelocationName { 24, "PC64" }, RelocationName { 25, "GOTOFF64" }, RelocationName { 26, "GOTPC32" }, RelocationName { 27, "GOT64" },
+		RelocationName { 28, "GOTPCREL64" }, RelocationName { 29, "GOTPC64" }, RelocationName { 30, "GOTPLT64" }, RelocationName { 31, "PLTOFF64" },
+		RelocationName { 32, "SIZE32" }, RelocationName { 33, "SIZE64" }, RelocationName { 34, "GOTPC32_TLSDESC" }, RelocationName { 35, "TLSDESC_CALL" },
+		RelocationName { 36, "TLSDESC" }, RelocationName { 37, "IRELATIVE" }, RelocationName { 41, "GOTPCRELX" }, RelocationName { 42, "REX_GOTPCRELX" },
+	};
+
+	constexpr std::array i386_relocations {
+		RelocationName { 0, "NONE" }, RelocationName { 1, "32" }, RelocationName { 2, "PC32" }, RelocationName { 3, "GOT32" },
+		RelocationName { 4, "PLT32" }, RelocationName { 5, "COPY" }, RelocationName { 6, "GLOB_DAT" }, RelocationName { 7, "JUMP_SLOT" },
+		RelocationName { 8, "RELATIVE" }, RelocationName { 9, "GOTOFF" }, RelocationName { 10, "GOTPC" }, RelocationName { 14, "TLS_TPOFF" },
+		RelocationName { 15, "TLS_IE" }, RelocationName { 16, "TLS_GOTIE" }, RelocationName { 17, "TLS_LE" }, RelocationName { 18, "TLS_GD" },
+		RelocationName { 19, "TLS_LDM" }, RelocationName { 20, "16" }, RelocationName { 21, "PC16" }, RelocationName { 22, "8" },
+		RelocationName { 23, "PC8" }, RelocationName { 32, "TLS_LDO_32" }, RelocationName { 35, "TLS_DTPMOD32" }, RelocationName { 36, "TLS_DTPOFF32" },
+		RelocationName { 37, "TLS_TPOFF32" }, RelocationName { 38, "SIZE32" }, RelocationName { 39, "TLS_GOTDESC" }, RelocationName { 40, "TLS_DESC_CALL" },
+		RelocationName { 41, "TLS_DESC" }, RelocationName { 42, "IRELATIVE" }, RelocationName { 43, "GOT32X" },
+	};
+
+	constexpr std::array arm_relocations {
+		RelocationName { 0, "NONE" }, RelocationName { 1, "PC24" }, RelocationName { 2, "ABS32" }, RelocationName { 3, "REL32" },
+		RelocationName { 4, "LDR_PC_G0" }, RelocationName { 5, "ABS16" }, RelocationName { 6, "ABS12" }, RelocationName { 7, "THM_ABS5" },
+		RelocationName { 8, "ABS8" }, RelocationName { 9, "SBREL32" }, RelocationName { 10, "THM_CALL" }, RelocationName { 11, "THM_PC8" },
+		RelocationName { 17, "TLS_DTPMOD32" }, RelocationName { 18, "TLS_DTPOFF32" }, RelocationName { 19, "TLS_TPOFF32" }, RelocationName { 20, "COPY" },
+		RelocationName { 21, "GLOB_DAT" }, RelocationName { 22, "JUMP_SLOT" }, RelocationName { 23, "RELATIVE" }, RelocationName { 24, "GOTOFF32" },
+		RelocationName { 25, "BASE_PREL" }, RelocationName { 26, "GOT_BREL" }, RelocationName { 27, "PLT32" }, RelocationName { 28, "CALL" },
+		RelocationName { 29, "JUMP24" }, RelocationName { 30, "THM_JUMP24" }, RelocationName { 31, "BASE_ABS" }, RelocationName { 38, "TARGET1" },
+		RelocationName { 40, "V4BX" }, RelocationName { 41, "TARGET2" }, RelocationName { 42, "PREL31" }, RelocationName { 43, "MOVW_ABS_NC" },
+		RelocationName { 44, "MOVT_ABS" }, RelocationName { 45, "MOVW_PREL_NC" }, RelocationName { 46, "MOVT_PREL" }, RelocationName { 47, "THM_MOVW_ABS_NC" },
+		RelocationName { 48, "THM_MOVT_ABS" }, RelocationName { 49, "THM_MOVW_PREL_NC" }, RelocationName { 50, "THM_MOVT_PREL" }, RelocationName { 51, "THM_JUMP19" },
+		RelocationName { 96, "GOT_PREL" }, RelocationName { 102, "THM_JUMP11" }, RelocationName { 103, "THM_JUMP8" }, RelocationName { 104, "TLS_GD32" },
+		RelocationName { 105, "TLS_LDM32" }, RelocationName { 106, "TLS_LDO32" }, RelocationName { 107, "TLS_IE32" }, RelocationName { 108, "TLS_LE32" },
+		RelocationName { 160, "IRELATIVE" },
+	};
+
+	constexpr std::array aarch64_relocations {
+		RelocationName { 0, "NONE" }, RelocationName { 257, "ABS64" }, RelocationName { 258, "ABS32" }, RelocationName { 259, "ABS16" },
+		RelocationName { 260, "PREL64" }, RelocationName { 261, "PREL32" }, RelocationName { 262, "PREL16" }, RelocationName { 263, "MOVW_UABS_G0" },
+		RelocationName { 264, "MOVW_UABS_G0_NC" }, RelocationName { 265, "MOVW_UABS_G1" }, RelocationName { 266, "MOVW_UABS_G1_NC" }, RelocationName { 267, "MOVW_UABS_G2" },
+		RelocationName { 268, "MOVW_UABS_G2_NC" }, RelocationName { 269, "MOVW_UABS_G3" }, RelocationName { 270, "MOVW_SABS_G0" }, RelocationName { 271, "MOVW_SABS_G1" },
+		RelocationName { 272, "MOVW_SABS_G2" }, RelocationName { 273, "LD_PREL_LO19" }, RelocationName { 274, "ADR_PREL_LO21" }, RelocationName { 275, "ADR_PREL_PG_HI21" },
+		RelocationName { 276, "ADR_PREL_PG_HI21_NC" }, RelocationName { 277, "ADD_ABS_LO12_NC" }, RelocationName { 278, "LDST8_ABS_LO12_NC" }, RelocationName { 279, "TSTBR14" },
+		RelocationName { 280, "CONDBR19" }, RelocationName { 282, "JUMP26" }, RelocationName { 283, "CALL26" }, RelocationName { 284, "LDST16_ABS_LO12_NC" },
+		RelocationName { 285, "LDST32_ABS_LO12_NC" }, RelocationName { 286, "LDST64_ABS_LO12_NC" }, RelocationName { 299, "LDST128_ABS_LO12_NC" }, RelocationName { 309, "GOT_LD_PREL19" },
+		RelocationName { 311, "ADR_GOT_PAGE" }, RelocationName { 312, "LD64_GOT_LO12_NC" }, RelocationName { 313, "LD64_GOTPAGE_LO15" }, RelocationName { 512, "TLSGD_ADR_PREL21" },
+		RelocationName { 513, "TLSGD_ADR_PAGE21" }, RelocationName { 514, "TLSGD_ADD_LO12_NC" }, RelocationName { 541, "TLSIE_ADR_GOTTPREL_PAGE21" }, RelocationName { 542, "TLSIE_LD64_GOTTPREL_LO12_NC" },
+		RelocationName { 549, "TLSLE_ADD_TPREL_HI12" }, RelocationName { 550, "TLSLE_ADD_TPREL_LO12" }, RelocationName { 551, "TLSLE_ADD_TPREL_LO12_NC" }, RelocationName { 562, "TLSDESC_ADR_PAGE21" },
+		RelocationName { 563, "TLSDESC_LD64_LO12" }, RelocationName { 564, "TLSDESC_ADD_LO12" }, RelocationName { 569, "TLSDESC_CALL" }, RelocationName { 1024, "COPY" },
+		RelocationName { 1025, "GLOB_DAT" }, RelocationName { 1026, "JUMP_SLOT" }, RelocationName { 1027, "RELATIVE" }, RelocationName { 1028, "TLS_DTPMOD64" },
+		RelocationName { 1029, "TLS_DTPREL64" }, RelocationName { 1030, "TLS_TPREL64" }, RelocationName { 1031, "TLSDESC" }, RelocationName { 1032, "IRELATIVE" },
+	};
+
+	template<size_t N>
+	char const* find_relocation_name (std::array<RelocationName, N> const& names, uint32_t type) noexcept
+	{
+		for (RelocationName const& entry : names) {
+			if (entry.type == type) {
+				return entry.name;
+			}
+		}
+
+		return nullptr;
+	}
+
+	uint64_t read_le (uint8_t const* p, size_t size) noexcept
+	{
+		uint64_t ret = 0;
+		for (size_t i = size; i > 0; i--) {
+			ret = (ret << 8) | p[i - 1];
+		}
+
+		return ret;
+	}
+}
+
+void SizeReport::add_object (fs::path const& object_file)
+{
+	add_object (ElfObject::read (object_file));
+}
+
+void SizeReport::add_object (ElfObject const& object)
+{
+	if (object_count > 0 && object.machine () != machine) {
+		throw invalid_operation_error { "Objects for different machines cannot be combined in one size report" };
+	}
+
+	machine = object.machine ();
+	object_count++;
+
+	for (ElfSection const& section : object.sections ()) {
+		if (section.type != ElfObject::SHT_NULL) {
+			add_section (object, section);
+		}
+	}
+
+	for (ElfSymbol const& symbol : object.symbols ()) {
+		add_symbol (object, symbol);
+	}
+}
+
+void SizeReport::add_section (ElfObject const& object, ElfSection const& section)
+{
+	uint64_t size = section.size ();
+	SectionStats &stats = sections[section.name];
+	stats.type = section.type;
+	stats.size += size;
+	stats.count++;
+
+	switch (section.type) {
+		case ElfObject::SHT_REL:
+		case ElfObject::SHT_RELA:
+			if (section.info < object.sections ().size () && DebugInfoSplitter::is_debug_section (object.sections ()[section.info])) {
+				categories.debug_relocations += size;
+			} else {
+				categories.relocations += size;
+			}
+			count_relocations (object, section);
+			return;
+
+		case ElfObject::SHT_SYMTAB:
+		case ElfObject::SHT_STRTAB:
+		case SHT_SYMTAB_SHNDX:
+			categories.symbol_table += size;
+			return;
+
+		case ElfObject::SHT_NOBITS:
+			categories.bss += size;
+			return;
+	}
+
+	if (DebugInfoSplitter::is_debug_section (section)) {
+		categories.debug += size;
+	} else if ((section.flags & ElfObject::SHF_ALLOC) == 0) {
+		categories.other += size;
+	} else if ((section.flags & ElfObject::SHF_EXECINSTR) != 0) {
+		categories.code += size;
+	} else if ((section.flags & ElfObject::SHF_WRITE) != 0) {
+		categories.data += size;
+	} else {
+		categories.read_only_data += size;
+	}
+}
+
+bool SizeReport::is_larger (SymbolStats const& a, SymbolStats const& b) noexcept
+{
+	if (a.size != b.size) {
+		return a.size > b.size;
+	}
+
+	return a.name < b.name;
+}
+
+void SizeReport::add_symbol (ElfObject const& object, ElfSymbol const& symbol)
+{
+	uint8_t type = symbol.type ();
+	if (!symbol.is_defined () || type == ElfObject::STT_SECTION || type == ElfObject::STT_FILE) {
+		return;
+	}
+
+	symbol_count++;
+	symbol_size += symbol.size;
+	if (symbol.size == 0) {
+		return;
+	}
+
+	// With `is_larger` as the heap order the smallest of the kept symbols is at the front
+	if (top_symbols.size () == top_symbol_count) {
+		if (symbol.size <= top_symbols.front ().size) {
+			return;
+		}
+		std::pop_heap (top_symbols.begin (), top_symbols.end (), is_larger);
+		top_symbols.pop_back ();
+	}
+
+	SymbolStats stats;
+	stats.name = symbol.name;
+	if (symbol.section < object.sections ().size ()) {
+		stats.section = object.sections ()[symbol.section].name;
+	} else if (symbol.section == ElfObject::SHN_COMMON) {
+		stats.section = "*COM*";
+	} else if (symbol.section == ElfObject::SHN_ABS) {
+		stats.section = "*ABS*";
+	}
+	stats.size = symbol.size;
+	stats.type = type;
+	stats.binding = symbol.binding ();
+
+	top_symbols.push_back (std::move (stats));
+	std::push_heap (top_symbols.begin (), top_symbols.end (), is_larger);
+}
+
+void SizeReport::count_relocations (ElfObject const& object, ElfSection const& section)
+{
+	bool rela = section.type == ElfObject::SHT_RELA;
+	size_t entry_size;
+	size_t info_offset;
+	size_t info_size;
+	if (object.is_64bit ()) {
+		entry_size = rela ? 24 : 16;
+		info_offset = 8;
+		info_size = 8;
+	} else {
+		entry_size = rela ? 12 : 8;
+		info_offset = 4;
+		info_size = 4;
+	}
+
+	std::map<uint32_t, uint64_t> counts;
+	uint8_t const* data = section.data.data ();
+	for (size_t offset = 0; offset + entry_size <= section.data.size (); offset += entry_size) {
+		uint64_t info = read_le (data + offset + info_offset, info_size);
+		uint32_t type = object.is_64bit () ? static_cast<uint32_t>(info & 0xffffffff) : static_cast<uint32_t>(info & 0xff);
+		counts[type]++;
+	}
+
+	for (auto const& [type, count] : counts) {
+		relocations[relocation_type_name (object.machine (), type)] += count;
+		relocation_count += count;
+	}
+}
+
+char const* SizeReport::machine_name (uint16_t machine) noexcept
+{
+	switch (machine) {
+		case EM_386:
+			return "i386";
+
+		case EM_ARM:
+			return "arm";
+
+		case EM_X86_64:
+			return "x86_64";
+
+		case EM_AARCH64:
+			return "aarch64";
+
+		default:
+			return "unknown";
+	}
+}
+
+std::string SizeReport::section_type_name (uint32_t type)
+{
+	switch (type) {
+		case ElfObject::SHT_PROGBITS:
+			return "PROGBITS";
+
+		case ElfObject::SHT_SYMTAB:
+			return "SYMTAB";
+
+		case ElfObject::SHT_STRTAB:
+			return "STRTAB";
+
+		case ElfObject::SHT_RELA:
+			return "RELA";
+
+		case ElfObject::SHT_NOTE:
+			return "NOTE";
+
+		case ElfObject::SHT_NOBITS:
+			return "NOBITS";
+
+		case ElfObject::SHT_REL:
+			return "REL";
+
+		case ElfObject::SHT_GROUP:
+			return "GROUP";
+
+		case SHT_SYMTAB_SHNDX:
+			return "SYMTAB_SHNDX";
+
+		case ElfObject::SHT_LLVM_ADDRSIG:
+			return "LLVM_ADDRSIG";
+
+		default: {
+			// Mostly processor-specific, e.g. `SHT_X86_64_UNWIND` and `SHT_ARM_EXIDX` share the same value
+			std::array<char, 16> buf {};
+			std::snprintf (buf.data (), buf.size (), "0x%x", type);
+			return buf.data ();
+		}
+	}
+}
+
+char const* SizeReport::symbol_type_name (uint8_t type) noexcept
+{
+	switch (type) {
+		case ElfObject::STT_NOTYPE:
+			return "NOTYPE";
+
+		case ElfObject::STT_OBJECT:
+			return "OBJECT";
+
+		case ElfObject::STT_FUNC:
+			return "FUNC";
+
+		case STT_TLS:
+			return "TLS";
+
+		default:
+			return "OTHER";
+	}
+}
+
+std::string SizeReport::relocation_type_name (uint16_t machine, uint32_t type)
+{
+	char const* prefix;
+	char const* name;
+	switch (machine) {
+		case EM_386:
+			prefix = "R_386_";
+			name = find_relocation_name (i386_relocations, type);
+			break;
+
+		case EM_ARM:
+			prefix = "R_ARM_";
+			name = find_relocation_name (arm_relocations, type);
+			break;
+
+		case EM_X86_64:
+			prefix = "R_X86_64_";
+			name = find_relocation_name (x86_64_relocations, type);
+			break;
+
+		case EM_AARCH64:
+			prefix = "R_AARCH64_";
+			name = find_relocation_name (aarch64_relocations, type);
+			break;
+
+		default:
+			prefix = "R_";
+			name = nullptr;
+			break;
+	}
+
+	std::string ret { prefix };
+	if (name != nullptr) {
+		ret.append (name);
+	} else {
+		ret.append (std::to_string (type));
+	}
+
+	return ret;
+}
+
+void SizeReport::write (fs::path const& report_file) const
+{
+	JsonWriter json;
+	json.begin_object ();
+	json.key ("version");
+	json.value (uint64_t { 1 });
+	json.key ("machine");
+	json.value (machine_name (machine));
+	json.key ("objects");
+	json.value (object_count);
+
+	uint64_t total_size = categories.code + categories.data + categories.read_only_data + categories.debug + categories.relocations +
+		categories.debug_relocations + categories.symbol_table + categories.other;
+	json.key ("total_size"); // of the section contents, without `.bss`
+	json.value (total_size);
+
+	json.key ("categories");
+	json.begin_object ();
+	json.key ("code");
+	json.value (categories.code);
+	json.key ("data");
+	json.value (categories.data);
+	json.key ("read_only_data");
+	json.value (categories.read_only_data);
+	json.key ("bss");
+	json.value (categories.bss);
+	json.key ("debug");
+	json.value (categories.debug);
+	json.key ("relocations");
+	json.value (categories.relocations);
+	json.key ("debug_relocations");
+	json.value (categories.debug_relocations);
+	json.key ("symbol_table");
+	json.value (categories.symbol_table);
+	json.key ("other");
+	json.value (categories.other);
+	json.end_object ();
+
+	json.key ("dwarf_to_code_ratio");
+	json.value (categories.code == 0 ? 0.0 : static_cast<double>(categories.debug) / static_cast<double>(categories.code));
+
+	std::vector<std::map<std::string, SectionStats>::const_iterator> sorted_sections;
+	for (auto it = sections.begin (); it != sections.end (); ++it) {
+		sorted_sections.push_back (it);
+	}
+	std::stable_sort (
+		sorted_sections.begin (), sorted_sections.end (),
+		[](auto const& a, auto const& b) -> bool {
+			return a->second.size > b->second.size;
+		}
+	);
+
+	json.key ("sections");
+	json.begin_array ();
+	for (auto const& it : sorted_sections) {
+		json.begin_object ();
+		json.key ("name");
+		json.value (it->first);
+		json.key ("type");
+		json.value (section_type_name (it->second.type));
+		json.key ("size");
+		json.value (it->second.size);
+		json.key ("count");
+		json.value (it->second.count);
+		json.end_object ();
+	}
+	json.end_array ();
+
+	std::vector<SymbolStats> sorted_symbols { top_symbols };
+	std::sort (sorted_symbols.begin (), sorted_symbols.end (), is_larger);
+
+	json.key ("symbols");
+	json.begin_object ();
+	json.key ("count");
+	json.value (symbol_count);
+	json.key ("total_size");
+	json.value (symbol_size);
+	json.key ("top");
+	json.begin_array ();
+	for (SymbolStats const& symbol : sorted_symbols) {
+		json.begin_object ();
+		json.key ("name");
+		json.value (symbol.name);
+		json.key ("size");
+		json.value (symbol.size);
+		json.key ("type");
+		json.value (symbol_type_name (symbol.type));
+		json.key ("binding");
+		json.value (symbol.binding == ElfObject::STB_LOCAL ? "LOCAL" : symbol.binding == ElfObject::STB_WEAK ? "WEAK" : "GLOBAL");
+		json.key ("section");
+		json.value (symbol.section);
+		json.end_object ();
+	}
+	json.end_array ();
+	json.end_object ();
+
+	json.key ("relocations");
+	json.begin_object ();
+	json.key ("count");
+	json.value (relocation_count);
+	json.key ("by_type");
+	json.begin_object ();
+	for (auto const& [name, count] : relocations) {
+		json.key (name);
+		json.value (count);
+	}
+	json.end_object ();
+	json.end_object ();
+	json.end_object ();
+
+	std::ofstream os { report_file, std::ios::binary };
+	if (!os) {
+		std::string message { "Unable to open " };
+		message.append (report_file.string ());
+		message.append (" for writing");
+		throw invalid_operation_error { message };
+	}
+
+	os.write (json.str ().data (), static_cast<std::streamsize>(json.str ().length ()));
+	os.close ();
+	if (!os) {
+		std::string message { "Unable to write " };
+		message.append (report_file.string ());
+		throw invalid_operation_error { message };
+	}
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__SIZE_REPORT_HH)
+#define __SIZE_REPORT_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "elf_object.hh"
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	class JsonWriter;
+
+	// Size and relocation statistics of the assembler output, written as JSON by `--size-report`: sizes of the
+	// individual sections and of section categories (code, data, DWARF etc), the largest symbols and relocation counts
+	// by type.  Sections of the same name in several objects (the members of an archive) are added up.  Two reports
+	// can be compared with tools/size-report-diff.py.
+	class SizeReport final
+	{
+	public:
+		static constexpr size_t top_symbol_count = 25;
+
+	public:
+		// Throws `invalid_operation_error` if the object cannot be read or parsed
+		void add_object (fs::path const& object_file);
+		void add_object (ElfObject const& object);
+
+		// Throws `invalid_operation_error` if the report cannot be written
+		void write (fs::path const& report_file) const;
+
+	private:
+		struct SectionStats
+		{
+			uint32_t type = 0;
+			uint64_t size = 0;
+			uint64_t count = 0;
+		};
+
+		struct SymbolStats
+		{
+			std::string name;
+			std::string section;
+			uint64_t    size = 0;
+			uint8_t     type = 0;
+			uint8_t     binding = 0;
+		};
+
+		struct CategorySizes
+		{
+			uint64_t code = 0;
+			uint64_t data = 0;
+			uint64_t read_only_data = 0;
+			uint64_t bss = 0;
+			uint64_t debug = 0;
+			uint64_t relocations = 0;
+			uint64_t debug_relocations = 0;
+			uint64_t symbol_table = 0;
+			uint64_t other = 0;
+		};
+
+		void add_section (ElfObject const& object, ElfSection const& section);
+		void add_symbol (ElfObject const& object, ElfSymbol const& symbol);
+		void count_relocations (ElfObject const& object, ElfSection const& section);
+
+		static bool is_larger (SymbolStats const& a, SymbolStats const& b) noexcept;
+		static char const* machine_name (uint16_t machine) noexcept;
+		static std::string section_type_name (uint32_t type);
+		static char const* symbol_type_name (uint8_t type) noexcept;
+		static std::string relocation_type_name (uint16_t machine, uint32_t type);
+
+	private:
+		uint16_t                            machine = 0;
+		uint64_t                            object_count = 0;
+		CategorySizes                       categories;
+		std::map<std::string, SectionStats> sections;
+		std::vector<SymbolStats>            top_symbols; // min-heap of the `top_symbol_count` largest symbols
+		uint64_t                            symbol_count = 0;
+		uint64_t                            symbol_size = 0;
+		std::map<std::string, uint64_t>     relocations;
+		uint64_t                            relocation_count = 0;
+	};
+}
+#endif // __SIZE_REPORT_HH
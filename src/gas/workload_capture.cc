@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: MIT
+#include <cstdlib>
+#include <fstream>
+#include <random>
+
+#include "dependency_scanner.hh"
+#include "exceptions.hh"
+#include "file_utils.hh"
+#include "input_stream.hh"
+#include "json_writer.hh"
+#include "sha256.hh"
+#include "workload_capture.hh"
+
+using namespace xamarin::android::gas;
+
+std::unique_ptr<WorkloadCapture> WorkloadCapture::from_environment ()
+{
+	char const* dir = std::getenv (capture_dir_variable);
+	if (dir == nullptr || *dir == '\0') {
+		return nullptr;
+	}
+
+	return std::make_unique<WorkloadCapture> (fs::absolute (fs::path { dir }));
+}
+
+std::string WorkloadCapture::to_utf8 (fs::path const& path)
+{
+	std::u8string s = path.u8string ();
+	return { s.begin (), s.end () };
+}
+
+std::string WorkloadCapture::store_file (fs::path const& path) const
+{
+	std::optional<std::string> digest = Sha256::hash_file_hex (path);
+	if (!digest.has_value ()) {
+		return {};
+	}
+
+	fs::path stored = capture_dir / "files" / digest.value ();
+	std::error_code ec;
+	if (fs::exists (stored, ec)) {
+		return digest.value ();
+	}
+
+	// Concurrent invocations may store the same file, whichever renames it last wins, the contents are the same
+	fs::path temporary = FileUtils::make_temporary_path (stored);
+	fs::copy_file (path, temporary);
+	fs::rename (temporary, stored);
+
+	return digest.value ();
+}
+
+void WorkloadCapture::record (std::vector<platform::string> const& args, std::vector<fs::path> const& input_files,
+                              std::vector<fs::path> const& include_dirs, fs::path const& output_file, int exit_code) const
+{
+	double wall_time_ms = std::chrono::duration<double, std::milli> (clock::now () - start_time).count ();
+
+	try {
+		fs::create_directories (capture_dir / "files");
+		fs::create_directories (capture_dir / "invocations");
+
+		DependencyScanner dependencies { include_dirs };
+		bool replayable = true;
+		for (fs::path const& input : input_files) {
+			if (InputStream::is_stdin (input)) {
+				replayable = false;
+			} else {
+				dependencies.scan_input (input);
+			}
+		}
+
+		JsonWriter json;
+		json.begin_object ();
+		json.key ("version");
+		json.value (uint64_t { 1 });
+		json.key ("cwd");
+		json.value (to_utf8 (fs::current_path ()));
+
+		json.key ("args");
+		json.begin_array ();
+		for (size_t i = 1; i < args.size (); i++) {
+			json.value (to_utf8 (fs::path { args[i] }));
+		}
+		json.end_array ();
+
+		json.key ("replayable");
+		json.value (replayable);
+
+		json.key ("files");
+		json.begin_array ();
+		for (fs::path const& file : dependencies.dependencies ()) {
+			std::string digest = store_file (file);
+			if (digest.empty ()) {
+				continue; // missing, the invocation most likely failed because of it
+			}
+
+			json.begin_object ();
+			json.key ("path");
+			json.value (to_utf8 (file));
+			json.key ("sha256");
+			json.value (digest);
+			json.end_object ();
+		}
+		json.end_array ();
+
+		json.key ("output");
+		json.begin_object ();
+		json.key ("path");
+		json.value (to_utf8 (output_file));
+		if (exit_code == 0) {
+			std::optional<std::string> digest = Sha256::hash_file_hex (output_file);
+			if (digest.has_value ()) {
+				json.key ("sha256");
+				json.value (digest.value ());
+			}
+		}
+		json.end_object ();
+
+		json.key ("exit_code");
+		json.value (static_cast<int64_t>(exit_code));
+		json.key ("wall_time_ms");
+		json.value (wall_time_ms);
+		json.end_object ();
+
+		// Named after the start time, so that the replay can keep the original order.  Written under a temporary
+		// name first, so that the replay never sees a partial record.
+		auto since_epoch = std::chrono::system_clock::now ().time_since_epoch () - std::chrono::duration_cast<std::chrono::system_clock::duration> (clock::now () - start_time);
+		std::string name = std::to_string (std::chrono::duration_cast<std::chrono::nanoseconds> (since_epoch).count ());
+		name.append ("-");
+		name.append (std::to_string (std::random_device {} ()));
+		name.append (".json");
+
+		fs::path record_file = capture_dir / "invocations" / name;
+		fs::path temporary = FileUtils::make_temporary_path (record_file);
+		{
+			std::ofstream os { temporary, std::ios::binary };
+			os.write (json.str ().data (), static_cast<std::streamsize>(json.str ().length ()));
+			os.close ();
+			if (!os) {
+				std::error_code ec;
+				fs::remove (temporary, ec);
+				throw invalid_operation_error { "Unable to write the invocation record" };
+			}
+		}
+		fs::rename (temporary, record_file);
+	} catch (std::exception const& ex) {
+		STDERR << "Failed to capture the invocation in " << capture_dir << ". " << ex.what () << Constants::newline;
+	}
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MIT
+#if !defined (__WORKLOAD_CAPTURE_HH)
+#define __WORKLOAD_CAPTURE_HH
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gas.hh"
+
+namespace xamarin::android::gas
+{
+	// Records `as` invocations of a real build, so that the workload can later be replayed offline (see
+	// tools/gas-replay.py) to compare toolchain versions.  Enabled by setting `XA_GAS_CAPTURE_DIR` to the capture
+	// directory, which can be shared by any number of concurrent invocations:
+	//
+	//   files/<sha256>            contents of the input files and the files they include, stored once
+	//   invocations/<id>.json     one per invocation: arguments, working directory, files read (path as seen by the
+	//                             invocation and digest), output digest, exit code and wall time
+	//
+	// Source read from stdin is not captured, such invocations are recorded but marked as not replayable.
+	class WorkloadCapture final
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		static constexpr char const capture_dir_variable[] = "XA_GAS_CAPTURE_DIR";
+
+	public:
+		explicit WorkloadCapture (fs::path capture_dir)
+			: capture_dir (std::move (capture_dir)),
+			  start_time (clock::now ())
+		{}
+
+		// Returns `nullptr` unless capture is enabled
+		static std::unique_ptr<WorkloadCapture> from_environment ();
+
+		// `args` is the complete command line, the program path is not recorded.  Errors are reported, but never fail
+		// the invocation.
+		void record (std::vector<platform::string> const& args, std::vector<fs::path> const& input_files,
+		             std::vector<fs::path> const& include_dirs, fs::path const& output_file, int exit_code) const;
+
+	private:
+		// Stores the file in the content-addressed store, returns its digest
+		std::string store_file (fs::path const& path) const;
+		static std::string to_utf8 (fs::path const& path);
+
+	private:
+		fs::path          capture_dir;
+		clock::time_point start_time;
+	};
+}
+#endif // __WORKLOAD_CAPTURE_HH
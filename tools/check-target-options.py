@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Table-driven check of the target option mappings of the `as` wrapper (`-march`, `-mcpu`, `-mfpu` and the `+ext`/`+noext`
+# architecture extensions).  The tables are read from the wrapper's sources, so every entry added to them is checked
+# without changes to this script.
+#
+# Every entry is passed to the wrapper, which assembles an empty source with `--warn`, and:
+#
+#  - entries mapped to llvm-mc values must be accepted, the `llvm-mc` command line must contain the mapped `--mcpu`
+#    value or `--mattr` attributes, every attribute must be prefixed with `+` or `-`, and `llvm-mc` must not warn that
+#    it doesn't recognize them
+#  - entries known to GAS but without an llvm-mc equivalent must be rejected with the "Unable to map" error
+#  - every extension is checked turned on and off (`+noext`), on top of a base architecture which has it
+#  - options which llvm-mc has no equivalent for (x86 `-mtune`) must accept every entry, mapped or not
+#  - a value missing from the table must be rejected as unknown
+#
+# Usage:
+#
+#   check-target-options.py AS [--target TARGET] [--verbose]
+#
+# AS is the `as` wrapper, run as `AS @gas-arch=TRIPLE-as`, so that it doesn't need to be installed under the target
+# specific name.  `llvm-mc` must be next to it.  TARGET is one of the targets below, all are checked by default.  The
+# exit code is 1 if any check failed.
+#
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+SOURCE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'src', 'gas')
+
+# Per target: the runner source and class, the name the wrapper is invoked as, the options mapped through each table,
+# the options only validated against a table and the `-march` value the extensions are appended to
+TARGETS = {
+    'arm32': {
+        'source': 'llvm_mc_runner_arm32.cc',
+        'class': 'LlvmMcRunnerARM32',
+        'gas_name': 'arm-linux-androideabi-as',
+        'options': [
+            ('march', 'arch_type_map'),
+            ('mcpu', 'cpu_type_map'),
+            ('mfpu', 'fpu_type_map'),
+        ],
+        'validated_options': [],
+        'extensions': 'arch_extension_map',
+        'extension_base': 'armv8.2-a',
+    },
+    'x86_64': {
+        'source': 'llvm_mc_runner_x86.cc',
+        'class': 'LlvmMcRunnerX86Family',
+        'gas_name': 'x86_64-linux-android-as',
+        'options': [
+            ('march', 'cpu_type_map'),
+        ],
+        'validated_options': [
+            ('mtune', 'cpu_type_map'),
+        ],
+        'extensions': 'arch_extension_map',
+        'extension_base': 'x86-64',
+    },
+}
+
+# x86 and x86_64 share their tables, but llvm-mc is run for a different architecture
+TARGETS['x86_32'] = dict(TARGETS['x86_64'], gas_name='i686-linux-android-as')
+
+UNRECOGNIZED_PATTERNS = [
+    re.compile(r'is not a recognized (feature|processor)'),
+    re.compile(r'not a recognized processor for this target'),
+]
+
+
+def read_table(source, class_name, table):
+    with open(os.path.join(SOURCE_DIR, source)) as f:
+        text = f.read()
+
+    match = re.search(r'LlvmMcRunner::(attribute_map|cpu_map) ' + re.escape(f'{class_name}::{table}') + r' \{(.*?)^\};', text,
+                      re.MULTILINE | re.DOTALL)
+    if match is None:
+        raise RuntimeError(f'Table {class_name}::{table} not found in {source}')
+
+    kind, body = match.groups()
+    entries = {}
+    for line in body.splitlines():
+        line = line.split('//', 1)[0]
+        values = re.findall(r'PSTR\("([^"]*)"\)', line)
+        if not values:
+            continue
+
+        gas_value, mc_values = values[0], values[1:]
+        if kind == 'cpu_map':
+            entries[gas_value] = ('cpu', [value for value in mc_values if value])
+        else:
+            entries[gas_value] = ('attributes', mc_values)
+    return entries
+
+
+class Checker:
+    def __init__(self, as_path, verbose):
+        self.as_path = as_path
+        self.verbose = verbose
+        self.work_dir = tempfile.mkdtemp(prefix='check-target-options-')
+        self.source = os.path.join(self.work_dir, 'empty.s')
+        with open(self.source, 'w') as f:
+            f.write('\t.text\n')
+        self.checks = 0
+        self.failures = 0
+
+    def run_as(self, gas_name, option):
+        output = os.path.join(self.work_dir, 'empty.o')
+        command = [self.as_path, f'@gas-arch={gas_name}', '--warn', option, '-o', output, self.source]
+        result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        return result.returncode, result.stdout.decode(errors='replace')
+
+    def report(self, option, ok, problem, output):
+        self.checks += 1
+        if ok:
+            if self.verbose:
+                print(f'ok    {option}')
+            return
+
+        self.failures += 1
+        print(f'FAIL  {option}: {problem}')
+        for line in output.splitlines():
+            print(f'        {line}')
+
+    @staticmethod
+    def llvm_mc_arguments(output):
+        for line in output.splitlines():
+            if line.startswith('Running:') and 'llvm-mc' in line:
+                return line.split()
+        return []
+
+    def expect_mapped(self, gas_name, option, kind, mc_values):
+        ret, output = self.run_as(gas_name, option)
+        if ret != 0:
+            self.report(option, False, f'rejected (exit code {ret})', output)
+            return
+
+        unrecognized = [line for line in output.splitlines() if any(p.search(line) for p in UNRECOGNIZED_PATTERNS)]
+        if unrecognized:
+            self.report(option, False, 'llvm-mc doesn\'t recognize the mapped value', output)
+            return
+
+        arguments = self.llvm_mc_arguments(output)
+        if kind == 'attributes':
+            # llvm-mc takes an attribute without a sign as turned on, the tables always spell the sign out
+            unsigned = [value for value in mc_values for attribute in value.split(',') if attribute[:1] not in ('+', '-')]
+            if unsigned:
+                self.report(option, False, f'attributes without a + or - sign: {", ".join(unsigned)}', output)
+                return
+
+        if kind == 'cpu':
+            missing = [value for value in mc_values if f'--mcpu={value}' not in arguments]
+        else:
+            mattr = [arg[len('--mattr='):] for arg in arguments if arg.startswith('--mattr=')]
+            attributes = set(','.join(mattr).split(','))
+            missing = [value for value in mc_values if not set(value.split(',')) <= attributes]
+
+        self.report(option, not missing, f'llvm-mc wasn\'t passed {", ".join(missing)}', output)
+
+    def expect_accepted(self, gas_name, option):
+        ret, output = self.run_as(gas_name, option)
+        self.report(option, ret == 0, f'rejected (exit code {ret})', output)
+
+    def expect_rejected(self, gas_name, option, message):
+        ret, output = self.run_as(gas_name, option)
+        self.report(option, ret != 0 and message in output, f'expected an error containing "{message}" (exit code {ret})', output)
+
+    def check_option(self, gas_name, option, entries, suffix=''):
+        for gas_value, (kind, mc_values) in sorted(entries.items()):
+            argument = f'-{option}={gas_value}{suffix}'
+            if mc_values:
+                self.expect_mapped(gas_name, argument, kind, mc_values)
+            else:
+                self.expect_rejected(gas_name, argument, 'Unable to map known')
+
+        self.expect_rejected(gas_name, f'-{option}=no-such-value{suffix}', 'Unknown GAS')
+
+    def check_validated_option(self, gas_name, option, entries):
+        # Every value known to GAS is accepted, whether llvm-mc has an equivalent or not
+        for gas_value in sorted(entries):
+            self.expect_accepted(gas_name, f'-{option}={gas_value}')
+
+        self.expect_rejected(gas_name, f'-{option}=no-such-value', 'Unknown GAS')
+
+    def check_extensions(self, gas_name, base, entries):
+        for extension, (_, attributes) in sorted(entries.items()):
+            for prefix, sign in (('', '+'), ('no', '-')):
+                argument = f'-march={base}+{prefix}{extension}'
+                if not attributes:
+                    self.expect_rejected(gas_name, argument, 'Unable to map known')
+                    continue
+
+                # The disabled form turns every attribute of the extension off
+                mc_values = [sign + attribute[1:] for attribute in attributes]
+                self.expect_mapped(gas_name, argument, 'attributes', mc_values)
+
+        self.expect_rejected(gas_name, f'-march={base}+no-such-extension', 'Unknown GAS architecture extension')
+
+    def check_target(self, name, target):
+        print(f'Checking {name} ({target["gas_name"]})')
+        for option, table in target['options']:
+            self.check_option(target['gas_name'], option, read_table(target['source'], target['class'], table))
+
+        for option, table in target['validated_options']:
+            self.check_validated_option(target['gas_name'], option, read_table(target['source'], target['class'], table))
+
+        extensions = read_table(target['source'], target['class'], target['extensions'])
+        self.check_extensions(target['gas_name'], target['extension_base'], extensions)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='check the target option mappings of the as wrapper')
+    parser.add_argument('as_path', metavar='AS')
+    parser.add_argument('--target', choices=sorted(TARGETS), action='append')
+    parser.add_argument('--verbose', action='store_true', help='list the passed checks too')
+    args = parser.parse_args()
+
+    checker = Checker(args.as_path, args.verbose)
+    try:
+        for name in args.target or sorted(TARGETS):
+            checker.check_target(name, TARGETS[name])
+    except RuntimeError as e:
+        print(f'error: {e}', file=sys.stderr)
+        return 1
+    finally:
+        shutil.rmtree(checker.work_dir, ignore_errors=True)
+
+    print(f'{checker.checks} check(s), {checker.failures} failure(s)')
+    return 1 if checker.failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
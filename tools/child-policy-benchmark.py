@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Benchmark of `--child-policy`: the throughput of a batch of assembler jobs and the latency of interactive work done
+# on the same machine while the batch runs.
+#
+# For every policy, JOBS copies of the wrapper assemble a generated source in parallel, all with the same
+# `--child-policy` value.  Meanwhile the benchmark repeatedly runs a small, fixed amount of CPU work at the normal
+# priority (a stand-in for the IDE or emulator) and records how long each run takes.  The report shows the wall clock
+# time of the batch (throughput) and the median, 95th percentile and worst time of the interactive work (latency),
+# next to its time on an idle machine.
+#
+# Usage:
+#
+#   child-policy-benchmark.py AS [--triple TRIPLE] [--jobs N] [--methods N] [--policy POLICY ...]
+#
+# AS is the `as` wrapper, run as `AS @gas-arch=TRIPLE-as`, so that it doesn't need to be installed under the target
+# specific name.  POLICY is a `--child-policy` value, `none` runs the jobs without the option.  Settings which need
+# privileges (e.g. `cgroup=`) must be usable by the user running the benchmark.
+#
+import argparse
+import os
+import random
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+DEFAULT_TRIPLE = 'x86_64-linux-android'
+DEFAULT_METHODS = 8000
+DEFAULT_POLICIES = ['none', 'nice=19', 'batch', 'nice=19,batch']
+
+# Iterations of the interactive work, about 10ms on a current desktop CPU
+PROBE_ITERATIONS = 200000
+PROBE_INTERVAL = 0.05
+
+
+def generate_source(path, methods):
+    rng = random.Random(42)
+    with open(path, 'w') as f:
+        for index in range(methods):
+            f.write(f'\t.text\n\t.globl method_{index}\n\t.type method_{index},@function\nmethod_{index}:\n\t.cfi_startproc\n')
+            for i in range(rng.randrange(4, 24)):
+                f.write(f'\tmovl {rng.randrange(1 << 16)}(%rdi), %eax\n\taddl ${rng.randrange(1 << 12)}, %eax\n')
+            f.write(f'\tretq\n\t.cfi_endproc\n\t.size method_{index}, .-method_{index}\n')
+
+
+def probe():
+    start = time.perf_counter()
+    value = 0
+    for i in range(PROBE_ITERATIONS):
+        value += i * i
+    return time.perf_counter() - start
+
+
+def run_batch(as_path, triple, source, work_dir, jobs, policy):
+    command = [as_path, f'@gas-arch={triple}-as', '--quiet']
+    if policy != 'none':
+        command.append(f'--child-policy={policy}')
+
+    start = time.perf_counter()
+    processes = [subprocess.Popen(command + ['-o', os.path.join(work_dir, f'job{i}.o'), source], stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+                 for i in range(jobs)]
+    for process in processes:
+        output, _ = process.communicate()
+        if process.returncode != 0:
+            raise RuntimeError(f'{" ".join(command)} failed with exit code {process.returncode}:\n{output.decode(errors="replace")}')
+    return time.perf_counter() - start
+
+
+def measure(as_path, triple, source, work_dir, jobs, policy):
+    result = {}
+
+    def batch():
+        try:
+            result['wall'] = run_batch(as_path, triple, source, work_dir, jobs, policy)
+        except RuntimeError as e:
+            result['error'] = e
+
+    thread = threading.Thread(target=batch)
+    thread.start()
+    latencies = []
+    while thread.is_alive():
+        latencies.append(probe())
+        time.sleep(PROBE_INTERVAL)
+    thread.join()
+
+    if 'error' in result:
+        raise result['error']
+    return result['wall'], latencies
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * fraction))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='measure the throughput and latency trade-off of --child-policy')
+    parser.add_argument('as_path', metavar='AS')
+    parser.add_argument('--triple', default=DEFAULT_TRIPLE)
+    parser.add_argument('--jobs', type=int, default=os.cpu_count() or 1, help='number of parallel assembler jobs (default: number of CPUs)')
+    parser.add_argument('--methods', type=int, default=DEFAULT_METHODS, help='size of the generated source')
+    parser.add_argument('--policy', action='append', help=f'--child-policy value to measure (default: {", ".join(DEFAULT_POLICIES)})')
+    args = parser.parse_args()
+
+    work_dir = tempfile.mkdtemp(prefix='child-policy-benchmark-')
+    try:
+        source = os.path.join(work_dir, 'source.s')
+        generate_source(source, args.methods)
+
+        idle = statistics.median(probe() for _ in range(50))
+        print(f'Source: {os.path.getsize(source) / (1024 * 1024):.1f} MiB, {args.jobs} parallel job(s), {os.cpu_count()} CPU(s)')
+        print(f'Interactive work on an idle machine: {idle * 1000:.1f}ms')
+        print()
+        print(f'{"policy":<24} {"batch":>8} {"median":>8} {"p95":>8} {"worst":>8} {"samples":>8}')
+        for policy in args.policy or DEFAULT_POLICIES:
+            wall, latencies = measure(args.as_path, args.triple, source, work_dir, args.jobs, policy)
+            print(f'{policy:<24} {wall:>7.2f}s {statistics.median(latencies) * 1000:>6.1f}ms {percentile(latencies, 0.95) * 1000:>6.1f}ms '
+                  f'{max(latencies) * 1000:>6.1f}ms {len(latencies):>8}')
+    except RuntimeError as e:
+        print(f'error: {e}', file=sys.stderr)
+        return 1
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Benchmark of compressed assembler input: assembles the same source as plain text, gzip and zstd and reports the
+# best wall clock time of several runs together with the number of bytes read from the input file.
+#
+# The generated source mimics the assembly Mono AOT writes: thousands of methods with their unwind info and a lot
+# of constant data, which compresses roughly 8-10x.
+#
+# Usage:
+#
+#   compressed-input-benchmark.py generate SOURCE.s [--methods N]
+#   compressed-input-benchmark.py run AS SOURCE.s [--triple TRIPLE] [--runs N] [--zstd ZSTD]
+#
+# AS is the `as` wrapper, run as `AS @gas-arch=TRIPLE-as`, so that it doesn't need to be installed under the target
+# specific name.  `.gz` and `.zst` copies of SOURCE.s are created next to it, the latter with the `zstd` program.
+#
+import argparse
+import gzip
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+DEFAULT_METHODS = 20000
+DEFAULT_TRIPLE = 'x86_64-linux-android'
+
+
+def generate_method(index, rng):
+    lines = [
+        '\t.text',
+        '\t.p2align 4',
+        f'\t.type method_{index},@function',
+        f'method_{index}:',
+        '\t.cfi_startproc',
+        '\tpushq %rbp',
+        '\t.cfi_def_cfa_offset 16',
+        '\tmovq %rsp, %rbp',
+        '\t.cfi_def_cfa_register %rbp',
+    ]
+    for i in range(rng.randrange(4, 24)):
+        lines.append(f'\tmovl {rng.randrange(1 << 16)}(%rdi), %eax')
+        lines.append(f'\taddl ${rng.randrange(1 << 12)}, %eax')
+        lines.append(f'\tmovl %eax, {rng.randrange(1 << 16)}(%rsi)')
+    lines += [
+        f'\tcallq method_{rng.randrange(index + 1)}',
+        '\tpopq %rbp',
+        '\t.cfi_def_cfa %rsp, 8',
+        '\tretq',
+        '\t.cfi_endproc',
+        f'\t.size method_{index}, .-method_{index}',
+        '\t.section .rodata',
+        f'method_{index}_info:',
+    ]
+    for i in range(rng.randrange(2, 8)):
+        lines.append('\t.long ' + ', '.join(str(rng.randrange(256)) for _ in range(8)))
+    return '\n'.join(lines) + '\n'
+
+
+def generate(args):
+    rng = random.Random(42)
+    with open(args.source, 'w') as f:
+        f.write('# Generated by compressed-input-benchmark.py\n')
+        for index in range(args.methods):
+            f.write(generate_method(index, rng))
+    return 0
+
+
+def make_compressed(source, zstd):
+    gz = source + '.gz'
+    with open(source, 'rb') as src, gzip.open(gz, 'wb', compresslevel=6) as dst:
+        shutil.copyfileobj(src, dst)
+
+    zst = source + '.zst'
+    subprocess.run([zstd, '-q', '-f', '-3', source, '-o', zst], check=True)
+    return gz, zst
+
+
+def time_as(command, runs):
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        elapsed = time.perf_counter() - start
+        if result.returncode != 0:
+            sys.stderr.write(result.stderr.decode(errors='replace'))
+            raise RuntimeError(f'{" ".join(command)} failed with exit code {result.returncode}')
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def run(args):
+    zstd = shutil.which(args.zstd)
+    if zstd is None:
+        raise RuntimeError(f'{args.zstd} not found')
+
+    inputs = [('plain', args.source)]
+    gz, zst = make_compressed(args.source, zstd)
+    inputs += [('gzip', gz), ('zstd', zst)]
+
+    work_dir = tempfile.mkdtemp(prefix='compressed-input-benchmark-')
+    results = []
+    try:
+        output = os.path.join(work_dir, 'out.o')
+        for name, path in inputs:
+            command = [args.assembler, f'@gas-arch={args.triple}-as', '--quiet', '-o', output, path]
+            results.append((name, os.path.getsize(path), time_as(command, args.runs)))
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    plain_size = results[0][1]
+    plain_time = results[0][2]
+    print('Compressed assembler input')
+    print()
+    print(f'Source: {args.source} ({plain_size / (1024 * 1024):.1f} MiB), target {args.triple}, best of {args.runs} runs.')
+    print()
+    print(f'{"":6} {"bytes read":>12} {"ratio":>6} {"time":>8} {"vs plain":>8}')
+    for name, size, elapsed in results:
+        print(f'{name:6} {size:12} {plain_size / size:5.1f}x {elapsed:7.3f}s {elapsed / plain_time:7.2f}x')
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='compressed assembler input benchmark')
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    cmd = commands.add_parser('generate', help='generate a synthetic AOT-like assembler source')
+    cmd.add_argument('source')
+    cmd.add_argument('--methods', type=int, default=DEFAULT_METHODS)
+    cmd.set_defaults(func=generate)
+
+    cmd = commands.add_parser('run', help='assemble plain, gzip and zstd input and print a report')
+    cmd.add_argument('assembler')
+    cmd.add_argument('source')
+    cmd.add_argument('--triple', default=DEFAULT_TRIPLE)
+    cmd.add_argument('--runs', type=int, default=5)
+    cmd.add_argument('--zstd', default='zstd')
+    cmd.set_defaults(func=run)
+
+    args = parser.parse_args()
+    try:
+        return args.func(args)
+    except (RuntimeError, subprocess.CalledProcessError) as e:
+        print(f'error: {e}', file=sys.stderr)
+        return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
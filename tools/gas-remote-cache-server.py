@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Reference implementation of the remote object cache used by the `as` wrapper (see `--remote-cache`).
+#
+# It implements the subset of the Bazel HTTP cache protocol the wrapper uses:
+#
+#   GET/PUT /ac/<sha256>   action cache, maps the action key to an `ActionResult` message naming the object's digest
+#   GET/PUT /cas/<sha256>  content addressable storage, PUT bodies are verified against the digest in the URL
+#
+# The action cache entries are stored as they are, without validation.
+# Entries are stored as files in a directory and are never evicted.  This server is meant for testing the cache on
+# a single machine, production setups should use a real cache server (e.g. bazel-remote).
+#
+# Usage:
+#
+#   gas-remote-cache-server.py [--host HOST] [--port PORT] [--dir DIRECTORY]
+#   XA_GAS_REMOTE_CACHE=http://localhost:8080 aarch64-linux-android-as -o file.o file.s
+#
+import argparse
+import hashlib
+import http.server
+import os
+import re
+import tempfile
+
+ENTRY_PATH = re.compile(r'^/(ac|cas)/([0-9a-f]{64})$')
+
+
+class CacheRequestHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    cache_dir = None
+
+    def _entry_path(self):
+        match = ENTRY_PATH.match(self.path)
+        if match is None:
+            return None, None, None
+        kind, digest = match.groups()
+        return kind, digest, os.path.join(self.cache_dir, kind, digest)
+
+    def _reply(self, status, body=b''):
+        self.send_response(status)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Content-Length', str(len(body)))
+        self.send_header('Connection', 'close')
+        self.end_headers()
+        self.wfile.write(body)
+        self.close_connection = True
+
+    def do_GET(self):
+        _, _, path = self._entry_path()
+        if path is None:
+            return self._reply(400)
+        try:
+            with open(path, 'rb') as f:
+                data = f.read()
+        except FileNotFoundError:
+            return self._reply(404)
+        self._reply(200, data)
+
+    def do_PUT(self):
+        kind, digest, path = self._entry_path()
+        length = int(self.headers.get('Content-Length', '0'))
+        data = self.rfile.read(length)
+        if path is None:
+            return self._reply(400)
+        if kind == 'cas' and hashlib.sha256(data).hexdigest() != digest:
+            return self._reply(400)
+
+        # Write atomically, so that concurrent readers never see partial entries
+        fd, temp_path = tempfile.mkstemp(dir=os.path.dirname(path))
+        with os.fdopen(fd, 'wb') as f:
+            f.write(data)
+        os.replace(temp_path, path)
+        self._reply(200)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Reference remote object cache server for the `as` wrapper')
+    parser.add_argument('--host', default='127.0.0.1', help='address to listen on (default: %(default)s)')
+    parser.add_argument('--port', type=int, default=8080, help='port to listen on (default: %(default)s)')
+    parser.add_argument('--dir', default='gas-remote-cache', help='directory to store the entries in (default: %(default)s)')
+    args = parser.parse_args()
+
+    for kind in ('ac', 'cas'):
+        os.makedirs(os.path.join(args.dir, kind), exist_ok=True)
+
+    CacheRequestHandler.cache_dir = os.path.abspath(args.dir)
+    server = http.server.ThreadingHTTPServer((args.host, args.port), CacheRequestHandler)
+    print(f'Serving the remote cache from {CacheRequestHandler.cache_dir} on http://{args.host}:{args.port}')
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
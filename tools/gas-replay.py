@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Replays assembler workloads captured from real builds, to compare toolchain versions (e.g. an LLVM bump or a change
+# to the `as` wrapper) on a single machine.
+#
+# Capture the workload by running the build with the `as` wrapper's capture mode enabled:
+#
+#   XA_GAS_CAPTURE_DIR=/tmp/capture dotnet build ...
+#
+# Every `as` invocation then records its arguments, working directory, the files it read (stored once, by content),
+# the digest of its output and its wall time in the capture directory.  The workload is replayed with:
+#
+#   gas-replay.py replay [--jobs N] [--runs N] [--keep] CAPTURE_DIR TOOLCHAIN_BIN_DIR RESULTS.json
+#   gas-replay.py compare BASELINE_RESULTS.json NEW_RESULTS.json
+#
+# `replay` re-creates the files of every invocation in a sandbox directory of its own (absolute paths, including
+# the ones in the arguments, are re-rooted in the sandbox), runs the `as` from TOOLCHAIN_BIN_DIR there and records
+# the exit code, wall time (best of `--runs`) and output digest.  The sandbox paths are the same on every replay
+# (unless `--work-dir` differs), so the outputs of two replays are comparable even if they contain debug info.
+# `compare` reports timing and output differences between two replays.  Invocations which read the source from stdin
+# cannot be replayed.
+#
+import argparse
+import concurrent.futures
+import hashlib
+import json
+import os
+import shutil
+import subprocess
+import sys
+import time
+
+
+def sha256_file(path):
+    digest = hashlib.sha256()
+    with open(path, 'rb') as f:
+        for chunk in iter(lambda: f.read(1024 * 1024), b''):
+            digest.update(chunk)
+    return digest.hexdigest()
+
+
+def load_invocations(capture_dir):
+    invocations_dir = os.path.join(capture_dir, 'invocations')
+    invocations = []
+    for name in sorted(os.listdir(invocations_dir)):
+        if not name.endswith('.json'):
+            continue
+        with open(os.path.join(invocations_dir, name), encoding='utf-8') as f:
+            record = json.load(f)
+        record['id'] = name[:-5]
+        invocations.append(record)
+    return invocations
+
+
+class Sandbox:
+    def __init__(self, root, cwd):
+        self.root = root
+        self.cwd = self.reroot(cwd)
+
+    def reroot(self, path):
+        _, rest = os.path.splitdrive(path)
+        return os.path.join(self.root, rest.lstrip('/\\'))
+
+    def map_path(self, path):
+        return self.reroot(path) if os.path.isabs(path) else os.path.join(self.cwd, path)
+
+    def map_arg(self, arg):
+        if os.path.isabs(arg):
+            return self.reroot(arg)
+
+        if arg.startswith('-'):
+            # `--option=/path`, `-I/path`
+            separator = arg.find('=')
+            if separator > 0 and os.path.isabs(arg[separator + 1:]):
+                return arg[:separator + 1] + self.reroot(arg[separator + 1:])
+            if not arg.startswith('--') and len(arg) > 2 and os.path.isabs(arg[2:]):
+                return arg[:2] + self.reroot(arg[2:])
+
+        return arg
+
+
+def materialize(source, destination):
+    os.makedirs(os.path.dirname(destination), exist_ok=True)
+    try:
+        os.link(source, destination)
+    except OSError:
+        shutil.copyfile(source, destination)
+
+
+def replay_invocation(invocation, capture_dir, as_path, work_dir, runs, keep):
+    sandbox_dir = os.path.join(work_dir, invocation['id'])
+    result = {
+        'args': invocation['args'],
+        'captured_exit_code': invocation['exit_code'],
+        'captured_wall_time_ms': invocation['wall_time_ms'],
+        'captured_output_sha256': invocation['output'].get('sha256'),
+    }
+
+    sandbox = Sandbox(os.path.join(sandbox_dir, 'root'), invocation['cwd'])
+    args = [as_path] + [sandbox.map_arg(arg) for arg in invocation['args']]
+    output = sandbox.map_path(invocation['output']['path'])
+    env = dict(os.environ)
+    env.pop('XA_GAS_CAPTURE_DIR', None)
+
+    best = None
+    for _ in range(runs):
+        if os.path.isdir(sandbox_dir):
+            shutil.rmtree(sandbox_dir)
+        os.makedirs(sandbox.cwd)
+        os.makedirs(os.path.dirname(output), exist_ok=True)
+        for f in invocation['files']:
+            materialize(os.path.join(capture_dir, 'files', f['sha256']), sandbox.map_path(f['path']))
+
+        start = time.perf_counter()
+        completed = subprocess.run(args, cwd=sandbox.cwd, env=env, stdin=subprocess.DEVNULL,
+                                   stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        elapsed = (time.perf_counter() - start) * 1000.0
+        if best is None or elapsed < best:
+            best = elapsed
+
+    result['exit_code'] = completed.returncode
+    result['wall_time_ms'] = best
+    result['output_sha256'] = sha256_file(output) if completed.returncode == 0 and os.path.isfile(output) else None
+    if completed.returncode != 0:
+        result['stderr'] = completed.stderr.decode(errors='replace')
+
+    if not keep:
+        shutil.rmtree(sandbox_dir, ignore_errors=True)
+
+    return invocation['id'], result
+
+
+def replay(args):
+    as_path = os.path.join(os.path.abspath(args.toolchain_bin_dir), 'as.exe' if sys.platform == 'win32' else 'as')
+    if not os.path.isfile(as_path):
+        print(f'error: {as_path} does not exist', file=sys.stderr)
+        return 1
+
+    capture_dir = os.path.abspath(args.capture_dir)
+    work_dir = os.path.abspath(args.work_dir or os.path.join(capture_dir, 'replay'))
+    invocations = load_invocations(capture_dir)
+    replayable = [i for i in invocations if i.get('replayable', False)]
+    skipped = len(invocations) - len(replayable)
+    if skipped > 0:
+        print(f'Skipping {skipped} invocation(s) which read the source from stdin')
+
+    results = {}
+    start = time.perf_counter()
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as executor:
+        futures = [executor.submit(replay_invocation, i, capture_dir, as_path, work_dir, args.runs, args.keep) for i in replayable]
+        for future in concurrent.futures.as_completed(futures):
+            invocation_id, result = future.result()
+            results[invocation_id] = result
+            if result['exit_code'] != result['captured_exit_code']:
+                print(f'{invocation_id}: exit code {result["exit_code"]}, captured {result["captured_exit_code"]}')
+                sys.stdout.write(result.get('stderr', ''))
+    elapsed = time.perf_counter() - start
+
+    with open(args.results, 'w', encoding='utf-8') as f:
+        json.dump({
+            'toolchain': as_path,
+            'jobs': args.jobs,
+            'wall_time_ms': elapsed * 1000.0,
+            'invocations': dict(sorted(results.items())),
+        }, f, indent=2)
+
+    print(f'Replayed {len(results)} invocation(s) in {elapsed:.2f}s, results written to {args.results}')
+    return 0
+
+
+def compare(args):
+    with open(args.baseline, encoding='utf-8') as f:
+        baseline = json.load(f)
+    with open(args.new, encoding='utf-8') as f:
+        new = json.load(f)
+
+    common = sorted(set(baseline['invocations']) & set(new['invocations']))
+    baseline_total = 0.0
+    new_total = 0.0
+    exit_code_differences = []
+    output_differences = []
+    for invocation_id in common:
+        before = baseline['invocations'][invocation_id]
+        after = new['invocations'][invocation_id]
+        baseline_total += before['wall_time_ms']
+        new_total += after['wall_time_ms']
+        if before['exit_code'] != after['exit_code']:
+            exit_code_differences.append(invocation_id)
+        elif before['output_sha256'] != after['output_sha256']:
+            output_differences.append(invocation_id)
+
+    def speedup(before, after):
+        return f'{(before / after - 1.0) * 100.0:+.1f}%' if after > 0 else 'n/a'
+
+    print(f'Baseline:    {baseline["toolchain"]}')
+    print(f'New:         {new["toolchain"]}')
+    print(f'Invocations: {len(common)} compared, {len(baseline["invocations"]) - len(common)} only in baseline, '
+          f'{len(new["invocations"]) - len(common)} only in new')
+    print()
+    print(f'Sum of invocation times: {baseline_total / 1000.0:.2f}s -> {new_total / 1000.0:.2f}s ({speedup(baseline_total, new_total)})')
+    print(f'Workload wall time:      {baseline["wall_time_ms"] / 1000.0:.2f}s -> {new["wall_time_ms"] / 1000.0:.2f}s '
+          f'({speedup(baseline["wall_time_ms"], new["wall_time_ms"])})')
+    print()
+    print(f'Exit code differences: {len(exit_code_differences)}')
+    for invocation_id in exit_code_differences:
+        print(f'  {invocation_id}: {baseline["invocations"][invocation_id]["exit_code"]} -> {new["invocations"][invocation_id]["exit_code"]}')
+    print(f'Output differences:    {len(output_differences)}')
+    for invocation_id in output_differences:
+        print(f'  {invocation_id}: {" ".join(new["invocations"][invocation_id]["args"])}')
+
+    return 1 if exit_code_differences or output_differences else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay assembler workloads captured with XA_GAS_CAPTURE_DIR')
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    cmd = commands.add_parser('replay', help='replay a captured workload with the given toolchain')
+    cmd.add_argument('capture_dir')
+    cmd.add_argument('toolchain_bin_dir', help='directory containing `as`, `llvm-mc` and the `ld` programs')
+    cmd.add_argument('results', help='JSON file to write the results to')
+    cmd.add_argument('--jobs', type=int, default=os.cpu_count() or 1, help='number of invocations to replay concurrently')
+    cmd.add_argument('--runs', type=int, default=1, help='run every invocation N times and record the best time')
+    cmd.add_argument('--work-dir', help='where to create the sandboxes (default: `replay` in the capture directory)')
+    cmd.add_argument('--keep', action='store_true', help='keep the sandboxes after replaying')
+    cmd.set_defaults(func=replay)
+
+    cmd = commands.add_parser('compare', help='compare the results of two replays')
+    cmd.add_argument('baseline')
+    cmd.add_argument('new')
+    cmd.set_defaults(func=compare)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
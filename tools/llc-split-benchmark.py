@@ -0,0 +1,275 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Benchmark of `llc-split` (see src/gas/llc_split.hh) against plain `llc`.
+#
+# The module mimics what Mono AOT hands to `llc`: one very large module with thousands of methods, most of them with
+# internal linkage, calling each other and reading from constant tables.  It is compiled to an object file by `llc`
+# and by `llc-split` with an increasing number of partitions (1, 2, 4 ... up to the number of CPUs), the best wall
+# clock time of several runs is reported for each.
+#
+# `stages` times every step of `llc-split` on its own instead: preparing the list of global symbols, `llvm-split`,
+# `llc` for each partition one after the other, `ld --relocatable` and the rest (mostly restoring the local symbols).
+# From these it projects the wall clock time on machines with 1, 2, 4 ... cores, assuming the partitions don't slow
+# each other down (no contention for memory bandwidth or caches), which is an upper bound of the speedup.  It is meant
+# for machines without enough cores to measure the speedup with `run`, use `run` where possible.
+#
+# Usage:
+#
+#   llc-split-benchmark.py generate MODULE.ll [--functions N]
+#   llc-split-benchmark.py run BIN_DIR MODULE [--triple TRIPLE] [--runs N] [--max-partitions N]
+#   llc-split-benchmark.py stages BIN_DIR MODULE [--triple TRIPLE] [--runs N] [--max-partitions N]
+#
+# BIN_DIR is the toolchain directory, with `llc`, `llvm-split`, `llvm-nm` and `ld` next to the `llc-split` program.
+# MODULE can be any textual or bitcode module, e.g. one saved from an AOT build.
+#
+import argparse
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+DEFAULT_FUNCTIONS = 20000
+DEFAULT_TRIPLE = 'aarch64-linux-android'
+TABLE_SIZE = 64
+
+
+def pointer_type(opaque, pointee):
+    return 'ptr' if opaque else f'{pointee}*'
+
+
+def generate_function(index, functions, opaque, rng):
+    callee = rng.randrange(functions)
+    other = rng.randrange(functions)
+    table = rng.randrange(functions // 16 + 1)
+    element = rng.randrange(TABLE_SIZE)
+    linkage = 'define' if index % 8 == 0 else 'define internal'
+    table_ptr = pointer_type(opaque, f'[{TABLE_SIZE} x i32]')
+    i32_ptr = pointer_type(opaque, 'i32')
+
+    return f'''\
+{linkage} i32 @method_{index}(i32 %a, i32 %b) #0 {{
+entry:
+  %cmp = icmp sgt i32 %a, {rng.randrange(1, 1000)}
+  br i1 %cmp, label %loop, label %exit
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ %b, %entry ], [ %acc.next, %loop ]
+  %slot = getelementptr inbounds [{TABLE_SIZE} x i32], {table_ptr} @table_{table}, i32 0, i32 {element}
+  %v = load i32, {i32_ptr} %slot, align 4
+  %mul = mul nsw i32 %acc, %v
+  %add = add nsw i32 %mul, %i
+  %acc.next = xor i32 %add, {rng.randrange(1, 1 << 16)}
+  %i.next = add nuw nsw i32 %i, 1
+  %done = icmp eq i32 %i.next, %a
+  br i1 %done, label %call, label %loop
+
+call:
+  %r1 = call i32 @method_{callee}(i32 %acc.next, i32 %b)
+  %r2 = call i32 @method_{other}(i32 %r1, i32 {rng.randrange(100)})
+  %sum = add i32 %r1, %r2
+  ret i32 %sum
+
+exit:
+  %shl = shl i32 %b, {rng.randrange(1, 8)}
+  ret i32 %shl
+}}
+
+'''
+
+
+def generate(args):
+    rng = random.Random(42)
+    functions = args.functions
+    opaque = args.opaque_pointers
+
+    with open(args.module, 'w') as f:
+        f.write('; Generated by llc-split-benchmark.py\n\n')
+        for table in range(functions // 16 + 1):
+            values = ', '.join(f'i32 {rng.randrange(1 << 20)}' for _ in range(TABLE_SIZE))
+            f.write(f'@table_{table} = internal constant [{TABLE_SIZE} x i32] [{values}], align 4\n')
+        f.write('\n')
+
+        for index in range(functions):
+            f.write(generate_function(index, functions, opaque, rng))
+
+        f.write('attributes #0 = { noinline nounwind uwtable "frame-pointer"="non-leaf" }\n')
+
+    return 0
+
+
+def tool_path(bin_dir, name, suffix=''):
+    path = os.path.join(bin_dir, name)
+    if sys.platform == 'win32':
+        path += suffix
+    return path
+
+
+def time_command(command, runs):
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        elapsed = time.perf_counter() - start
+        if result.returncode != 0:
+            sys.stderr.write(result.stderr.decode(errors='replace'))
+            raise RuntimeError(f'{os.path.basename(command[0])} failed with exit code {result.returncode}')
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def make_partition_counts(max_partitions):
+    partition_counts = []
+    count = 1
+    while count < max_partitions:
+        partition_counts.append(count)
+        count *= 2
+    partition_counts.append(max_partitions)
+    return partition_counts
+
+
+def run(args):
+    llc = tool_path(args.bin_dir, 'llc', '.exe')
+    llc_split = tool_path(args.bin_dir, 'llc-split', '.exe')
+    cpus = os.cpu_count() or 1
+    partition_counts = make_partition_counts(args.max_partitions or cpus)
+
+    work_dir = tempfile.mkdtemp(prefix='llc-split-benchmark-')
+    try:
+        output = os.path.join(work_dir, 'module.o')
+        llc_args = [f'-mtriple={args.triple}', '-O2', '-relocation-model=pic', '-filetype=obj', '-o', output, args.module]
+
+        baseline = time_command([llc] + llc_args, args.runs)
+        results = []
+        for partitions in partition_counts:
+            elapsed = time_command([llc_split, f'--partitions={partitions}'] + llc_args, args.runs)
+            results.append((partitions, elapsed))
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    print('llc-split: code generation of a module split into partitions, compiled in parallel')
+    print()
+    print(f'Module: {args.module} ({os.path.getsize(args.module) / (1024 * 1024):.1f} MiB), target {args.triple}, {cpus} CPU(s).')
+    print(f'Best of {args.runs} runs.')
+    print()
+    print(f'{"":16} {"time":>9} {"speedup":>8}')
+    print(f'{"llc":16} {baseline:8.2f}s {1.0:7.2f}x')
+    for partitions, elapsed in results:
+        print(f'{f"{partitions} partition(s)":16} {elapsed:8.2f}s {baseline / elapsed:7.2f}x')
+    return 0
+
+
+def is_bitcode(path):
+    with open(path, 'rb') as f:
+        return f.read(4) in (b'BC\xc0\xde', b'\xde\xc0\x17\x0b')
+
+
+def makespan(durations, cores):
+    # Longest partitions first, each on the core which becomes free first, like JobScheduler does
+    finish = [0.0] * cores
+    for duration in sorted(durations, reverse=True):
+        core = finish.index(min(finish))
+        finish[core] += duration
+    return max(finish)
+
+
+def stages(args):
+    llc = tool_path(args.bin_dir, 'llc', '.exe')
+    llc_split = tool_path(args.bin_dir, 'llc-split', '.exe')
+    llvm_split = tool_path(args.bin_dir, 'llvm-split', '.exe')
+    llvm_nm = tool_path(args.bin_dir, 'llvm-nm', '.exe')
+    ld = tool_path(args.bin_dir, 'ld', '.exe')
+    cpus = os.cpu_count() or 1
+    # With a single partition `llc-split` runs `llc` unchanged
+    partition_counts = [count for count in make_partition_counts(args.max_partitions or 8) if count > 1]
+    llc_options = [f'-mtriple={args.triple}', '-O2', '-relocation-model=pic', '-filetype=obj']
+
+    work_dir = tempfile.mkdtemp(prefix='llc-split-benchmark-')
+    try:
+        output = os.path.join(work_dir, 'module.o')
+        baseline = time_command([llc] + llc_options + ['-o', output, args.module], args.runs)
+
+        # Same steps as `LlcSplit::split_and_compile`
+        module = args.module
+        symbols = 0.0
+        if not is_bitcode(module):
+            prefix = os.path.join(work_dir, 'module')
+            symbols += time_command([llvm_split, '-preserve-locals', '-j', '1', '-o', prefix, module], args.runs)
+            module = prefix + '0'
+        symbols += time_command([llvm_nm, '--defined-only', '--extern-only', '--format=just-symbols', module], args.runs)
+
+        results = []
+        for partitions in partition_counts:
+            prefix = os.path.join(work_dir, f'part{partitions}.')
+            split = time_command([llvm_split, '-j', str(partitions), '-o', prefix, module], args.runs)
+
+            objects = []
+            compile_times = []
+            for i in range(partitions):
+                objects.append(f'{prefix}{i}.o')
+                compile_times.append(time_command([llc] + llc_options + ['-o', objects[-1], f'{prefix}{i}'], args.runs))
+
+            merge = time_command([ld, '--relocatable', '-o', os.path.join(work_dir, 'merged.o')] + objects, args.runs)
+
+            # The whole tool with one `llc` at a time, what it spends besides the steps above is the rest
+            total = time_command([llc_split, f'--partitions={partitions}', '--split-jobs=1'] + llc_options + ['-o', output, args.module], args.runs)
+            rest = max(0.0, total - symbols - split - sum(compile_times) - merge)
+            results.append((partitions, split, compile_times, merge, rest))
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    print('llc-split: time of every step, and the wall clock time projected from them')
+    print()
+    print(f'Module: {args.module} ({os.path.getsize(args.module) / (1024 * 1024):.1f} MiB), target {args.triple}, measured on {cpus} CPU(s).')
+    print(f'Best of {args.runs} runs.  Projections assume as many cores as partitions and no contention between them.')
+    print()
+    print(f'llc: {baseline:.2f}s, global symbols list: {symbols:.2f}s')
+    print()
+    print(f'{"partitions":>10} {"split":>7} {"llc sum":>8} {"llc max":>8} {"merge":>7} {"rest":>7} {"projected":>10} {"speedup":>8}')
+    for partitions, split, compile_times, merge, rest in results:
+        projected = symbols + split + makespan(compile_times, partitions) + merge + rest
+        print(f'{partitions:>10} {split:6.2f}s {sum(compile_times):7.2f}s {max(compile_times):7.2f}s {merge:6.2f}s {rest:6.2f}s '
+              f'{projected:9.2f}s {baseline / projected:7.2f}x')
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='llc-split benchmark')
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    cmd = commands.add_parser('generate', help='generate a synthetic AOT-like module')
+    cmd.add_argument('module')
+    cmd.add_argument('--functions', type=int, default=DEFAULT_FUNCTIONS)
+    cmd.add_argument('--opaque-pointers', action='store_true', help='use `ptr` (required by LLVM 17 and newer)')
+    cmd.set_defaults(func=generate)
+
+    cmd = commands.add_parser('run', help='compare llc and llc-split and print a report')
+    cmd.add_argument('bin_dir')
+    cmd.add_argument('module')
+    cmd.add_argument('--triple', default=DEFAULT_TRIPLE)
+    cmd.add_argument('--runs', type=int, default=3)
+    cmd.add_argument('--max-partitions', type=int, default=0)
+    cmd.set_defaults(func=run)
+
+    cmd = commands.add_parser('stages', help='time every step of llc-split and project the time on more cores')
+    cmd.add_argument('bin_dir')
+    cmd.add_argument('module')
+    cmd.add_argument('--triple', default=DEFAULT_TRIPLE)
+    cmd.add_argument('--runs', type=int, default=3)
+    cmd.add_argument('--max-partitions', type=int, default=0, help='largest partition count (default: 8)')
+    cmd.set_defaults(func=stages)
+
+    args = parser.parse_args()
+    try:
+        return args.func(args)
+    except RuntimeError as e:
+        print(f'error: {e}', file=sys.stderr)
+        return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Memory benchmark of `--reduce-memory-overheads`: reports the peak resident set size of the wrapper and the programs
+# it runs, with and without the option.  Linux only.
+#
+# Two inputs are measured:
+#
+#  - several source files assembled by one wrapper invocation, which `llvm-mc` processes in parallel by default
+#  - a source read from stdin with `--function-sections`, which the wrapper keeps in memory by default, because it
+#    reads the source twice
+#
+# For each run two figures are reported: the peak RSS of the largest single process (from `wait4`) and the peak of the
+# sum of the RSS of the wrapper and all its descendants, sampled every few milliseconds from /proc.  The latter is what
+# a memory constrained build agent sees.
+#
+# Usage:
+#
+#   memory-overheads-benchmark.py AS [--triple TRIPLE] [--files N] [--methods N] [--jobs N] [--runs N]
+#
+# AS is the `as` wrapper, run as `AS @gas-arch=TRIPLE-as`, so that it doesn't need to be installed under the target
+# specific name.  Without `--reduce-memory-overheads` the wrapper runs as many `llvm-mc` processes as there are CPUs,
+# `--jobs N` passes `--jobs=N` to the default runs instead, to show the memory use of a machine with N CPUs.
+#
+import argparse
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+DEFAULT_TRIPLE = 'x86_64-linux-android'
+DEFAULT_FILES = 4
+DEFAULT_METHODS = 20000
+SAMPLE_INTERVAL = 0.005
+
+
+def generate_source(path, methods, seed):
+    rng = random.Random(seed)
+    with open(path, 'w') as f:
+        for index in range(methods):
+            f.write(f'\t.text\n\t.globl method_{seed}_{index}\n\t.type method_{seed}_{index},@function\nmethod_{seed}_{index}:\n\t.cfi_startproc\n')
+            for i in range(rng.randrange(4, 24)):
+                f.write(f'\tmovl {rng.randrange(1 << 16)}(%rdi), %eax\n\taddl ${rng.randrange(1 << 12)}, %eax\n')
+            f.write(f'\tretq\n\t.cfi_endproc\n\t.size method_{seed}_{index}, .-method_{seed}_{index}\n')
+            f.write(f'\t.section .rodata\nmethod_{seed}_{index}_info:\n\t.long {rng.randrange(1 << 30)}, {index}\n')
+
+
+def read_processes():
+    parents = {}
+    for entry in os.listdir('/proc'):
+        if not entry.isdigit():
+            continue
+        try:
+            with open(f'/proc/{entry}/stat') as f:
+                stat = f.read()
+        except OSError:
+            continue
+        # The command name is in parentheses and may contain spaces
+        fields = stat[stat.rindex(')') + 2:].split()
+        parents[int(entry)] = int(fields[1])
+    return parents
+
+
+def tree_rss(pid):
+    parents = read_processes()
+    tree = {pid}
+    added = True
+    while added:
+        added = False
+        for child, parent in parents.items():
+            if parent in tree and child not in tree:
+                tree.add(child)
+                added = True
+
+    total = 0
+    for member in tree:
+        try:
+            with open(f'/proc/{member}/statm') as f:
+                total += int(f.read().split()[1]) * os.sysconf('SC_PAGE_SIZE')
+        except OSError:
+            continue
+    return total
+
+
+def measure(command, stdin_path, cwd):
+    stdin = open(stdin_path, 'rb') if stdin_path else subprocess.DEVNULL
+    try:
+        start = time.perf_counter()
+        process = subprocess.Popen(command, stdin=stdin, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, cwd=cwd)
+        peak_tree = 0
+        while True:
+            pid, status, usage = os.wait4(process.pid, os.WNOHANG)
+            if pid != 0:
+                break
+            peak_tree = max(peak_tree, tree_rss(process.pid))
+            time.sleep(SAMPLE_INTERVAL)
+        wall = time.perf_counter() - start
+    finally:
+        if stdin_path:
+            stdin.close()
+
+    process.returncode = os.waitstatus_to_exitcode(status)
+    if process.returncode != 0:
+        raise RuntimeError(f'{" ".join(command)} failed with exit code {process.returncode}:\n{process.stderr.read().decode(errors="replace")}')
+
+    # `ru_maxrss` is in kilobytes on Linux
+    return wall, usage.ru_maxrss * 1024, peak_tree
+
+
+def mib(size):
+    return f'{size / (1024 * 1024):.1f}'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='measure the peak RSS with and without --reduce-memory-overheads')
+    parser.add_argument('as_path', metavar='AS')
+    parser.add_argument('--triple', default=DEFAULT_TRIPLE)
+    parser.add_argument('--files', type=int, default=DEFAULT_FILES, help='number of source files assembled together')
+    parser.add_argument('--methods', type=int, default=DEFAULT_METHODS, help='size of each generated source')
+    parser.add_argument('--jobs', type=int, help='--jobs value of the runs without --reduce-memory-overheads')
+    parser.add_argument('--runs', type=int, default=3)
+    args = parser.parse_args()
+
+    if not sys.platform.startswith('linux'):
+        print('error: the benchmark reads /proc and works only on Linux', file=sys.stderr)
+        return 1
+
+    as_path = os.path.abspath(args.as_path)
+    work_dir = tempfile.mkdtemp(prefix='memory-overheads-benchmark-')
+    try:
+        sources = []
+        for i in range(args.files):
+            source = os.path.join(work_dir, f'source{i}.s')
+            generate_source(source, args.methods, i)
+            sources.append(os.path.basename(source))
+
+        base = [as_path, f'@gas-arch={args.triple}-as', '--quiet']
+        default_flags = [f'--jobs={args.jobs}'] if args.jobs else []
+        cases = [
+            (f'{args.files} files', base + sources, None),
+            ('stdin', base + ['--function-sections', '-o', 'stdin.o', '-'], os.path.join(work_dir, sources[0])),
+        ]
+
+        print(f'{args.files} source(s) of {mib(os.path.getsize(os.path.join(work_dir, sources[0])))} MiB, {os.cpu_count()} CPU(s), best of {args.runs} run(s)')
+        print()
+        print(f'{"input":<10} {"mode":<28} {"time":>8} {"largest process":>16} {"all processes":>14}')
+        for name, command, stdin_path in cases:
+            for mode, flags in (('default' + (f' (--jobs={args.jobs})' if args.jobs else ''), default_flags), ('--reduce-memory-overheads', ['--reduce-memory-overheads'])):
+                results = [measure(command[:3] + flags + command[3:], stdin_path, work_dir) for _ in range(args.runs)]
+                wall = min(result[0] for result in results)
+                largest = min(result[1] for result in results)
+                tree = min(result[2] for result in results)
+                print(f'{name:<10} {mode:<28} {wall:>7.2f}s {mib(largest):>12} MiB {mib(tree):>10} MiB')
+    except RuntimeError as e:
+        print(f'error: {e}', file=sys.stderr)
+        return 1
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,448 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Workload used by the PGO build of LLVM (see `LLVM_PGO` in build-llvm.sh).
+#
+# The profile is only as good as the code exercised while it is collected, so the workload mimics what Mono AOT hands
+# to the toolchain: large assembly files with thousands of small functions (prologue, a few branches and calls through
+# the PLT, CFI directives), GOT/literal pool references to data and big `.byte`/`.long` tables.  Each file is assembled
+# with `llvm-mc` for all four Android targets, the objects are then merged with `ld -r` and linked into a shared
+# library, just like the `as` and `ld` wrappers do during an app build.  The LLVM IR files, standing in for the bitcode
+# Mono's LLVM backend emits, are compiled with `llc` and linked into the same library.
+#
+# Usage:
+#
+#   pgo-workload.py generate CORPUS_DIR
+#   pgo-workload.py run BIN_DIR CORPUS_DIR WORK_DIR
+#   pgo-workload.py benchmark BASELINE_BIN_DIR OPTIMIZED_BIN_DIR CORPUS_DIR WORK_DIR [--runs N]
+#
+# The corpus directory contains one subdirectory per Android triple (e.g. `aarch64-linux-android`) with any number of
+# `*.s`, `*.ll` and `*.bc` files, so real AOT output can be used instead of the generated corpus by laying it out the
+# same way.
+#
+import argparse
+import os
+import random
+import shutil
+import subprocess
+import sys
+import time
+
+# Android triple (the corpus subdirectory name) -> llvm-mc triple
+TARGETS = {
+    'aarch64-linux-android': 'aarch64-linux-android',
+    'arm-linux-androideabi': 'armv7-linux-androideabi',
+    'i686-linux-android': 'i686-linux-android',
+    'x86_64-linux-android': 'x86_64-linux-android',
+}
+
+FILES_PER_TARGET = 4
+FUNCTIONS_PER_FILE = 3000
+DATA_BLOBS_PER_FILE = 600
+IR_FILES_PER_TARGET = 2
+IR_FUNCTIONS_PER_FILE = 500
+IR_GLOBALS_PER_FILE = 300
+
+X86_64_FUNCTION = '''\
+\t.text
+\t.globl\t{name}
+\t.type\t{name},@function
+\t.p2align\t4
+{name}:
+\t.cfi_startproc
+\tpushq\t%rbp
+\t.cfi_def_cfa_offset 16
+\t.cfi_offset %rbp, -16
+\tmovq\t%rsp, %rbp
+\t.cfi_def_cfa_register %rbp
+\tsubq\t${frame}, %rsp
+\tmovq\t%rdi, -8(%rbp)
+\tmovl\t%esi, -12(%rbp)
+\tcmpl\t${imm}, %esi
+\tjle\t.L{name}_skip
+\tmovq\t{data}@GOTPCREL(%rip), %rax
+\tmovq\t(%rax), %rdi
+\tcallq\t{callee}@PLT
+\tleaq\t.L{name}_str(%rip), %rsi
+.L{name}_skip:
+\taddl\t$1, -12(%rbp)
+\tmovl\t-12(%rbp), %eax
+\taddq\t${frame}, %rsp
+\tpopq\t%rbp
+\t.cfi_def_cfa %rsp, 8
+\tretq
+.L{name}_end:
+\t.size\t{name}, .L{name}_end-{name}
+\t.cfi_endproc
+\t.section\t.rodata.str1.1,"aMS",@progbits,1
+.L{name}_str:
+\t.asciz\t"{string}"
+'''
+
+I686_FUNCTION = '''\
+\t.text
+\t.globl\t{name}
+\t.type\t{name},@function
+\t.p2align\t4
+{name}:
+\t.cfi_startproc
+\tpushl\t%ebp
+\t.cfi_def_cfa_offset 8
+\t.cfi_offset %ebp, -8
+\tmovl\t%esp, %ebp
+\t.cfi_def_cfa_register %ebp
+\tpushl\t%ebx
+\tsubl\t${frame}, %esp
+\tcalll\t.L{name}_pic
+.L{name}_pic:
+\tpopl\t%ebx
+\taddl\t$_GLOBAL_OFFSET_TABLE_+(.-.L{name}_pic), %ebx
+\tmovl\t8(%ebp), %eax
+\tcmpl\t${imm}, %eax
+\tjle\t.L{name}_skip
+\tmovl\t{data}@GOT(%ebx), %eax
+\tmovl\t%eax, (%esp)
+\tcalll\t{callee}@PLT
+\tleal\t.L{name}_str@GOTOFF(%ebx), %eax
+.L{name}_skip:
+\taddl\t${frame}, %esp
+\tpopl\t%ebx
+\tpopl\t%ebp
+\t.cfi_def_cfa %esp, 4
+\tretl
+.L{name}_end:
+\t.size\t{name}, .L{name}_end-{name}
+\t.cfi_endproc
+\t.section\t.rodata.str1.1,"aMS",@progbits,1
+.L{name}_str:
+\t.asciz\t"{string}"
+'''
+
+AARCH64_FUNCTION = '''\
+\t.text
+\t.globl\t{name}
+\t.type\t{name},%function
+\t.p2align\t2
+{name}:
+\t.cfi_startproc
+\tstp\tx29, x30, [sp, #-{frame}]!
+\t.cfi_def_cfa_offset {frame}
+\t.cfi_offset w30, -{frame_lr}
+\t.cfi_offset w29, -{frame}
+\tmov\tx29, sp
+\tstr\tx0, [sp, #16]
+\tcmp\tw1, #{imm}
+\tb.le\t.L{name}_skip
+\tadrp\tx8, :got:{data}
+\tldr\tx8, [x8, :got_lo12:{data}]
+\tldr\tx0, [x8]
+\tbl\t{callee}
+\tadrp\tx1, .L{name}_str
+\tadd\tx1, x1, :lo12:.L{name}_str
+.L{name}_skip:
+\tadd\tw0, w1, #1
+\tldp\tx29, x30, [sp], #{frame}
+\tret
+.L{name}_end:
+\t.size\t{name}, .L{name}_end-{name}
+\t.cfi_endproc
+\t.section\t.rodata.str1.1,"aMS",@progbits,1
+.L{name}_str:
+\t.asciz\t"{string}"
+'''
+
+ARM_FUNCTION = '''\
+\t.text
+\t.globl\t{name}
+\t.type\t{name},%function
+\t.p2align\t2
+\t.arm
+{name}:
+\t.fnstart
+\t.cfi_startproc
+\tpush\t{{r4, r11, lr}}
+\t.cfi_def_cfa_offset 12
+\t.cfi_offset lr, -4
+\t.cfi_offset r11, -8
+\t.cfi_offset r4, -12
+\tadd\tr11, sp, #4
+\tsub\tsp, sp, #{frame}
+\tmov\tr4, r0
+\tcmp\tr1, #{imm}
+\tble\t.L{name}_skip
+\tldr\tr0, .L{name}_pool
+.L{name}_pc:
+\tldr\tr0, [pc, r0]
+\tldr\tr0, [r0]
+\tbl\t{callee}
+.L{name}_skip:
+\tadd\tr0, r1, #1
+\tsub\tsp, r11, #4
+\tpop\t{{r4, r11, pc}}
+\t.p2align\t2
+.L{name}_pool:
+\t.long\t{data}(GOT_PREL)-((.L{name}_pc+8)-.L{name}_pool)
+.L{name}_end:
+\t.size\t{name}, .L{name}_end-{name}
+\t.cfi_endproc
+\t.fnend
+\t.section\t.rodata.str1.1,"aMS",%progbits,1
+.L{name}_str:
+\t.asciz\t"{string}"
+'''
+
+# A loop over an array plus a call and a global load on the slow path, the typical shape of AOT compiled methods.
+# Typed pointers, so that the IR can be read by every LLVM version the tools are built from.
+IR_FUNCTION = '''\
+define i32 @{name}(i64* %array, i32 %count) {{
+entry:
+  %slow = icmp sgt i32 %count, {imm}
+  br i1 %slow, label %call, label %loop
+
+call:
+  %value = load i64, i64* @{data}, align 8
+  %result = call i32 @{callee}(i64* %array, i32 {imm})
+  %extended = sext i32 %result to i64
+  %start = add i64 %value, %extended
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ 0, %call ], [ %next, %loop ]
+  %sum = phi i64 [ 0, %entry ], [ %start, %call ], [ %new_sum, %loop ]
+  %element_ptr = getelementptr inbounds i64, i64* %array, i32 %i
+  %element = load i64, i64* %element_ptr, align 8
+  %scaled = mul i64 %element, {factor}
+  %new_sum = add i64 %sum, %scaled
+  store i64 %new_sum, i64* %element_ptr, align 8
+  %next = add nuw nsw i32 %i, 1
+  %done = icmp sge i32 %next, %count
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %truncated = trunc i64 %new_sum to i32
+  ret i32 %truncated
+}}
+
+'''
+
+FUNCTION_TEMPLATES = {
+    'aarch64-linux-android': AARCH64_FUNCTION,
+    'arm-linux-androideabi': ARM_FUNCTION,
+    'i686-linux-android': I686_FUNCTION,
+    'x86_64-linux-android': X86_64_FUNCTION,
+}
+
+
+def pointer_directive(triple):
+    return '.quad' if triple.startswith(('aarch64', 'x86_64')) else '.long'
+
+
+def generate_file(triple, file_index, rng):
+    prefix = f'm{file_index}'
+    template = FUNCTION_TEMPLATES[triple]
+    pointer = pointer_directive(triple)
+    object_type = '%object' if triple.startswith('arm') else '@object'
+    lines = []
+
+    for i in range(FUNCTIONS_PER_FILE):
+        frame = rng.choice((32, 48, 64, 96))
+        # Calls go both to functions defined in the same file and to ones defined in the other files, like calls into
+        # other AOT images and the runtime
+        callee_file = file_index if rng.random() < 0.7 else rng.randrange(FILES_PER_TARGET)
+        lines.append(template.format(
+            name=f'{prefix}_method_{i}',
+            frame=frame,
+            frame_lr=frame - 8,
+            imm=rng.randrange(0, 200),
+            data=f'{prefix}_blob_{rng.randrange(DATA_BLOBS_PER_FILE)}',
+            callee=f'm{callee_file}_method_{rng.randrange(FUNCTIONS_PER_FILE)}',
+            string=f'System.Method{i}::Invoke(object,intptr,intptr)',
+        ))
+
+    for i in range(DATA_BLOBS_PER_FILE):
+        lines.append('\t.section\t.data.rel.ro,"aw"\n')
+        lines.append(f'\t.globl\t{prefix}_blob_{i}\n\t.type\t{prefix}_blob_{i},{object_type}\n\t.p2align\t3\n')
+        lines.append(f'{prefix}_blob_{i}:\n')
+        for _ in range(rng.randrange(4, 16)):
+            lines.append(f'\t{pointer}\t{prefix}_method_{rng.randrange(FUNCTIONS_PER_FILE)}\n')
+        for _ in range(rng.randrange(8, 32)):
+            values = ','.join(str(rng.randrange(256)) for _ in range(16))
+            lines.append(f'\t.byte\t{values}\n')
+        lines.append(f'\t.size\t{prefix}_blob_{i}, .-{prefix}_blob_{i}\n')
+
+    return ''.join(lines)
+
+
+def generate_ir_file(file_index, rng):
+    prefix = f'llvm{file_index}'
+    lines = []
+
+    for i in range(IR_GLOBALS_PER_FILE):
+        lines.append(f'@{prefix}_global_{i} = global i64 {rng.randrange(1 << 32)}, align 8\n')
+    lines.append('\n')
+
+    for i in range(IR_FUNCTIONS_PER_FILE):
+        lines.append(IR_FUNCTION.format(
+            name=f'{prefix}_method_{i}',
+            imm=rng.randrange(0, 200),
+            factor=rng.randrange(2, 1000),
+            data=f'{prefix}_global_{rng.randrange(IR_GLOBALS_PER_FILE)}',
+            callee=f'{prefix}_method_{rng.randrange(IR_FUNCTIONS_PER_FILE)}',
+        ))
+
+    return ''.join(lines)
+
+
+def generate(args):
+    rng = random.Random(0x5eed)  # the corpus must be the same on every build
+
+    for triple in TARGETS:
+        target_dir = os.path.join(args.corpus_dir, triple)
+        os.makedirs(target_dir, exist_ok=True)
+        for file_index in range(FILES_PER_TARGET):
+            with open(os.path.join(target_dir, f'aot-{file_index}.s'), 'w') as f:
+                f.write(generate_file(triple, file_index, rng))
+        for file_index in range(IR_FILES_PER_TARGET):
+            with open(os.path.join(target_dir, f'aot-llvm-{file_index}.ll'), 'w') as f:
+                f.write(generate_ir_file(file_index, rng))
+
+    return 0
+
+
+def tool_path(bin_dir, name):
+    path = os.path.join(bin_dir, name)
+    if sys.platform == 'win32':
+        path += '.exe'
+    return path
+
+
+def run_tool(args):
+    result = subprocess.run(args, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr.decode(errors='replace'))
+        raise RuntimeError(f'{os.path.basename(args[0])} failed with exit code {result.returncode}')
+
+
+def run_workload(bin_dir, corpus_dir, work_dir):
+    """Runs the workload once, returns the time spent in llvm-mc, llc and lld (in seconds)"""
+    llvm_mc = tool_path(bin_dir, 'llvm-mc')
+    llc = tool_path(bin_dir, 'llc')
+    lld = tool_path(bin_dir, 'lld')
+    mc_time = 0.0
+    llc_time = 0.0
+    ld_time = 0.0
+
+    if os.path.isdir(work_dir):
+        shutil.rmtree(work_dir)
+
+    for triple, mc_triple in TARGETS.items():
+        target_corpus = os.path.join(corpus_dir, triple)
+        if not os.path.isdir(target_corpus):
+            continue
+
+        target_work = os.path.join(work_dir, triple)
+        os.makedirs(target_work)
+
+        objects = []
+        for source in sorted(os.listdir(target_corpus)):
+            base, ext = os.path.splitext(source)
+            obj = os.path.join(target_work, base + '.o')
+            start = time.perf_counter()
+            if ext == '.s':
+                run_tool([llvm_mc, f'--triple={mc_triple}', '--filetype=obj', '-o', obj, os.path.join(target_corpus, source)])
+                mc_time += time.perf_counter() - start
+            elif ext in ('.ll', '.bc'):
+                run_tool([llc, f'-mtriple={mc_triple}', '-O2', '-relocation-model=pic', '-filetype=obj', '-o', obj,
+                          os.path.join(target_corpus, source)])
+                llc_time += time.perf_counter() - start
+            else:
+                continue
+            objects.append(obj)
+
+        if not objects:
+            continue
+
+        start = time.perf_counter()
+        run_tool([lld, '-flavor', 'gnu', '--relocatable', '-o', os.path.join(target_work, 'merged.o')] + objects)
+        run_tool([lld, '-flavor', 'gnu', '-shared', '--gc-sections', '-o', os.path.join(target_work, 'libaot.so')] + objects)
+        ld_time += time.perf_counter() - start
+
+    return mc_time, llc_time, ld_time
+
+
+def run(args):
+    mc_time, llc_time, ld_time = run_workload(args.bin_dir, args.corpus_dir, args.work_dir)
+    print(f'Workload done: llvm-mc {mc_time:.2f}s, llc {llc_time:.2f}s, lld {ld_time:.2f}s')
+    return 0
+
+
+def best_of(runs, bin_dir, corpus_dir, work_dir):
+    results = [run_workload(bin_dir, corpus_dir, work_dir) for _ in range(runs)]
+    return tuple(min(r[i] for r in results) for i in range(len(results[0])))
+
+
+def speedup(before, after):
+    return f'{(before / after - 1.0) * 100.0:+.1f}%' if after > 0 else 'n/a'
+
+
+def benchmark(args):
+    baseline = best_of(args.runs, args.baseline_bin_dir, args.corpus_dir, args.work_dir)
+    optimized = best_of(args.runs, args.optimized_bin_dir, args.corpus_dir, args.work_dir)
+
+    sources = 0
+    size = 0
+    for triple in TARGETS:
+        target_corpus = os.path.join(args.corpus_dir, triple)
+        if not os.path.isdir(target_corpus):
+            continue
+        for source in os.listdir(target_corpus):
+            if source.endswith(('.s', '.ll', '.bc')):
+                sources += 1
+                size += os.path.getsize(os.path.join(target_corpus, source))
+
+    print('PGO + ThinLTO build of llvm-mc, llc and lld')
+    print()
+    print(f'Workload: {sources} assembly and LLVM IR files ({size / (1024 * 1024):.1f} MiB), assembled or compiled for all')
+    print(f'targets, then merged with `ld -r` and linked into a shared library.  Best of {args.runs} runs.')
+    print()
+    print(f'{"":10} {"baseline":>10} {"optimized":>10} {"speedup":>9}')
+    for name, before, after in zip(('llvm-mc', 'llc', 'lld'), baseline, optimized):
+        print(f'{name:10} {before:9.2f}s {after:9.2f}s {speedup(before, after):>9}')
+    total_before = sum(baseline)
+    total_after = sum(optimized)
+    print(f'{"total":10} {total_before:9.2f}s {total_after:9.2f}s {speedup(total_before, total_after):>9}')
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='LLVM PGO training and benchmark workload')
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    cmd = commands.add_parser('generate', help='generate the synthetic AOT assembly corpus')
+    cmd.add_argument('corpus_dir')
+    cmd.set_defaults(func=generate)
+
+    cmd = commands.add_parser('run', help='run the workload once (used to collect the profile)')
+    cmd.add_argument('bin_dir')
+    cmd.add_argument('corpus_dir')
+    cmd.add_argument('work_dir')
+    cmd.set_defaults(func=run)
+
+    cmd = commands.add_parser('benchmark', help='compare two builds of the tools and print a report')
+    cmd.add_argument('baseline_bin_dir')
+    cmd.add_argument('optimized_bin_dir')
+    cmd.add_argument('corpus_dir')
+    cmd.add_argument('work_dir')
+    cmd.add_argument('--runs', type=int, default=3)
+    cmd.set_defaults(func=benchmark)
+
+    args = parser.parse_args()
+    try:
+        return args.func(args)
+    except RuntimeError as e:
+        print(f'error: {e}', file=sys.stderr)
+        return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Check of `--reproducible-paths`: assembles the same sources in two directories with different absolute paths and
+# compares the object files byte for byte.
+#
+# Two sources are checked, one with the `.file`/`.loc` line information compilers emit and one plain assembly source
+# assembled with `-g`, for which llvm-mc generates the debug information itself (including the compilation
+# directory).  Each is also assembled without `--reproducible-paths`, to show that the check notices when the output
+# depends on the directory.  SOURCE adds a source of your own to the checked ones.
+#
+# Usage:
+#
+#   reproducible-paths-check.py AS [--triple TRIPLE] [--source SOURCE] [--keep]
+#
+# AS is the `as` wrapper, run as `AS @gas-arch=TRIPLE-as`, so that it doesn't need to be installed under the target
+# specific name.  The exit code is 1 if any output assembled with `--reproducible-paths` differs between the
+# directories.
+#
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+DEFAULT_TRIPLE = 'x86_64-linux-android'
+
+# Relative to the build directory, like the sources of a real build
+SOURCE_SUBDIR = os.path.join('obj', 'src')
+
+LINE_INFO_SOURCE = '''\t.text
+\t.file 1 "lib/helper.c"
+\t.globl helper
+\t.type helper,@function
+helper:
+\t.loc 1 3 0
+\t.cfi_startproc
+\tnop
+\t.loc 1 4 0
+\tret
+\t.cfi_endproc
+\t.size helper, .-helper
+'''
+
+PLAIN_SOURCE = '''\t.text
+\t.globl plain
+\t.type plain,@function
+plain:
+\tnop
+\tret
+\t.size plain, .-plain
+'''
+
+
+def assemble(as_path, triple, build_dir, source, flags):
+    output = os.path.join(SOURCE_SUBDIR, os.path.splitext(os.path.basename(source))[0] + '.o')
+    command = [as_path, f'@gas-arch={triple}-as', '--quiet'] + flags + ['-o', output, os.path.join(SOURCE_SUBDIR, os.path.basename(source))]
+    result = subprocess.run(command, cwd=build_dir, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    if result.returncode != 0:
+        raise RuntimeError(f'{" ".join(command)} failed in {build_dir}:\n{result.stdout.decode(errors="replace")}')
+
+    with open(os.path.join(build_dir, output), 'rb') as f:
+        return f.read()
+
+
+def first_difference(a, b):
+    for offset, (x, y) in enumerate(zip(a, b)):
+        if x != y:
+            return offset
+    return min(len(a), len(b))
+
+
+def compare(as_path, triple, build_dirs, source, flags):
+    outputs = [assemble(as_path, triple, build_dir, source, flags) for build_dir in build_dirs]
+    if outputs[0] == outputs[1]:
+        return 'identical', True
+
+    leaked = [build_dir for build_dir, output in zip(build_dirs, outputs) if build_dir.encode() in output]
+    details = f'differ at offset {first_difference(*outputs)} ({len(outputs[0])} and {len(outputs[1])} bytes)'
+    if leaked:
+        details += ', the build directory is embedded'
+    return details, False
+
+
+def main():
+    parser = argparse.ArgumentParser(description='check that --reproducible-paths makes the output independent of the build directory')
+    parser.add_argument('as_path', metavar='AS')
+    parser.add_argument('--triple', default=DEFAULT_TRIPLE)
+    parser.add_argument('--source', action='append', default=[], help='additional source to check')
+    parser.add_argument('--keep', action='store_true', help='keep the build directories')
+    args = parser.parse_args()
+
+    as_path = os.path.abspath(args.as_path)
+    work_dir = tempfile.mkdtemp(prefix='reproducible-paths-')
+
+    # Different lengths, so that a path which leaks into the output changes the offsets too
+    build_dirs = [os.path.join(work_dir, 'a', 'build'), os.path.join(work_dir, 'second-checkout', 'build')]
+
+    sources = []
+    for name, text in (('line-info.s', LINE_INFO_SOURCE), ('plain.s', PLAIN_SOURCE)):
+        path = os.path.join(work_dir, name)
+        with open(path, 'w') as f:
+            f.write(text)
+        sources.append(path)
+    sources += [os.path.abspath(source) for source in args.source]
+
+    for build_dir in build_dirs:
+        os.makedirs(os.path.join(build_dir, SOURCE_SUBDIR))
+        for source in sources:
+            shutil.copy(source, os.path.join(build_dir, SOURCE_SUBDIR))
+
+    failed = False
+    try:
+        print(f'Build directories: {build_dirs[0]}, {build_dirs[1]}')
+        print()
+        print(f'{"source":<24} {"flags":<26} result')
+        for source in sources:
+            for flags, must_match in (([], False), (['-g'], False), (['--reproducible-paths'], True), (['--reproducible-paths', '-g'], True)):
+                result, identical = compare(as_path, args.triple, build_dirs, source, flags)
+                if must_match and not identical:
+                    result += '  FAIL'
+                    failed = True
+                print(f'{os.path.basename(source):<24} {" ".join(flags) or "(none)":<26} {result}')
+    except RuntimeError as e:
+        print(f'error: {e}', file=sys.stderr)
+        failed = True
+    finally:
+        if not args.keep:
+            shutil.rmtree(work_dir, ignore_errors=True)
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Compares two reports written by the `as` wrapper's `--size-report=FILE` option, so that size regressions of the
+# generated objects show up in CI:
+#
+#   size-report-diff.py [--threshold PERCENT] [--min-bytes N] BASELINE.json NEW.json
+#
+# Prints the differences in section category sizes, section sizes, relocation counts and sizes of the largest
+# symbols.  Exits with 1 if the total size, the size of any category or the relocation count grew by more than
+# PERCENT (default: 1%) and at least N bytes (or relocations, default: 0), with 0 otherwise.
+#
+import argparse
+import json
+import sys
+
+
+def percent(before, after):
+    if before == 0:
+        return 'new' if after != 0 else '0.0%'
+    return f'{(after - before) * 100.0 / before:+.1f}%'
+
+
+def is_regression(before, after, args):
+    growth = after - before
+    if growth <= 0 or growth < args.min_bytes:
+        return False
+    return before == 0 or growth * 100.0 / before > args.threshold
+
+
+def print_changes(title, before, after, args):
+    names = sorted(set(before) | set(after), key=lambda name: -abs(after.get(name, 0) - before.get(name, 0)))
+    changes = [(name, before.get(name, 0), after.get(name, 0)) for name in names if before.get(name, 0) != after.get(name, 0)]
+    print(f'{title}: {len(changes)} changed')
+    for name, old, new in changes[:args.limit]:
+        print(f'  {name:<40} {old:>12} -> {new:>12} ({new - old:+}, {percent(old, new)})')
+    if len(changes) > args.limit:
+        print(f'  ... and {len(changes) - args.limit} more')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare two `as --size-report` reports')
+    parser.add_argument('baseline')
+    parser.add_argument('new')
+    parser.add_argument('--threshold', type=float, default=1.0, help='growth, in percent, reported as a regression')
+    parser.add_argument('--min-bytes', type=int, default=0, help='ignore growth smaller than this')
+    parser.add_argument('--limit', type=int, default=20, help='maximum number of changes to print per table')
+    args = parser.parse_args()
+
+    with open(args.baseline, encoding='utf-8') as f:
+        baseline = json.load(f)
+    with open(args.new, encoding='utf-8') as f:
+        new = json.load(f)
+
+    if baseline['machine'] != new['machine']:
+        print(f'warning: comparing {baseline["machine"]} with {new["machine"]} objects', file=sys.stderr)
+
+    regressions = []
+    print(f'Total size:          {baseline["total_size"]} -> {new["total_size"]} ({percent(baseline["total_size"], new["total_size"])})')
+    if is_regression(baseline['total_size'], new['total_size'], args):
+        regressions.append('total size')
+
+    before = baseline['relocations']['count']
+    after = new['relocations']['count']
+    print(f'Relocations:         {before} -> {after} ({percent(before, after)})')
+    if is_regression(before, after, args):
+        regressions.append('relocation count')
+
+    print(f'DWARF to code ratio: {baseline["dwarf_to_code_ratio"]:.3f} -> {new["dwarf_to_code_ratio"]:.3f}')
+    print()
+
+    print_changes('Categories', baseline['categories'], new['categories'], args)
+    for name, size in new['categories'].items():
+        if is_regression(baseline['categories'].get(name, 0), size, args):
+            regressions.append(f'{name} size')
+
+    print_changes('Sections', {s['name']: s['size'] for s in baseline['sections']}, {s['name']: s['size'] for s in new['sections']}, args)
+    print_changes('Relocations by type', baseline['relocations']['by_type'], new['relocations']['by_type'], args)
+
+    # Only the largest symbols are in the reports, a symbol missing from one of them may just have dropped out of it
+    before = {s['name']: s['size'] for s in baseline['symbols']['top']}
+    after = {s['name']: s['size'] for s in new['symbols']['top']}
+    common = set(before) & set(after)
+    print_changes('Largest symbols', {n: before[n] for n in common}, {n: after[n] for n in common}, args)
+
+    print()
+    if regressions:
+        print(f'Size regressions (over {args.threshold}%): {", ".join(regressions)}')
+        return 1
+
+    print('No size regressions')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())